@@ -0,0 +1,51 @@
+#ifndef SD_DEBUG_H
+#define SD_DEBUG_H
+
+#include "sword/def.h"
+#include "sword/math.h"
+#include "sword/render.h"
+
+// Immediate mode shapes for collision boxes, paths and grids. Everything
+// drawn in a frame goes into one stream of triangles and one of lines, which
+// are drawn over the final image with two draw calls, after lighting and post
+// processing. Positions are in world space of the current camera. Without
+// SD_DEBUG the calls compile to nothing.
+
+#ifdef SD_DEBUG
+
+SDAPI void SDDebugDrawLine(SDVec2 from, SDVec2 to, SDColor color);
+// Outline of rect placed by transform, e.g. an oriented collision box
+SDAPI void SDDebugDrawRect(SDRect rect, SDMat3 transform, SDColor color);
+SDAPI void SDDebugFillRect(SDRect rect, SDMat3 transform, SDColor color);
+SDAPI void SDDebugDrawCircle(SDVec2 center, SDFloat radius, SDColor color);
+// Square of size in point on the canvas, whatever the camera zoom
+SDAPI void SDDebugDrawPoint(SDVec2 position, SDFloat size, SDColor color);
+
+// Calls to one GL function in the last finished frame. Every GL call goes
+// through hooks of the debug GL loader which count and time it, so times are
+// of the CPU side and include the error check after each call.
+typedef struct SDGLCallStats {
+  const char *name;  // e.g. "glDrawElements"
+  int numCall;
+  SDFloat time;  // in seconds
+} SDGLCallStats;
+
+// Copy the stats of up to maxStats functions, the most time spent first, and
+// return how many were copied
+SDAPI int SDGetGLCallStats(SDGLCallStats *stats, int maxStats);
+// Print the stats of the last finished frame as a table
+SDAPI void SDDumpGLCallStats(void);
+
+#else
+
+#define SDDebugDrawLine(from, to, color) ((void)0)
+#define SDDebugDrawRect(rect, transform, color) ((void)0)
+#define SDDebugFillRect(rect, transform, color) ((void)0)
+#define SDDebugDrawCircle(center, radius, color) ((void)0)
+#define SDDebugDrawPoint(position, size, color) ((void)0)
+#define SDGetGLCallStats(stats, maxStats) 0
+#define SDDumpGLCallStats() ((void)0)
+
+#endif  // SD_DEBUG
+
+#endif  // SD_DEBUG_H
@@ -0,0 +1,46 @@
+#ifndef SD_LIGHT_H
+#define SD_LIGHT_H
+
+#include "sword/def.h"
+#include "sword/math.h"
+#include "sword/render.h"
+
+// 2D lights are accumulated into a lower resolution light buffer which is then
+// multiplied over the scene in a single pass. With lighting enabled, anything
+// not reached by a light is shaded with the ambient color.
+typedef struct SDLightingParams {
+  int enabled;
+  SDColor ambientColor;
+  SDFloat resolutionScale;  // Light buffer size relative to the scene
+
+  // Bin lights into screen tiles on the CPU and shade every tile with only the
+  // lights touching it, in one pass. Cheaper than drawing each light when many
+  // of them overlap.
+  int tiledCulling;
+} SDLightingParams;
+
+SDAPI SDLightingParams SDMakeLightingParams(void);
+// Must be called after the render context is created, e.g. in load callback
+SDAPI void SDSetLighting(const SDLightingParams *params);
+
+typedef struct SDLight {
+  SDVec2 position;
+  SDFloat radius;  // Falls off to zero at radius
+  SDColor color;   // Alpha is the intensity
+
+  // Spot lights only light the cone of coneAngle radians on either side of
+  // direction. Point lights have a coneAngle of pi.
+  SDVec2 direction;
+  SDFloat coneAngle;
+} SDLight;
+
+SDAPI SDLight SDMakePointLight(SDVec2 position, SDFloat radius, SDColor color);
+SDAPI SDLight SDMakeSpotLight(SDVec2 position, SDFloat radius,
+                              SDVec2 direction, SDFloat coneAngle,
+                              SDColor color);
+
+// Queue a light for this frame, placed through the current camera. Lights are
+// drawn together after the render callback returns.
+SDAPI void SDDrawLight(const SDLight *light);
+
+#endif  // SD_LIGHT_H
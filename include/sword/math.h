@@ -13,6 +13,8 @@ typedef float SDFloat;
 
 SDINLINE SDFloat SDMinF(SDFloat x, SDFloat y) { return x <= y ? x : y; }
 
+SDINLINE SDFloat SDMaxF(SDFloat x, SDFloat y) { return x >= y ? x : y; }
+
 SDINLINE SDFloat SDAbsF(SDFloat x) { return fabsf(x); }
 
 SDINLINE SDFloat SDFloorF(SDFloat x) { return floorf(x); }
@@ -139,6 +141,32 @@ SDINLINE SDMat3 SDDotM3(SDMat3 t1, SDMat3 t2) {
   return result;
 }
 
+// Inverse of an affine transform
+SDINLINE SDMat3 SDInverseM3(SDMat3 t) {
+  SDMat3 result = SDIdentityM3();
+
+  SDFloat det = t.m00 * t.m11 - t.m01 * t.m10;
+  if (det == 0.0f) {
+    return result;
+  }
+  SDFloat invDet = 1.0f / det;
+
+  result.m00 = t.m11 * invDet;
+  result.m01 = -t.m01 * invDet;
+  result.m10 = -t.m10 * invDet;
+  result.m11 = t.m00 * invDet;
+  result.m02 = -(result.m00 * t.m02 + result.m01 * t.m12);
+  result.m12 = -(result.m10 * t.m02 + result.m11 * t.m12);
+
+  return result;
+}
+
+// Transform a point, i.e. a column vector (x, y, 1)
+SDINLINE SDVec2 SDDotM3V2(SDMat3 t, SDVec2 p) {
+  return (SDVec2){t.m00 * p.x + t.m01 * p.y + t.m02,
+                  t.m10 * p.x + t.m11 * p.y + t.m12};
+}
+
 // ----------------------------------------------------------------------------
 // Rectangle
 // ----------------------------------------------------------------------------
@@ -155,4 +183,19 @@ SDINLINE SDRect SDRectMinMax(SDVec2 min, SDVec2 max) {
   return (SDRect){min, max};
 }
 
+// Axis-aligned bounding box of a rect after an affine transform
+SDINLINE SDRect SDTransformRectM3(SDMat3 t, SDRect rect) {
+  SDVec2 p0 = SDDotM3V2(t, rect.min);
+  SDVec2 p1 = SDDotM3V2(t, SDV2(rect.max.x, rect.min.y));
+  SDVec2 p2 = SDDotM3V2(t, rect.max);
+  SDVec2 p3 = SDDotM3V2(t, SDV2(rect.min.x, rect.max.y));
+
+  SDRect result;
+  result.min.x = SDMinF(SDMinF(p0.x, p1.x), SDMinF(p2.x, p3.x));
+  result.min.y = SDMinF(SDMinF(p0.y, p1.y), SDMinF(p2.y, p3.y));
+  result.max.x = SDMaxF(SDMaxF(p0.x, p1.x), SDMaxF(p2.x, p3.x));
+  result.max.y = SDMaxF(SDMaxF(p0.y, p1.y), SDMaxF(p2.y, p3.y));
+  return result;
+}
+
 #endif  // SD_MATH_H
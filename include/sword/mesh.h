@@ -0,0 +1,31 @@
+#ifndef SD_MESH_H
+#define SD_MESH_H
+
+#include "sword/def.h"
+#include "sword/math.h"
+#include "sword/render.h"
+
+typedef struct SDMeshVertex {
+  SDVec2 position;  // in point
+  SDVec2 texCoord;  // Texture space (pixel), ignored without a texture
+  SDColor color;    // Straight alpha
+} SDMeshVertex;
+
+// Triangles uploaded to static GPU buffers once at creation, for geometry that
+// does not change such as level outlines, terrain strips and decorations.
+typedef struct SDMesh SDMesh;
+
+/**
+ * Copy numIndex / 3 triangles indexing into vertices to the GPU. The mesh is
+ * drawn with texture multiplied by the vertex colors, or with the vertex
+ * colors alone when texture is NULL. The texture must outlive the mesh.
+ */
+SDAPI SDMesh *SDCreateMesh(const SDMeshVertex *vertices, int numVertex,
+                           const unsigned int *indices, int numIndex,
+                           SDTexture *texture);
+SDAPI void SDDestroyMesh(SDMesh **mesh);
+
+// One draw call with no vertex upload, skipped when outside the camera
+SDAPI void SDDrawMesh(const SDMesh *mesh, SDMat3 transform, SDColor tintColor);
+
+#endif  // SD_MESH_H
@@ -0,0 +1,52 @@
+#ifndef SD_PARTICLE_H
+#define SD_PARTICLE_H
+
+#include "sword/def.h"
+#include "sword/math.h"
+#include "sword/render.h"
+
+// Particles stored in structure-of-arrays form, updated in bulk and drawn with
+// a single instanced draw call.
+typedef struct SDParticleSystem SDParticleSystem;
+
+typedef struct SDParticleSystemParams {
+  SDTexture *atlas;  // Frames laid out in rows, frame 0 at top left
+  int frameWidth;    // Size of one atlas frame in pixel
+  int frameHeight;
+  int capacity;    // Max number of alive particles
+  SDVec2 gravity;  // Acceleration applied to every particle
+  int multithreaded;  // Split update across worker threads
+} SDParticleSystemParams;
+
+SDAPI SDParticleSystemParams SDMakeParticleSystemParams(SDTexture *atlas);
+
+// Returns NULL when the atlas is smaller than a frame
+SDAPI SDParticleSystem *SDCreateParticleSystem(
+    const SDParticleSystemParams *params);
+SDAPI void SDDestroyParticleSystem(SDParticleSystem **particleSystem);
+
+typedef struct SDEmitParticleParams {
+  SDVec2 position;
+  SDVec2 velocity;
+  SDFloat lifetime;  // in seconds, the particle fades out over it
+  SDFloat size;      // in point
+  int frame;         // Atlas frame index
+  SDColor color;     // Straight alpha
+} SDEmitParticleParams;
+
+SDAPI SDEmitParticleParams SDMakeEmitParticleParams(SDVec2 position);
+
+// Particles emitted beyond capacity are dropped
+SDAPI void SDEmitParticle(SDParticleSystem *particleSystem,
+                          const SDEmitParticleParams *params);
+
+// Simulate dt seconds and remove dead particles
+SDAPI void SDUpdateParticleSystem(SDParticleSystem *particleSystem,
+                                  SDFloat dt);
+
+SDAPI int SDGetParticleCount(const SDParticleSystem *particleSystem);
+
+SDAPI void SDDrawParticleSystem(SDParticleSystem *particleSystem,
+                                SDMat3 transform);
+
+#endif  // SD_PARTICLE_H
@@ -9,11 +9,37 @@ typedef void (*SDUpdateCallback)(void *gameState);
 typedef void (*SDRenderCallback)(void *gameState);
 
 SDAPI void SDSetExitOnEsc(int exitOnEsc);
+// Must be called before SDRun
+SDAPI void SDSetWindowHidden(int hidden);
+// Run GL on a dedicated render thread. The main thread records each frame while
+// the render thread draws the one before, so stats and the resolution scale lag
+// a frame behind. Must be called before SDRun
+SDAPI void SDSetRenderThread(int enabled);
+
+// Where rendering goes. The null backend runs without a window or GL context:
+// the renderer does all of its CPU work, e.g. batching, culling and building
+// vertices, but every GL call does nothing, so captures come back blank. The
+// recording backend also keeps the draw calls of each frame, see
+// SDGetSubmittedDraws. The software backend rasterizes sprite batches, sprite
+// buffers and layers, meshes, tilemaps and particles on the CPU across the job
+// workers, so captures come back with them drawn; lighting, post processing
+// and material shaders are left out.
+typedef enum SDRenderBackend {
+  SD_RENDER_BACKEND_GL,
+  SD_RENDER_BACKEND_NULL,
+  SD_RENDER_BACKEND_RECORDING,
+  SD_RENDER_BACKEND_SOFTWARE,
+} SDRenderBackend;
+
+// Must be called before SDRun
+SDAPI void SDSetRenderBackend(SDRenderBackend backend);
 SDAPI void SDSetGameState(void *gameState);
 SDAPI void SDSetLoadCallback(SDLoadCallback load);
 SDAPI void SDSetUpdateCallback(SDUpdateCallback update);
 SDAPI void SDSetRenderCallback(SDRenderCallback render);
 
 SDAPI void SDRun(void);
+// Stop the main loop, SDRun returns once the current frame is done
+SDAPI void SDQuit(void);
 
 #endif  // SD_PLATFORM_H
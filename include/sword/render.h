@@ -4,6 +4,8 @@
 #include "sword/def.h"
 #include "sword/math.h"
 
+#include <stddef.h>
+
 // Normalized color
 typedef struct SDColor {
   SDFloat r, g, b, a;
@@ -32,16 +34,185 @@ SDAPI float SDGetCanvasHeight(void);
 SDAPI float SDGetPointToPixel(void);
 SDAPI float SDGetPixelToPoint(void);
 
+// Counters of the last finished frame
+typedef struct SDRenderStats {
+  int numDrawCall;
+  SDFloat cpuFrameTime;  // Seconds from frame start to submitting the frame
+} SDRenderStats;
+
+SDAPI SDRenderStats SDGetRenderStats(void);
+
+// A draw call of the last finished frame, only kept by the recording backend.
+// Objects are GL names, equal between draws using the same one.
+typedef struct SDSubmittedDraw {
+  int numElement;  // Vertices or indices, summed over the draws of a multi-draw
+  int numInstance;
+  int isLines;  // Rather than triangles
+  int isBlended;
+  int isScissored;
+  unsigned int program;
+  unsigned int texture;      // on the first texture unit
+  unsigned int framebuffer;  // 0 for the window
+} SDSubmittedDraw;
+
+// Draw calls of the last finished frame in order, valid until the next one
+SDAPI const SDSubmittedDraw *SDGetSubmittedDraws(int *numDraw);
+
 // ----------------------------------------------------------------------------
 // Render State
 // ----------------------------------------------------------------------------
 
+// Save the render state, i.e. the clip rect, to be restored by SDPopState
 SDAPI void SDPushState(void);
 SDAPI void SDPopState(void);
 
+// Push the state and clip drawing to rect, in world space of the current
+// camera, intersected with the clip rect pushed before. Axis aligned sprites
+// and nine-slices are trimmed on the CPU and keep batching, anything else
+// partly clipped flushes the batch once to set a scissor.
+SDAPI void SDPushClipRect(SDRect rect);
+SDAPI void SDPopClipRect(void);
+
 SDAPI void SDPushMatrix(SDMat3 mat);
 SDAPI void SDPopMatrix(void);
 
+// ----------------------------------------------------------------------------
+// Camera
+// ----------------------------------------------------------------------------
+
+typedef struct SDCamera {
+  SDVec2 position;   // World position shown at the center of the viewport
+  SDFloat zoom;      // Points on the canvas per world unit
+  SDFloat rotation;  // Rotation of the view in radians
+  SDRect viewport;   // Area of the canvas drawn to, in point
+
+  // Computed by SDBeginCamera
+  SDMat3 view;            // World to canvas
+  SDMat3 viewProjection;  // World to clip space
+  SDRect visibleBounds;   // World space box containing everything visible
+} SDCamera;
+
+// Camera showing the whole canvas, centered on the canvas center
+SDAPI SDCamera SDMakeCamera(void);
+
+/**
+ * Draw through camera until SDEndCamera, clipped to its viewport. Draw a scene
+ * once per camera for split screen or a minimap: cached shapes, tilemap chunks
+ * and particle buffers are shared between views. Cameras do not nest, outside
+ * of them drawing uses the whole canvas in canvas coordinates.
+ */
+SDAPI void SDBeginCamera(SDCamera *camera);
+SDAPI void SDEndCamera(void);
+
+// ----------------------------------------------------------------------------
+// Dynamic Resolution
+// ----------------------------------------------------------------------------
+
+// Render into an offscreen target whose size is a fraction of the viewport and
+// upscale it to the window. The fraction is adjusted every frame from the
+// measured GPU and CPU frame time against the target budget.
+typedef struct SDDynamicResolutionParams {
+  int enabled;
+  SDFloat targetFrameTime;  // Frame time budget in seconds
+  SDFloat minScale;         // Lowest fraction of viewport size
+  SDFloat maxScale;         // Highest fraction of viewport size
+} SDDynamicResolutionParams;
+
+SDAPI SDDynamicResolutionParams SDMakeDynamicResolutionParams(void);
+// Must be called after the render context is created, e.g. in load callback.
+// Settings take effect from the next frame.
+SDAPI void SDSetDynamicResolution(const SDDynamicResolutionParams *params);
+// Get the fraction of viewport size the scene is currently rendered at
+SDAPI SDFloat SDGetResolutionScale(void);
+
+// ----------------------------------------------------------------------------
+// Post Processing
+// ----------------------------------------------------------------------------
+
+// Effects applied to the scene after the render callback. Disabled effects
+// cost nothing, with all of them disabled the scene goes straight to the
+// window.
+typedef struct SDPostProcessParams {
+  int bloomEnabled;
+  SDFloat bloomThreshold;  // Brightness above which pixels bloom
+  SDFloat bloomIntensity;
+  // More passes for wider bloom, at half resolution, up to 16
+  int bloomBlurPasses;
+
+  int colorGradingEnabled;
+  SDFloat exposure;
+  SDFloat contrast;
+  SDFloat saturation;
+  SDColor colorFilter;  // Multiplied with the graded color
+
+  int vignetteEnabled;
+  SDFloat vignetteIntensity;
+  SDFloat vignetteRadius;  // Distance from the center where darkening starts
+  SDFloat vignetteSoftness;
+} SDPostProcessParams;
+
+SDAPI SDPostProcessParams SDMakePostProcessParams(void);
+// Must be called after the render context is created, e.g. in load callback
+SDAPI void SDSetPostProcess(const SDPostProcessParams *params);
+
+// ----------------------------------------------------------------------------
+// Frame Capture
+// ----------------------------------------------------------------------------
+
+typedef struct SDFrameCapture {
+  int width;  // in pixels
+  int height;
+  const unsigned char *pixels;  // RGBA8, rows from top to bottom
+  const unsigned char *qoi;     // The same pixels encoded as a QOI image
+  size_t qoiSize;
+} SDFrameCapture;
+
+// Called on a background thread, capture is only valid during the call
+typedef void (*SDCaptureFrameCallback)(const SDFrameCapture *capture,
+                                       void *userData);
+
+/**
+ * Capture the window once the current frame is rendered. The pixels are read
+ * back without stalling the GPU and handed to callback a frame or two later.
+ * When many captures are in flight, later ones are taken on following frames.
+ */
+SDAPI void SDCaptureFrame(SDCaptureFrameCallback callback, void *userData);
+
+// ----------------------------------------------------------------------------
+// Frame Recording
+// ----------------------------------------------------------------------------
+
+/**
+ * Write the render calls of the next frame to a file at path, along with the
+ * contents of the textures and the source of the materials they use, and the
+ * lighting and post processing settings. Replaying the file draws the frame
+ * again without the game, e.g. with sword_replay, to profile the renderer.
+ * Meshes, sprite buffers, sprite layers, tilemaps and particle systems are
+ * recorded as meshes of what they drew, replayed with a draw call each. Files
+ * are read back only by the same build of the engine.
+ */
+SDAPI void SDRecordFrame(const char *path);
+
+typedef struct SDFrameRecording SDFrameRecording;
+
+typedef struct SDFrameRecordingInfo {
+  SDFloat canvasWidth;  // Of the recorded frame, in point
+  SDFloat canvasHeight;
+  int numCall;
+  int numTexture;
+  int numMaterial;
+  int numMesh;
+} SDFrameRecordingInfo;
+
+// Create the textures, materials and meshes of a recording and apply its
+// settings. Returns NULL if the file cannot be read.
+SDAPI SDFrameRecording *SDLoadFrameRecording(const char *path);
+SDAPI void SDDestroyFrameRecording(SDFrameRecording **recording);
+SDAPI SDFrameRecordingInfo SDGetFrameRecordingInfo(
+    const SDFrameRecording *recording);
+// Issue the recorded calls again, from the render callback
+SDAPI void SDReplayFrameRecording(const SDFrameRecording *recording);
+
 // ----------------------------------------------------------------------------
 // Image
 // ----------------------------------------------------------------------------
@@ -58,11 +229,39 @@ typedef struct SDImage {
   int stride;
   int format;
   void *data;
+  // RGBA8 images not yet pre-multiplied are pre-multiplied when loaded into a
+  // texture. Images from SDLoadImage already are.
+  int isPremultiplied;
 } SDImage;
 
 SDAPI SDImage *SDLoadImage(const char *path);
 SDAPI void SDDestroyImage(SDImage **image);
 
+// ----------------------------------------------------------------------------
+// Material
+// ----------------------------------------------------------------------------
+
+// Parameters a material reads per draw, in vec4
+#define SD_MAX_MATERIAL_PARAM 4
+
+// A custom fragment shader for SDDrawTexture. The parameters of each draw are
+// stored in a shared uniform buffer and picked by an index in its vertices, so
+// draws of one material with different parameters still batch together.
+typedef struct SDMaterial SDMaterial;
+
+/**
+ * Create a material from GLSL 3.30 code defining
+ *
+ *   vec4 Shade(vec2 texCoord, vec4 color)
+ *
+ * which returns the pre-multiplied color of a fragment, given the texture
+ * coordinate and tint color of the draw. The code can sample the texture of
+ * the draw through texture0 and read its numParam parameters with SDParam(i).
+ * Compile errors are printed and the material then draws like no material.
+ */
+SDAPI SDMaterial *SDCreateMaterial(const char *source, int numParam);
+SDAPI void SDDestroyMaterial(SDMaterial **material);
+
 // ----------------------------------------------------------------------------
 // Texture
 // ----------------------------------------------------------------------------
@@ -76,12 +275,25 @@ SDAPI SDTexture *SDLoadTexture(const char *path);
 SDAPI SDTexture *SDLoadTextureFromImage(const SDImage *image);
 SDAPI void SDDestroyTexture(SDTexture **texture);
 
+// How drawn colors combine with what is already on the canvas. Alpha and
+// additive draws share the blend state and batch together, the others break
+// the batch when the mode changes.
+typedef enum SDBlendMode {
+  SD_BLEND_MODE_ALPHA,     // Pre-multiplied alpha blending
+  SD_BLEND_MODE_ADDITIVE,  // Tint alpha scales the added color
+  SD_BLEND_MODE_MULTIPLY,
+  SD_BLEND_MODE_SCREEN,
+} SDBlendMode;
+
 typedef struct SDDrawTextureParams {
   SDTexture *texture;
   SDMat3 transform;
   SDRect dstRect;  // Destination rect in world space
   SDRect srcRect;  // Source rect in texture space (pixel)
   SDColor tintColor;
+  SDBlendMode blendMode;
+  SDMaterial *material;  // NULL for the plain texture shader
+  SDFloat materialParams[SD_MAX_MATERIAL_PARAM * 4];
 } SDDrawTextureParams;
 
 SDAPI SDDrawTextureParams SDMakeDrawTextureParams(SDTexture *texture);
@@ -96,6 +308,24 @@ SDAPI SDDrawTextureParams SDMakeDrawTextureParams(SDTexture *texture);
  */
 SDAPI void SDDrawTexture(const SDDrawTextureParams *params);
 
+// Distance from each edge of a texture in pixel
+typedef struct SDInsets {
+  SDFloat left, top, right, bottom;
+} SDInsets;
+
+SDINLINE SDInsets SDMakeInsets(SDFloat left, SDFloat top, SDFloat right,
+                               SDFloat bottom) {
+  return (SDInsets){left, top, right, bottom};
+}
+
+/**
+ * Draw texture stretched over dstRect keeping the corners at their size. The
+ * edges stretch along one axis and the center along both. Up to 9 quads go
+ * into the batch at once, slices with zero size are skipped.
+ */
+SDAPI void SDDrawNineSlice(SDTexture *texture, SDInsets insets, SDRect dstRect,
+                           SDMat3 transform, SDColor tintColor);
+
 // ----------------------------------------------------------------------------
 // Shape
 // ----------------------------------------------------------------------------
@@ -109,6 +339,51 @@ typedef struct SDDrawRectParams {
 
 SDAPI SDDrawRectParams SDMakeDrawRectParams(SDRect rect);
 
+/**
+ * Shapes go through the sprite batch. Colors are straight alpha. Borders of
+ * rects and circles are drawn inside the shape, polygon borders are centered
+ * on the outline. Tessellation is cached by shape parameters and the
+ * number of segments of curves adapts to their size on screen, so shapes
+ * drawn again with the same parameters cost no tessellation.
+ */
 SDAPI void SDDrawRect(const SDDrawRectParams *params);
 
+typedef struct SDDrawCircleParams {
+  SDVec2 center;
+  SDFloat radius;
+  SDFloat borderWidth;
+  SDColor strokeColor;
+  SDColor fillColor;
+} SDDrawCircleParams;
+
+SDAPI SDDrawCircleParams SDMakeDrawCircleParams(SDVec2 center, SDFloat radius);
+
+SDAPI void SDDrawCircle(const SDDrawCircleParams *params);
+
+typedef enum SDLineJoin {
+  SD_LINE_JOIN_MITER,  // Falls back to bevel for very sharp corners
+  SD_LINE_JOIN_BEVEL,
+  SD_LINE_JOIN_ROUND,
+} SDLineJoin;
+
+SDAPI void SDDrawLine(SDVec2 from, SDVec2 to, SDFloat width, SDColor color);
+
+SDAPI void SDDrawPolyline(const SDVec2 *points, int numPoint, SDFloat width,
+                          SDLineJoin join, SDColor color);
+
+// Simple polygon, may be concave
+typedef struct SDDrawPolygonParams {
+  const SDVec2 *points;
+  int numPoint;
+  SDFloat borderWidth;
+  SDLineJoin join;
+  SDColor strokeColor;
+  SDColor fillColor;
+} SDDrawPolygonParams;
+
+SDAPI SDDrawPolygonParams SDMakeDrawPolygonParams(const SDVec2 *points,
+                                                  int numPoint);
+
+SDAPI void SDDrawPolygon(const SDDrawPolygonParams *params);
+
 #endif  // SD_RENDER_H
@@ -0,0 +1,60 @@
+#ifndef SD_SPRITE_H
+#define SD_SPRITE_H
+
+#include "sword/def.h"
+#include "sword/math.h"
+#include "sword/render.h"
+
+// Sprites of one texture kept on the GPU between frames. Every sprite owns a
+// stable slot of the vertex buffer, changing it only marks the slot dirty and
+// the dirty slots are uploaded in coalesced ranges on the next draw.
+typedef struct SDSpriteBuffer SDSpriteBuffer;
+
+typedef struct SDSprite {
+  SDMat3 transform;
+  SDRect dstRect;  // Destination rect in buffer space
+  SDRect srcRect;  // Source rect in texture space (pixel)
+  SDColor tintColor;
+} SDSprite;
+
+// Sprite covering the whole texture at its size, like SDMakeDrawTextureParams
+SDAPI SDSprite SDMakeSprite(const SDTexture *texture);
+
+SDAPI SDSpriteBuffer *SDCreateSpriteBuffer(SDTexture *texture, int capacity);
+SDAPI void SDDestroySpriteBuffer(SDSpriteBuffer **spriteBuffer);
+
+// Returns the slot of the new sprite, or -1 when the buffer is full
+SDAPI int SDAddSprite(SDSpriteBuffer *spriteBuffer, const SDSprite *sprite);
+SDAPI void SDSetSprite(SDSpriteBuffer *spriteBuffer, int slot,
+                       const SDSprite *sprite);
+// The slot is reused by a later SDAddSprite, removing a free slot does nothing
+SDAPI void SDRemoveSprite(SDSpriteBuffer *spriteBuffer, int slot);
+
+// Upload the dirty slots and draw every sprite with one draw call
+SDAPI void SDDrawSpriteBuffer(SDSpriteBuffer *spriteBuffer, SDMat3 transform,
+                              SDColor tintColor);
+
+// Sprites of one texture drawn back to front by a sort key, usually the Y of
+// their feet for top-down scenes. The draw order of the last frame is kept and
+// only repaired, which is close to linear when few sprites change places, and
+// only slots whose sprite changed are uploaded again.
+typedef struct SDSpriteLayer SDSpriteLayer;
+
+SDAPI SDSpriteLayer *SDCreateSpriteLayer(SDTexture *texture, int capacity);
+SDAPI void SDDestroySpriteLayer(SDSpriteLayer **spriteLayer);
+
+// Returns the handle of the new sprite, or -1 when the layer is full. Sprites
+// with a larger sortKey are drawn over those with a smaller one, equal keys
+// keep their order.
+SDAPI int SDAddLayerSprite(SDSpriteLayer *spriteLayer, const SDSprite *sprite,
+                           SDFloat sortKey);
+SDAPI void SDSetLayerSprite(SDSpriteLayer *spriteLayer, int handle,
+                            const SDSprite *sprite, SDFloat sortKey);
+// The handle is reused by SDAddLayerSprite after the next SDDrawSpriteLayer
+SDAPI void SDRemoveLayerSprite(SDSpriteLayer *spriteLayer, int handle);
+
+// Sort the sprites and draw them with one draw call
+SDAPI void SDDrawSpriteLayer(SDSpriteLayer *spriteLayer, SDMat3 transform,
+                             SDColor tintColor);
+
+#endif  // SD_SPRITE_H
@@ -1,9 +1,15 @@
 #ifndef SD_SWORD_H
 #define SD_SWORD_H
 
+#include "sword/debug.h"
 #include "sword/entity.h"
+#include "sword/light.h"
 #include "sword/math.h"
+#include "sword/mesh.h"
+#include "sword/particle.h"
 #include "sword/platform.h"
 #include "sword/render.h"
+#include "sword/sprite.h"
+#include "sword/tilemap.h"
 
 #endif  // SD_SWORD_H
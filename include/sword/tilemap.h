@@ -0,0 +1,35 @@
+#ifndef SD_TILEMAP_H
+#define SD_TILEMAP_H
+
+#include "sword/def.h"
+#include "sword/math.h"
+#include "sword/render.h"
+
+// Tile index meaning "nothing is drawn here"
+#define SD_TILE_EMPTY (-1)
+
+// Grid of tiles drawn from a tileset texture. Tiles are stored in fixed-size
+// chunks, each of which keeps its geometry in a range of a shared GPU buffer
+// that is only rebuilt when one of its tiles changes.
+typedef struct SDTilemap SDTilemap;
+
+/**
+ * tileset is a texture of tiles laid out in rows, each tileWidth x tileHeight
+ * pixels. Tile index 0 is the top left one. The map is width x height tiles
+ * and starts out empty. Returns NULL when the map is empty or the tileset is
+ * smaller than a tile.
+ */
+SDAPI SDTilemap *SDCreateTilemap(SDTexture *tileset, int tileWidth,
+                                 int tileHeight, int width, int height);
+SDAPI void SDDestroyTilemap(SDTilemap **tilemap);
+
+// Tiles outside the map or past the last one of the tileset are ignored
+SDAPI void SDSetTile(SDTilemap *tilemap, int x, int y, int tile);
+SDAPI int SDGetTile(const SDTilemap *tilemap, int x, int y);
+
+// Draw the chunks visible through the camera, one multi-draw call for those
+// sharing a GPU buffer
+SDAPI void SDDrawTilemap(SDTilemap *tilemap, SDMat3 transform,
+                         SDColor tintColor);
+
+#endif  // SD_TILEMAP_H
@@ -0,0 +1,261 @@
+#include "sword/render.h"
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "command.h"
+#include "job.h"
+#include "render_internal.h"
+
+// Frames being read back at the same time
+#define CAPTURE_RING_SIZE 3
+#define MAX_PENDING_CAPTURE 8
+
+enum {
+  CAPTURE_FREE,
+  CAPTURE_READING,  // Waiting for the GPU to fill the buffer
+  CAPTURE_MAPPED,   // Being copied out on the background thread
+};
+
+typedef struct CaptureRequest {
+  SDCaptureFrameCallback callback;
+  void *userData;
+} CaptureRequest;
+
+typedef struct CaptureSlot {
+  int state;
+  GLuint pbo;
+  size_t pboSize;
+  GLsync fence;
+  int width;
+  int height;
+  CaptureRequest request;
+  const unsigned char *mapped;
+  SDL_atomic_t isCopied;  // Set once the background thread is done with mapped
+} CaptureSlot;
+
+typedef struct CaptureRing {
+  CaptureSlot slots[CAPTURE_RING_SIZE];
+  CaptureRequest pending[MAX_PENDING_CAPTURE];
+  int numPending;
+} CaptureRing;
+
+static CaptureRing CAPTURE = {0};
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+
+static unsigned char *WriteBigEndian32(unsigned char *out, unsigned int v) {
+  *out++ = (unsigned char)(v >> 24);
+  *out++ = (unsigned char)(v >> 16);
+  *out++ = (unsigned char)(v >> 8);
+  *out++ = (unsigned char)v;
+  return out;
+}
+
+// Encode RGBA8 pixels as a QOI image, see https://qoiformat.org
+static unsigned char *EncodeQOI(const unsigned char *pixels, int width,
+                                int height, size_t *size) {
+  static const unsigned char padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+  size_t numPixel = (size_t)width * height;
+  unsigned char *data = malloc(14 + numPixel * 5 + sizeof(padding));
+  unsigned char *out = data;
+
+  memcpy(out, "qoif", 4);
+  out = WriteBigEndian32(out + 4, (unsigned int)width);
+  out = WriteBigEndian32(out, (unsigned int)height);
+  *out++ = 4;  // RGBA
+  *out++ = 0;  // sRGB with linear alpha
+
+  unsigned char index[64][4] = {{0}};
+  unsigned char prev[4] = {0, 0, 0, 255};
+  int run = 0;
+
+  for (size_t i = 0; i < numPixel; ++i) {
+    const unsigned char *px = pixels + i * 4;
+
+    if (memcmp(px, prev, 4) == 0) {
+      run++;
+      if (run == 62 || i == numPixel - 1) {
+        *out++ = (unsigned char)(QOI_OP_RUN | (run - 1));
+        run = 0;
+      }
+      continue;
+    }
+
+    if (run > 0) {
+      *out++ = (unsigned char)(QOI_OP_RUN | (run - 1));
+      run = 0;
+    }
+
+    int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+    if (memcmp(index[hash], px, 4) == 0) {
+      *out++ = (unsigned char)(QOI_OP_INDEX | hash);
+    } else if (px[3] == prev[3]) {
+      int vr = (signed char)(px[0] - prev[0]);
+      int vg = (signed char)(px[1] - prev[1]);
+      int vb = (signed char)(px[2] - prev[2]);
+      int vgr = vr - vg;
+      int vgb = vb - vg;
+
+      if (vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1) {
+        *out++ = (unsigned char)(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 |
+                                 (vb + 2));
+      } else if (vgr >= -8 && vgr <= 7 && vg >= -32 && vg <= 31 &&
+                 vgb >= -8 && vgb <= 7) {
+        *out++ = (unsigned char)(QOI_OP_LUMA | (vg + 32));
+        *out++ = (unsigned char)((vgr + 8) << 4 | (vgb + 8));
+      } else {
+        *out++ = QOI_OP_RGB;
+        memcpy(out, px, 3);
+        out += 3;
+      }
+    } else {
+      *out++ = QOI_OP_RGBA;
+      memcpy(out, px, 4);
+      out += 4;
+    }
+
+    memcpy(index[hash], px, 4);
+    memcpy(prev, px, 4);
+  }
+
+  memcpy(out, padding, sizeof(padding));
+  out += sizeof(padding);
+
+  *size = (size_t)(out - data);
+  return data;
+}
+
+// Runs on the background thread
+static void EncodeCapture(void *data) {
+  CaptureSlot *slot = data;
+  CaptureRequest request = slot->request;
+  int width = slot->width;
+  int height = slot->height;
+  size_t stride = (size_t)width * 4;
+
+  // GL rows go from bottom to top
+  unsigned char *pixels = malloc(stride * height);
+  for (int y = 0; y < height; ++y) {
+    memcpy(pixels + y * stride, slot->mapped + (height - 1 - y) * stride,
+           stride);
+  }
+
+  // The slot is handed back to the render thread from here on
+  SDL_AtomicSet(&slot->isCopied, 1);
+
+  SDFrameCapture capture = {
+      .width = width,
+      .height = height,
+      .pixels = pixels,
+  };
+  unsigned char *qoi = EncodeQOI(pixels, width, height, &capture.qoiSize);
+  capture.qoi = qoi;
+
+  request.callback(&capture, request.userData);
+
+  free(qoi);
+  free(pixels);
+}
+
+static void ReadBack(CaptureSlot *slot, const CaptureRequest *request,
+                     int width, int height) {
+  size_t size = (size_t)width * height * 4;
+
+  if (!slot->pbo) {
+    glGenBuffers(1, &slot->pbo);
+  }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+  if (slot->pboSize != size) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+    slot->pboSize = size;
+  }
+
+  // Returns immediately, the copy happens on the GPU
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  slot->state = CAPTURE_READING;
+  slot->width = width;
+  slot->height = height;
+  slot->request = *request;
+}
+
+extern void ProcessFrameCaptures(RenderContext *rc) {
+  CaptureRing *ring = &CAPTURE;
+
+  for (int i = 0; i < CAPTURE_RING_SIZE; ++i) {
+    CaptureSlot *slot = &ring->slots[i];
+
+    if (slot->state == CAPTURE_MAPPED && SDL_AtomicGet(&slot->isCopied)) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      slot->state = CAPTURE_FREE;
+    }
+
+    // Never wait on the fence, just check whether it has been passed
+    if (slot->state == CAPTURE_READING) {
+      GLenum status = glClientWaitSync(slot->fence, 0, 0);
+      if (status == GL_ALREADY_SIGNALED ||
+          status == GL_CONDITION_SATISFIED) {
+        glDeleteSync(slot->fence);
+        slot->fence = 0;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+        slot->mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                        slot->pboSize, GL_MAP_READ_BIT);
+        slot->state = CAPTURE_MAPPED;
+        SDL_AtomicSet(&slot->isCopied, 0);
+        SubmitTask(EncodeCapture, slot);
+      }
+    }
+  }
+
+  if (ring->numPending > 0) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    int numIssued = 0;
+    for (int i = 0; i < CAPTURE_RING_SIZE && numIssued < ring->numPending;
+         ++i) {
+      CaptureSlot *slot = &ring->slots[i];
+      if (slot->state == CAPTURE_FREE) {
+        ReadBack(slot, &ring->pending[numIssued++], rc->viewportWidth,
+                 rc->viewportHeight);
+      }
+    }
+
+    ring->numPending -= numIssued;
+    memmove(ring->pending, ring->pending + numIssued,
+            sizeof(CaptureRequest) * (size_t)ring->numPending);
+  }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Requests are queued on the render side, which reads them back
+static void ExecuteCaptureFrame(void *data) {
+  const CaptureRequest *request = data;
+  CaptureRing *ring = &CAPTURE;
+
+  if (ring->numPending == MAX_PENDING_CAPTURE) {
+    printf("Too many pending frame captures, dropping one\n");
+    return;
+  }
+
+  ring->pending[ring->numPending++] = *request;
+}
+
+SDAPI void SDCaptureFrame(SDCaptureFrameCallback callback, void *userData) {
+  CaptureRequest *command =
+      BeginCommand(ExecuteCaptureFrame, sizeof(CaptureRequest));
+  *command = (CaptureRequest){callback, userData};
+  CommitCommand();
+}
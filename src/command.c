@@ -0,0 +1,256 @@
+#include "command.h"
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "context.h"
+
+#define COMMAND_BLOCK_SIZE (1024 * 1024)
+#define COMMAND_ALIGNMENT 16
+#define NUM_COMMAND_BUFFER 2
+
+#define ALIGN_COMMAND_SIZE(size) \
+  (((size) + COMMAND_ALIGNMENT - 1) & ~(size_t)(COMMAND_ALIGNMENT - 1))
+
+typedef struct Command {
+  CommandFunc func;
+  struct Command *next;
+} Command;
+
+// Commands and their data are allocated linearly from a list of blocks. The
+// blocks are kept for the next frame recorded into the same buffer.
+typedef struct CommandBlock {
+  struct CommandBlock *next;
+  size_t capacity;
+  size_t used;
+} CommandBlock;
+
+#define COMMAND_HEADER_SIZE ALIGN_COMMAND_SIZE(sizeof(Command))
+#define BLOCK_HEADER_SIZE ALIGN_COMMAND_SIZE(sizeof(CommandBlock))
+
+typedef struct CommandBuffer {
+  CommandBlock *blocks;  // Current block first
+  CommandBlock *freeBlocks;
+  Command *first;
+  Command *last;
+  int isLast;  // The render thread stops after running it
+} CommandBuffer;
+
+// Frames are recorded into one buffer while the render thread runs the other.
+// Each side only touches its own index, the semaphores hand buffers over.
+typedef struct RenderThread {
+  SDL_Thread *thread;
+  SDL_sem *numFrame;       // Submitted buffers waiting to run
+  SDL_sem *numFreeBuffer;  // Run buffers the main thread may record into
+  CommandBuffer buffers[NUM_COMMAND_BUFFER];
+  CommandBuffer *recording;  // NULL without a render thread
+  int recordIndex;
+  int runIndex;
+
+  Command *current;  // Being filled in between BeginCommand and CommitCommand
+
+  // Without a render thread, the command being filled in
+  CommandFunc directFunc;
+  void *directData;
+  size_t directCapacity;
+} RenderThread;
+
+static RenderThread RENDER_THREAD = {0};
+
+static void *AllocCommandMemory(CommandBuffer *buffer, size_t size) {
+  size = ALIGN_COMMAND_SIZE(size);
+
+  CommandBlock *block = buffer->blocks;
+  if (!block || block->used + size > block->capacity) {
+    // Take the first free block big enough, or a new one
+    CommandBlock **link = &buffer->freeBlocks;
+    while (*link && (*link)->capacity < size) {
+      link = &(*link)->next;
+    }
+
+    block = *link;
+    if (block) {
+      *link = block->next;
+    } else {
+      size_t capacity = size > COMMAND_BLOCK_SIZE ? size : COMMAND_BLOCK_SIZE;
+      block = malloc(BLOCK_HEADER_SIZE + capacity);
+      block->capacity = capacity;
+    }
+
+    block->used = 0;
+    block->next = buffer->blocks;
+    buffer->blocks = block;
+  }
+
+  void *result = (unsigned char *)block + BLOCK_HEADER_SIZE + block->used;
+  block->used += size;
+  return result;
+}
+
+static void ResetCommandBuffer(CommandBuffer *buffer) {
+  while (buffer->blocks) {
+    CommandBlock *block = buffer->blocks;
+    buffer->blocks = block->next;
+    block->next = buffer->freeBlocks;
+    buffer->freeBlocks = block;
+  }
+
+  buffer->first = NULL;
+  buffer->last = NULL;
+  buffer->isLast = 0;
+}
+
+static void RunCommands(const CommandBuffer *buffer) {
+  for (Command *command = buffer->first; command; command = command->next) {
+    command->func((unsigned char *)command + COMMAND_HEADER_SIZE);
+  }
+}
+
+extern void *BeginCommand(CommandFunc func, size_t size) {
+  RenderThread *rt = &RENDER_THREAD;
+
+  SDAssert(!rt->current && !rt->directFunc);
+
+  if (!rt->recording) {
+    if (size > rt->directCapacity) {
+      rt->directCapacity = size > 256 ? size : 256;
+      rt->directData = realloc(rt->directData, rt->directCapacity);
+    }
+    rt->directFunc = func;
+    return rt->directData;
+  }
+
+  Command *command =
+      AllocCommandMemory(rt->recording, COMMAND_HEADER_SIZE + size);
+  command->func = func;
+  command->next = NULL;
+  rt->current = command;
+
+  return (unsigned char *)command + COMMAND_HEADER_SIZE;
+}
+
+extern void *CopyCommandData(const void *data, size_t size) {
+  RenderThread *rt = &RENDER_THREAD;
+
+  if (!rt->recording || size == 0) {
+    return (void *)data;
+  }
+
+  void *result = AllocCommandMemory(rt->recording, size);
+  memcpy(result, data, size);
+  return result;
+}
+
+extern void CommitCommand(void) {
+  RenderThread *rt = &RENDER_THREAD;
+
+  if (!rt->recording) {
+    CommandFunc func = rt->directFunc;
+    rt->directFunc = NULL;
+    func(rt->directData);
+    return;
+  }
+
+  CommandBuffer *buffer = rt->recording;
+  if (buffer->last) {
+    buffer->last->next = rt->current;
+  } else {
+    buffer->first = rt->current;
+  }
+  buffer->last = rt->current;
+  rt->current = NULL;
+}
+
+static int RenderThreadMain(void *data) {
+  RenderThread *rt = data;
+
+  if (CTX.glContext) {
+    SDL_GL_MakeCurrent(CTX.window, CTX.glContext);
+  }
+
+  for (;;) {
+    SDL_SemWait(rt->numFrame);
+
+    CommandBuffer *buffer = &rt->buffers[rt->runIndex];
+    rt->runIndex = (rt->runIndex + 1) % NUM_COMMAND_BUFFER;
+
+    RunCommands(buffer);
+
+    int isLast = buffer->isLast;
+    ResetCommandBuffer(buffer);
+    SDL_SemPost(rt->numFreeBuffer);
+
+    if (isLast) {
+      break;
+    }
+  }
+
+  if (CTX.glContext) {
+    SDL_GL_MakeCurrent(CTX.window, NULL);
+  }
+
+  return 0;
+}
+
+extern void StartRenderThread(void) {
+  RenderThread *rt = &RENDER_THREAD;
+
+  rt->numFrame = SDL_CreateSemaphore(0);
+  // The first buffer is taken for recording right away
+  rt->numFreeBuffer = SDL_CreateSemaphore(NUM_COMMAND_BUFFER - 1);
+  rt->recordIndex = 0;
+  rt->runIndex = 0;
+  rt->recording = &rt->buffers[0];
+
+  // A GL context is current on at most one thread
+  if (CTX.glContext) {
+    SDL_GL_MakeCurrent(CTX.window, NULL);
+  }
+
+  rt->thread = SDL_CreateThread(RenderThreadMain, "SDRender", rt);
+  if (!rt->thread) {
+    printf("Failed to create render thread: %s\n", SDL_GetError());
+    exit(EXIT_FAILURE);
+  }
+}
+
+extern void SubmitFrame(void) {
+  RenderThread *rt = &RENDER_THREAD;
+
+  if (!rt->recording) {
+    return;
+  }
+
+  SDL_SemPost(rt->numFrame);
+  SDL_SemWait(rt->numFreeBuffer);
+
+  rt->recordIndex = (rt->recordIndex + 1) % NUM_COMMAND_BUFFER;
+  rt->recording = &rt->buffers[rt->recordIndex];
+}
+
+extern int GetFrameLatency(void) {
+  return RENDER_THREAD.recording ? NUM_COMMAND_BUFFER - 1 : 0;
+}
+
+extern void StopRenderThread(void) {
+  RenderThread *rt = &RENDER_THREAD;
+
+  if (!rt->recording) {
+    return;
+  }
+
+  rt->recording->isLast = 1;
+  SDL_SemPost(rt->numFrame);
+  SDL_WaitThread(rt->thread, NULL);
+
+  SDL_DestroySemaphore(rt->numFrame);
+  SDL_DestroySemaphore(rt->numFreeBuffer);
+  rt->thread = NULL;
+  rt->recording = NULL;
+
+  if (CTX.glContext) {
+    SDL_GL_MakeCurrent(CTX.window, CTX.glContext);
+  }
+}
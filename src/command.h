@@ -0,0 +1,36 @@
+#ifndef SD_COMMAND_H
+#define SD_COMMAND_H
+
+#include <stddef.h>
+
+// Runs a recorded command with the data it was recorded with
+typedef void (*CommandFunc)(void *data);
+
+/**
+ * Everything that touches GL goes through commands so it can run on the render
+ * thread. Reserve size bytes of data for func, fill them in and call
+ * CommitCommand. Without a render thread the command runs in CommitCommand,
+ * otherwise it runs on the render thread with the rest of its frame.
+ */
+extern void *BeginCommand(CommandFunc func, size_t size);
+// Copy of data that stays valid until the current command has run. Without a
+// render thread data is returned as is.
+extern void *CopyCommandData(const void *data, size_t size);
+extern void CommitCommand(void);
+
+// Hand the GL context to a new render thread, frames recorded from now on run
+// there
+extern void StartRenderThread(void);
+// Hand the recorded frame to the render thread and start recording the next
+// one. Waits while the render thread is still busy with the frame before, so
+// recording is never more than one frame ahead. Does nothing without a render
+// thread.
+extern void SubmitFrame(void);
+// Frames the render thread may still be running behind the one being recorded,
+// 0 without a render thread
+extern int GetFrameLatency(void);
+// Run the frames already submitted, stop the render thread and take the GL
+// context back
+extern void StopRenderThread(void);
+
+#endif  // SD_COMMAND_H
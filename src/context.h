@@ -8,6 +8,7 @@
 #include <windows.h>
 #endif
 
+#include "sword/platform.h"
 #include "sword/render.h"
 
 struct SDL_Window;
@@ -24,6 +25,8 @@ typedef struct Context {
   int viewportWidth;
   int viewportHeight;
 
+  SDRenderBackend renderBackend;
+  // Both NULL with the null and recording backends
   struct SDL_Window *window;
   struct SDL_GLContext *glContext;
 
@@ -32,6 +35,12 @@ typedef struct Context {
 
 extern Context CTX;
 
+// Loader of the GL the null and recording backends use, which does nothing
+extern void *GetNullGLProcAddress(const char *name);
+
 extern RenderContext *CreateRenderContext(int viewportWidth, int viewportHeight,
                                           float pixelToPoint);
+extern void BeginRenderFrame(RenderContext *rc);
+// cpuFrameTime is the time in seconds spent on CPU for this frame
+extern void EndRenderFrame(RenderContext *rc, float cpuFrameTime);
 #endif  // SD_CONTEXT_H
@@ -0,0 +1,211 @@
+#include "sword/debug.h"
+
+#ifdef SD_DEBUG
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "command.h"
+#include "render_internal.h"
+
+#define DEBUG_CIRCLE_SEGMENT 32
+
+// Room for count more vertices at the end of a growing array
+static MeshVertex *AddDebugVertices(MeshVertex **vertices, int *numVertex,
+                                    int *capacity, int count) {
+  if (*numVertex + count > *capacity) {
+    int newCapacity = *capacity > 0 ? *capacity : 1024;
+    while (newCapacity < *numVertex + count) {
+      newCapacity *= 2;
+    }
+    *vertices = realloc(*vertices, (size_t)newCapacity * sizeof(MeshVertex));
+    *capacity = newCapacity;
+  }
+
+  MeshVertex *result = *vertices + *numVertex;
+  *numVertex += count;
+  return result;
+}
+
+static MeshVertex *AddDebugLines(DebugDraw *debugDraw, int numLine) {
+  return AddDebugVertices(&debugDraw->lines, &debugDraw->numLineVertex,
+                          &debugDraw->lineCapacity, numLine * 2);
+}
+
+static MeshVertex *AddDebugTriangles(DebugDraw *debugDraw, int numTriangle) {
+  return AddDebugVertices(&debugDraw->triangles,
+                          &debugDraw->numTriangleVertex,
+                          &debugDraw->triangleCapacity, numTriangle * 3);
+}
+
+// Vertices are in canvas space with pre-multiplied colors, sampling the white
+// texture with the mesh program
+static void WriteDebugVertex(MeshVertex *v, SDVec2 pos, SDColor color) {
+  *v = (MeshVertex){{pos.x, pos.y},
+                    {0.5f, 0.5f},
+                    {color.r * color.a, color.g * color.a, color.b * color.a,
+                     color.a}};
+}
+
+SDAPI void SDDebugDrawLine(SDVec2 from, SDVec2 to, SDColor color) {
+  RenderContext *rc = CTX.rc;
+  MeshVertex *v = AddDebugLines(&rc->debugDraw, 1);
+
+  WriteDebugVertex(v, SDDotM3V2(rc->camera, from), color);
+  WriteDebugVertex(v + 1, SDDotM3V2(rc->camera, to), color);
+}
+
+// Corners of rect on the canvas, clockwise on screen
+static void GetDebugRectCorners(const RenderContext *rc, SDRect rect,
+                                SDMat3 transform, SDVec2 *corners) {
+  SDMat3 t = SDDotM3(rc->camera, transform);
+  corners[0] = SDDotM3V2(t, rect.min);
+  corners[1] = SDDotM3V2(t, SDV2(rect.max.x, rect.min.y));
+  corners[2] = SDDotM3V2(t, rect.max);
+  corners[3] = SDDotM3V2(t, SDV2(rect.min.x, rect.max.y));
+}
+
+SDAPI void SDDebugDrawRect(SDRect rect, SDMat3 transform, SDColor color) {
+  RenderContext *rc = CTX.rc;
+  SDVec2 corners[4];
+  GetDebugRectCorners(rc, rect, transform, corners);
+
+  MeshVertex *v = AddDebugLines(&rc->debugDraw, 4);
+  for (int i = 0; i < 4; ++i) {
+    WriteDebugVertex(v++, corners[i], color);
+    WriteDebugVertex(v++, corners[(i + 1) % 4], color);
+  }
+}
+
+static void AddDebugQuad(DebugDraw *debugDraw, const SDVec2 *corners,
+                         SDColor color) {
+  MeshVertex *v = AddDebugTriangles(debugDraw, 2);
+  WriteDebugVertex(v, corners[0], color);
+  WriteDebugVertex(v + 1, corners[1], color);
+  WriteDebugVertex(v + 2, corners[2], color);
+  WriteDebugVertex(v + 3, corners[0], color);
+  WriteDebugVertex(v + 4, corners[2], color);
+  WriteDebugVertex(v + 5, corners[3], color);
+}
+
+SDAPI void SDDebugFillRect(SDRect rect, SDMat3 transform, SDColor color) {
+  RenderContext *rc = CTX.rc;
+  SDVec2 corners[4];
+  GetDebugRectCorners(rc, rect, transform, corners);
+
+  AddDebugQuad(&rc->debugDraw, corners, color);
+}
+
+SDAPI void SDDebugDrawCircle(SDVec2 center, SDFloat radius, SDColor color) {
+  RenderContext *rc = CTX.rc;
+  MeshVertex *v = AddDebugLines(&rc->debugDraw, DEBUG_CIRCLE_SEGMENT);
+
+  SDVec2 prev = SDDotM3V2(rc->camera, SDV2(center.x + radius, center.y));
+  for (int i = 1; i <= DEBUG_CIRCLE_SEGMENT; ++i) {
+    SDFloat angle = 2.0f * 3.14159265f * i / DEBUG_CIRCLE_SEGMENT;
+    SDVec2 next = SDDotM3V2(rc->camera,
+                            SDV2(center.x + cosf(angle) * radius,
+                                 center.y + sinf(angle) * radius));
+    WriteDebugVertex(v++, prev, color);
+    WriteDebugVertex(v++, next, color);
+    prev = next;
+  }
+}
+
+SDAPI void SDDebugDrawPoint(SDVec2 position, SDFloat size, SDColor color) {
+  RenderContext *rc = CTX.rc;
+  SDVec2 p = SDDotM3V2(rc->camera, position);
+  SDFloat half = size * 0.5f;
+  SDVec2 corners[4] = {
+      SDV2(p.x - half, p.y - half),
+      SDV2(p.x + half, p.y - half),
+      SDV2(p.x + half, p.y + half),
+      SDV2(p.x - half, p.y + half),
+  };
+
+  AddDebugQuad(&rc->debugDraw, corners, color);
+}
+
+extern void RecordDebugDraw(RenderContext *rc, DebugDrawList *list) {
+  DebugDraw *debugDraw = &rc->debugDraw;
+
+  list->numTriangleVertex = debugDraw->numTriangleVertex;
+  list->triangles = CopyCommandData(
+      debugDraw->triangles,
+      (size_t)debugDraw->numTriangleVertex * sizeof(MeshVertex));
+  list->numLineVertex = debugDraw->numLineVertex;
+  list->lines = CopyCommandData(
+      debugDraw->lines, (size_t)debugDraw->numLineVertex * sizeof(MeshVertex));
+
+  debugDraw->numTriangleVertex = 0;
+  debugDraw->numLineVertex = 0;
+}
+
+static void InitDebugDrawBuffers(DebugDraw *debugDraw) {
+  glGenVertexArrays(1, &debugDraw->vao);
+  glGenBuffers(1, &debugDraw->vbo);
+
+  glBindVertexArray(debugDraw->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, debugDraw->vbo);
+
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                        (void *)offsetof(MeshVertex, pos));
+  glEnableVertexAttribArray(0);
+
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                        (void *)offsetof(MeshVertex, texCoord));
+  glEnableVertexAttribArray(1);
+
+  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                        (void *)offsetof(MeshVertex, color));
+  glEnableVertexAttribArray(2);
+
+  glBindVertexArray(0);
+}
+
+extern void ExecuteDebugDraw(RenderContext *rc, const DebugDrawList *list) {
+  DebugDraw *debugDraw = &rc->debugDraw;
+  MeshProgram *meshProgram = &rc->meshProgram;
+  int numVertex = list->numTriangleVertex + list->numLineVertex;
+
+  if (numVertex == 0) {
+    return;
+  }
+
+  if (!meshProgram->program) {
+    InitMeshProgram(meshProgram);
+  }
+  if (!debugDraw->vao) {
+    InitDebugDrawBuffers(debugDraw);
+  }
+
+  // Triangles first, then lines in the same buffer
+  size_t triangleSize = (size_t)list->numTriangleVertex * sizeof(MeshVertex);
+  size_t lineSize = (size_t)list->numLineVertex * sizeof(MeshVertex);
+  glBindVertexArray(debugDraw->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, debugDraw->vbo);
+  glBufferData(GL_ARRAY_BUFFER, triangleSize + lineSize, NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, triangleSize, list->triangles);
+  glBufferSubData(GL_ARRAY_BUFFER, triangleSize, lineSize, list->lines);
+
+  glUseProgram(meshProgram->program);
+  glUniformMatrix3fv(meshProgram->MVPLocation, 1, GL_FALSE,
+                     (const GLfloat *)&rc->projection);
+  glUniform4f(meshProgram->tintColorLocation, 1.0f, 1.0f, 1.0f, 1.0f);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, rc->whiteTexture->id);
+
+  if (list->numTriangleVertex > 0) {
+    glDrawArrays(GL_TRIANGLES, 0, list->numTriangleVertex);
+    rc->numDrawCall++;
+  }
+  if (list->numLineVertex > 0) {
+    glDrawArrays(GL_LINES, list->numTriangleVertex, list->numLineVertex);
+    rc->numDrawCall++;
+  }
+
+  glBindVertexArray(0);
+}
+
+#endif  // SD_DEBUG
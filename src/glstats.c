@@ -0,0 +1,125 @@
+#include "sword/debug.h"
+
+#ifdef SD_DEBUG
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "render_internal.h"
+
+// Open addressing table of the GL functions called so far, keyed by the name
+// the loader passes, which is a string literal of its own for each function
+#define GL_CALL_TABLE_SIZE 1024
+
+typedef struct GLCallCounter {
+  const char *name;
+  int numCall;
+  Uint64 ticks;
+} GLCallCounter;
+
+// GL is only called from one thread at a time, the main thread or the render
+// thread, so the counters need no locking
+static struct {
+  GLCallCounter counters[GL_CALL_TABLE_SIZE];
+  int numCounter;
+  Uint64 callStart;
+} GL_CALLS;
+
+static GLCallCounter *GetGLCallCounter(const char *name) {
+  size_t slot = ((size_t)name >> 3) % GL_CALL_TABLE_SIZE;
+  while (GL_CALLS.counters[slot].name != name) {
+    if (!GL_CALLS.counters[slot].name) {
+      if (GL_CALLS.numCounter == GL_CALL_TABLE_SIZE - 1) {
+        printf("Too many GL functions called, max %d\n",
+               GL_CALL_TABLE_SIZE - 1);
+        exit(EXIT_FAILURE);
+      }
+      GL_CALLS.counters[slot].name = name;
+      GL_CALLS.numCounter++;
+      break;
+    }
+    slot = (slot + 1) % GL_CALL_TABLE_SIZE;
+  }
+  return &GL_CALLS.counters[slot];
+}
+
+static void OnBeforeGLCall(const char *name, void *funcptr, int len_args,
+                           ...) {
+  GL_CALLS.callStart = SDL_GetPerformanceCounter();
+}
+
+// Replaces the loader's default hook, so checks for errors the same way
+static void OnAfterGLCall(const char *name, void *funcptr, int len_args, ...) {
+  Uint64 ticks = SDL_GetPerformanceCounter() - GL_CALLS.callStart;
+
+  GLCallCounter *counter = GetGLCallCounter(name);
+  counter->numCall++;
+  counter->ticks += ticks;
+
+  GLenum error = glad_glGetError();
+  if (error != GL_NO_ERROR) {
+    fprintf(stderr, "ERROR %d in %s\n", error, name);
+  }
+}
+
+extern void InstallGLCallHooks(void) {
+  glad_set_pre_callback(OnBeforeGLCall);
+  glad_set_post_callback(OnAfterGLCall);
+}
+
+static int CompareGLCallStats(const void *a, const void *b) {
+  SDFloat timeA = ((const SDGLCallStats *)a)->time;
+  SDFloat timeB = ((const SDGLCallStats *)b)->time;
+  return (timeA < timeB) - (timeA > timeB);
+}
+
+extern void EndGLCallFrame(GLCallFrame *frame) {
+  static SDGLCallStats stats[GL_CALL_TABLE_SIZE];
+  int numStats = 0;
+  double tickToSecond = 1.0 / (double)SDL_GetPerformanceFrequency();
+
+  for (int i = 0; i < GL_CALL_TABLE_SIZE; ++i) {
+    GLCallCounter *counter = &GL_CALLS.counters[i];
+    if (counter->numCall == 0) {
+      continue;
+    }
+
+    SDGLCallStats *s = &stats[numStats++];
+    s->name = counter->name;
+    s->numCall = counter->numCall;
+    s->time = (SDFloat)(counter->ticks * tickToSecond);
+    counter->numCall = 0;
+    counter->ticks = 0;
+  }
+
+  qsort(stats, (size_t)numStats, sizeof(SDGLCallStats), CompareGLCallStats);
+  frame->numStats =
+      numStats < MAX_GL_CALL_STATS ? numStats : MAX_GL_CALL_STATS;
+  memcpy(frame->stats, stats, sizeof(SDGLCallStats) * (size_t)frame->numStats);
+}
+
+SDAPI int SDGetGLCallStats(SDGLCallStats *stats, int maxStats) {
+  const GLCallFrame *frame = &GetLastFrameResult(CTX.rc)->glCalls;
+  int numStats = frame->numStats < maxStats ? frame->numStats : maxStats;
+  memcpy(stats, frame->stats, sizeof(SDGLCallStats) * (size_t)numStats);
+  return numStats;
+}
+
+SDAPI void SDDumpGLCallStats(void) {
+  const GLCallFrame *frame = &GetLastFrameResult(CTX.rc)->glCalls;
+  int totalCall = 0;
+  SDFloat totalTime = 0.0f;
+
+  printf("%-40s %8s %10s\n", "GL function", "calls", "time (ms)");
+  for (int i = 0; i < frame->numStats; ++i) {
+    const SDGLCallStats *s = &frame->stats[i];
+    printf("%-40s %8d %10.3f\n", s->name, s->numCall, s->time * 1000.0f);
+    totalCall += s->numCall;
+    totalTime += s->time;
+  }
+  printf("%-40s %8d %10.3f\n", "total", totalCall, totalTime * 1000.0f);
+}
+
+#endif  // SD_DEBUG
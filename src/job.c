@@ -0,0 +1,180 @@
+#include "job.h"
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_WORKER 16
+#define MAX_TASK 64
+
+typedef struct JobPool {
+  int numWorker;
+  SDL_mutex *lock;  // Serializes ParallelFor callers
+  SDL_sem *start;
+  SDL_sem *done;
+
+  // Current parallel loop
+  JobFunc func;
+  void *data;
+  int count;
+  int numRange;
+  int rangeSize;
+  SDL_atomic_t nextRange;
+} JobPool;
+
+static JobPool POOL = {0};
+
+typedef struct Task {
+  TaskFunc func;
+  void *data;
+} Task;
+
+// Ring of tasks for the background thread
+typedef struct TaskQueue {
+  SDL_mutex *lock;
+  SDL_sem *numTask;
+  SDL_sem *numFreeTask;
+  Task tasks[MAX_TASK];
+  int head;
+  int tail;
+} TaskQueue;
+
+static TaskQueue QUEUE = {0};
+
+static void RunRanges(JobPool *pool) {
+  for (;;) {
+    int index = SDL_AtomicAdd(&pool->nextRange, 1);
+    if (index >= pool->numRange) {
+      break;
+    }
+
+    int begin = index * pool->rangeSize;
+    int end = begin + pool->rangeSize;
+    if (end > pool->count) {
+      end = pool->count;
+    }
+    if (begin < end) {
+      pool->func(pool->data, begin, end, index);
+    }
+  }
+}
+
+static int WorkerMain(void *data) {
+  JobPool *pool = data;
+
+  for (;;) {
+    SDL_SemWait(pool->start);
+    RunRanges(pool);
+    SDL_SemPost(pool->done);
+  }
+
+  return 0;
+}
+
+static void InitJobPool(JobPool *pool) {
+  int numWorker = SDL_GetCPUCount() - 1;
+  if (numWorker > MAX_WORKER) {
+    numWorker = MAX_WORKER;
+  }
+
+  pool->lock = SDL_CreateMutex();
+  pool->start = SDL_CreateSemaphore(0);
+  pool->done = SDL_CreateSemaphore(0);
+
+  for (int i = 0; i < numWorker; ++i) {
+    SDL_Thread *thread = SDL_CreateThread(WorkerMain, "SDWorker", pool);
+    if (!thread) {
+      break;
+    }
+    pool->numWorker++;
+  }
+}
+
+extern int GetNumWorker(void) {
+  if (!POOL.lock) {
+    InitJobPool(&POOL);
+  }
+  return POOL.numWorker;
+}
+
+extern void ParallelFor(JobFunc func, void *data, int count, int rangeSize) {
+  JobPool *pool = &POOL;
+
+  if (!pool->lock) {
+    InitJobPool(pool);
+  }
+
+  int numRange = (count + rangeSize - 1) / rangeSize;
+
+  if (numRange <= 1 || pool->numWorker == 0) {
+    for (int index = 0; index < numRange; ++index) {
+      int begin = index * rangeSize;
+      int end = begin + rangeSize < count ? begin + rangeSize : count;
+      func(data, begin, end, index);
+    }
+    return;
+  }
+
+  SDL_LockMutex(pool->lock);
+
+  pool->func = func;
+  pool->data = data;
+  pool->count = count;
+  pool->numRange = numRange;
+  pool->rangeSize = rangeSize;
+  SDL_AtomicSet(&pool->nextRange, 0);
+
+  int numWake = numRange - 1 < pool->numWorker ? numRange - 1 : pool->numWorker;
+  for (int i = 0; i < numWake; ++i) {
+    SDL_SemPost(pool->start);
+  }
+
+  RunRanges(pool);
+
+  for (int i = 0; i < numWake; ++i) {
+    SDL_SemWait(pool->done);
+  }
+
+  SDL_UnlockMutex(pool->lock);
+}
+
+static int TaskThreadMain(void *data) {
+  TaskQueue *queue = data;
+
+  for (;;) {
+    SDL_SemWait(queue->numTask);
+
+    SDL_LockMutex(queue->lock);
+    Task task = queue->tasks[queue->head];
+    queue->head = (queue->head + 1) % MAX_TASK;
+    SDL_UnlockMutex(queue->lock);
+
+    SDL_SemPost(queue->numFreeTask);
+    task.func(task.data);
+  }
+
+  return 0;
+}
+
+extern void SubmitTask(TaskFunc func, void *data) {
+  TaskQueue *queue = &QUEUE;
+
+  if (!queue->lock) {
+    queue->lock = SDL_CreateMutex();
+    queue->numTask = SDL_CreateSemaphore(0);
+    queue->numFreeTask = SDL_CreateSemaphore(MAX_TASK);
+    if (!SDL_CreateThread(TaskThreadMain, "SDTask", queue)) {
+      printf("Failed to create task thread: %s\n", SDL_GetError());
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  SDL_SemWait(queue->numFreeTask);
+
+  SDL_LockMutex(queue->lock);
+  queue->tasks[queue->tail] = (Task){func, data};
+  queue->tail = (queue->tail + 1) % MAX_TASK;
+  SDL_UnlockMutex(queue->lock);
+
+  SDL_SemPost(queue->numTask);
+}
@@ -0,0 +1,24 @@
+#ifndef SD_JOB_H
+#define SD_JOB_H
+
+// Process the range [begin, end) of a parallel loop. index is the index of the
+// range, in [0, numRange).
+typedef void (*JobFunc)(void *data, int begin, int end, int index);
+
+// Number of worker threads, not counting the calling thread
+extern int GetNumWorker(void);
+
+/**
+ * Split [0, count) into ranges of rangeSize elements and run them on the
+ * worker threads. The calling thread takes part and the call returns when
+ * every range is done.
+ */
+extern void ParallelFor(JobFunc func, void *data, int count, int rangeSize);
+
+typedef void (*TaskFunc)(void *data);
+
+// Queue func to run on the background thread, tasks run one at a time in
+// submission order. Only blocks when the queue is full.
+extern void SubmitTask(TaskFunc func, void *data);
+
+#endif  // SD_JOB_H
@@ -0,0 +1,592 @@
+#include "sword/light.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "render_internal.h"
+
+const char LIGHT_VERTEX_SHADER[] =
+    "#version 330 core                                                      \n"
+    "                                                                       \n"
+    "uniform mat3 projection;                                               \n"
+    "                                                                       \n"
+    "layout (location = 0) in vec2 aCorner;                                 \n"
+    "layout (location = 1) in vec4 aGeometry;  // center, radius, cosCone   \n"
+    "layout (location = 2) in vec4 aColor;                                  \n"
+    "layout (location = 3) in vec2 aDirection;                              \n"
+    "layout (location = 4) in vec4 aClip;                                   \n"
+    "out vec2 vPos;                                                         \n"
+    "flat out vec4 vGeometry;                                               \n"
+    "flat out vec4 vColor;                                                  \n"
+    "flat out vec2 vDirection;                                              \n"
+    "flat out vec4 vClip;                                                   \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   vPos = aGeometry.xy + aCorner * aGeometry.z;                        \n"
+    "   gl_Position = vec4(projection * vec3(vPos, 1), 1);                  \n"
+    "                                                                       \n"
+    "   vGeometry = aGeometry;                                              \n"
+    "   vColor = aColor;                                                    \n"
+    "   vDirection = aDirection;                                            \n"
+    "   vClip = aClip;                                                      \n"
+    "}                                                                      \n";
+
+const char SHADE_LIGHT_FUNCTION[] =
+    "// geometry is center, radius and cosine of the cone angle. Lights     \n"
+    "// only reach the viewport they were drawn in, given by clip.          \n"
+    "vec3 ShadeLight(vec2 pos, vec4 geometry, vec4 color, vec2 direction,   \n"
+    "                vec4 clip) {                                           \n"
+    "   if (any(lessThan(pos, clip.xy)) ||                                 \n"
+    "       any(greaterThanEqual(pos, clip.zw))) {                          \n"
+    "       return vec3(0);                                                 \n"
+    "   }                                                                   \n"
+    "                                                                       \n"
+    "   vec2 toPos = pos - geometry.xy;                                     \n"
+    "   float dist = length(toPos);                                         \n"
+    "   float attenuation = clamp(1 - dist / geometry.z, 0, 1);             \n"
+    "   attenuation *= attenuation;                                         \n"
+    "                                                                       \n"
+    "   // Point lights have a cone of -1 and skip the cone falloff         \n"
+    "   if (geometry.w > -1) {                                              \n"
+    "       float cosAngle = dot(toPos, direction) / max(dist, 0.0001);     \n"
+    "       float edge = mix(geometry.w, 1, 0.2);                           \n"
+    "       attenuation *= smoothstep(geometry.w, edge, cosAngle);          \n"
+    "   }                                                                   \n"
+    "                                                                       \n"
+    "   return color.rgb * (color.a * attenuation);                         \n"
+    "}                                                                      \n";
+
+const char LIGHT_FRAGMENT_SHADER[] =
+    "in vec2 vPos;                                                          \n"
+    "flat in vec4 vGeometry;                                                \n"
+    "flat in vec4 vColor;                                                   \n"
+    "flat in vec2 vDirection;                                               \n"
+    "flat in vec4 vClip;                                                    \n"
+    "                                                                       \n"
+    "out vec4 fragColor;                                                    \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   vec3 color = ShadeLight(vPos, vGeometry, vColor, vDirection, vClip);\n"
+    "   fragColor = vec4(color, 0);                                         \n"
+    "}                                                                      \n";
+
+const char TILED_LIGHT_FRAGMENT_SHADER[] =
+    "uniform samplerBuffer lights;  // Four texels per light                \n"
+    "uniform isamplerBuffer tiles;  // Offset and count into lightIndices   \n"
+    "uniform isamplerBuffer lightIndices;                                   \n"
+    "uniform vec4 fragToCanvas;  // xy: scale, zw: offset                   \n"
+    "uniform int numTileX;                                                  \n"
+    "uniform vec3 ambient;                                                  \n"
+    "                                                                       \n"
+    "out vec4 fragColor;                                                    \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   vec2 pos = gl_FragCoord.xy * fragToCanvas.xy + fragToCanvas.zw;     \n"
+    "   ivec2 tile = ivec2(gl_FragCoord.xy) / TILE_SIZE;                    \n"
+    "   ivec2 range = texelFetch(tiles, tile.y * numTileX + tile.x).xy;     \n"
+    "                                                                       \n"
+    "   vec3 color = ambient;                                               \n"
+    "   for (int i = 0; i < range.y; ++i) {                                 \n"
+    "       int light = texelFetch(lightIndices, range.x + i).x * 4;        \n"
+    "       color += ShadeLight(pos, texelFetch(lights, light),             \n"
+    "                           texelFetch(lights, light + 1),              \n"
+    "                           texelFetch(lights, light + 2).xy,           \n"
+    "                           texelFetch(lights, light + 3));             \n"
+    "   }                                                                   \n"
+    "                                                                       \n"
+    "   fragColor = vec4(color, 0);                                         \n"
+    "}                                                                      \n";
+
+const char LIGHT_COMPOSITE_FRAGMENT_SHADER[] =
+    "#version 330 core                                                      \n"
+    "                                                                       \n"
+    "uniform sampler2D source;                                              \n"
+    "uniform vec2 uvScale;                                                  \n"
+    "uniform vec2 uvMax;                                                    \n"
+    "                                                                       \n"
+    "in vec2 vUV;                                                           \n"
+    "                                                                       \n"
+    "out vec4 fragColor;                                                    \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   fragColor = vec4(texture(source, min(vUV * uvScale, uvMax)).rgb, 1);\n"
+    "}                                                                      \n";
+
+static GLuint CompileLightProgram(const char *vss, const char *fss,
+                                  size_t fssSize) {
+  char *source = malloc(fssSize + sizeof(SHADE_LIGHT_FUNCTION) + 64);
+  sprintf(source, "#version 330 core\n#define TILE_SIZE %d\n%s%s",
+          LIGHT_TILE_SIZE, SHADE_LIGHT_FUNCTION, fss);
+  GLuint program = CompileGLProgram(vss, source);
+  free(source);
+  if (!program) {
+    exit(EXIT_FAILURE);
+  }
+  return program;
+}
+
+static void InitLightTextureBuffer(GLuint *tbo, GLuint *texture,
+                                   GLenum internalFormat) {
+  glGenBuffers(1, tbo);
+  glGenTextures(1, texture);
+  glBindBuffer(GL_TEXTURE_BUFFER, *tbo);
+  glBindTexture(GL_TEXTURE_BUFFER, *texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, *tbo);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Programs and buffers are only created once lighting is used
+static void InitLightingPrograms(Lighting *lighting) {
+  static const float corners[] = {-1.0f, -1.0f, 1.0f, -1.0f,
+                                  -1.0f, 1.0f,  1.0f, 1.0f};
+
+  lighting->program =
+      CompileLightProgram(LIGHT_VERTEX_SHADER, LIGHT_FRAGMENT_SHADER,
+                          sizeof(LIGHT_FRAGMENT_SHADER));
+  lighting->projectionLocation =
+      glGetUniformLocation(lighting->program, "projection");
+
+  glGenVertexArrays(1, &lighting->vao);
+  glGenBuffers(1, &lighting->cornerVBO);
+  glGenBuffers(1, &lighting->instanceVBO);
+
+  glBindVertexArray(lighting->vao);
+
+  glBindBuffer(GL_ARRAY_BUFFER, lighting->cornerVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+  glEnableVertexAttribArray(0);
+
+  glBindBuffer(GL_ARRAY_BUFFER, lighting->instanceVBO);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(LightInstance),
+                        (void *)offsetof(LightInstance, center));
+  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(LightInstance),
+                        (void *)offsetof(LightInstance, color));
+  glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(LightInstance),
+                        (void *)offsetof(LightInstance, direction));
+  glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(LightInstance),
+                        (void *)offsetof(LightInstance, clip));
+  for (GLuint location = 1; location <= 4; ++location) {
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location);
+  }
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  GLuint tiledProgram =
+      CompileLightProgram(FULLSCREEN_VERTEX_SHADER, TILED_LIGHT_FRAGMENT_SHADER,
+                          sizeof(TILED_LIGHT_FRAGMENT_SHADER));
+  glUseProgram(tiledProgram);
+  glUniform1i(glGetUniformLocation(tiledProgram, "lights"), 0);
+  glUniform1i(glGetUniformLocation(tiledProgram, "tiles"), 1);
+  glUniform1i(glGetUniformLocation(tiledProgram, "lightIndices"), 2);
+  lighting->tiledProgram = tiledProgram;
+  lighting->fragToCanvasLocation =
+      glGetUniformLocation(tiledProgram, "fragToCanvas");
+  lighting->numTileXLocation = glGetUniformLocation(tiledProgram, "numTileX");
+  lighting->ambientLocation = glGetUniformLocation(tiledProgram, "ambient");
+
+  InitLightTextureBuffer(&lighting->lightTBO, &lighting->lightTexture,
+                         GL_RGBA32F);
+  InitLightTextureBuffer(&lighting->tileTBO, &lighting->tileTexture, GL_RG32I);
+  InitLightTextureBuffer(&lighting->indexTBO, &lighting->indexTexture,
+                         GL_R32I);
+
+  InitFullscreenProgram(&lighting->compositeProgram,
+                        LIGHT_COMPOSITE_FRAGMENT_SHADER);
+}
+
+extern void InitLighting(Lighting *lighting) {
+  lighting->params = SDMakeLightingParams();
+  lighting->program = 0;
+}
+
+extern int IsLightingEnabled(const RenderContext *rc) {
+  return rc->lighting.params.enabled;
+}
+
+static SDVec2 GetCanvasSize(const RenderContext *rc) {
+  return SDV2(rc->viewportWidth * CTX.pixelToPoint,
+              rc->viewportHeight * CTX.pixelToPoint);
+}
+
+static void DrawLightQuads(RenderContext *rc, const SDLightingParams *params,
+                           const LightInstance *lights, int numLight,
+                           const RenderTarget *target, int width, int height) {
+  Lighting *lighting = &rc->lighting;
+  SDColor ambient = params->ambientColor;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+  glViewport(0, 0, width, height);
+  glClearColor(ambient.r, ambient.g, ambient.b, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+  if (numLight == 0) {
+    return;
+  }
+
+  // Orphan last frame's storage
+  glBindBuffer(GL_ARRAY_BUFFER, lighting->instanceVBO);
+  glBufferData(GL_ARRAY_BUFFER, (size_t)numLight * sizeof(LightInstance), NULL,
+               GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, (size_t)numLight * sizeof(LightInstance),
+                  lights);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+
+  glUseProgram(lighting->program);
+  // The light buffer covers the canvas like the scene does
+  glUniformMatrix3fv(lighting->projectionLocation, 1, GL_FALSE,
+                     (const GLfloat *)&rc->projection);
+
+  glBindVertexArray(lighting->vao);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, numLight);
+  glBindVertexArray(0);
+
+  glDisable(GL_BLEND);
+  rc->numDrawCall++;
+}
+
+static int ClampTile(float tile, int numTile) {
+  return (int)SDClampF(SDFloorF(tile), 0.0f, (float)(numTile - 1));
+}
+
+// Build the per tile light lists, returns the number of indices written
+static int BinLights(Lighting *lighting, const LightInstance *lights,
+                     int numLight, int numTileX, int numTileY,
+                     SDVec2 canvasToFrag, SDFloat canvasHeight) {
+  int numTile = numTileX * numTileY;
+  if (numTile > lighting->tileCapacity) {
+    lighting->tileCapacity = numTile;
+    lighting->tiles =
+        realloc(lighting->tiles, sizeof(int) * 2 * (size_t)numTile);
+  }
+
+  int *tiles = lighting->tiles;
+  memset(tiles, 0, sizeof(int) * 2 * (size_t)numTile);
+
+  // First pass counts the lights touching each tile, second pass fills the
+  // lists
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < numLight; ++i) {
+      const LightInstance *light = &lights[i];
+      // Bounds of the light inside its clip rect, in fragment coordinates
+      float left = SDMaxF(light->center[0] - light->radius, light->clip[0]);
+      float right = SDMinF(light->center[0] + light->radius, light->clip[2]);
+      float top = SDMaxF(light->center[1] - light->radius, light->clip[1]);
+      float bottom = SDMinF(light->center[1] + light->radius, light->clip[3]);
+      if (left >= right || top >= bottom) {
+        continue;
+      }
+
+      int minX = ClampTile(left * canvasToFrag.x / LIGHT_TILE_SIZE, numTileX);
+      int maxX = ClampTile(right * canvasToFrag.x / LIGHT_TILE_SIZE, numTileX);
+      int minY = ClampTile((canvasHeight - bottom) * canvasToFrag.y /
+                               LIGHT_TILE_SIZE,
+                           numTileY);
+      int maxY = ClampTile((canvasHeight - top) * canvasToFrag.y /
+                               LIGHT_TILE_SIZE,
+                           numTileY);
+
+      for (int ty = minY; ty <= maxY; ++ty) {
+        for (int tx = minX; tx <= maxX; ++tx) {
+          int *tile = &tiles[(ty * numTileX + tx) * 2];
+          if (pass == 1) {
+            lighting->indices[tile[0] + tile[1]] = i;
+          }
+          tile[1]++;
+        }
+      }
+    }
+
+    if (pass == 1) {
+      break;
+    }
+
+    // Prefix sum of the counts gives each tile its offset
+    int numIndex = 0;
+    for (int t = 0; t < numTile; ++t) {
+      tiles[t * 2] = numIndex;
+      numIndex += tiles[t * 2 + 1];
+      tiles[t * 2 + 1] = 0;
+    }
+
+    if (numIndex > lighting->indexCapacity) {
+      lighting->indexCapacity = numIndex;
+      lighting->indices =
+          realloc(lighting->indices, sizeof(int) * (size_t)numIndex);
+    }
+  }
+
+  int last = (numTile - 1) * 2;
+  return tiles[last] + tiles[last + 1];
+}
+
+static void UploadTextureBuffer(GLuint tbo, size_t size, const void *data) {
+  // Empty buffers are not allowed as texture buffer storage
+  glBindBuffer(GL_TEXTURE_BUFFER, tbo);
+  glBufferData(GL_TEXTURE_BUFFER, size ? size : 16, NULL, GL_STREAM_DRAW);
+  if (size) {
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+  }
+}
+
+static void DrawTiledLights(RenderContext *rc, const SDLightingParams *params,
+                            const LightInstance *lights, int numLight,
+                            const RenderTarget *target, int width,
+                            int height) {
+  Lighting *lighting = &rc->lighting;
+  SDColor ambient = params->ambientColor;
+  SDVec2 canvasSize = GetCanvasSize(rc);
+  SDVec2 canvasToFrag = SDV2(width / canvasSize.x, height / canvasSize.y);
+
+  int numTileX = (width + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+  int numTileY = (height + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+  int numIndex = BinLights(lighting, lights, numLight, numTileX, numTileY,
+                           canvasToFrag, canvasSize.y);
+
+  UploadTextureBuffer(lighting->lightTBO,
+                      sizeof(LightInstance) * (size_t)numLight, lights);
+  UploadTextureBuffer(lighting->tileTBO,
+                      sizeof(int) * 2 * (size_t)numTileX * numTileY,
+                      lighting->tiles);
+  UploadTextureBuffer(lighting->indexTBO, sizeof(int) * (size_t)numIndex,
+                      lighting->indices);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+  glViewport(0, 0, width, height);
+
+  glUseProgram(lighting->tiledProgram);
+  glUniform4f(lighting->fragToCanvasLocation, 1.0f / canvasToFrag.x,
+              -1.0f / canvasToFrag.y, 0.0f, canvasSize.y);
+  glUniform1i(lighting->numTileXLocation, numTileX);
+  glUniform3f(lighting->ambientLocation, ambient.r, ambient.g, ambient.b);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, lighting->lightTexture);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_BUFFER, lighting->tileTexture);
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_BUFFER, lighting->indexTexture);
+
+  glBindVertexArray(rc->fullscreenVAO);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(0);
+
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+  rc->numDrawCall++;
+}
+
+typedef struct LightPassData {
+  const SDLightingParams *params;
+  const LightInstance *lights;
+  int numLight;
+  int lightBuffer;
+  int width;
+  int height;
+} LightPassData;
+
+static void ExecuteLightPass(RenderContext *rc, const RenderGraph *graph,
+                             const void *data) {
+  const LightPassData *pass = data;
+  const RenderTarget *lightTarget = GetGraphTarget(graph, pass->lightBuffer);
+
+  glDisable(GL_BLEND);
+
+  if (pass->params->tiledCulling) {
+    DrawTiledLights(rc, pass->params, pass->lights, pass->numLight,
+                    lightTarget, pass->width, pass->height);
+  } else {
+    DrawLightQuads(rc, pass->params, pass->lights, pass->numLight,
+                   lightTarget, pass->width, pass->height);
+  }
+
+  glEnable(GL_BLEND);
+}
+
+typedef struct LightCompositePassData {
+  int lightBuffer;
+  int lightWidth;
+  int lightHeight;
+  int scene;
+  int width;
+  int height;
+} LightCompositePassData;
+
+// Multiply the scene by the light buffer, keeping the scene's alpha
+static void ExecuteLightCompositePass(RenderContext *rc,
+                                      const RenderGraph *graph,
+                                      const void *data) {
+  static const float noParams[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  const LightCompositePassData *pass = data;
+
+  glBlendFuncSeparate(GL_DST_COLOR, GL_ZERO, GL_ZERO, GL_ONE);
+  glBindVertexArray(rc->fullscreenVAO);
+  RunFullscreenPass(&rc->lighting.compositeProgram,
+                    GetGraphTarget(graph, pass->lightBuffer), pass->lightWidth,
+                    pass->lightHeight, GetGraphTarget(graph, pass->scene),
+                    pass->width, pass->height, SDV2(1.0f, 1.0f), noParams);
+  glBindVertexArray(0);
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+extern void AddLightingPasses(RenderContext *rc, RenderGraph *graph,
+                              const SDLightingParams *params,
+                              const LightInstance *lights, int numLight,
+                              int scene, int width, int height) {
+  Lighting *lighting = &rc->lighting;
+  const RenderTarget *sceneTarget = GetGraphTarget(graph, scene);
+
+  if (!lighting->program) {
+    InitLightingPrograms(lighting);
+  }
+
+  // Like the scene, the light buffer is sized from the viewport so the pool
+  // hands back the same one each frame
+  float scale = SDClampF(params->resolutionScale, 0.125f, 1.0f);
+  LightPassData light = {
+      .params = params,
+      .lights = lights,
+      .numLight = numLight,
+      .lightBuffer = CreateGraphTarget(
+          graph, (int)SDCeilF(sceneTarget->width * scale),
+          (int)SDCeilF(sceneTarget->height * scale), GL_RGBA16F),
+      .width = (int)SDMaxF(1.0f, SDCeilF(width * scale)),
+      .height = (int)SDMaxF(1.0f, SDCeilF(height * scale)),
+  };
+  RenderPass *pass =
+      AddRenderPass(graph, ExecuteLightPass, &light, sizeof(light));
+  WriteGraphTarget(pass, light.lightBuffer);
+
+  LightCompositePassData composite = {
+      .lightBuffer = light.lightBuffer,
+      .lightWidth = light.width,
+      .lightHeight = light.height,
+      .scene = scene,
+      .width = width,
+      .height = height,
+  };
+  pass = AddRenderPass(graph, ExecuteLightCompositePass, &composite,
+                       sizeof(composite));
+  ReadGraphTarget(pass, light.lightBuffer);
+  ReadGraphTarget(pass, scene);
+  WriteGraphTarget(pass, scene);
+}
+
+// ----------------------------------------------------------------------------
+// Lighting API
+// ----------------------------------------------------------------------------
+
+SDAPI SDLightingParams SDMakeLightingParams(void) {
+  SDLightingParams params = {
+      .enabled = 0,
+      .ambientColor = SDRGBA(0.1f, 0.1f, 0.1f, 1.0f),
+      .resolutionScale = 0.5f,
+      .tiledCulling = 0,
+  };
+  return params;
+}
+
+SDAPI void SDSetLighting(const SDLightingParams *params) {
+  CTX.rc->lighting.params = *params;
+}
+
+SDAPI SDLight SDMakePointLight(SDVec2 position, SDFloat radius,
+                               SDColor color) {
+  SDLight light = {
+      .position = position,
+      .radius = radius,
+      .color = color,
+      .direction = SDV2(1.0f, 0.0f),
+      .coneAngle = (SDFloat)M_PI,
+  };
+  return light;
+}
+
+SDAPI SDLight SDMakeSpotLight(SDVec2 position, SDFloat radius,
+                              SDVec2 direction, SDFloat coneAngle,
+                              SDColor color) {
+  SDLight light = {
+      .position = position,
+      .radius = radius,
+      .color = color,
+      .direction = direction,
+      .coneAngle = coneAngle,
+  };
+  return light;
+}
+
+SDAPI void SDDrawLight(const SDLight *light) {
+  RenderContext *rc = CTX.rc;
+  Lighting *lighting = &rc->lighting;
+  SDMat3 camera = rc->camera;
+
+  if (!lighting->params.enabled || light->radius <= 0.0f) {
+    return;
+  }
+
+  if (rc->recorder) {
+    RecordCall(rc->recorder, RECORD_DRAW_LIGHT, light, sizeof(*light));
+  }
+
+  SDVec2 center = SDDotM3V2(camera, light->position);
+  SDFloat radius =
+      light->radius *
+      sqrtf(SDAbsF(camera.m00 * camera.m11 - camera.m01 * camera.m10));
+
+  // Lights outside the camera's viewport are dropped here rather than on the
+  // GPU
+  SDRect viewport = rc->cameraViewport;
+  if (center.x + radius < viewport.min.x ||
+      center.y + radius < viewport.min.y ||
+      center.x - radius > viewport.max.x ||
+      center.y - radius > viewport.max.y) {
+    return;
+  }
+
+  if (lighting->numLight == lighting->lightCapacity) {
+    lighting->lightCapacity =
+        lighting->lightCapacity ? lighting->lightCapacity * 2 : 64;
+    lighting->lights =
+        realloc(lighting->lights,
+                sizeof(LightInstance) * (size_t)lighting->lightCapacity);
+  }
+
+  SDVec2 direction = SDV2(camera.m00 * light->direction.x +
+                              camera.m01 * light->direction.y,
+                          camera.m10 * light->direction.x +
+                              camera.m11 * light->direction.y);
+  SDFloat length = sqrtf(direction.x * direction.x + direction.y * direction.y);
+  if (length > 0.0f) {
+    direction = SDV2(direction.x / length, direction.y / length);
+  }
+
+  SDFloat cosCone = light->coneAngle >= (SDFloat)M_PI
+                        ? -1.0f
+                        : cosf(SDMaxF(light->coneAngle, 0.0f));
+
+  LightInstance *instance = &lighting->lights[lighting->numLight++];
+  *instance = (LightInstance){
+      .center = {center.x, center.y},
+      .radius = radius,
+      .cosCone = cosCone,
+      .color = {light->color.r, light->color.g, light->color.b,
+                light->color.a},
+      .direction = {direction.x, direction.y},
+      .clip = {viewport.min.x, viewport.min.y, viewport.max.x,
+               viewport.max.y},
+  };
+}
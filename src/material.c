@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "command.h"
+#include "render_internal.h"
+
+const char MATERIAL_FRAGMENT_SHADER_HEADER[] =
+    "#version 330 core                                                      \n"
+    "                                                                       \n"
+    "uniform sampler2D texture0;                                            \n"
+    "                                                                       \n"
+    "// MAX_BATCH_PARAM                                                     \n"
+    "layout (std140) uniform SDMaterialParams {                             \n"
+    "   vec4 sdParams[1024];                                                \n"
+    "};                                                                     \n"
+    "                                                                       \n"
+    "flat in int vParamOffset;                                              \n"
+    "                                                                       \n"
+    "vec4 SDParam(int i) { return sdParams[vParamOffset + i]; }             \n"
+    "                                                                       \n"
+    "// Errors in the material code report its own line numbers             \n"
+    "#line 1                                                                \n";
+
+const char MATERIAL_FRAGMENT_SHADER_FOOTER[] =
+    "                                                                       \n"
+    "in vec2 vTexCoord;                                                     \n"
+    "in vec4 vColor;                                                        \n"
+    "                                                                       \n"
+    "out vec4 fragColor;                                                    \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   fragColor = Shade(vTexCoord, vColor);                               \n"
+    "}                                                                      \n";
+
+static void InitMaterialRing(MaterialRing *ring) {
+  glGenBuffers(1, &ring->ubo);
+  glBindBuffer(GL_UNIFORM_BUFFER, ring->ubo);
+  glBufferData(GL_UNIFORM_BUFFER, MATERIAL_RING_SIZE, NULL, GL_STREAM_DRAW);
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ring->alignment);
+  ring->offset = 0;
+}
+
+extern void BindMaterialParams(RenderContext *rc, const SDFloat *params,
+                               int numParam) {
+  MaterialRing *ring = &rc->materialRing;
+  // The whole block is bound, whatever the batch used of it
+  GLsizeiptr blockSize = MAX_BATCH_PARAM * 4 * sizeof(SDFloat);
+  GLsizeiptr size = numParam * 4 * sizeof(SDFloat);
+
+  glBindBuffer(GL_UNIFORM_BUFFER, ring->ubo);
+  if (ring->offset + blockSize > MATERIAL_RING_SIZE) {
+    // Batches still reading the old storage keep it until they are done
+    glBufferData(GL_UNIFORM_BUFFER, MATERIAL_RING_SIZE, NULL, GL_STREAM_DRAW);
+    ring->offset = 0;
+  }
+
+  if (size > 0) {
+    glBufferSubData(GL_UNIFORM_BUFFER, ring->offset, size, params);
+  }
+  glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_PARAM_BINDING, ring->ubo,
+                    ring->offset, blockSize);
+
+  int alignment = ring->alignment > 0 ? ring->alignment : 256;
+  ring->offset += (int)((size + alignment - 1) / alignment * alignment);
+}
+
+typedef struct CreateMaterialCommand {
+  SDMaterial *material;
+  const char *fragmentShader;
+} CreateMaterialCommand;
+
+static void ExecuteCreateMaterial(void *data) {
+  const CreateMaterialCommand *command = data;
+  RenderContext *rc = CTX.rc;
+  SDMaterial *material = command->material;
+
+  if (!rc->materialRing.ubo) {
+    InitMaterialRing(&rc->materialRing);
+  }
+
+  material->program =
+      CompileGLProgram(DRAW_TEXTURE_VERTEX_SHADER, command->fragmentShader);
+  if (!material->program) {
+    return;
+  }
+
+  glUseProgram(material->program);
+  glUniform1i(glGetUniformLocation(material->program, "texture0"), 0);
+  material->MVPLocation = glGetUniformLocation(material->program, "MVP");
+
+  // Inactive when the material reads no parameters
+  GLuint blockIndex =
+      glGetUniformBlockIndex(material->program, "SDMaterialParams");
+  if (blockIndex != GL_INVALID_INDEX) {
+    glUniformBlockBinding(material->program, blockIndex,
+                          MATERIAL_PARAM_BINDING);
+  }
+}
+
+SDAPI SDMaterial *SDCreateMaterial(const char *source, int numParam) {
+  SDAssert(numParam >= 0 && numParam <= SD_MAX_MATERIAL_PARAM);
+
+  SDMaterial *material = malloc(sizeof(SDMaterial));
+  material->program = 0;
+  material->MVPLocation = -1;
+  material->numParam = numParam;
+
+  size_t sourceSize = strlen(source);
+  material->source = malloc(sourceSize + 1);
+  memcpy(material->source, source, sourceSize + 1);
+
+  size_t headerSize = sizeof(MATERIAL_FRAGMENT_SHADER_HEADER) - 1;
+  size_t footerSize = sizeof(MATERIAL_FRAGMENT_SHADER_FOOTER);
+  size_t size = headerSize + sourceSize + footerSize;
+  char *fragmentShader = malloc(size);
+  memcpy(fragmentShader, MATERIAL_FRAGMENT_SHADER_HEADER, headerSize);
+  memcpy(fragmentShader + headerSize, source, sourceSize);
+  memcpy(fragmentShader + headerSize + sourceSize,
+         MATERIAL_FRAGMENT_SHADER_FOOTER, footerSize);
+
+  CreateMaterialCommand *command =
+      BeginCommand(ExecuteCreateMaterial, sizeof(CreateMaterialCommand));
+  command->material = material;
+  command->fragmentShader = CopyCommandData(fragmentShader, size);
+  CommitCommand();
+
+  free(fragmentShader);
+  return material;
+}
+
+static void ExecuteDestroyMaterial(void *data) {
+  SDMaterial *material = *(SDMaterial **)data;
+
+  if (material->program) {
+    glDeleteProgram(material->program);
+  }
+  free(material->source);
+  free(material);
+}
+
+SDAPI void SDDestroyMaterial(SDMaterial **ptr) {
+  RenderContext *rc = CTX.rc;
+  SDMaterial *material = *ptr;
+
+  // Draws of it still waiting in the batch go first
+  if (rc->batch.material == material) {
+    FlushBatch(rc);
+    rc->batch.material = NULL;
+  }
+
+  SDMaterial **command =
+      BeginCommand(ExecuteDestroyMaterial, sizeof(SDMaterial *));
+  *command = material;
+  CommitCommand();
+
+  *ptr = NULL;
+}
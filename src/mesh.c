@@ -0,0 +1,314 @@
+#include "sword/mesh.h"
+
+#include "command.h"
+#include "render_internal.h"
+
+const char MESH_VERTEX_SHADER[] =
+    "#version 330 core                                                      \n"
+    "                                                                       \n"
+    "uniform mat3 MVP;                                                      \n"
+    "                                                                       \n"
+    "layout (location = 0) in vec2 aPos;                                    \n"
+    "layout (location = 1) in vec2 aTexCoord;                               \n"
+    "layout (location = 2) in vec4 aColor;                                  \n"
+    "out vec2 vTexCoord;                                                    \n"
+    "out vec4 vColor;                                                       \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   gl_Position = vec4(MVP * vec3(aPos, 1), 1);                         \n"
+    "   vTexCoord = aTexCoord;                                              \n"
+    "   vColor = aColor;                                                    \n"
+    "}                                                                      \n";
+
+const char MESH_FRAGMENT_SHADER[] =
+    "#version 330 core                                                      \n"
+    "                                                                       \n"
+    "uniform sampler2D texture0;                                            \n"
+    "uniform vec4 tintColor;                                                \n"
+    "                                                                       \n"
+    "in vec2 vTexCoord;                                                     \n"
+    "in vec4 vColor;                                                        \n"
+    "                                                                       \n"
+    "out vec4 fragColor;                                                    \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   // Textures and vertex colors are pre-multiplied at creation        \n"
+    "   fragColor = texture(texture0, vTexCoord) * vColor * tintColor;      \n"
+    "}                                                                      \n";
+
+struct SDMesh {
+  SDTexture *texture;
+  BufferRange range;  // Vertices, then indices
+  size_t indexOffset;  // in the range
+  int numIndex;
+  GLenum indexType;  // 16 bit indices when the vertices fit
+  SDRect bounds;     // in mesh space
+};
+
+extern void InitMeshProgram(MeshProgram *meshProgram) {
+  meshProgram->program =
+      CompileGLProgram(MESH_VERTEX_SHADER, MESH_FRAGMENT_SHADER);
+  if (!meshProgram->program) {
+    exit(EXIT_FAILURE);
+  }
+  glUseProgram(meshProgram->program);
+  glUniform1i(glGetUniformLocation(meshProgram->program, "texture0"), 0);
+  meshProgram->MVPLocation = glGetUniformLocation(meshProgram->program, "MVP");
+  meshProgram->tintColorLocation =
+      glGetUniformLocation(meshProgram->program, "tintColor");
+}
+
+extern void InitMeshVertexFormat(void) {
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                        (void *)offsetof(MeshVertex, pos));
+  glEnableVertexAttribArray(0);
+
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                        (void *)offsetof(MeshVertex, texCoord));
+  glEnableVertexAttribArray(1);
+
+  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                        (void *)offsetof(MeshVertex, color));
+  glEnableVertexAttribArray(2);
+}
+
+extern SDMesh *CreateMeshFromVertices(const MeshVertex *vertices,
+                                      int numVertex,
+                                      const unsigned int *indices,
+                                      int numIndex, SDTexture *texture) {
+  RenderContext *rc = CTX.rc;
+
+  SDMesh *mesh = malloc(sizeof(SDMesh));
+  mesh->texture = texture ? texture : rc->whiteTexture;
+  mesh->numIndex = numIndex;
+
+  SDVec2 min = SDV2(vertices[0].pos[0], vertices[0].pos[1]);
+  SDVec2 max = min;
+  for (int i = 1; i < numVertex; ++i) {
+    const MeshVertex *vertex = &vertices[i];
+    min = SDV2(SDMinF(min.x, vertex->pos[0]), SDMinF(min.y, vertex->pos[1]));
+    max = SDV2(SDMaxF(max.x, vertex->pos[0]), SDMaxF(max.y, vertex->pos[1]));
+  }
+  mesh->bounds = SDRectMinMax(min, max);
+
+  // 16 bit indices when the vertices fit
+  unsigned short *shortIndices = NULL;
+  if (numVertex <= 0xFFFF) {
+    shortIndices = malloc(numIndex * sizeof(*shortIndices) + 1);
+    for (int i = 0; i < numIndex; ++i) {
+      shortIndices[i] = (unsigned short)indices[i];
+    }
+    mesh->indexType = GL_UNSIGNED_SHORT;
+  } else {
+    mesh->indexType = GL_UNSIGNED_INT;
+  }
+
+  // Vertices are aligned to their size so the range starts at a whole base
+  // vertex, the indices after them are then aligned as well
+  size_t vertexSize = (size_t)numVertex * sizeof(MeshVertex);
+  size_t indexSize = shortIndices ? numIndex * sizeof(*shortIndices)
+                                  : numIndex * sizeof(*indices);
+  mesh->range = AllocBufferRange(&rc->meshArena, vertexSize + indexSize,
+                                 sizeof(MeshVertex));
+  mesh->indexOffset = vertexSize;
+  UploadBufferRange(mesh->range, 0, vertices, vertexSize);
+  if (shortIndices) {
+    UploadBufferRange(mesh->range, vertexSize, shortIndices, indexSize);
+  } else {
+    UploadBufferRange(mesh->range, vertexSize, indices, indexSize);
+  }
+
+  free(shortIndices);
+
+  return mesh;
+}
+
+SDAPI SDMesh *SDCreateMesh(const SDMeshVertex *vertices, int numVertex,
+                           const unsigned int *indices, int numIndex,
+                           SDTexture *texture) {
+  SDAssert(numVertex > 0 && numIndex % 3 == 0);
+
+  // Bring texture coordinates to the padded texture and pre-multiply colors
+  // here so drawing does no per-vertex work
+  SDVec2 texScale = SDZeroVec2();
+  if (texture) {
+    texScale = SDV2(1.0f / texture->actualWidth, 1.0f / texture->actualHeight);
+  }
+
+  MeshVertex *meshVertices = malloc(numVertex * sizeof(MeshVertex));
+  for (int i = 0; i < numVertex; ++i) {
+    const SDMeshVertex *src = &vertices[i];
+    MeshVertex *dst = &meshVertices[i];
+    dst->pos[0] = src->position.x;
+    dst->pos[1] = src->position.y;
+    dst->texCoord[0] = src->texCoord.x * texScale.x;
+    dst->texCoord[1] = src->texCoord.y * texScale.y;
+    dst->color[0] = src->color.r * src->color.a;
+    dst->color[1] = src->color.g * src->color.a;
+    dst->color[2] = src->color.b * src->color.a;
+    dst->color[3] = src->color.a;
+  }
+
+  SDMesh *mesh = CreateMeshFromVertices(meshVertices, numVertex, indices,
+                                        numIndex, texture);
+  free(meshVertices);
+
+  return mesh;
+}
+
+static void ExecuteDestroyMesh(void *data) {
+  SDMesh *mesh = *(SDMesh **)data;
+  free(mesh);
+}
+
+SDAPI void SDDestroyMesh(SDMesh **ptr) {
+  RenderContext *rc = CTX.rc;
+
+  // A mesh created at the same address is another one
+  if (rc->recorder) {
+    ForgetRecordedMesh(rc->recorder, *ptr);
+  }
+
+  FreeBufferRange((*ptr)->range);
+
+  // Draws recorded before still use the mesh
+  SDMesh **command = BeginCommand(ExecuteDestroyMesh, sizeof(SDMesh *));
+  *command = *ptr;
+  CommitCommand();
+
+  *ptr = NULL;
+}
+
+typedef struct DrawMeshCommand {
+  const SDMesh *mesh;
+  SDMat3 MVP;
+  SDColor tintColor;
+} DrawMeshCommand;
+
+static void ExecuteDrawMesh(void *data) {
+  const DrawMeshCommand *command = data;
+  RenderContext *rc = CTX.rc;
+  MeshProgram *meshProgram = &rc->meshProgram;
+  const SDMesh *mesh = command->mesh;
+  SDColor tintColor = command->tintColor;
+
+  if (!meshProgram->program) {
+    InitMeshProgram(meshProgram);
+  }
+
+  glUseProgram(meshProgram->program);
+  glUniformMatrix3fv(meshProgram->MVPLocation, 1, GL_FALSE,
+                     (const GLfloat *)&command->MVP);
+  glUniform4f(meshProgram->tintColorLocation, tintColor.r, tintColor.g,
+              tintColor.b, tintColor.a);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, mesh->texture->id);
+
+  const BufferRange *range = &mesh->range;
+  glBindVertexArray(range->block->vao);
+  glDrawElementsBaseVertex(
+      GL_TRIANGLES, mesh->numIndex, mesh->indexType,
+      (void *)(range->offset + mesh->indexOffset),
+      (GLint)(range->offset / sizeof(MeshVertex)));
+  glBindVertexArray(0);
+
+  if (CTX.renderBackend == SD_RENDER_BACKEND_SOFTWARE) {
+    const unsigned char *buffer = GetNullGLBufferData(range->block->buffer);
+    DrawSoftwareMesh(mesh->texture, command->MVP, tintColor,
+                     (const MeshVertex *)(buffer + range->offset),
+                     buffer + range->offset + mesh->indexOffset,
+                     mesh->indexType, mesh->numIndex);
+  }
+
+  rc->numDrawCall++;
+}
+
+typedef struct ReadMeshCommand {
+  const SDMesh *mesh;
+  MeshVertex *vertices;
+  unsigned int *indices;
+} ReadMeshCommand;
+
+// The mesh is only kept on the GPU
+static void ExecuteReadMesh(void *data) {
+  const ReadMeshCommand *command = data;
+  const SDMesh *mesh = command->mesh;
+  const BufferRange *range = &mesh->range;
+  GLintptr indexOffset = (GLintptr)(range->offset + mesh->indexOffset);
+
+  glBindBuffer(GL_COPY_READ_BUFFER, range->block->buffer);
+  glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)range->offset,
+                     (GLsizeiptr)mesh->indexOffset, command->vertices);
+  if (mesh->indexType == GL_UNSIGNED_INT) {
+    glGetBufferSubData(GL_COPY_READ_BUFFER, indexOffset,
+                       mesh->numIndex * sizeof(unsigned int),
+                       command->indices);
+  } else {
+    unsigned short *shortIndices =
+        malloc(mesh->numIndex * sizeof(*shortIndices));
+    glGetBufferSubData(GL_COPY_READ_BUFFER, indexOffset,
+                       mesh->numIndex * sizeof(*shortIndices), shortIndices);
+    for (int i = 0; i < mesh->numIndex; ++i) {
+      command->indices[i] = shortIndices[i];
+    }
+    free(shortIndices);
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+// Read the mesh back the first time it is drawn in the frame
+static void RecordMesh(FrameRecorder *recorder, const SDMesh *mesh,
+                       SDMat3 transform, SDColor tintColor) {
+  int index = FindRecordedMesh(recorder, mesh);
+  if (index < 0) {
+    MeshVertex *vertices;
+    unsigned int *indices;
+    index = AddRecordedMesh(
+        recorder, mesh, mesh->texture,
+        (int)(mesh->indexOffset / sizeof(MeshVertex)), mesh->numIndex,
+        &vertices, &indices);
+
+    ReadMeshCommand *command =
+        BeginCommand(ExecuteReadMesh, sizeof(ReadMeshCommand));
+    command->mesh = mesh;
+    command->vertices = vertices;
+    command->indices = indices;
+    CommitCommand();
+  }
+
+  RecordMeshDraw(recorder, index, transform, tintColor);
+}
+
+SDAPI void SDDrawMesh(const SDMesh *mesh, SDMat3 transform,
+                      SDColor tintColor) {
+  RenderContext *rc = CTX.rc;
+
+  if (mesh->numIndex == 0) {
+    return;
+  }
+
+  if (rc->recorder) {
+    RecordMesh(rc->recorder, mesh, transform, tintColor);
+  }
+
+  SDRect bounds = SDTransformRectM3(transform, mesh->bounds);
+  SDRect visible = rc->visibleBounds;
+  if (bounds.max.x < visible.min.x || bounds.max.y < visible.min.y ||
+      bounds.min.x > visible.max.x || bounds.min.y > visible.max.y) {
+    return;
+  }
+
+  if (!ClipBounds(rc, bounds)) {
+    return;
+  }
+
+  FlushBatch(rc);
+
+  DrawMeshCommand *command =
+      BeginCommand(ExecuteDrawMesh, sizeof(DrawMeshCommand));
+  command->mesh = mesh;
+  command->MVP = SDDotM3(rc->viewProjection, transform);
+  command->tintColor = tintColor;
+  CommitCommand();
+}
@@ -0,0 +1,667 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "render_internal.h"
+
+// GL of the null and recording backends, handed to the loader in place of the
+// driver's. Every call does nothing, except for what the renderer reads back:
+// object names, successful compiles and links, finished queries and fences,
+// and zeroed memory for maps and pixel reads. The state a draw is made with is
+// tracked so the recording backend can describe it. Pixel reads return what
+// the software backend drew, if anything, and buffers keep their contents for
+// it to draw from.
+
+#define NULL_GL_TEXTURE_UNIT 16
+#define NULL_GL_BUFFER_TARGET 16
+
+typedef struct NullGLObject {
+  int width;  // Of level 0 of a texture
+  int height;
+  void *mapped;  // Of a buffer
+  // Of a pixel pack buffer, which pixels are read into and mapped from, and of
+  // every buffer on the software backend
+  unsigned char *storage;
+} NullGLObject;
+
+typedef struct BufferBinding {
+  GLenum target;
+  GLuint buffer;
+} BufferBinding;
+
+static struct {
+  // Indexed by name, names are never reused. Name 0 is the default
+  // framebuffer, texture and so on.
+  NullGLObject *objects;
+  GLuint numObject;
+  GLuint objectCapacity;
+
+  BufferBinding buffers[NULL_GL_BUFFER_TARGET];
+  int numBufferTarget;
+  GLuint textures[NULL_GL_TEXTURE_UNIT];
+  int activeTexture;
+  GLuint program;
+  GLuint drawFramebuffer;
+  int isBlended;
+  int isScissored;
+  GLint scissor[4];
+
+  // Draws of the frame so far with the recording backend
+  SubmittedDraws draws;
+} NULL_GL;
+
+static GLuint GenNullGLObject(void) {
+  GLuint name = ++NULL_GL.numObject;
+  if (name >= NULL_GL.objectCapacity) {
+    NULL_GL.objectCapacity =
+        NULL_GL.objectCapacity > 0 ? NULL_GL.objectCapacity * 2 : 256;
+    NULL_GL.objects = realloc(NULL_GL.objects, sizeof(NullGLObject) *
+                                                   NULL_GL.objectCapacity);
+  }
+  if (name == 1) {
+    memset(&NULL_GL.objects[0], 0, sizeof(NullGLObject));
+  }
+  memset(&NULL_GL.objects[name], 0, sizeof(NullGLObject));
+  return name;
+}
+
+static void GenNullGLObjects(GLsizei n, GLuint *names) {
+  for (GLsizei i = 0; i < n; ++i) {
+    names[i] = GenNullGLObject();
+  }
+}
+
+static void DeleteNullGLObjects(GLsizei n, const GLuint *names) {
+  for (GLsizei i = 0; i < n; ++i) {
+    if (names[i] && names[i] <= NULL_GL.numObject) {
+      free(NULL_GL.objects[names[i]].mapped);
+      NULL_GL.objects[names[i]].mapped = NULL;
+      free(NULL_GL.objects[names[i]].storage);
+      NULL_GL.objects[names[i]].storage = NULL;
+    }
+  }
+}
+
+static GLuint *GetBufferBinding(GLenum target) {
+  for (int i = 0; i < NULL_GL.numBufferTarget; ++i) {
+    if (NULL_GL.buffers[i].target == target) {
+      return &NULL_GL.buffers[i].buffer;
+    }
+  }
+
+  SDAssert(NULL_GL.numBufferTarget < NULL_GL_BUFFER_TARGET);
+  BufferBinding *binding = &NULL_GL.buffers[NULL_GL.numBufferTarget++];
+  binding->target = target;
+  binding->buffer = 0;
+  return &binding->buffer;
+}
+
+static void RecordNullGLDraw(GLenum mode, int numElement, int numInstance) {
+  if (CTX.renderBackend != SD_RENDER_BACKEND_RECORDING) {
+    return;
+  }
+
+  SubmittedDraws *draws = &NULL_GL.draws;
+  if (draws->numDraw == draws->capacity) {
+    draws->capacity = draws->capacity > 0 ? draws->capacity * 2 : 256;
+    draws->draws = realloc(draws->draws,
+                           sizeof(SDSubmittedDraw) * (size_t)draws->capacity);
+  }
+
+  SDSubmittedDraw *draw = &draws->draws[draws->numDraw++];
+  draw->numElement = numElement;
+  draw->numInstance = numInstance;
+  draw->isLines =
+      mode == GL_LINES || mode == GL_LINE_STRIP || mode == GL_LINE_LOOP;
+  draw->isBlended = NULL_GL.isBlended;
+  draw->isScissored = NULL_GL.isScissored;
+  draw->program = NULL_GL.program;
+  draw->texture = NULL_GL.textures[0];
+  draw->framebuffer = NULL_GL.drawFramebuffer;
+}
+
+extern void EndNullGLFrame(SubmittedDraws *draws) {
+  SubmittedDraws recorded = NULL_GL.draws;
+  NULL_GL.draws = *draws;
+  NULL_GL.draws.numDraw = 0;
+  *draws = recorded;
+}
+
+// ----------------------------------------------------------------------------
+// Objects
+// ----------------------------------------------------------------------------
+
+static GLuint APIENTRY NullCreateProgram(void) { return GenNullGLObject(); }
+
+static GLuint APIENTRY NullCreateShader(GLenum type) {
+  return GenNullGLObject();
+}
+
+static void APIENTRY NullGenBuffers(GLsizei n, GLuint *buffers) {
+  GenNullGLObjects(n, buffers);
+}
+
+static void APIENTRY NullGenFramebuffers(GLsizei n, GLuint *framebuffers) {
+  GenNullGLObjects(n, framebuffers);
+}
+
+static void APIENTRY NullGenQueries(GLsizei n, GLuint *ids) {
+  GenNullGLObjects(n, ids);
+}
+
+static void APIENTRY NullGenTextures(GLsizei n, GLuint *textures) {
+  GenNullGLObjects(n, textures);
+}
+
+static void APIENTRY NullGenVertexArrays(GLsizei n, GLuint *arrays) {
+  GenNullGLObjects(n, arrays);
+}
+
+static void APIENTRY NullDeleteBuffers(GLsizei n, const GLuint *buffers) {
+  DeleteNullGLObjects(n, buffers);
+}
+
+static void APIENTRY NullDeleteFramebuffers(GLsizei n,
+                                            const GLuint *framebuffers) {}
+
+static void APIENTRY NullDeleteProgram(GLuint program) {}
+
+static void APIENTRY NullDeleteTextures(GLsizei n, const GLuint *textures) {}
+
+static void APIENTRY NullDeleteVertexArrays(GLsizei n, const GLuint *arrays) {}
+
+static GLsync APIENTRY NullFenceSync(GLenum condition, GLbitfield flags) {
+  return (GLsync)(uintptr_t)GenNullGLObject();
+}
+
+static void APIENTRY NullDeleteSync(GLsync sync) {}
+
+static GLenum APIENTRY NullClientWaitSync(GLsync sync, GLbitfield flags,
+                                          GLuint64 timeout) {
+  return GL_ALREADY_SIGNALED;
+}
+
+// ----------------------------------------------------------------------------
+// Shaders
+// ----------------------------------------------------------------------------
+
+static void APIENTRY NullShaderSource(GLuint shader, GLsizei count,
+                                      const GLchar *const *string,
+                                      const GLint *length) {}
+
+static void APIENTRY NullCompileShader(GLuint shader) {}
+
+static void APIENTRY NullAttachShader(GLuint program, GLuint shader) {}
+
+static void APIENTRY NullLinkProgram(GLuint program) {}
+
+static void APIENTRY NullGetShaderiv(GLuint shader, GLenum pname,
+                                     GLint *params) {
+  *params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+}
+
+static void APIENTRY NullGetProgramiv(GLuint program, GLenum pname,
+                                      GLint *params) {
+  *params = pname == GL_LINK_STATUS ? GL_TRUE : 0;
+}
+
+static void APIENTRY NullGetInfoLog(GLuint object, GLsizei bufSize,
+                                    GLsizei *length, GLchar *infoLog) {
+  if (length) {
+    *length = 0;
+  }
+  if (bufSize > 0) {
+    infoLog[0] = 0;
+  }
+}
+
+static GLint APIENTRY NullGetUniformLocation(GLuint program,
+                                             const GLchar *name) {
+  return 0;
+}
+
+static GLuint APIENTRY NullGetUniformBlockIndex(GLuint program,
+                                                const GLchar *name) {
+  return 0;
+}
+
+static void APIENTRY NullUniformBlockBinding(GLuint program, GLuint index,
+                                             GLuint binding) {}
+
+static void APIENTRY NullUseProgram(GLuint program) {
+  NULL_GL.program = program;
+}
+
+static void APIENTRY NullUniform1f(GLint location, GLfloat v0) {}
+
+static void APIENTRY NullUniform1i(GLint location, GLint v0) {}
+
+static void APIENTRY NullUniform2f(GLint location, GLfloat v0, GLfloat v1) {}
+
+static void APIENTRY NullUniform3f(GLint location, GLfloat v0, GLfloat v1,
+                                   GLfloat v2) {}
+
+static void APIENTRY NullUniform4f(GLint location, GLfloat v0, GLfloat v1,
+                                   GLfloat v2, GLfloat v3) {}
+
+static void APIENTRY NullUniform4fv(GLint location, GLsizei count,
+                                    const GLfloat *value) {}
+
+static void APIENTRY NullUniformMatrix3fv(GLint location, GLsizei count,
+                                          GLboolean transpose,
+                                          const GLfloat *value) {}
+
+// ----------------------------------------------------------------------------
+// Buffers and Vertex Arrays
+// ----------------------------------------------------------------------------
+
+static void APIENTRY NullBindBuffer(GLenum target, GLuint buffer) {
+  *GetBufferBinding(target) = buffer;
+}
+
+static void APIENTRY NullBindBufferRange(GLenum target, GLuint index,
+                                         GLuint buffer, GLintptr offset,
+                                         GLsizeiptr size) {
+  *GetBufferBinding(target) = buffer;
+}
+
+static void APIENTRY NullBufferData(GLenum target, GLsizeiptr size,
+                                    const void *data, GLenum usage) {
+  if (target != GL_PIXEL_PACK_BUFFER &&
+      CTX.renderBackend != SD_RENDER_BACKEND_SOFTWARE) {
+    return;
+  }
+
+  NullGLObject *buffer = &NULL_GL.objects[*GetBufferBinding(target)];
+  free(buffer->storage);
+  buffer->storage = calloc(1, size > 0 ? (size_t)size : 1);
+  if (data) {
+    memcpy(buffer->storage, data, (size_t)size);
+  }
+}
+
+static void APIENTRY NullBufferSubData(GLenum target, GLintptr offset,
+                                       GLsizeiptr size, const void *data) {
+  NullGLObject *buffer = &NULL_GL.objects[*GetBufferBinding(target)];
+  if (buffer->storage) {
+    memcpy(buffer->storage + offset, data, (size_t)size);
+  }
+}
+
+static void APIENTRY NullGetBufferSubData(GLenum target, GLintptr offset,
+                                          GLsizeiptr size, void *data) {
+  const NullGLObject *buffer = &NULL_GL.objects[*GetBufferBinding(target)];
+  if (buffer->storage) {
+    memcpy(data, buffer->storage + offset, (size_t)size);
+  } else {
+    memset(data, 0, (size_t)size);
+  }
+}
+
+extern const void *GetNullGLBufferData(GLuint buffer) {
+  return NULL_GL.objects[buffer].storage;
+}
+
+// Mapped memory stays with the buffer until it is unmapped
+static void *APIENTRY NullMapBufferRange(GLenum target, GLintptr offset,
+                                         GLsizeiptr length,
+                                         GLbitfield access) {
+  NullGLObject *buffer = &NULL_GL.objects[*GetBufferBinding(target)];
+  if (buffer->storage) {
+    return buffer->storage + offset;
+  }
+  free(buffer->mapped);
+  buffer->mapped = calloc(1, length > 0 ? (size_t)length : 1);
+  return buffer->mapped;
+}
+
+static GLboolean APIENTRY NullUnmapBuffer(GLenum target) {
+  NullGLObject *buffer = &NULL_GL.objects[*GetBufferBinding(target)];
+  free(buffer->mapped);
+  buffer->mapped = NULL;
+  return GL_TRUE;
+}
+
+static void APIENTRY NullBindVertexArray(GLuint array) {}
+
+static void APIENTRY NullEnableVertexAttribArray(GLuint index) {}
+
+static void APIENTRY NullVertexAttribPointer(GLuint index, GLint size,
+                                             GLenum type, GLboolean normalized,
+                                             GLsizei stride,
+                                             const void *pointer) {}
+
+static void APIENTRY NullVertexAttribIPointer(GLuint index, GLint size,
+                                              GLenum type, GLsizei stride,
+                                              const void *pointer) {}
+
+static void APIENTRY NullVertexAttribDivisor(GLuint index, GLuint divisor) {}
+
+// ----------------------------------------------------------------------------
+// Textures and Framebuffers
+// ----------------------------------------------------------------------------
+
+static void APIENTRY NullActiveTexture(GLenum texture) {
+  NULL_GL.activeTexture = (int)(texture - GL_TEXTURE0);
+}
+
+static void APIENTRY NullBindTexture(GLenum target, GLuint texture) {
+  SDAssert(NULL_GL.activeTexture < NULL_GL_TEXTURE_UNIT);
+  NULL_GL.textures[NULL_GL.activeTexture] = texture;
+}
+
+static void APIENTRY NullTexImage2D(GLenum target, GLint level,
+                                    GLint internalformat, GLsizei width,
+                                    GLsizei height, GLint border,
+                                    GLenum format, GLenum type,
+                                    const void *pixels) {
+  if (level == 0) {
+    NullGLObject *texture =
+        &NULL_GL.objects[NULL_GL.textures[NULL_GL.activeTexture]];
+    texture->width = width;
+    texture->height = height;
+  }
+}
+
+static void APIENTRY NullTexParameteri(GLenum target, GLenum pname,
+                                       GLint param) {}
+
+static void APIENTRY NullTexParameteriv(GLenum target, GLenum pname,
+                                        const GLint *params) {}
+
+static void APIENTRY NullTexBuffer(GLenum target, GLenum internalformat,
+                                   GLuint buffer) {}
+
+static void APIENTRY NullPixelStorei(GLenum pname, GLint param) {}
+
+// Only what the renderer reads, one byte channels
+static size_t GetNullGLPixelSize(GLenum format) {
+  return format == GL_RED ? 1 : 4;
+}
+
+static void APIENTRY NullGetTexImage(GLenum target, GLint level,
+                                     GLenum format, GLenum type,
+                                     void *pixels) {
+  if (*GetBufferBinding(GL_PIXEL_PACK_BUFFER)) {
+    return;
+  }
+
+  const NullGLObject *texture =
+      &NULL_GL.objects[NULL_GL.textures[NULL_GL.activeTexture]];
+  memset(pixels, 0,
+         (size_t)texture->width * texture->height * GetNullGLPixelSize(format));
+}
+
+// Only reads RGBA of the default framebuffer
+static void APIENTRY NullReadPixels(GLint x, GLint y, GLsizei width,
+                                    GLsizei height, GLenum format, GLenum type,
+                                    void *pixels) {
+  GLuint pack = *GetBufferBinding(GL_PIXEL_PACK_BUFFER);
+  if (pack) {
+    // pixels is an offset into the pack buffer
+    unsigned char *storage = NULL_GL.objects[pack].storage;
+    if (!storage) {
+      return;
+    }
+    pixels = storage + (uintptr_t)pixels;
+  }
+  ReadSoftwarePixels(x, y, width, height, pixels);
+}
+
+static void APIENTRY NullBindFramebuffer(GLenum target, GLuint framebuffer) {
+  if (target != GL_READ_FRAMEBUFFER) {
+    NULL_GL.drawFramebuffer = framebuffer;
+  }
+}
+
+static void APIENTRY NullFramebufferTexture2D(GLenum target, GLenum attachment,
+                                              GLenum textarget, GLuint texture,
+                                              GLint level) {}
+
+static GLenum APIENTRY NullCheckFramebufferStatus(GLenum target) {
+  return GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void APIENTRY NullBlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1,
+                                         GLint srcY1, GLint dstX0, GLint dstY0,
+                                         GLint dstX1, GLint dstY1,
+                                         GLbitfield mask, GLenum filter) {}
+
+// ----------------------------------------------------------------------------
+// State and Queries
+// ----------------------------------------------------------------------------
+
+static void APIENTRY NullEnable(GLenum cap) {
+  if (cap == GL_BLEND) {
+    NULL_GL.isBlended = 1;
+  } else if (cap == GL_SCISSOR_TEST) {
+    NULL_GL.isScissored = 1;
+  }
+}
+
+static void APIENTRY NullDisable(GLenum cap) {
+  if (cap == GL_BLEND) {
+    NULL_GL.isBlended = 0;
+  } else if (cap == GL_SCISSOR_TEST) {
+    NULL_GL.isScissored = 0;
+  }
+}
+
+static void APIENTRY NullBlendFunc(GLenum sfactor, GLenum dfactor) {}
+
+static void APIENTRY NullBlendFuncSeparate(GLenum sfactorRGB,
+                                           GLenum dfactorRGB,
+                                           GLenum sfactorAlpha,
+                                           GLenum dfactorAlpha) {}
+
+static void APIENTRY NullViewport(GLint x, GLint y, GLsizei width,
+                                  GLsizei height) {}
+
+static void APIENTRY NullScissor(GLint x, GLint y, GLsizei width,
+                                 GLsizei height) {
+  NULL_GL.scissor[0] = x;
+  NULL_GL.scissor[1] = y;
+  NULL_GL.scissor[2] = width;
+  NULL_GL.scissor[3] = height;
+}
+
+extern int GetNullGLScissor(int box[4]) {
+  memcpy(box, NULL_GL.scissor, sizeof(NULL_GL.scissor));
+  return NULL_GL.isScissored;
+}
+
+static void APIENTRY NullClearColor(GLfloat red, GLfloat green, GLfloat blue,
+                                    GLfloat alpha) {}
+
+static void APIENTRY NullClear(GLbitfield mask) {}
+
+static void APIENTRY NullBeginQuery(GLenum target, GLuint id) {}
+
+static void APIENTRY NullEndQuery(GLenum target) {}
+
+// Queries are always available and took no time
+static void APIENTRY NullGetQueryObjectiv(GLuint id, GLenum pname,
+                                          GLint *params) {
+  *params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+}
+
+static void APIENTRY NullGetQueryObjectui64v(GLuint id, GLenum pname,
+                                             GLuint64 *params) {
+  *params = 0;
+}
+
+static void APIENTRY NullGetIntegerv(GLenum pname, GLint *data) {
+  switch (pname) {
+    case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT:
+      *data = 256;
+      break;
+    // The loader fails without any extension
+    case GL_NUM_EXTENSIONS:
+      *data = 1;
+      break;
+    default:
+      *data = 0;
+      break;
+  }
+}
+
+static GLenum APIENTRY NullGetError(void) { return GL_NO_ERROR; }
+
+static const GLubyte *APIENTRY NullGetString(GLenum name) {
+  switch (name) {
+    case GL_VERSION:
+      return (const GLubyte *)"3.3 Null";
+    case GL_SHADING_LANGUAGE_VERSION:
+      return (const GLubyte *)"3.30 Null";
+    default:
+      return (const GLubyte *)"Null";
+  }
+}
+
+static const GLubyte *APIENTRY NullGetStringi(GLenum name, GLuint index) {
+  return (const GLubyte *)"GL_SD_null";
+}
+
+// ----------------------------------------------------------------------------
+// Draws
+// ----------------------------------------------------------------------------
+
+static void APIENTRY NullDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  RecordNullGLDraw(mode, count, 1);
+}
+
+static void APIENTRY NullDrawArraysInstanced(GLenum mode, GLint first,
+                                             GLsizei count,
+                                             GLsizei instancecount) {
+  RecordNullGLDraw(mode, count, instancecount);
+}
+
+static void APIENTRY NullDrawElements(GLenum mode, GLsizei count, GLenum type,
+                                      const void *indices) {
+  RecordNullGLDraw(mode, count, 1);
+}
+
+static void APIENTRY NullDrawElementsBaseVertex(GLenum mode, GLsizei count,
+                                                GLenum type,
+                                                const void *indices,
+                                                GLint basevertex) {
+  RecordNullGLDraw(mode, count, 1);
+}
+
+static void APIENTRY NullMultiDrawElementsBaseVertex(
+    GLenum mode, const GLsizei *count, GLenum type, const void *const *indices,
+    GLsizei drawcount, const GLint *basevertex) {
+  int numElement = 0;
+  for (GLsizei i = 0; i < drawcount; ++i) {
+    numElement += count[i];
+  }
+  RecordNullGLDraw(mode, numElement, 1);
+}
+
+// ----------------------------------------------------------------------------
+// Loader
+// ----------------------------------------------------------------------------
+
+typedef struct NullGLFunction {
+  const char *name;
+  void *func;
+} NullGLFunction;
+
+#define NULL_GL_FUNCTION(name) {"gl" #name, (void *)Null##name}
+
+// The functions the renderer calls, the loader leaves the others NULL
+static const NullGLFunction NULL_GL_FUNCTIONS[] = {
+    NULL_GL_FUNCTION(ActiveTexture),
+    NULL_GL_FUNCTION(AttachShader),
+    NULL_GL_FUNCTION(BeginQuery),
+    NULL_GL_FUNCTION(BindBuffer),
+    NULL_GL_FUNCTION(BindBufferRange),
+    NULL_GL_FUNCTION(BindFramebuffer),
+    NULL_GL_FUNCTION(BindTexture),
+    NULL_GL_FUNCTION(BindVertexArray),
+    NULL_GL_FUNCTION(BlendFunc),
+    NULL_GL_FUNCTION(BlendFuncSeparate),
+    NULL_GL_FUNCTION(BlitFramebuffer),
+    NULL_GL_FUNCTION(BufferData),
+    NULL_GL_FUNCTION(BufferSubData),
+    NULL_GL_FUNCTION(CheckFramebufferStatus),
+    NULL_GL_FUNCTION(Clear),
+    NULL_GL_FUNCTION(ClearColor),
+    NULL_GL_FUNCTION(ClientWaitSync),
+    NULL_GL_FUNCTION(CompileShader),
+    NULL_GL_FUNCTION(CreateProgram),
+    NULL_GL_FUNCTION(CreateShader),
+    NULL_GL_FUNCTION(DeleteBuffers),
+    NULL_GL_FUNCTION(DeleteFramebuffers),
+    NULL_GL_FUNCTION(DeleteProgram),
+    NULL_GL_FUNCTION(DeleteSync),
+    NULL_GL_FUNCTION(DeleteTextures),
+    NULL_GL_FUNCTION(DeleteVertexArrays),
+    NULL_GL_FUNCTION(Disable),
+    NULL_GL_FUNCTION(DrawArrays),
+    NULL_GL_FUNCTION(DrawArraysInstanced),
+    NULL_GL_FUNCTION(DrawElements),
+    NULL_GL_FUNCTION(DrawElementsBaseVertex),
+    NULL_GL_FUNCTION(Enable),
+    NULL_GL_FUNCTION(EnableVertexAttribArray),
+    NULL_GL_FUNCTION(EndQuery),
+    NULL_GL_FUNCTION(FenceSync),
+    NULL_GL_FUNCTION(FramebufferTexture2D),
+    NULL_GL_FUNCTION(GenBuffers),
+    NULL_GL_FUNCTION(GenFramebuffers),
+    NULL_GL_FUNCTION(GenQueries),
+    NULL_GL_FUNCTION(GenTextures),
+    NULL_GL_FUNCTION(GenVertexArrays),
+    NULL_GL_FUNCTION(GetBufferSubData),
+    NULL_GL_FUNCTION(GetError),
+    NULL_GL_FUNCTION(GetIntegerv),
+    {"glGetProgramInfoLog", (void *)NullGetInfoLog},
+    NULL_GL_FUNCTION(GetProgramiv),
+    NULL_GL_FUNCTION(GetQueryObjectiv),
+    NULL_GL_FUNCTION(GetQueryObjectui64v),
+    {"glGetShaderInfoLog", (void *)NullGetInfoLog},
+    NULL_GL_FUNCTION(GetShaderiv),
+    NULL_GL_FUNCTION(GetString),
+    NULL_GL_FUNCTION(GetStringi),
+    NULL_GL_FUNCTION(GetTexImage),
+    NULL_GL_FUNCTION(GetUniformBlockIndex),
+    NULL_GL_FUNCTION(GetUniformLocation),
+    NULL_GL_FUNCTION(LinkProgram),
+    NULL_GL_FUNCTION(MapBufferRange),
+    NULL_GL_FUNCTION(MultiDrawElementsBaseVertex),
+    NULL_GL_FUNCTION(PixelStorei),
+    NULL_GL_FUNCTION(ReadPixels),
+    NULL_GL_FUNCTION(Scissor),
+    NULL_GL_FUNCTION(ShaderSource),
+    NULL_GL_FUNCTION(TexBuffer),
+    NULL_GL_FUNCTION(TexImage2D),
+    NULL_GL_FUNCTION(TexParameteri),
+    NULL_GL_FUNCTION(TexParameteriv),
+    NULL_GL_FUNCTION(Uniform1f),
+    NULL_GL_FUNCTION(Uniform1i),
+    NULL_GL_FUNCTION(Uniform2f),
+    NULL_GL_FUNCTION(Uniform3f),
+    NULL_GL_FUNCTION(Uniform4f),
+    NULL_GL_FUNCTION(Uniform4fv),
+    NULL_GL_FUNCTION(UniformBlockBinding),
+    NULL_GL_FUNCTION(UniformMatrix3fv),
+    NULL_GL_FUNCTION(UnmapBuffer),
+    NULL_GL_FUNCTION(UseProgram),
+    NULL_GL_FUNCTION(VertexAttribDivisor),
+    NULL_GL_FUNCTION(VertexAttribIPointer),
+    NULL_GL_FUNCTION(VertexAttribPointer),
+    NULL_GL_FUNCTION(Viewport),
+};
+
+#define NUM_NULL_GL_FUNCTION \
+  ((int)(sizeof(NULL_GL_FUNCTIONS) / sizeof(NULL_GL_FUNCTIONS[0])))
+
+extern void *GetNullGLProcAddress(const char *name) {
+  for (int i = 0; i < NUM_NULL_GL_FUNCTION; ++i) {
+    if (strcmp(NULL_GL_FUNCTIONS[i].name, name) == 0) {
+      return NULL_GL_FUNCTIONS[i].func;
+    }
+  }
+  return NULL;
+}
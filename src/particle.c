@@ -0,0 +1,582 @@
+#include "sword/particle.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "command.h"
+#include "job.h"
+#include "render_internal.h"
+#include "simd.h"
+
+// Below this many particles a single thread is faster than waking workers
+#define MIN_PARTICLE_PER_THREAD 8192
+
+const char PARTICLE_VERTEX_SHADER[] =
+    "#version 330 core                                                      \n"
+    "                                                                       \n"
+    "uniform mat3 MVP;                                                      \n"
+    "uniform vec2 frameSize;                                                \n"
+    "uniform int numColumn;                                                 \n"
+    "                                                                       \n"
+    "layout (location = 0) in vec2 aCorner;                                 \n"
+    "layout (location = 1) in float aPosX;                                  \n"
+    "layout (location = 2) in float aPosY;                                  \n"
+    "layout (location = 3) in float aLife;                                  \n"
+    "layout (location = 4) in float aInvLifetime;                           \n"
+    "layout (location = 5) in float aSize;                                  \n"
+    "layout (location = 6) in float aFrame;                                 \n"
+    "layout (location = 7) in vec4 aColor;                                  \n"
+    "out vec2 vTexCoord;                                                    \n"
+    "out vec4 vColor;                                                       \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   vec2 pos = vec2(aPosX, aPosY) + (aCorner - 0.5) * aSize;            \n"
+    "   gl_Position = vec4(MVP * vec3(pos, 1), 1);                          \n"
+    "                                                                       \n"
+    "   int frame = int(aFrame);                                            \n"
+    "   vec2 origin = vec2(frame % numColumn, frame / numColumn) * frameSize;\n"
+    "   vTexCoord = origin + aCorner * frameSize;                           \n"
+    "                                                                       \n"
+    "   // Fade out over lifetime, color is pre-multiplied at emission      \n"
+    "   vColor = aColor * clamp(aLife * aInvLifetime, 0, 1);                \n"
+    "}                                                                      \n";
+
+const char PARTICLE_FRAGMENT_SHADER[] =
+    "#version 330 core                                                      \n"
+    "                                                                       \n"
+    "uniform sampler2D texture0;                                            \n"
+    "                                                                       \n"
+    "in vec2 vTexCoord;                                                     \n"
+    "in vec4 vColor;                                                        \n"
+    "                                                                       \n"
+    "out vec4 fragColor;                                                    \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   // Textures are pre-multiplied at load                              \n"
+    "   vec4 texColor = texture(texture0, vTexCoord);                       \n"
+    "   fragColor = texColor * vColor;                                      \n"
+    "}                                                                      \n";
+
+struct SDParticleSystem {
+  SDTexture *atlas;
+  SDVec2 frameSize;  // in texture space
+  int numColumn;
+  SDVec2 gravity;
+  int multithreaded;
+
+  int capacity;  // Rounded up to a multiple of 4
+  int count;
+
+  // Structure of arrays, each holds capacity elements
+  float *posX;
+  float *posY;
+  float *velX;
+  float *velY;
+  float *life;
+  float *invLifetime;
+  float *size;
+  float *frame;
+  unsigned int *color;  // RGBA8
+
+  // Per range survivor counts of the last update
+  int rangeCount[64];
+
+  GLuint vao;
+  GLuint cornerVBO;
+  GLuint instanceVBO;
+};
+
+// Per instance streams in instanceVBO, each is a capacity sized section
+enum {
+  STREAM_POS_X,
+  STREAM_POS_Y,
+  STREAM_LIFE,
+  STREAM_INV_LIFETIME,
+  STREAM_SIZE,
+  STREAM_FRAME,
+  STREAM_COLOR,
+  STREAM_COUNT,
+};
+
+static void InitParticleProgram(ParticleProgram *particleProgram) {
+  particleProgram->program =
+      CompileGLProgram(PARTICLE_VERTEX_SHADER, PARTICLE_FRAGMENT_SHADER);
+  if (!particleProgram->program) {
+    exit(EXIT_FAILURE);
+  }
+  glUseProgram(particleProgram->program);
+  glUniform1i(glGetUniformLocation(particleProgram->program, "texture0"), 0);
+  particleProgram->MVPLocation =
+      glGetUniformLocation(particleProgram->program, "MVP");
+  particleProgram->frameSizeLocation =
+      glGetUniformLocation(particleProgram->program, "frameSize");
+  particleProgram->numColumnLocation =
+      glGetUniformLocation(particleProgram->program, "numColumn");
+}
+
+static void *StreamOffset(const SDParticleSystem *particleSystem, int stream) {
+  return (void *)((size_t)stream * particleSystem->capacity * 4);
+}
+
+static void ExecuteInitParticleBuffers(void *data) {
+  static const float corners[] = {0.0f, 0.0f, 1.0f, 0.0f,
+                                  0.0f, 1.0f, 1.0f, 1.0f};
+  SDParticleSystem *particleSystem = *(SDParticleSystem **)data;
+  RenderContext *rc = CTX.rc;
+
+  if (!rc->particleProgram.program) {
+    InitParticleProgram(&rc->particleProgram);
+  }
+
+  glGenVertexArrays(1, &particleSystem->vao);
+  glGenBuffers(1, &particleSystem->cornerVBO);
+  glGenBuffers(1, &particleSystem->instanceVBO);
+
+  glBindVertexArray(particleSystem->vao);
+
+  glBindBuffer(GL_ARRAY_BUFFER, particleSystem->cornerVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+  glEnableVertexAttribArray(0);
+
+  glBindBuffer(GL_ARRAY_BUFFER, particleSystem->instanceVBO);
+  glBufferData(GL_ARRAY_BUFFER,
+               (size_t)STREAM_COUNT * particleSystem->capacity * 4, NULL,
+               GL_STREAM_DRAW);
+
+  for (int stream = STREAM_POS_X; stream < STREAM_COLOR; ++stream) {
+    GLuint location = (GLuint)stream + 1;
+    glVertexAttribPointer(location, 1, GL_FLOAT, GL_FALSE, 0,
+                          StreamOffset(particleSystem, stream));
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location);
+  }
+
+  glVertexAttribPointer(STREAM_COLOR + 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0,
+                        StreamOffset(particleSystem, STREAM_COLOR));
+  glVertexAttribDivisor(STREAM_COLOR + 1, 1);
+  glEnableVertexAttribArray(STREAM_COLOR + 1);
+
+  glBindVertexArray(0);
+}
+
+SDAPI SDParticleSystemParams SDMakeParticleSystemParams(SDTexture *atlas) {
+  SDParticleSystemParams params = {
+      .atlas = atlas,
+      .frameWidth = atlas->width,
+      .frameHeight = atlas->height,
+      .capacity = 65536,
+      .gravity = SDZeroVec2(),
+      .multithreaded = 0,
+  };
+  return params;
+}
+
+SDAPI SDParticleSystem *SDCreateParticleSystem(
+    const SDParticleSystemParams *params) {
+  SDTexture *atlas = params->atlas;
+
+  if (params->frameWidth <= 0 || params->frameHeight <= 0 ||
+      atlas->width < params->frameWidth ||
+      atlas->height < params->frameHeight) {
+    printf("Atlas %dx%d has no frame of %dx%d\n", atlas->width,
+           atlas->height, params->frameWidth, params->frameHeight);
+    return NULL;
+  }
+
+  SDParticleSystem *particleSystem = malloc(sizeof(SDParticleSystem));
+
+  particleSystem->atlas = atlas;
+  particleSystem->frameSize =
+      SDV2((SDFloat)params->frameWidth / atlas->actualWidth,
+           (SDFloat)params->frameHeight / atlas->actualHeight);
+  particleSystem->numColumn = atlas->width / params->frameWidth;
+  particleSystem->gravity = params->gravity;
+  particleSystem->multithreaded = params->multithreaded;
+
+  particleSystem->capacity = (params->capacity + 3) / 4 * 4;
+  particleSystem->count = 0;
+
+  size_t size = (size_t)particleSystem->capacity * 4;
+  particleSystem->posX = malloc(size);
+  particleSystem->posY = malloc(size);
+  particleSystem->velX = malloc(size);
+  particleSystem->velY = malloc(size);
+  particleSystem->life = malloc(size);
+  particleSystem->invLifetime = malloc(size);
+  particleSystem->size = malloc(size);
+  particleSystem->frame = malloc(size);
+  particleSystem->color = malloc(size);
+
+  SDParticleSystem **command =
+      BeginCommand(ExecuteInitParticleBuffers, sizeof(SDParticleSystem *));
+  *command = particleSystem;
+  CommitCommand();
+
+  return particleSystem;
+}
+
+static void ExecuteDestroyParticleSystem(void *data) {
+  SDParticleSystem *particleSystem = *(SDParticleSystem **)data;
+
+  glDeleteVertexArrays(1, &particleSystem->vao);
+  glDeleteBuffers(1, &particleSystem->cornerVBO);
+  glDeleteBuffers(1, &particleSystem->instanceVBO);
+
+  free(particleSystem->posX);
+  free(particleSystem->posY);
+  free(particleSystem->velX);
+  free(particleSystem->velY);
+  free(particleSystem->life);
+  free(particleSystem->invLifetime);
+  free(particleSystem->size);
+  free(particleSystem->frame);
+  free(particleSystem->color);
+  free(particleSystem);
+}
+
+SDAPI void SDDestroyParticleSystem(SDParticleSystem **ptr) {
+  SDParticleSystem **command =
+      BeginCommand(ExecuteDestroyParticleSystem, sizeof(SDParticleSystem *));
+  *command = *ptr;
+  CommitCommand();
+
+  *ptr = NULL;
+}
+
+SDAPI SDEmitParticleParams SDMakeEmitParticleParams(SDVec2 position) {
+  SDEmitParticleParams params = {
+      .position = position,
+      .velocity = SDZeroVec2(),
+      .lifetime = 1.0f,
+      .size = 8.0f,
+      .frame = 0,
+      .color = SDRGBA(1.0f, 1.0f, 1.0f, 1.0f),
+  };
+  return params;
+}
+
+// Pre-multiplied, like mesh and shape colors
+static unsigned int PackColor(SDColor color) {
+  SDFloat alpha = SDClamp01F(color.a);
+  unsigned int r = (unsigned int)(SDClamp01F(color.r) * alpha * 255.0f + 0.5f);
+  unsigned int g = (unsigned int)(SDClamp01F(color.g) * alpha * 255.0f + 0.5f);
+  unsigned int b = (unsigned int)(SDClamp01F(color.b) * alpha * 255.0f + 0.5f);
+  unsigned int a = (unsigned int)(alpha * 255.0f + 0.5f);
+  // Byte order in memory is R, G, B, A
+  unsigned char bytes[4] = {(unsigned char)r, (unsigned char)g,
+                            (unsigned char)b, (unsigned char)a};
+  unsigned int result;
+  memcpy(&result, bytes, 4);
+  return result;
+}
+
+SDAPI void SDEmitParticle(SDParticleSystem *particleSystem,
+                          const SDEmitParticleParams *params) {
+  if (particleSystem->count >= particleSystem->capacity ||
+      params->lifetime <= 0.0f) {
+    return;
+  }
+
+  int i = particleSystem->count++;
+  particleSystem->posX[i] = params->position.x;
+  particleSystem->posY[i] = params->position.y;
+  particleSystem->velX[i] = params->velocity.x;
+  particleSystem->velY[i] = params->velocity.y;
+  particleSystem->life[i] = params->lifetime;
+  particleSystem->invLifetime[i] = 1.0f / params->lifetime;
+  particleSystem->size[i] = params->size;
+  particleSystem->frame[i] = (float)params->frame;
+  particleSystem->color[i] = PackColor(params->color);
+}
+
+typedef struct UpdateJob {
+  SDParticleSystem *particleSystem;
+  float dt;
+} UpdateJob;
+
+// Move particle src to dst, dst <= src
+#define MOVE_PARTICLE(ps, dst, src)                  \
+  do {                                               \
+    (ps)->invLifetime[dst] = (ps)->invLifetime[src]; \
+    (ps)->size[dst] = (ps)->size[src];               \
+    (ps)->frame[dst] = (ps)->frame[src];             \
+    (ps)->color[dst] = (ps)->color[src];             \
+  } while (0)
+
+/**
+ * Integrate particles in [begin, end) and compact the survivors to the front
+ * of the range. Every lane is written to the write cursor and the cursor only
+ * advances when the lane is alive, so compaction has no branches. The cursor
+ * never passes the read position, so it works in place.
+ */
+static void UpdateParticleRange(void *data, int begin, int end, int index) {
+  UpdateJob *job = data;
+  SDParticleSystem *ps = job->particleSystem;
+  float dt = job->dt;
+  float gdx = ps->gravity.x * dt;
+  float gdy = ps->gravity.y * dt;
+  int w = begin;
+
+#ifdef SD_SSE2
+  __m128 dt4 = _mm_set1_ps(dt);
+  __m128 gdx4 = _mm_set1_ps(gdx);
+  __m128 gdy4 = _mm_set1_ps(gdy);
+  __m128 zero = _mm_setzero_ps();
+
+  for (int i = begin; i < end; i += 4) {
+    __m128 vx = _mm_add_ps(_mm_loadu_ps(ps->velX + i), gdx4);
+    __m128 vy = _mm_add_ps(_mm_loadu_ps(ps->velY + i), gdy4);
+    __m128 px = _mm_add_ps(_mm_loadu_ps(ps->posX + i), _mm_mul_ps(vx, dt4));
+    __m128 py = _mm_add_ps(_mm_loadu_ps(ps->posY + i), _mm_mul_ps(vy, dt4));
+    __m128 life = _mm_sub_ps(_mm_loadu_ps(ps->life + i), dt4);
+
+    int numValid = end - i < 4 ? end - i : 4;
+    int alive = _mm_movemask_ps(_mm_cmpgt_ps(life, zero)) &
+                ((1 << numValid) - 1);
+
+    float lane[5][4];
+    _mm_storeu_ps(lane[0], px);
+    _mm_storeu_ps(lane[1], py);
+    _mm_storeu_ps(lane[2], vx);
+    _mm_storeu_ps(lane[3], vy);
+    _mm_storeu_ps(lane[4], life);
+
+    for (int j = 0; j < 4; ++j) {
+      ps->posX[w] = lane[0][j];
+      ps->posY[w] = lane[1][j];
+      ps->velX[w] = lane[2][j];
+      ps->velY[w] = lane[3][j];
+      ps->life[w] = lane[4][j];
+      MOVE_PARTICLE(ps, w, i + j);
+      w += (alive >> j) & 1;
+    }
+  }
+#else
+  for (int i = begin; i < end; ++i) {
+    float vx = ps->velX[i] + gdx;
+    float vy = ps->velY[i] + gdy;
+    float life = ps->life[i] - dt;
+
+    ps->posX[w] = ps->posX[i] + vx * dt;
+    ps->posY[w] = ps->posY[i] + vy * dt;
+    ps->velX[w] = vx;
+    ps->velY[w] = vy;
+    ps->life[w] = life;
+    MOVE_PARTICLE(ps, w, i);
+    w += life > 0.0f;
+  }
+#endif
+
+  ps->rangeCount[index] = w - begin;
+}
+
+#undef MOVE_PARTICLE
+
+SDAPI void SDUpdateParticleSystem(SDParticleSystem *particleSystem,
+                                  SDFloat dt) {
+  SDParticleSystem *ps = particleSystem;
+  int count = ps->count;
+
+  if (count == 0) {
+    return;
+  }
+
+  int numRange = 1;
+  if (ps->multithreaded && count >= MIN_PARTICLE_PER_THREAD * 2) {
+    numRange = GetNumWorker() + 1;
+    if (numRange > count / MIN_PARTICLE_PER_THREAD) {
+      numRange = count / MIN_PARTICLE_PER_THREAD;
+    }
+    if (numRange > (int)(sizeof(ps->rangeCount) / sizeof(int))) {
+      numRange = sizeof(ps->rangeCount) / sizeof(int);
+    }
+  }
+
+  UpdateJob job = {ps, dt};
+  int rangeSize = (count + numRange - 1) / numRange;
+  rangeSize = (rangeSize + 3) / 4 * 4;
+  numRange = (count + rangeSize - 1) / rangeSize;
+
+  if (numRange == 1) {
+    UpdateParticleRange(&job, 0, count, 0);
+  } else {
+    ParallelFor(UpdateParticleRange, &job, count, rangeSize);
+  }
+
+  // Join the survivors of each range
+  int total = ps->rangeCount[0];
+  for (int index = 1; index < numRange; ++index) {
+    int begin = index * rangeSize;
+    int n = ps->rangeCount[index];
+    if (n && begin != total) {
+      size_t bytes = (size_t)n * 4;
+      memmove(ps->posX + total, ps->posX + begin, bytes);
+      memmove(ps->posY + total, ps->posY + begin, bytes);
+      memmove(ps->velX + total, ps->velX + begin, bytes);
+      memmove(ps->velY + total, ps->velY + begin, bytes);
+      memmove(ps->life + total, ps->life + begin, bytes);
+      memmove(ps->invLifetime + total, ps->invLifetime + begin, bytes);
+      memmove(ps->size + total, ps->size + begin, bytes);
+      memmove(ps->frame + total, ps->frame + begin, bytes);
+      memmove(ps->color + total, ps->color + begin, bytes);
+    }
+    total += n;
+  }
+
+  ps->count = total;
+}
+
+SDAPI int SDGetParticleCount(const SDParticleSystem *particleSystem) {
+  return particleSystem->count;
+}
+
+// The streams are copied as the next update rewrites them in place
+typedef struct DrawParticlesCommand {
+  const SDParticleSystem *particleSystem;
+  SDMat3 MVP;
+  int count;
+  const void *streams[STREAM_COUNT];
+} DrawParticlesCommand;
+
+// Quads of count particles as the vertex shader makes them, from streams laid
+// out like the instance buffer
+static void WriteParticleQuads(const SDParticleSystem *ps,
+                               const void *const *streams, int count,
+                               MeshVertex *vertices, unsigned int *indices) {
+  static const float corners[4][2] = {{0.0f, 0.0f}, {1.0f, 0.0f},
+                                      {0.0f, 1.0f}, {1.0f, 1.0f}};
+  const float *posX = streams[STREAM_POS_X];
+  const float *posY = streams[STREAM_POS_Y];
+  const float *life = streams[STREAM_LIFE];
+  const float *invLifetime = streams[STREAM_INV_LIFETIME];
+  const float *size = streams[STREAM_SIZE];
+  const float *frames = streams[STREAM_FRAME];
+  const unsigned char *colors = streams[STREAM_COLOR];
+
+  for (int i = 0; i < count; ++i) {
+    int frame = (int)frames[i];
+    SDFloat originU = (frame % ps->numColumn) * ps->frameSize.x;
+    SDFloat originV = (frame / ps->numColumn) * ps->frameSize.y;
+    SDFloat fade = SDClamp01F(life[i] * invLifetime[i]);
+    const unsigned char *color = colors + i * 4;
+
+    for (int corner = 0; corner < 4; ++corner) {
+      SDFloat cornerX = corners[corner][0];
+      SDFloat cornerY = corners[corner][1];
+      vertices[i * 4 + corner] = (MeshVertex){
+          {posX[i] + (cornerX - 0.5f) * size[i],
+           posY[i] + (cornerY - 0.5f) * size[i]},
+          {originU + cornerX * ps->frameSize.x,
+           originV + cornerY * ps->frameSize.y},
+          {color[0] / 255.0f * fade, color[1] / 255.0f * fade,
+           color[2] / 255.0f * fade, color[3] / 255.0f * fade},
+      };
+    }
+
+    // The two triangles of the strip
+    unsigned int base = (unsigned int)i * 4;
+    unsigned int *quad = indices + i * 6;
+    quad[0] = base;
+    quad[1] = base + 1;
+    quad[2] = base + 2;
+    quad[3] = base + 2;
+    quad[4] = base + 1;
+    quad[5] = base + 3;
+  }
+}
+
+static void DrawSoftwareParticles(const DrawParticlesCommand *command) {
+  const SDParticleSystem *ps = command->particleSystem;
+  int count = command->count;
+  MeshVertex *vertices = malloc((size_t)count * 4 * sizeof(MeshVertex));
+  unsigned int *indices = malloc((size_t)count * 6 * sizeof(unsigned int));
+  WriteParticleQuads(ps, command->streams, count, vertices, indices);
+  DrawSoftwareMesh(ps->atlas, command->MVP, SDRGBA(1.0f, 1.0f, 1.0f, 1.0f),
+                   vertices, indices, GL_UNSIGNED_INT, count * 6);
+  free(vertices);
+  free(indices);
+}
+
+static void ExecuteDrawParticles(void *data) {
+  const DrawParticlesCommand *command = data;
+  RenderContext *rc = CTX.rc;
+  ParticleProgram *particleProgram = &rc->particleProgram;
+  const SDParticleSystem *ps = command->particleSystem;
+
+  // Orphan last frame's storage and upload each stream as is
+  size_t bytes = (size_t)command->count * 4;
+  glBindBuffer(GL_ARRAY_BUFFER, ps->instanceVBO);
+  glBufferData(GL_ARRAY_BUFFER, (size_t)STREAM_COUNT * ps->capacity * 4, NULL,
+               GL_STREAM_DRAW);
+  for (int stream = 0; stream < STREAM_COUNT; ++stream) {
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)StreamOffset(ps, stream), bytes,
+                    command->streams[stream]);
+  }
+
+  glUseProgram(particleProgram->program);
+  glUniformMatrix3fv(particleProgram->MVPLocation, 1, GL_FALSE,
+                     (const GLfloat *)&command->MVP);
+  glUniform2f(particleProgram->frameSizeLocation, ps->frameSize.x,
+              ps->frameSize.y);
+  glUniform1i(particleProgram->numColumnLocation, ps->numColumn);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, ps->atlas->id);
+
+  glBindVertexArray(ps->vao);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, command->count);
+  glBindVertexArray(0);
+
+  if (CTX.renderBackend == SD_RENDER_BACKEND_SOFTWARE) {
+    DrawSoftwareParticles(command);
+  }
+
+  rc->numDrawCall++;
+}
+
+// Recorded as the quads it drew
+static void RecordParticles(FrameRecorder *recorder,
+                            const SDParticleSystem *ps,
+                            const void *const *streams, SDMat3 transform) {
+  MeshVertex *vertices;
+  unsigned int *indices;
+  int mesh = AddRecordedMesh(recorder, NULL, ps->atlas, ps->count * 4,
+                             ps->count * 6, &vertices, &indices);
+  WriteParticleQuads(ps, streams, ps->count, vertices, indices);
+  RecordMeshDraw(recorder, mesh, transform, SDRGBA(1.0f, 1.0f, 1.0f, 1.0f));
+}
+
+SDAPI void SDDrawParticleSystem(SDParticleSystem *particleSystem,
+                                SDMat3 transform) {
+  RenderContext *rc = CTX.rc;
+  SDParticleSystem *ps = particleSystem;
+  int count = ps->count;
+
+  if (count == 0) {
+    return;
+  }
+
+  const void *streams[STREAM_COUNT] = {
+      ps->posX, ps->posY,  ps->life,  ps->invLifetime,
+      ps->size, ps->frame, ps->color,
+  };
+  size_t bytes = (size_t)count * 4;
+
+  if (rc->recorder) {
+    RecordParticles(rc->recorder, ps, streams, transform);
+  }
+
+  FlushBatch(rc);
+  ApplyClipScissor(rc);
+
+  DrawParticlesCommand *command =
+      BeginCommand(ExecuteDrawParticles, sizeof(DrawParticlesCommand));
+  command->particleSystem = ps;
+  command->MVP = SDDotM3(rc->viewProjection, transform);
+  command->count = count;
+  for (int stream = 0; stream < STREAM_COUNT; ++stream) {
+    command->streams[stream] = CopyCommandData(streams[stream], bytes);
+  }
+  CommitCommand();
+}
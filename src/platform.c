@@ -3,6 +3,7 @@
 #include <SDL2/SDL.h>
 #include <glad/glad.h>
 
+#include "command.h"
 #include "context.h"
 #include "sword/entity.h"
 
@@ -11,11 +12,14 @@ typedef struct WindowConfig {
   int height;         // window height in point
   const char *title;  // window title
   int supportHiDPI;   // support hidpi mode
+  int hidden;         // create the window hidden, e.g. for headless runs
 } WindowConfig;
 
 typedef struct Config {
   WindowConfig window;
-  int exitOnEsc;  // Exit game when Esc pressed?
+  int exitOnEsc;     // Exit game when Esc pressed?
+  int renderThread;  // Run GL on a dedicated render thread
+  SDRenderBackend renderBackend;
   SDLoadCallback load;
   SDUpdateCallback update;
   SDUpdateCallback render;
@@ -26,8 +30,11 @@ Config CONFIG = {
     .window = {.width = 1280,
                .height = 720,
                .title = "Sword",
-               .supportHiDPI = 1},
+               .supportHiDPI = 1,
+               .hidden = 0},
     .exitOnEsc = 0,
+    .renderThread = 0,
+    .renderBackend = SD_RENDER_BACKEND_GL,
     .update = 0,
     .load = 0,
     .render = 0,
@@ -64,6 +71,9 @@ static void InitWindow(const WindowConfig *window) {
   if (window->supportHiDPI) {
     flags |= SDL_WINDOW_ALLOW_HIGHDPI;
   }
+  if (window->hidden) {
+    flags |= SDL_WINDOW_HIDDEN;
+  }
   CTX.window = SDL_CreateWindow(window->title, SDL_WINDOWPOS_CENTERED,
                                 SDL_WINDOWPOS_CENTERED, CTX.viewportWidth,
                                 CTX.viewportHeight, flags);
@@ -103,6 +113,22 @@ static void InitWindow(const WindowConfig *window) {
   CTX.pixelToPoint = 1.0f / CTX.pointToPixel;
 }
 
+// No window or GL context, GL calls go to the null GL. The viewport is the
+// window size, a point being a pixel.
+static void InitHeadless(const WindowConfig *window) {
+  CTX.viewportWidth = window->width;
+  CTX.viewportHeight = window->height;
+  CTX.pointToPixel = 1.0f;
+  CTX.pixelToPoint = 1.0f;
+
+  SDL_Init(SDL_INIT_EVENTS);
+
+  if (gladLoadGLLoader(&GetNullGLProcAddress) == 0) {
+    printf("Failed to load null GL\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
 static void ProcessSystemEvent(void) {
   SDL_Event event;
 
@@ -136,8 +162,18 @@ static void Render(void) {
   }
 }
 
+static void ExecuteSwapWindow(void *data) { SDL_GL_SwapWindow(CTX.window); }
+
 SDAPI void SDSetExitOnEsc(int exitOnEsc) { CONFIG.exitOnEsc = exitOnEsc; }
 
+SDAPI void SDSetWindowHidden(int hidden) { CONFIG.window.hidden = hidden; }
+
+SDAPI void SDSetRenderThread(int enabled) { CONFIG.renderThread = enabled; }
+
+SDAPI void SDSetRenderBackend(SDRenderBackend backend) {
+  CONFIG.renderBackend = backend;
+}
+
 SDAPI void SDSetGameState(void *gameState) { CONFIG.gameState = gameState; }
 
 SDAPI void SDSetLoadCallback(SDLoadCallback load) { CONFIG.load = load; }
@@ -150,8 +186,15 @@ SDAPI void SDSetRenderCallback(SDRenderCallback render) {
   CONFIG.render = render;
 }
 
+SDAPI void SDQuit(void) { CTX.isRunning = 0; }
+
 SDAPI void SDRun(void) {
-  InitWindow(&CONFIG.window);
+  CTX.renderBackend = CONFIG.renderBackend;
+  if (CTX.renderBackend == SD_RENDER_BACKEND_GL) {
+    InitWindow(&CONFIG.window);
+  } else {
+    InitHeadless(&CONFIG.window);
+  }
 
   CTX.rc = CreateRenderContext(CTX.viewportWidth, CTX.viewportHeight,
                                CTX.pixelToPoint);
@@ -160,13 +203,35 @@ SDAPI void SDRun(void) {
     CONFIG.load(CONFIG.gameState);
   }
 
+  // Resources created while loading are ready before the first frame
+  if (CONFIG.renderThread) {
+    StartRenderThread();
+  }
+
+  float counterToSecond = 1.0f / SDL_GetPerformanceFrequency();
+
   CTX.isRunning = 1;
   while (CTX.isRunning) {
+    Uint64 frameStart = SDL_GetPerformanceCounter();
+
     ProcessSystemEvent();
 
     Update();
+
+    BeginRenderFrame(CTX.rc);
     Render();
 
-    SDL_GL_SwapWindow(CTX.window);
+    float cpuFrameTime =
+        (SDL_GetPerformanceCounter() - frameStart) * counterToSecond;
+    EndRenderFrame(CTX.rc, cpuFrameTime);
+
+    if (CTX.window) {
+      BeginCommand(ExecuteSwapWindow, 0);
+      CommitCommand();
+    }
+
+    SubmitFrame();
   }
+
+  StopRenderThread();
 }
\ No newline at end of file
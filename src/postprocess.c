@@ -0,0 +1,449 @@
+#include "sword/render.h"
+
+#include <string.h>
+
+#include "render_internal.h"
+
+// Each blur pass is a horizontal and a vertical pass in the render graph
+#define MAX_BLOOM_BLUR_PASS 16
+
+const char FULLSCREEN_VERTEX_SHADER[] =
+    "#version 330 core                                                      \n"
+    "                                                                       \n"
+    "out vec2 vUV;                                                          \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   // One triangle covering the viewport                               \n"
+    "   vUV = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);                \n"
+    "   gl_Position = vec4(vUV * 2 - 1, 0, 1);                              \n"
+    "}                                                                      \n";
+
+const char BRIGHT_PASS_FRAGMENT_SHADER[] =
+    "#version 330 core                                                      \n"
+    "                                                                       \n"
+    "uniform sampler2D source;                                              \n"
+    "uniform vec2 uvScale;                                                  \n"
+    "uniform vec2 uvMax;                                                    \n"
+    "uniform vec2 texelSize;                                                \n"
+    "uniform vec4 params;  // x: threshold                                  \n"
+    "                                                                       \n"
+    "in vec2 vUV;                                                           \n"
+    "                                                                       \n"
+    "out vec4 fragColor;                                                    \n"
+    "                                                                       \n"
+    "vec3 Fetch(vec2 uv) {                                                  \n"
+    "   return texture(source, min(uv, uvMax)).rgb;                         \n"
+    "}                                                                      \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   // Four bilinear taps cover a 4x4 block of the full resolution scene\n"
+    "   vec2 uv = vUV * uvScale;                                            \n"
+    "   vec3 color = (Fetch(uv + vec2(-1, -1) * texelSize) +                \n"
+    "                 Fetch(uv + vec2(1, -1) * texelSize) +                 \n"
+    "                 Fetch(uv + vec2(-1, 1) * texelSize) +                 \n"
+    "                 Fetch(uv + vec2(1, 1) * texelSize)) * 0.25;           \n"
+    "                                                                       \n"
+    "   float brightness = max(color.r, max(color.g, color.b));             \n"
+    "   float contribution =                                                \n"
+    "       max(brightness - params.x, 0) / max(brightness, 1e-4);          \n"
+    "   fragColor = vec4(color * contribution, 1);                          \n"
+    "}                                                                      \n";
+
+const char BLUR_FRAGMENT_SHADER[] =
+    "#version 330 core                                                      \n"
+    "                                                                       \n"
+    "uniform sampler2D source;                                              \n"
+    "uniform vec2 uvScale;                                                  \n"
+    "uniform vec2 uvMax;                                                    \n"
+    "uniform vec2 texelSize;                                                \n"
+    "uniform vec4 params;  // xy: direction                                 \n"
+    "                                                                       \n"
+    "in vec2 vUV;                                                           \n"
+    "                                                                       \n"
+    "out vec4 fragColor;                                                    \n"
+    "                                                                       \n"
+    "vec3 Fetch(vec2 uv) {                                                  \n"
+    "   return texture(source, min(max(uv, vec2(0)), uvMax)).rgb;           \n"
+    "}                                                                      \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   // 9-tap gaussian from 5 bilinear taps                              \n"
+    "   vec2 uv = vUV * uvScale;                                            \n"
+    "   vec2 step1 = params.xy * texelSize * 1.3846153846;                  \n"
+    "   vec2 step2 = params.xy * texelSize * 3.2307692308;                  \n"
+    "   vec3 color = Fetch(uv) * 0.2270270270 +                             \n"
+    "                (Fetch(uv + step1) + Fetch(uv - step1)) * 0.3162162162 +\n"
+    "                (Fetch(uv + step2) + Fetch(uv - step2)) * 0.0702702703;\n"
+    "   fragColor = vec4(color, 1);                                         \n"
+    "}                                                                      \n";
+
+// Version line and effect defines are prepended for each variant
+const char COMPOSITE_FRAGMENT_SHADER[] =
+    "uniform sampler2D scene;                                               \n"
+    "uniform sampler2D bloom;                                               \n"
+    "uniform vec2 sceneUVScale;                                             \n"
+    "uniform vec2 bloomUVScale;                                             \n"
+    "uniform vec2 bloomUVMax;                                               \n"
+    "uniform float bloomIntensity;                                          \n"
+    "uniform vec3 grading;  // exposure, contrast, saturation               \n"
+    "uniform vec4 colorFilter;                                              \n"
+    "uniform vec4 vignette;  // intensity, radius, softness, aspect         \n"
+    "                                                                       \n"
+    "in vec2 vUV;                                                           \n"
+    "                                                                       \n"
+    "out vec4 fragColor;                                                    \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   vec4 color = texture(scene, vUV * sceneUVScale);                    \n"
+    "                                                                       \n"
+    "#ifdef BLOOM                                                           \n"
+    "   vec2 bloomUV = min(vUV * bloomUVScale, bloomUVMax);                 \n"
+    "   color.rgb += texture(bloom, bloomUV).rgb * bloomIntensity;          \n"
+    "#endif                                                                 \n"
+    "                                                                       \n"
+    "#ifdef COLOR_GRADING                                                   \n"
+    "   color.rgb *= grading.x;                                             \n"
+    "   // Contrast around linear middle grey                               \n"
+    "   color.rgb = max((color.rgb - 0.18) * grading.y + 0.18, 0);          \n"
+    "   float luma = dot(color.rgb, vec3(0.2126, 0.7152, 0.0722));          \n"
+    "   color.rgb = max(mix(vec3(luma), color.rgb, grading.z), 0);          \n"
+    "   color.rgb *= colorFilter.rgb;                                       \n"
+    "#endif                                                                 \n"
+    "                                                                       \n"
+    "#ifdef VIGNETTE                                                        \n"
+    "   vec2 d = (vUV - 0.5) * vec2(vignette.w, 1);                         \n"
+    "   float edge = vignette.y + vignette.z;                               \n"
+    "   float falloff = smoothstep(vignette.y, edge, length(d));            \n"
+    "   color.rgb *= 1 - falloff * vignette.x;                              \n"
+    "#endif                                                                 \n"
+    "                                                                       \n"
+    "   fragColor = color;                                                  \n"
+    "}                                                                      \n";
+
+extern void InitFullscreenProgram(FullscreenProgram *fullscreenProgram,
+                                  const char *fss) {
+  GLuint program = CompileGLProgram(FULLSCREEN_VERTEX_SHADER, fss);
+  if (!program) {
+    exit(EXIT_FAILURE);
+  }
+
+  fullscreenProgram->program = program;
+  fullscreenProgram->sourceLocation = glGetUniformLocation(program, "source");
+  fullscreenProgram->uvScaleLocation =
+      glGetUniformLocation(program, "uvScale");
+  fullscreenProgram->uvMaxLocation = glGetUniformLocation(program, "uvMax");
+  fullscreenProgram->texelSizeLocation =
+      glGetUniformLocation(program, "texelSize");
+  fullscreenProgram->paramsLocation = glGetUniformLocation(program, "params");
+}
+
+extern void InitPostProcess(PostProcess *postProcess) {
+  postProcess->params = SDMakePostProcessParams();
+  postProcess->brightPassProgram.program = 0;
+}
+
+// Programs are only compiled once post processing is used
+static void InitPostProcessPrograms(PostProcess *postProcess) {
+  InitFullscreenProgram(&postProcess->brightPassProgram,
+                        BRIGHT_PASS_FRAGMENT_SHADER);
+  InitFullscreenProgram(&postProcess->blurProgram, BLUR_FRAGMENT_SHADER);
+}
+
+static CompositeProgram *GetCompositeProgram(PostProcess *postProcess,
+                                             int variant) {
+  CompositeProgram *compositeProgram =
+      &postProcess->compositePrograms[variant];
+
+  if (compositeProgram->program) {
+    return compositeProgram;
+  }
+
+  static char fss[sizeof(COMPOSITE_FRAGMENT_SHADER) + 128];
+  snprintf(fss, sizeof(fss), "#version 330 core\n%s%s%s%s",
+           variant & POST_PROCESS_BLOOM ? "#define BLOOM\n" : "",
+           variant & POST_PROCESS_COLOR_GRADING ? "#define COLOR_GRADING\n"
+                                                : "",
+           variant & POST_PROCESS_VIGNETTE ? "#define VIGNETTE\n" : "",
+           COMPOSITE_FRAGMENT_SHADER);
+
+  GLuint program = CompileGLProgram(FULLSCREEN_VERTEX_SHADER, fss);
+  if (!program) {
+    exit(EXIT_FAILURE);
+  }
+
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "scene"), 0);
+  glUniform1i(glGetUniformLocation(program, "bloom"), 1);
+
+  compositeProgram->program = program;
+  compositeProgram->sceneUVScaleLocation =
+      glGetUniformLocation(program, "sceneUVScale");
+  compositeProgram->bloomUVScaleLocation =
+      glGetUniformLocation(program, "bloomUVScale");
+  compositeProgram->bloomUVMaxLocation =
+      glGetUniformLocation(program, "bloomUVMax");
+  compositeProgram->bloomIntensityLocation =
+      glGetUniformLocation(program, "bloomIntensity");
+  compositeProgram->gradingLocation = glGetUniformLocation(program, "grading");
+  compositeProgram->colorFilterLocation =
+      glGetUniformLocation(program, "colorFilter");
+  compositeProgram->vignetteLocation =
+      glGetUniformLocation(program, "vignette");
+
+  return compositeProgram;
+}
+
+static int GetPostProcessVariant(const SDPostProcessParams *params) {
+  int variant = 0;
+
+  if (params->bloomEnabled && params->bloomIntensity > 0.0f) {
+    variant |= POST_PROCESS_BLOOM;
+  }
+  if (params->colorGradingEnabled) {
+    variant |= POST_PROCESS_COLOR_GRADING;
+  }
+  if (params->vignetteEnabled && params->vignetteIntensity > 0.0f) {
+    variant |= POST_PROCESS_VIGNETTE;
+  }
+
+  return variant;
+}
+
+extern int IsPostProcessEnabled(const SDPostProcessParams *params) {
+  return GetPostProcessVariant(params) != 0;
+}
+
+extern void RunFullscreenPass(const FullscreenProgram *fullscreenProgram,
+                              const RenderTarget *source, int sourceWidth,
+                              int sourceHeight, const RenderTarget *target,
+                              int targetWidth, int targetHeight,
+                              SDVec2 texelScale, const float *params) {
+  glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+  glViewport(0, 0, targetWidth, targetHeight);
+
+  glUseProgram(fullscreenProgram->program);
+  glUniform1i(fullscreenProgram->sourceLocation, 0);
+  glUniform2f(fullscreenProgram->uvScaleLocation,
+              (float)sourceWidth / source->width,
+              (float)sourceHeight / source->height);
+  glUniform2f(fullscreenProgram->uvMaxLocation,
+              (sourceWidth - 0.5f) / source->width,
+              (sourceHeight - 0.5f) / source->height);
+  glUniform2f(fullscreenProgram->texelSizeLocation,
+              texelScale.x / source->width, texelScale.y / source->height);
+  glUniform4fv(fullscreenProgram->paramsLocation, 1, params);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, source->texture);
+
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+typedef struct FullscreenPassData {
+  const FullscreenProgram *program;
+  int source;
+  int sourceWidth;
+  int sourceHeight;
+  int target;
+  int targetWidth;
+  int targetHeight;
+  float params[4];
+} FullscreenPassData;
+
+static void ExecuteFullscreenPass(RenderContext *rc, const RenderGraph *graph,
+                                  const void *data) {
+  const FullscreenPassData *pass = data;
+
+  glDisable(GL_BLEND);
+  glBindVertexArray(rc->fullscreenVAO);
+  RunFullscreenPass(pass->program, GetGraphTarget(graph, pass->source),
+                    pass->sourceWidth, pass->sourceHeight,
+                    GetGraphTarget(graph, pass->target), pass->targetWidth,
+                    pass->targetHeight, SDV2(1.0f, 1.0f), pass->params);
+  glBindVertexArray(0);
+  glEnable(GL_BLEND);
+}
+
+extern RenderPass *AddFullscreenPass(RenderGraph *graph,
+                                     const FullscreenProgram *program,
+                                     int source, int sourceWidth,
+                                     int sourceHeight, int target,
+                                     int targetWidth, int targetHeight,
+                                     const float *params) {
+  FullscreenPassData data = {
+      .program = program,
+      .source = source,
+      .sourceWidth = sourceWidth,
+      .sourceHeight = sourceHeight,
+      .target = target,
+      .targetWidth = targetWidth,
+      .targetHeight = targetHeight,
+  };
+  memcpy(data.params, params, sizeof(data.params));
+
+  RenderPass *pass =
+      AddRenderPass(graph, ExecuteFullscreenPass, &data, sizeof(data));
+  ReadGraphTarget(pass, source);
+  WriteGraphTarget(pass, target);
+  return pass;
+}
+
+typedef struct CompositePassData {
+  const SDPostProcessParams *params;
+  int variant;
+  int scene;
+  int bloom;  // -1 without bloom
+  int width;
+  int height;
+} CompositePassData;
+
+// Composite every enabled effect in one pass, upscaling to the window
+static void ExecuteCompositePass(RenderContext *rc, const RenderGraph *graph,
+                                 const void *data) {
+  const CompositePassData *pass = data;
+  const SDPostProcessParams *params = pass->params;
+  const RenderTarget *scene = GetGraphTarget(graph, pass->scene);
+  int width = pass->width;
+  int height = pass->height;
+  CompositeProgram *compositeProgram =
+      GetCompositeProgram(&rc->postProcess, pass->variant);
+
+  glDisable(GL_BLEND);
+  glBindVertexArray(rc->fullscreenVAO);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, rc->windowTarget.fbo);
+  glViewport(0, 0, rc->viewportWidth, rc->viewportHeight);
+  glUseProgram(compositeProgram->program);
+
+  glUniform2f(compositeProgram->sceneUVScaleLocation,
+              (float)width / scene->width, (float)height / scene->height);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, scene->texture);
+
+  if (pass->bloom >= 0) {
+    const RenderTarget *bloom = GetGraphTarget(graph, pass->bloom);
+    int bloomWidth = (width + 1) / 2;
+    int bloomHeight = (height + 1) / 2;
+    glUniform2f(compositeProgram->bloomUVScaleLocation,
+                (float)bloomWidth / bloom->width,
+                (float)bloomHeight / bloom->height);
+    glUniform2f(compositeProgram->bloomUVMaxLocation,
+                (bloomWidth - 0.5f) / bloom->width,
+                (bloomHeight - 0.5f) / bloom->height);
+    glUniform1f(compositeProgram->bloomIntensityLocation,
+                params->bloomIntensity);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, bloom->texture);
+    glActiveTexture(GL_TEXTURE0);
+  }
+
+  if (pass->variant & POST_PROCESS_COLOR_GRADING) {
+    glUniform3f(compositeProgram->gradingLocation, params->exposure,
+                params->contrast, params->saturation);
+    glUniform4f(compositeProgram->colorFilterLocation, params->colorFilter.r,
+                params->colorFilter.g, params->colorFilter.b,
+                params->colorFilter.a);
+  }
+
+  if (pass->variant & POST_PROCESS_VIGNETTE) {
+    glUniform4f(compositeProgram->vignetteLocation, params->vignetteIntensity,
+                params->vignetteRadius, params->vignetteSoftness,
+                (float)rc->viewportWidth / rc->viewportHeight);
+  }
+
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+
+  glBindVertexArray(0);
+  glEnable(GL_BLEND);
+}
+
+extern void AddPostProcessPasses(RenderContext *rc, RenderGraph *graph,
+                                 const SDPostProcessParams *params, int scene,
+                                 int window, int width, int height) {
+  PostProcess *postProcess = &rc->postProcess;
+  const RenderTarget *sceneTarget = GetGraphTarget(graph, scene);
+
+  if (!postProcess->brightPassProgram.program) {
+    InitPostProcessPrograms(postProcess);
+  }
+
+  CompositePassData composite = {
+      .params = params,
+      .variant = GetPostProcessVariant(params),
+      .scene = scene,
+      .bloom = -1,
+      .width = width,
+      .height = height,
+  };
+
+  // Bloom works at half resolution. Targets are sized from the viewport, not
+  // the dynamic resolution, so the pool hands back the same ones each frame.
+  // Each blur pass writes a target of its own, the graph lets them share two.
+  if (composite.variant & POST_PROCESS_BLOOM) {
+    int halfWidth = (sceneTarget->width + 1) / 2;
+    int halfHeight = (sceneTarget->height + 1) / 2;
+    int bloomWidth = (width + 1) / 2;
+    int bloomHeight = (height + 1) / 2;
+    int numBlurPass = params->bloomBlurPasses < MAX_BLOOM_BLUR_PASS
+                          ? params->bloomBlurPasses
+                          : MAX_BLOOM_BLUR_PASS;
+
+    int bloom = CreateGraphTarget(graph, halfWidth, halfHeight, GL_RGBA16F);
+    float brightParams[4] = {params->bloomThreshold, 0.0f, 0.0f, 0.0f};
+    AddFullscreenPass(graph, &postProcess->brightPassProgram, scene, width,
+                      height, bloom, bloomWidth, bloomHeight, brightParams);
+
+    static const float horizontal[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+    static const float vertical[4] = {0.0f, 1.0f, 0.0f, 0.0f};
+    for (int i = 0; i < numBlurPass; ++i) {
+      int blurred =
+          CreateGraphTarget(graph, halfWidth, halfHeight, GL_RGBA16F);
+      AddFullscreenPass(graph, &postProcess->blurProgram, bloom, bloomWidth,
+                        bloomHeight, blurred, bloomWidth, bloomHeight,
+                        horizontal);
+      bloom = CreateGraphTarget(graph, halfWidth, halfHeight, GL_RGBA16F);
+      AddFullscreenPass(graph, &postProcess->blurProgram, blurred, bloomWidth,
+                        bloomHeight, bloom, bloomWidth, bloomHeight,
+                        vertical);
+    }
+
+    composite.bloom = bloom;
+  }
+
+  RenderPass *pass = AddRenderPass(graph, ExecuteCompositePass, &composite,
+                                   sizeof(composite));
+  ReadGraphTarget(pass, scene);
+  if (composite.bloom >= 0) {
+    ReadGraphTarget(pass, composite.bloom);
+  }
+  WriteGraphTarget(pass, window);
+}
+
+// ----------------------------------------------------------------------------
+// Post Processing
+// ----------------------------------------------------------------------------
+
+SDAPI SDPostProcessParams SDMakePostProcessParams(void) {
+  SDPostProcessParams params = {
+      .bloomEnabled = 0,
+      .bloomThreshold = 0.8f,
+      .bloomIntensity = 1.0f,
+      .bloomBlurPasses = 2,
+
+      .colorGradingEnabled = 0,
+      .exposure = 1.0f,
+      .contrast = 1.0f,
+      .saturation = 1.0f,
+      .colorFilter = SDRGBA(1.0f, 1.0f, 1.0f, 1.0f),
+
+      .vignetteEnabled = 0,
+      .vignetteIntensity = 0.5f,
+      .vignetteRadius = 0.5f,
+      .vignetteSoftness = 0.4f,
+  };
+  return params;
+}
+
+SDAPI void SDSetPostProcess(const SDPostProcessParams *params) {
+  CTX.rc->postProcess.params = *params;
+}
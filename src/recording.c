@@ -0,0 +1,874 @@
+#include "sword/render.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "command.h"
+#include "render_internal.h"
+#include "sword/light.h"
+#include "sword/mesh.h"
+
+// File layout: the header, each texture as RecordedTextureHeader and its
+// pixels, each material as RecordedMaterialHeader and its source, each mesh as
+// RecordedMeshHeader, its vertices and its indices, then the calls. Structs
+// are written as they are in memory.
+#define FRAME_RECORDING_MAGIC 0x52464453  // "SDFR"
+#define FRAME_RECORDING_VERSION 2
+
+typedef struct FrameRecordingHeader {
+  unsigned int magic;
+  unsigned int version;
+  unsigned int headerSize;  // Catches builds with different structs
+  SDFloat canvasWidth;
+  SDFloat canvasHeight;
+  int numTexture;
+  int numMaterial;
+  int numMesh;
+  int numCall;
+  size_t callSize;  // in bytes
+  SDLightingParams lighting;
+  SDPostProcessParams postProcess;
+} FrameRecordingHeader;
+
+typedef struct RecordedTextureHeader {
+  int width;  // in pixel
+  int height;
+  int format;
+} RecordedTextureHeader;
+
+typedef struct RecordedMaterialHeader {
+  int numParam;
+  size_t sourceSize;  // in bytes, with the terminating zero
+} RecordedMaterialHeader;
+
+// Followed by numVertex MeshVertex and numIndex unsigned int
+typedef struct RecordedMeshHeader {
+  int texture;
+  int numVertex;
+  int numIndex;
+} RecordedMeshHeader;
+
+// Each call is a CallHeader followed by its data, padded to keep the next
+// header aligned
+typedef struct CallHeader {
+  RecordOp op;
+  unsigned int size;
+} CallHeader;
+
+#define CALL_ALIGNMENT 8
+
+// Textures, materials and meshes are referred to by their index in the file,
+// -1 for none
+typedef struct RecordedTextureDraw {
+  SDDrawTextureParams params;  // Without pointers
+  int texture;
+  int material;
+} RecordedTextureDraw;
+
+typedef struct RecordedNineSliceDraw {
+  int texture;
+  SDInsets insets;
+  SDRect dstRect;
+  SDMat3 transform;
+  SDColor tintColor;
+} RecordedNineSliceDraw;
+
+typedef struct RecordedLineDraw {
+  SDVec2 from;
+  SDVec2 to;
+  SDFloat width;
+  SDColor color;
+} RecordedLineDraw;
+
+// Followed by the points
+typedef struct RecordedPolylineDraw {
+  int numPoint;
+  SDFloat width;
+  SDLineJoin join;
+  SDColor color;
+} RecordedPolylineDraw;
+
+// Followed by the points
+typedef struct RecordedPolygonDraw {
+  SDDrawPolygonParams params;  // Without points
+} RecordedPolygonDraw;
+
+typedef struct RecordedMeshDraw {
+  int mesh;
+  SDMat3 transform;
+  SDColor tintColor;
+} RecordedMeshDraw;
+
+typedef struct RecordedTexture {
+  const SDTexture *texture;
+  RecordedTextureHeader header;
+  unsigned char *pixels;  // Read back on render side
+} RecordedTexture;
+
+typedef struct RecordedMaterial {
+  const SDMaterial *material;
+  RecordedMaterialHeader header;
+  char *source;  // Copied on first use, the material may not outlive the frame
+} RecordedMaterial;
+
+typedef struct RecordedMesh {
+  const void *object;  // NULL if not shared by draws
+  RecordedMeshHeader header;
+  MeshVertex *vertices;  // Filled by the one adding the mesh
+  unsigned int *indices;
+} RecordedMesh;
+
+struct FrameRecorder {
+  char *path;
+  FrameRecordingHeader header;
+
+  unsigned char *calls;
+  size_t callCapacity;
+
+  RecordedTexture *textures;
+  int textureCapacity;
+  RecordedMaterial *materials;
+  int materialCapacity;
+  RecordedMesh *meshes;
+  int meshCapacity;
+};
+
+SDAPI void SDRecordFrame(const char *path) {
+  RenderContext *rc = CTX.rc;
+
+  size_t size = strlen(path) + 1;
+  free(rc->recordPath);
+  rc->recordPath = malloc(size);
+  memcpy(rc->recordPath, path, size);
+}
+
+extern void BeginFrameRecording(RenderContext *rc) {
+  if (!rc->recordPath) {
+    return;
+  }
+
+  FrameRecorder *recorder = calloc(1, sizeof(FrameRecorder));
+  recorder->path = rc->recordPath;
+  recorder->header.magic = FRAME_RECORDING_MAGIC;
+  recorder->header.version = FRAME_RECORDING_VERSION;
+  recorder->header.headerSize = sizeof(FrameRecordingHeader);
+  recorder->header.canvasWidth = SDGetCanvasWidth();
+  recorder->header.canvasHeight = SDGetCanvasHeight();
+
+  rc->recorder = recorder;
+  rc->recordPath = NULL;
+}
+
+static void *ReserveCall(FrameRecorder *recorder, RecordOp op, size_t size) {
+  size_t callSize = sizeof(CallHeader) + size;
+  callSize = (callSize + CALL_ALIGNMENT - 1) / CALL_ALIGNMENT * CALL_ALIGNMENT;
+
+  FrameRecordingHeader *header = &recorder->header;
+  if (header->callSize + callSize > recorder->callCapacity) {
+    recorder->callCapacity = recorder->callCapacity * 2 + callSize;
+    recorder->calls = realloc(recorder->calls, recorder->callCapacity);
+  }
+
+  unsigned char *call = recorder->calls + header->callSize;
+  memset(call, 0, callSize);
+  *(CallHeader *)call = (CallHeader){op, (unsigned int)size};
+  header->callSize += callSize;
+  header->numCall++;
+  return call + sizeof(CallHeader);
+}
+
+extern void RecordCall(FrameRecorder *recorder, RecordOp op, const void *data,
+                       size_t size) {
+  void *call = ReserveCall(recorder, op, size);
+  if (size > 0) {
+    memcpy(call, data, size);
+  }
+}
+
+typedef struct ReadTextureCommand {
+  const SDTexture *texture;
+  unsigned char *pixels;
+} ReadTextureCommand;
+
+static void ExecuteReadTexture(void *data) {
+  const ReadTextureCommand *command = data;
+  const SDTexture *texture = command->texture;
+  int isA8 = texture->format == SD_IMAGE_FORMAT_A8;
+  size_t numChannel = isA8 ? 1 : 4;
+
+  // The whole padded texture, cropped to the image below. The software
+  // backend keeps its own copy.
+  unsigned char *texels = NULL;
+  size_t texelStride = (size_t)texture->actualWidth * numChannel;
+  if (CTX.renderBackend == SD_RENDER_BACKEND_SOFTWARE) {
+    texelStride = (size_t)texture->texelStride;
+  } else {
+    texels = malloc(texelStride * texture->actualHeight);
+    glBindTexture(GL_TEXTURE_2D, texture->id);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 0, isA8 ? GL_RED : GL_RGBA, GL_UNSIGNED_BYTE,
+                  texels);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  }
+  const unsigned char *src = texels ? texels : texture->texels;
+
+  size_t rowSize = (size_t)texture->width * numChannel;
+  for (int y = 0; y < texture->height; ++y) {
+    memcpy(command->pixels + y * rowSize, src + y * texelStride, rowSize);
+  }
+  free(texels);
+}
+
+// Index of texture in the recording, its contents are read back the first
+// time it is used
+static int RecordTexture(FrameRecorder *recorder, const SDTexture *texture) {
+  FrameRecordingHeader *header = &recorder->header;
+
+  for (int i = header->numTexture - 1; i >= 0; --i) {
+    if (recorder->textures[i].texture == texture) {
+      return i;
+    }
+  }
+
+  if (header->numTexture == recorder->textureCapacity) {
+    recorder->textureCapacity = recorder->textureCapacity * 2 + 8;
+    recorder->textures =
+        realloc(recorder->textures,
+                (size_t)recorder->textureCapacity * sizeof(RecordedTexture));
+  }
+
+  RecordedTexture *recorded = &recorder->textures[header->numTexture];
+  size_t numChannel = texture->format == SD_IMAGE_FORMAT_A8 ? 1 : 4;
+  recorded->texture = texture;
+  recorded->header.width = texture->width;
+  recorded->header.height = texture->height;
+  recorded->header.format = texture->format;
+  recorded->pixels =
+      malloc((size_t)texture->width * texture->height * numChannel);
+
+  ReadTextureCommand *command =
+      BeginCommand(ExecuteReadTexture, sizeof(ReadTextureCommand));
+  command->texture = texture;
+  command->pixels = recorded->pixels;
+  CommitCommand();
+
+  return header->numTexture++;
+}
+
+static int RecordMaterial(FrameRecorder *recorder,
+                          const SDMaterial *material) {
+  FrameRecordingHeader *header = &recorder->header;
+
+  if (!material) {
+    return -1;
+  }
+
+  for (int i = 0; i < header->numMaterial; ++i) {
+    if (recorder->materials[i].material == material) {
+      return i;
+    }
+  }
+
+  if (header->numMaterial == recorder->materialCapacity) {
+    recorder->materialCapacity = recorder->materialCapacity * 2 + 4;
+    recorder->materials =
+        realloc(recorder->materials,
+                (size_t)recorder->materialCapacity * sizeof(RecordedMaterial));
+  }
+
+  RecordedMaterial *recorded = &recorder->materials[header->numMaterial];
+  size_t sourceSize = strlen(material->source) + 1;
+  recorded->material = material;
+  recorded->header.numParam = material->numParam;
+  recorded->header.sourceSize = sourceSize;
+  recorded->source = malloc(sourceSize);
+  memcpy(recorded->source, material->source, sourceSize);
+  return header->numMaterial++;
+}
+
+extern void RecordTextureDraw(FrameRecorder *recorder,
+                              const SDDrawTextureParams *params) {
+  RecordedTextureDraw *draw =
+      ReserveCall(recorder, RECORD_DRAW_TEXTURE, sizeof(RecordedTextureDraw));
+  draw->params = *params;
+  draw->params.texture = NULL;
+  draw->params.material = NULL;
+  draw->texture = RecordTexture(recorder, params->texture);
+  draw->material = RecordMaterial(recorder, params->material);
+}
+
+extern void RecordNineSliceDraw(FrameRecorder *recorder,
+                                const SDTexture *texture, SDInsets insets,
+                                SDRect dstRect, SDMat3 transform,
+                                SDColor tintColor) {
+  RecordedNineSliceDraw *draw = ReserveCall(
+      recorder, RECORD_DRAW_NINE_SLICE, sizeof(RecordedNineSliceDraw));
+  draw->texture = RecordTexture(recorder, texture);
+  draw->insets = insets;
+  draw->dstRect = dstRect;
+  draw->transform = transform;
+  draw->tintColor = tintColor;
+}
+
+extern void RecordLineDraw(FrameRecorder *recorder, SDVec2 from, SDVec2 to,
+                           SDFloat width, SDColor color) {
+  RecordedLineDraw draw = {from, to, width, color};
+  RecordCall(recorder, RECORD_DRAW_LINE, &draw, sizeof(draw));
+}
+
+extern void RecordPolylineDraw(FrameRecorder *recorder, const SDVec2 *points,
+                               int numPoint, SDFloat width, SDLineJoin join,
+                               SDColor color) {
+  size_t pointSize = (size_t)numPoint * sizeof(SDVec2);
+  RecordedPolylineDraw *draw =
+      ReserveCall(recorder, RECORD_DRAW_POLYLINE,
+                  sizeof(RecordedPolylineDraw) + pointSize);
+  *draw = (RecordedPolylineDraw){numPoint, width, join, color};
+  memcpy(draw + 1, points, pointSize);
+}
+
+extern void RecordPolygonDraw(FrameRecorder *recorder,
+                              const SDDrawPolygonParams *params) {
+  size_t pointSize = (size_t)params->numPoint * sizeof(SDVec2);
+  RecordedPolygonDraw *draw =
+      ReserveCall(recorder, RECORD_DRAW_POLYGON,
+                  sizeof(RecordedPolygonDraw) + pointSize);
+  draw->params = *params;
+  draw->params.points = NULL;
+  memcpy(draw + 1, params->points, pointSize);
+}
+
+extern int FindRecordedMesh(FrameRecorder *recorder, const void *object) {
+  for (int i = recorder->header.numMesh - 1; i >= 0; --i) {
+    if (recorder->meshes[i].object == object) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+extern int AddRecordedMesh(FrameRecorder *recorder, const void *object,
+                           const SDTexture *texture, int numVertex,
+                           int numIndex, MeshVertex **vertices,
+                           unsigned int **indices) {
+  FrameRecordingHeader *header = &recorder->header;
+
+  if (header->numMesh == recorder->meshCapacity) {
+    recorder->meshCapacity = recorder->meshCapacity * 2 + 4;
+    recorder->meshes =
+        realloc(recorder->meshes,
+                (size_t)recorder->meshCapacity * sizeof(RecordedMesh));
+  }
+
+  RecordedMesh *recorded = &recorder->meshes[header->numMesh];
+  recorded->object = object;
+  recorded->header.texture = RecordTexture(recorder, texture);
+  recorded->header.numVertex = numVertex;
+  recorded->header.numIndex = numIndex;
+  recorded->vertices = malloc((size_t)numVertex * sizeof(MeshVertex) + 1);
+  recorded->indices = malloc((size_t)numIndex * sizeof(unsigned int) + 1);
+  *vertices = recorded->vertices;
+  *indices = recorded->indices;
+  return header->numMesh++;
+}
+
+extern void ForgetRecordedMesh(FrameRecorder *recorder, const void *object) {
+  int index = FindRecordedMesh(recorder, object);
+  if (index >= 0) {
+    recorder->meshes[index].object = NULL;
+  }
+}
+
+extern void RecordMeshDraw(FrameRecorder *recorder, int mesh, SDMat3 transform,
+                           SDColor tintColor) {
+  RecordedMeshDraw draw = {mesh, transform, tintColor};
+  RecordCall(recorder, RECORD_DRAW_MESH, &draw, sizeof(draw));
+}
+
+static void FreeFrameRecorder(FrameRecorder *recorder) {
+  for (int i = 0; i < recorder->header.numTexture; ++i) {
+    free(recorder->textures[i].pixels);
+  }
+  for (int i = 0; i < recorder->header.numMaterial; ++i) {
+    free(recorder->materials[i].source);
+  }
+  for (int i = 0; i < recorder->header.numMesh; ++i) {
+    free(recorder->meshes[i].vertices);
+    free(recorder->meshes[i].indices);
+  }
+  free(recorder->textures);
+  free(recorder->materials);
+  free(recorder->meshes);
+  free(recorder->calls);
+  free(recorder->path);
+  free(recorder);
+}
+
+// Runs after the texture and mesh read backs of the frame
+static void ExecuteWriteFrameRecording(void *data) {
+  FrameRecorder *recorder = *(FrameRecorder **)data;
+  const FrameRecordingHeader *header = &recorder->header;
+
+  FILE *file = fopen(recorder->path, "wb");
+  if (!file) {
+    printf("Failed to write frame recording %s\n", recorder->path);
+    FreeFrameRecorder(recorder);
+    return;
+  }
+
+  fwrite(header, sizeof(*header), 1, file);
+
+  for (int i = 0; i < header->numTexture; ++i) {
+    const RecordedTexture *texture = &recorder->textures[i];
+    size_t numChannel = texture->header.format == SD_IMAGE_FORMAT_A8 ? 1 : 4;
+    fwrite(&texture->header, sizeof(texture->header), 1, file);
+    fwrite(texture->pixels, numChannel * texture->header.width,
+           texture->header.height, file);
+  }
+
+  for (int i = 0; i < header->numMaterial; ++i) {
+    const RecordedMaterial *material = &recorder->materials[i];
+    fwrite(&material->header, sizeof(material->header), 1, file);
+    fwrite(material->source, material->header.sourceSize, 1, file);
+  }
+
+  for (int i = 0; i < header->numMesh; ++i) {
+    const RecordedMesh *mesh = &recorder->meshes[i];
+    fwrite(&mesh->header, sizeof(mesh->header), 1, file);
+    fwrite(mesh->vertices, sizeof(MeshVertex), (size_t)mesh->header.numVertex,
+           file);
+    fwrite(mesh->indices, sizeof(unsigned int), (size_t)mesh->header.numIndex,
+           file);
+  }
+
+  fwrite(recorder->calls, header->callSize, 1, file);
+
+  if (fclose(file) != 0) {
+    printf("Failed to write frame recording %s\n", recorder->path);
+  }
+  FreeFrameRecorder(recorder);
+}
+
+extern void EndFrameRecording(RenderContext *rc) {
+  FrameRecorder *recorder = rc->recorder;
+  if (!recorder) {
+    return;
+  }
+
+  // Settings the frame ends with are the ones it is drawn with
+  recorder->header.lighting = rc->lighting.params;
+  recorder->header.postProcess = rc->postProcess.params;
+
+  // The recorder belongs to the command from here
+  FrameRecorder **command =
+      BeginCommand(ExecuteWriteFrameRecording, sizeof(FrameRecorder *));
+  *command = recorder;
+  CommitCommand();
+
+  rc->recorder = NULL;
+}
+
+// ----------------------------------------------------------------------------
+// Replay
+// ----------------------------------------------------------------------------
+
+struct SDFrameRecording {
+  FrameRecordingHeader header;
+  SDTexture **textures;
+  SDMaterial **materials;
+  SDMesh **meshes;
+  unsigned char *calls;
+};
+
+static SDTexture *GetRecordedTexture(const SDFrameRecording *recording,
+                                     int index) {
+  SDAssert(index >= 0 && index < recording->header.numTexture);
+  return recording->textures[index];
+}
+
+static int ReadExactly(FILE *file, void *data, size_t size) {
+  return size == 0 || fread(data, size, 1, file) == 1;
+}
+
+// Size of the data of each op without its points, 0 for none
+static size_t GetCallDataSize(RecordOp op) {
+  switch (op) {
+    case RECORD_PUSH_STATE:
+    case RECORD_POP_STATE:
+    case RECORD_END_CAMERA:
+      return 0;
+    case RECORD_PUSH_CLIP_RECT:
+      return sizeof(SDRect);
+    case RECORD_BEGIN_CAMERA:
+      return sizeof(SDCamera);
+    case RECORD_DRAW_TEXTURE:
+      return sizeof(RecordedTextureDraw);
+    case RECORD_DRAW_NINE_SLICE:
+      return sizeof(RecordedNineSliceDraw);
+    case RECORD_DRAW_RECT:
+      return sizeof(SDDrawRectParams);
+    case RECORD_DRAW_CIRCLE:
+      return sizeof(SDDrawCircleParams);
+    case RECORD_DRAW_LINE:
+      return sizeof(RecordedLineDraw);
+    case RECORD_DRAW_POLYLINE:
+      return sizeof(RecordedPolylineDraw);
+    case RECORD_DRAW_POLYGON:
+      return sizeof(RecordedPolygonDraw);
+    case RECORD_DRAW_LIGHT:
+      return sizeof(SDLight);
+    case RECORD_DRAW_MESH:
+      return sizeof(RecordedMeshDraw);
+  }
+  return 0;
+}
+
+static int IsValidIndex(int index, int count) {
+  return index >= 0 && index < count;
+}
+
+static int HasPoints(size_t size, size_t drawSize, int numPoint) {
+  return numPoint >= 0 &&
+         (size - drawSize) / sizeof(SDVec2) >= (size_t)numPoint;
+}
+
+// Every call must fit in the file and refer only to what the file holds, as
+// replay trusts them
+static int ValidateCalls(const SDFrameRecording *recording) {
+  const FrameRecordingHeader *header = &recording->header;
+  size_t offset = 0;
+  int numCall = 0;
+
+  while (offset < header->callSize) {
+    if (header->callSize - offset < sizeof(CallHeader)) {
+      return 0;
+    }
+    const CallHeader *call = (const CallHeader *)(recording->calls + offset);
+    const void *data = call + 1;
+    size_t size = call->size;
+    if (call->op < RECORD_PUSH_STATE || call->op > RECORD_DRAW_MESH ||
+        size > header->callSize - offset - sizeof(CallHeader) ||
+        size < GetCallDataSize(call->op)) {
+      return 0;
+    }
+
+    int isValid = 1;
+    switch (call->op) {
+      case RECORD_DRAW_TEXTURE: {
+        const RecordedTextureDraw *draw = data;
+        isValid = IsValidIndex(draw->texture, header->numTexture) &&
+                  (draw->material == -1 ||
+                   IsValidIndex(draw->material, header->numMaterial));
+      } break;
+
+      case RECORD_DRAW_NINE_SLICE: {
+        const RecordedNineSliceDraw *draw = data;
+        isValid = IsValidIndex(draw->texture, header->numTexture);
+      } break;
+
+      case RECORD_DRAW_POLYLINE: {
+        const RecordedPolylineDraw *draw = data;
+        isValid = HasPoints(size, sizeof(*draw), draw->numPoint);
+      } break;
+
+      case RECORD_DRAW_POLYGON: {
+        const RecordedPolygonDraw *draw = data;
+        isValid = HasPoints(size, sizeof(*draw), draw->params.numPoint);
+      } break;
+
+      case RECORD_DRAW_MESH: {
+        const RecordedMeshDraw *draw = data;
+        isValid = IsValidIndex(draw->mesh, header->numMesh);
+      } break;
+
+      default:
+        break;
+    }
+    if (!isValid) {
+      return 0;
+    }
+
+    size_t callSize = sizeof(CallHeader) + size;
+    offset += (callSize + CALL_ALIGNMENT - 1) / CALL_ALIGNMENT * CALL_ALIGNMENT;
+    numCall++;
+  }
+
+  return numCall == header->numCall;
+}
+
+// Counts and sizes are checked against fileSize before anything is allocated
+// for them
+static int ReadFrameRecording(SDFrameRecording *recording, FILE *file,
+                              size_t fileSize) {
+  FrameRecordingHeader *header = &recording->header;
+
+  if (!ReadExactly(file, header, sizeof(*header)) ||
+      header->magic != FRAME_RECORDING_MAGIC ||
+      header->version != FRAME_RECORDING_VERSION ||
+      header->headerSize != sizeof(FrameRecordingHeader)) {
+    return 0;
+  }
+
+  if (header->numTexture < 0 || (size_t)header->numTexture > fileSize ||
+      header->numMaterial < 0 || (size_t)header->numMaterial > fileSize ||
+      header->numMesh < 0 || (size_t)header->numMesh > fileSize ||
+      header->numCall < 0 || header->callSize > fileSize) {
+    return 0;
+  }
+
+  recording->textures = calloc((size_t)header->numTexture + 1,
+                               sizeof(SDTexture *));
+  for (int i = 0; i < header->numTexture; ++i) {
+    RecordedTextureHeader texture;
+    if (!ReadExactly(file, &texture, sizeof(texture)) || texture.width <= 0 ||
+        texture.height <= 0 ||
+        (texture.format != SD_IMAGE_FORMAT_RGBA8 &&
+         texture.format != SD_IMAGE_FORMAT_A8)) {
+      return 0;
+    }
+
+    int numChannel = texture.format == SD_IMAGE_FORMAT_A8 ? 1 : 4;
+    if ((size_t)texture.width * texture.height * numChannel > fileSize) {
+      return 0;
+    }
+    SDImage image = {
+        .width = texture.width,
+        .height = texture.height,
+        .stride = texture.width * numChannel,
+        .format = texture.format,
+        .isPremultiplied = 1,
+    };
+    size_t size = (size_t)image.stride * image.height;
+    image.data = malloc(size);
+    if (!ReadExactly(file, image.data, size)) {
+      free(image.data);
+      return 0;
+    }
+    recording->textures[i] = SDLoadTextureFromImage(&image);
+    free(image.data);
+  }
+
+  recording->materials = calloc((size_t)header->numMaterial + 1,
+                                sizeof(SDMaterial *));
+  for (int i = 0; i < header->numMaterial; ++i) {
+    RecordedMaterialHeader material;
+    if (!ReadExactly(file, &material, sizeof(material)) ||
+        material.sourceSize == 0 || material.sourceSize > fileSize ||
+        material.numParam < 0 || material.numParam > SD_MAX_MATERIAL_PARAM) {
+      return 0;
+    }
+
+    char *source = malloc(material.sourceSize);
+    if (!ReadExactly(file, source, material.sourceSize)) {
+      free(source);
+      return 0;
+    }
+    source[material.sourceSize - 1] = '\0';
+    recording->materials[i] = SDCreateMaterial(source, material.numParam);
+    free(source);
+  }
+
+  recording->meshes = calloc((size_t)header->numMesh + 1, sizeof(SDMesh *));
+  for (int i = 0; i < header->numMesh; ++i) {
+    RecordedMeshHeader mesh;
+    if (!ReadExactly(file, &mesh, sizeof(mesh)) ||
+        !IsValidIndex(mesh.texture, header->numTexture) ||
+        mesh.numVertex <= 0 || mesh.numIndex < 0 || mesh.numIndex % 3 != 0) {
+      return 0;
+    }
+
+    size_t vertexSize = (size_t)mesh.numVertex * sizeof(MeshVertex);
+    size_t indexSize = (size_t)mesh.numIndex * sizeof(unsigned int);
+    if (vertexSize > fileSize || indexSize > fileSize) {
+      return 0;
+    }
+
+    MeshVertex *vertices = malloc(vertexSize);
+    unsigned int *indices = malloc(indexSize + 1);
+    int isValid = ReadExactly(file, vertices, vertexSize) &&
+                  ReadExactly(file, indices, indexSize);
+    for (int j = 0; isValid && j < mesh.numIndex; ++j) {
+      isValid = indices[j] < (unsigned int)mesh.numVertex;
+    }
+    if (isValid) {
+      recording->meshes[i] = CreateMeshFromVertices(
+          vertices, mesh.numVertex, indices, mesh.numIndex,
+          GetRecordedTexture(recording, mesh.texture));
+    }
+    free(vertices);
+    free(indices);
+    if (!isValid) {
+      return 0;
+    }
+  }
+
+  recording->calls = malloc(header->callSize + 1);
+  return ReadExactly(file, recording->calls, header->callSize) &&
+         ValidateCalls(recording);
+}
+
+SDAPI SDFrameRecording *SDLoadFrameRecording(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long fileSize = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  SDFrameRecording *recording = calloc(1, sizeof(SDFrameRecording));
+  int isRead = fileSize >= 0 &&
+               ReadFrameRecording(recording, file, (size_t)fileSize);
+  fclose(file);
+
+  if (!isRead) {
+    printf("Failed to read frame recording %s\n", path);
+    SDDestroyFrameRecording(&recording);
+    return NULL;
+  }
+
+  SDSetLighting(&recording->header.lighting);
+  SDSetPostProcess(&recording->header.postProcess);
+  return recording;
+}
+
+SDAPI void SDDestroyFrameRecording(SDFrameRecording **ptr) {
+  SDFrameRecording *recording = *ptr;
+
+  if (recording->textures) {
+    for (int i = 0; i < recording->header.numTexture; ++i) {
+      if (recording->textures[i]) {
+        SDDestroyTexture(&recording->textures[i]);
+      }
+    }
+  }
+  if (recording->materials) {
+    for (int i = 0; i < recording->header.numMaterial; ++i) {
+      if (recording->materials[i]) {
+        SDDestroyMaterial(&recording->materials[i]);
+      }
+    }
+  }
+  if (recording->meshes) {
+    for (int i = 0; i < recording->header.numMesh; ++i) {
+      if (recording->meshes[i]) {
+        SDDestroyMesh(&recording->meshes[i]);
+      }
+    }
+  }
+
+  free(recording->textures);
+  free(recording->materials);
+  free(recording->meshes);
+  free(recording->calls);
+  free(recording);
+
+  *ptr = NULL;
+}
+
+SDAPI SDFrameRecordingInfo SDGetFrameRecordingInfo(
+    const SDFrameRecording *recording) {
+  const FrameRecordingHeader *header = &recording->header;
+  SDFrameRecordingInfo info = {
+      .canvasWidth = header->canvasWidth,
+      .canvasHeight = header->canvasHeight,
+      .numCall = header->numCall,
+      .numTexture = header->numTexture,
+      .numMaterial = header->numMaterial,
+      .numMesh = header->numMesh,
+  };
+  return info;
+}
+
+static void ReplayCall(const SDFrameRecording *recording, RecordOp op,
+                       const void *data) {
+  switch (op) {
+    case RECORD_PUSH_STATE: {
+      SDPushState();
+    } break;
+
+    case RECORD_POP_STATE: {
+      SDPopState();
+    } break;
+
+    case RECORD_PUSH_CLIP_RECT: {
+      SDPushClipRect(*(const SDRect *)data);
+    } break;
+
+    case RECORD_BEGIN_CAMERA: {
+      SDCamera camera = *(const SDCamera *)data;
+      SDBeginCamera(&camera);
+    } break;
+
+    case RECORD_END_CAMERA: {
+      SDEndCamera();
+    } break;
+
+    case RECORD_DRAW_TEXTURE: {
+      const RecordedTextureDraw *draw = data;
+      SDDrawTextureParams params = draw->params;
+      params.texture = GetRecordedTexture(recording, draw->texture);
+      params.material =
+          draw->material >= 0 ? recording->materials[draw->material] : NULL;
+      SDDrawTexture(&params);
+    } break;
+
+    case RECORD_DRAW_NINE_SLICE: {
+      const RecordedNineSliceDraw *draw = data;
+      SDDrawNineSlice(GetRecordedTexture(recording, draw->texture),
+                      draw->insets, draw->dstRect, draw->transform,
+                      draw->tintColor);
+    } break;
+
+    case RECORD_DRAW_RECT: {
+      SDDrawRect(data);
+    } break;
+
+    case RECORD_DRAW_CIRCLE: {
+      SDDrawCircle(data);
+    } break;
+
+    case RECORD_DRAW_LINE: {
+      const RecordedLineDraw *draw = data;
+      SDDrawLine(draw->from, draw->to, draw->width, draw->color);
+    } break;
+
+    case RECORD_DRAW_POLYLINE: {
+      const RecordedPolylineDraw *draw = data;
+      SDDrawPolyline((const SDVec2 *)(draw + 1), draw->numPoint, draw->width,
+                     draw->join, draw->color);
+    } break;
+
+    case RECORD_DRAW_POLYGON: {
+      const RecordedPolygonDraw *draw = data;
+      SDDrawPolygonParams params = draw->params;
+      params.points = (const SDVec2 *)(draw + 1);
+      SDDrawPolygon(&params);
+    } break;
+
+    case RECORD_DRAW_LIGHT: {
+      SDDrawLight(data);
+    } break;
+
+    case RECORD_DRAW_MESH: {
+      const RecordedMeshDraw *draw = data;
+      SDDrawMesh(recording->meshes[draw->mesh], draw->transform,
+                 draw->tintColor);
+    } break;
+  }
+}
+
+SDAPI void SDReplayFrameRecording(const SDFrameRecording *recording) {
+  const unsigned char *call = recording->calls;
+  const unsigned char *end = call + recording->header.callSize;
+
+  while (call < end) {
+    const CallHeader *header = (const CallHeader *)call;
+    ReplayCall(recording, header->op, header + 1);
+
+    size_t callSize = sizeof(CallHeader) + header->size;
+    call += (callSize + CALL_ALIGNMENT - 1) / CALL_ALIGNMENT * CALL_ALIGNMENT;
+  }
+}
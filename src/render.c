@@ -6,22 +6,9 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-#include "context.h"
-
-typedef struct DrawTextureProgram {
-  GLuint vao;
-  GLuint vbo;
-  GLuint ebo;
-  GLuint program;
-  GLint MVPLocation;
-} DrawTextureProgram;
-
-struct RenderContext {
-  int numDrawCall;
-  SDMat3 projection;
-  SDMat3 camera;
-  DrawTextureProgram drawTextureProgram;
-};
+#include "command.h"
+#include "render_internal.h"
+#include "simd.h"
 
 const char DRAW_TEXTURE_VERTEX_SHADER[] =
     "#version 330 core                                                      \n"
@@ -32,13 +19,16 @@ const char DRAW_TEXTURE_VERTEX_SHADER[] =
     "layout (location = 3) in vec2 aPos;                                    \n"
     "layout (location = 4) in vec2 aTexCoord;                               \n"
     "layout (location = 5) in vec4 aColor;                                  \n"
+    "layout (location = 6) in int aParamOffset;                             \n"
     "out vec2 vTexCoord;                                                    \n"
     "out vec4 vColor;                                                       \n"
+    "flat out int vParamOffset;                                             \n"
     "                                                                       \n"
     "void main() {                                                          \n"
     "   gl_Position = vec4(MVP * aTransform * vec3(aPos, 1), 1);            \n"
     "   vTexCoord = aTexCoord;                                              \n"
     "   vColor = aColor;                                                    \n"
+    "   vParamOffset = aParamOffset;                                        \n"
     "}                                                                      \n";
 
 const char DRAW_TEXTURE_FRAGMENT_SHADER[] =
@@ -52,22 +42,10 @@ const char DRAW_TEXTURE_FRAGMENT_SHADER[] =
     "out vec4 fragColor;                                                    \n"
     "                                                                       \n"
     "void main() {                                                          \n"
-    "   vec4 texColor = texture(texture0, vTexCoord);                       \n"
-    "   // Pre-multiply alpha                                               \n"
-    "   texColor = vec4(texColor.rgb * texColor.a, texColor.a);             \n"
-    "                                                                       \n"
-    "   fragColor = texColor * vColor;                                      \n"
+    "   // Textures are pre-multiplied at load                              \n"
+    "   fragColor = texture(texture0, vTexCoord) * vColor;                  \n"
     "}                                                                      \n";
 
-typedef struct DrawTextureVertexAttrib {
-  float transform0[3];
-  float transform1[3];
-  float transform2[3];
-  float pos[2];
-  float texCoord[2];
-  float color[4];
-} DrawTextureVertexAttrib;
-
 static GLuint CompileGLShader(GLenum type, const char *source) {
   GLuint result = glCreateShader(type);
 
@@ -87,7 +65,7 @@ static GLuint CompileGLShader(GLenum type, const char *source) {
   return result;
 }
 
-static GLuint CompileGLProgram(const char *vss, const char *fss) {
+extern GLuint CompileGLProgram(const char *vss, const char *fss) {
   GLuint result = 0;
 
   GLuint vs = CompileGLShader(GL_VERTEX_SHADER, vss);
@@ -156,6 +134,11 @@ static void InitDrawTextureProgram(DrawTextureProgram *drawTextureProgram) {
                         (void *)offsetof(DrawTextureVertexAttrib, color));
   glEnableVertexAttribArray(5);
 
+  glVertexAttribIPointer(
+      6, 1, GL_INT, sizeof(DrawTextureVertexAttrib),
+      (void *)offsetof(DrawTextureVertexAttrib, paramOffset));
+  glEnableVertexAttribArray(6);
+
   glBindVertexArray(0);
 
   // Compile Program
@@ -170,19 +153,341 @@ static void InitDrawTextureProgram(DrawTextureProgram *drawTextureProgram) {
       glGetUniformLocation(drawTextureProgram->program, "MVP");
 }
 
+static void InitDynamicResolution(DynamicResolution *dr, int viewportWidth,
+                                  int viewportHeight) {
+  dr->hasPendingParams = 0;
+  dr->enabled = 0;
+  dr->targetFrameTime = 1.0f / 60.0f;
+  dr->minScale = 0.5f;
+  dr->maxScale = 1.0f;
+  dr->scale = 1.0f;
+  dr->cooldown = 0;
+  dr->gpuFrameTime = 0.0f;
+  dr->cpuFrameTime = 0.0f;
+  dr->renderWidth = viewportWidth;
+  dr->renderHeight = viewportHeight;
+  dr->numFrame = 0;
+
+  glGenQueries(TIMER_QUERY_COUNT, dr->timerQueries);
+}
+
+static void CreateRenderTarget(RenderTarget *rt, int width, int height,
+                               GLenum internalFormat) {
+  rt->width = width;
+  rt->height = height;
+  rt->internalFormat = internalFormat;
+  rt->isInUse = 0;
+
+  glGenTextures(1, &rt->texture);
+  glBindTexture(GL_TEXTURE_2D, rt->texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, NULL);
+
+  glGenFramebuffers(1, &rt->fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, rt->fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         rt->texture, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    printf("Failed to create render target %dx%d\n", width, height);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+static void DestroyRenderTarget(RenderTarget *rt) {
+  glDeleteFramebuffers(1, &rt->fbo);
+  glDeleteTextures(1, &rt->texture);
+  rt->fbo = 0;
+  rt->texture = 0;
+}
+
+extern RenderTarget *AcquireRenderTarget(RenderContext *rc, int width,
+                                         int height, GLenum internalFormat) {
+  RenderTarget *empty = NULL;
+  RenderTarget *unused = NULL;
+
+  for (int i = 0; i < MAX_POOLED_RENDER_TARGET; ++i) {
+    RenderTarget *rt = &rc->renderTargetPool[i];
+    if (!rt->fbo) {
+      empty = empty ? empty : rt;
+    } else if (!rt->isInUse) {
+      if (rt->width == width && rt->height == height &&
+          rt->internalFormat == internalFormat) {
+        rt->isInUse = 1;
+        return rt;
+      }
+      unused = unused ? unused : rt;
+    }
+  }
+
+  // Recycle a target of another size only when the pool is full
+  RenderTarget *rt = empty ? empty : unused;
+  if (!rt) {
+    printf("Render target pool exhausted\n");
+    exit(EXIT_FAILURE);
+  }
+  if (rt->fbo) {
+    DestroyRenderTarget(rt);
+  }
+
+  CreateRenderTarget(rt, width, height, internalFormat);
+  rt->isInUse = 1;
+  return rt;
+}
+
+extern void ReleaseRenderTarget(RenderTarget *rt) { rt->isInUse = 0; }
+
+static void UpdateResolutionScale(DynamicResolution *dr, float gpuFrameTime,
+                                  float cpuFrameTime) {
+  // Exponential moving average, so a single spike doesn't cause a jump
+  dr->gpuFrameTime = SDLerpF(dr->gpuFrameTime, 0.2f, gpuFrameTime);
+  dr->cpuFrameTime = SDLerpF(dr->cpuFrameTime, 0.2f, cpuFrameTime);
+
+  float budget = dr->targetFrameTime;
+  float scale = dr->scale;
+
+  if (dr->gpuFrameTime <= 0.0f) {
+    // No measurement yet
+  } else if (dr->gpuFrameTime > budget * 0.95f) {
+    // GPU bound, shrink the pixel count proportionally to the overrun. Pixel
+    // count goes with scale squared.
+    scale *= sqrtf(budget * 0.9f / dr->gpuFrameTime);
+    dr->cooldown = 30;
+  } else if (dr->cooldown > 0) {
+    dr->cooldown--;
+  } else if (dr->gpuFrameTime < budget * 0.75f &&
+             dr->cpuFrameTime < budget) {
+    // Plenty of headroom, grow back slowly to avoid oscillating
+    scale = SDMinF(scale * sqrtf(budget * 0.85f / dr->gpuFrameTime),
+                   scale + 0.02f);
+  }
+
+  dr->scale = SDClampF(scale, dr->minScale, dr->maxScale);
+}
+
+static void ApplyResolutionScale(RenderContext *rc) {
+  DynamicResolution *dr = &rc->dynamicResolution;
+  SDFloat scale = dr->enabled ? dr->scale : 1.0f;
+
+  dr->renderWidth = (int)SDCeilF(rc->viewportWidth * scale);
+  dr->renderHeight = (int)SDCeilF(rc->viewportHeight * scale);
+}
+
+static void ApplyDynamicResolutionParams(
+    RenderContext *rc, const SDDynamicResolutionParams *params) {
+  DynamicResolution *dr = &rc->dynamicResolution;
+
+  dr->enabled = params->enabled;
+  dr->targetFrameTime = params->targetFrameTime;
+  dr->minScale = SDClampF(params->minScale, 0.1f, 1.0f);
+  dr->maxScale = SDClampF(params->maxScale, dr->minScale, 1.0f);
+  dr->scale = SDClampF(dr->scale, dr->minScale, dr->maxScale);
+
+  ApplyResolutionScale(rc);
+}
+
+static SDTexture *LoadTextureFromMemory(const void *data, int width, int height,
+                                        int stride, int format,
+                                        int isPremultiplied);
+
+static void InitSpriteBatch(SpriteBatch *batch) {
+  batch->texture = NULL;
+  batch->blendMode = SD_BLEND_MODE_ALPHA;
+  batch->material = NULL;
+  batch->params = malloc(MAX_BATCH_PARAM * 4 * sizeof(SDFloat));
+  batch->numParam = 0;
+  batch->numVertex = 0;
+  batch->numIndex = 0;
+  batch->vertices = malloc(MAX_BATCH_VERTEX * sizeof(DrawTextureVertexAttrib));
+  batch->indices = malloc(MAX_BATCH_INDEX * sizeof(unsigned int));
+}
+
+typedef struct FlushBatchCommand {
+  const SDTexture *texture;
+  SDBlendMode blendMode;
+  const SDMaterial *material;
+  int numParam;
+  const SDFloat *params;
+  SDMat3 viewProjection;
+  int numVertex;
+  int numIndex;
+  const DrawTextureVertexAttrib *vertices;
+  const unsigned int *indices;
+} FlushBatchCommand;
+
+static void ExecuteFlushBatch(void *data) {
+  const FlushBatchCommand *command = data;
+  RenderContext *rc = CTX.rc;
+  DrawTextureProgram *drawTextureProgram = &rc->drawTextureProgram;
+
+  // The element buffer binding is VAO state, bind ours first so it is not
+  // attached to whatever VAO is current
+  glBindVertexArray(drawTextureProgram->vao);
+
+  glBindBuffer(GL_ARRAY_BUFFER, drawTextureProgram->vbo);
+  glBufferData(GL_ARRAY_BUFFER,
+               command->numVertex * sizeof(DrawTextureVertexAttrib),
+               command->vertices, GL_STREAM_DRAW);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, drawTextureProgram->ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               command->numIndex * sizeof(unsigned int), command->indices,
+               GL_STREAM_DRAW);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, command->texture->id);
+
+  const SDMaterial *material = command->material;
+  if (material && material->program) {
+    BindMaterialParams(rc, command->params, command->numParam);
+    glUseProgram(material->program);
+    glUniformMatrix3fv(material->MVPLocation, 1, GL_FALSE,
+                       (const GLfloat *)&command->viewProjection);
+  } else {
+    glUseProgram(drawTextureProgram->program);
+    glUniformMatrix3fv(drawTextureProgram->MVPLocation, 1, GL_FALSE,
+                       (const GLfloat *)&command->viewProjection);
+  }
+
+  // Alpha stays the pre-multiplied over operator in every mode
+  switch (command->blendMode) {
+    case SD_BLEND_MODE_MULTIPLY:
+      glBlendFuncSeparate(GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+                          GL_ONE_MINUS_SRC_ALPHA);
+      break;
+    case SD_BLEND_MODE_SCREEN:
+      glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_COLOR, GL_ONE,
+                          GL_ONE_MINUS_SRC_ALPHA);
+      break;
+    default:
+      break;
+  }
+
+  glDrawElements(GL_TRIANGLES, command->numIndex, GL_UNSIGNED_INT, 0);
+  glBindVertexArray(0);
+
+  if (CTX.renderBackend == SD_RENDER_BACKEND_SOFTWARE) {
+    DrawSoftwareBatch(command->texture, command->blendMode,
+                      command->viewProjection, command->vertices,
+                      command->indices, command->numIndex);
+  }
+
+  if (command->blendMode != SD_BLEND_MODE_ALPHA) {
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  }
+
+  rc->numDrawCall++;
+}
+
+extern void FlushBatch(RenderContext *rc) {
+  SpriteBatch *batch = &rc->batch;
+
+  if (batch->numIndex == 0) {
+    return;
+  }
+
+  FlushBatchCommand *command =
+      BeginCommand(ExecuteFlushBatch, sizeof(FlushBatchCommand));
+  command->texture = batch->texture;
+  command->blendMode = batch->blendMode;
+  command->material = batch->material;
+  command->numParam = batch->numParam;
+  command->params = batch->numParam > 0
+                        ? CopyCommandData(batch->params,
+                                          batch->numParam * 4 * sizeof(SDFloat))
+                        : NULL;
+  command->viewProjection = rc->viewProjection;
+  command->numVertex = batch->numVertex;
+  command->numIndex = batch->numIndex;
+  command->vertices = CopyCommandData(
+      batch->vertices, batch->numVertex * sizeof(DrawTextureVertexAttrib));
+  command->indices = CopyCommandData(
+      batch->indices, batch->numIndex * sizeof(unsigned int));
+  CommitCommand();
+
+  batch->numVertex = 0;
+  batch->numIndex = 0;
+  batch->numParam = 0;
+}
+
+extern unsigned int ReserveBatch(RenderContext *rc, const SDTexture *texture,
+                                 SDBlendMode blendMode,
+                                 const SDMaterial *material, int numVertex,
+                                 int numIndex,
+                                 DrawTextureVertexAttrib **vertices,
+                                 unsigned int **indices) {
+  SpriteBatch *batch = &rc->batch;
+
+  SDAssert(numVertex <= MAX_BATCH_VERTEX && numIndex <= MAX_BATCH_INDEX);
+
+  // Additive colors come with zero alpha, which the alpha blend state adds
+  if (blendMode == SD_BLEND_MODE_ADDITIVE) {
+    blendMode = SD_BLEND_MODE_ALPHA;
+  }
+
+  if (batch->texture != texture || batch->blendMode != blendMode ||
+      batch->material != material ||
+      batch->numVertex + numVertex > MAX_BATCH_VERTEX ||
+      batch->numIndex + numIndex > MAX_BATCH_INDEX ||
+      (material && batch->numParam + material->numParam > MAX_BATCH_PARAM)) {
+    FlushBatch(rc);
+    batch->texture = texture;
+    batch->blendMode = blendMode;
+    batch->material = material;
+  }
+
+  unsigned int base = (unsigned int)batch->numVertex;
+  *vertices = batch->vertices + batch->numVertex;
+  *indices = batch->indices + batch->numIndex;
+  batch->numVertex += numVertex;
+  batch->numIndex += numIndex;
+
+  return base;
+}
+
+static void ExecuteResetScissor(void *data) { glDisable(GL_SCISSOR_TEST); }
+
+// Back to drawing on the whole canvas in canvas coordinates
+static void ResetCamera(RenderContext *rc) {
+  SDRect canvas = SDRectMinMax(
+      SDZeroVec2(), SDV2(rc->viewportWidth * CTX.pixelToPoint,
+                         rc->viewportHeight * CTX.pixelToPoint));
+
+  rc->camera = SDIdentityM3();
+  rc->viewProjection = rc->projection;
+  rc->cameraViewport = canvas;
+  rc->visibleBounds = canvas;
+
+  BeginCommand(ExecuteResetScissor, 0);
+  CommitCommand();
+  rc->isClipScissorSet = 0;
+}
+
 extern RenderContext *CreateRenderContext(int viewportWidth, int viewportHeight,
                                           float pixelToPoint) {
   float width = viewportWidth * pixelToPoint;
   float height = viewportHeight * pixelToPoint;
 
-  RenderContext *rc = malloc(sizeof(RenderContext));
+#ifdef SD_DEBUG
+  InstallGLCallHooks();
+#endif
+  if (CTX.renderBackend == SD_RENDER_BACKEND_SOFTWARE) {
+    InitSoftwareRasterizer();
+  }
+
+  RenderContext *rc = calloc(1, sizeof(RenderContext));
   rc->numDrawCall = 0;
-  rc->camera = SDIdentityM3();
+  rc->viewportWidth = viewportWidth;
+  rc->viewportHeight = viewportHeight;
   rc->projection = SDDotM3(
       SDMat3Translation(-1.0f, -1.0f),
       SDDotM3(
           SDMat3Scale(1.0f / width * 2.0f, 1.0f / height * 2.0f),
           SDDotM3(SDMat3Translation(0.0f, height), SDMat3Scale(1.0f, -1.0f))));
+  ResetCamera(rc);
 
   glViewport(0, 0, viewportWidth, viewportHeight);
 
@@ -195,10 +500,213 @@ extern RenderContext *CreateRenderContext(int viewportWidth, int viewportHeight,
   glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
   InitDrawTextureProgram(&rc->drawTextureProgram);
+  InitSpriteBatch(&rc->batch);
+  InitBufferArena(&rc->meshArena, InitMeshVertexFormat);
+
+  unsigned char white[4] = {255, 255, 255, 255};
+  rc->whiteTexture =
+      LoadTextureFromMemory(white, 1, 1, 4, SD_IMAGE_FORMAT_RGBA8, 1);
+
+  glGenVertexArrays(1, &rc->fullscreenVAO);
+  rc->windowTarget.width = viewportWidth;
+  rc->windowTarget.height = viewportHeight;
+  rc->windowTarget.internalFormat = GL_SRGB8_ALPHA8;
+
+  InitDynamicResolution(&rc->dynamicResolution, viewportWidth, viewportHeight);
+  InitPostProcess(&rc->postProcess);
+  InitLighting(&rc->lighting);
 
   return rc;
 }
 
+typedef struct BeginFrameCommand {
+  int isLitOrPostProcessed;
+} BeginFrameCommand;
+
+static void ExecuteBeginFrame(void *data) {
+  const BeginFrameCommand *command = data;
+  RenderContext *rc = CTX.rc;
+  DynamicResolution *dr = &rc->dynamicResolution;
+
+  rc->numDrawCall = 0;
+
+  // Whether the timer query runs and the render size stay the same until the
+  // frame ends
+  if (dr->hasPendingParams) {
+    ApplyDynamicResolutionParams(rc, &dr->pendingParams);
+    dr->hasPendingParams = 0;
+  }
+
+  if (dr->enabled) {
+    glBeginQuery(GL_TIME_ELAPSED,
+                 dr->timerQueries[dr->numFrame % TIMER_QUERY_COUNT]);
+  }
+
+  // The scene goes through an offscreen target when it is rendered at lower
+  // resolution, lit or post processed
+  rc->isSceneTargetBound = dr->enabled || command->isLitOrPostProcessed;
+  if (rc->isSceneTargetBound) {
+    if (!rc->sceneTarget.fbo) {
+      CreateRenderTarget(&rc->sceneTarget, rc->viewportWidth,
+                         rc->viewportHeight, GL_SRGB8_ALPHA8);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, rc->sceneTarget.fbo);
+    glViewport(0, 0, dr->renderWidth, dr->renderHeight);
+  }
+
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  if (CTX.renderBackend == SD_RENDER_BACKEND_SOFTWARE) {
+    BeginSoftwareFrame(rc->viewportWidth, rc->viewportHeight);
+  }
+}
+
+extern void BeginRenderFrame(RenderContext *rc) {
+  BeginFrameRecording(rc);
+
+  BeginFrameCommand *command =
+      BeginCommand(ExecuteBeginFrame, sizeof(BeginFrameCommand));
+  command->isLitOrPostProcessed =
+      IsLightingEnabled(rc) || IsPostProcessEnabled(&rc->postProcess.params);
+  CommitCommand();
+}
+
+// Lighting and post processing settings are taken from the time the frame
+// ends, along with the lights drawn in it
+typedef struct EndFrameCommand {
+  FrameResult *result;
+  float cpuFrameTime;
+  SDLightingParams lighting;
+  const LightInstance *lights;
+  int numLight;
+  SDPostProcessParams postProcess;
+#ifdef SD_DEBUG
+  DebugDrawList debugDraw;
+#endif
+} EndFrameCommand;
+
+// Blit the scene to the window when no effect does
+static void ExecuteUpscalePass(RenderContext *rc, const RenderGraph *graph,
+                               const void *data) {
+  DynamicResolution *dr = &rc->dynamicResolution;
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, rc->sceneTarget.fbo);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, rc->windowTarget.fbo);
+  glBlitFramebuffer(0, 0, dr->renderWidth, dr->renderHeight, 0, 0,
+                    rc->viewportWidth, rc->viewportHeight, GL_COLOR_BUFFER_BIT,
+                    GL_LINEAR);
+}
+
+static void ExecuteEndFrame(void *data) {
+  const EndFrameCommand *command = data;
+  RenderContext *rc = CTX.rc;
+  DynamicResolution *dr = &rc->dynamicResolution;
+
+  if (rc->isSceneTargetBound) {
+    RenderGraph *graph = &rc->renderGraph;
+    ResetRenderGraph(graph);
+    int scene = ImportGraphTarget(graph, &rc->sceneTarget);
+    int window = ImportGraphTarget(graph, &rc->windowTarget);
+
+    if (command->lighting.enabled) {
+      AddLightingPasses(rc, graph, &command->lighting, command->lights,
+                        command->numLight, scene, dr->renderWidth,
+                        dr->renderHeight);
+    }
+
+    if (IsPostProcessEnabled(&command->postProcess)) {
+      AddPostProcessPasses(rc, graph, &command->postProcess, scene, window,
+                           dr->renderWidth, dr->renderHeight);
+    } else {
+      RenderPass *pass = AddRenderPass(graph, ExecuteUpscalePass, NULL, 0);
+      ReadGraphTarget(pass, scene);
+      WriteGraphTarget(pass, window);
+    }
+
+    ExecuteRenderGraph(rc, graph);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, rc->viewportWidth, rc->viewportHeight);
+    rc->isSceneTargetBound = 0;
+  }
+
+#ifdef SD_DEBUG
+  ExecuteDebugDraw(rc, &command->debugDraw);
+#endif
+
+  // Captures read what the tiles are rasterized into
+  if (CTX.renderBackend == SD_RENDER_BACKEND_SOFTWARE) {
+    EndSoftwareFrame();
+  }
+
+  ProcessFrameCaptures(rc);
+
+  FrameResult *result = command->result;
+  result->stats.numDrawCall = rc->numDrawCall;
+  result->stats.cpuFrameTime = command->cpuFrameTime;
+  result->resolutionScale = 1.0f;
+#ifdef SD_DEBUG
+  // Reading the GPU timer below is counted in the next frame
+  EndGLCallFrame(&result->glCalls);
+#endif
+  if (CTX.renderBackend == SD_RENDER_BACKEND_RECORDING) {
+    EndNullGLFrame(&result->submittedDraws);
+  }
+
+  if (!dr->enabled) {
+    return;
+  }
+
+  glEndQuery(GL_TIME_ELAPSED);
+  dr->numFrame++;
+
+  // Read the oldest query in the ring, which has most likely finished
+  float gpuFrameTime = dr->gpuFrameTime;
+  if (dr->numFrame >= TIMER_QUERY_COUNT) {
+    GLuint query = dr->timerQueries[dr->numFrame % TIMER_QUERY_COUNT];
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      GLuint64 elapsed = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+      gpuFrameTime = (float)(elapsed * 1e-9);
+    }
+  }
+
+  UpdateResolutionScale(dr, gpuFrameTime, command->cpuFrameTime);
+  ApplyResolutionScale(rc);
+  result->resolutionScale = dr->scale;
+}
+
+extern void EndRenderFrame(RenderContext *rc, float cpuFrameTime) {
+  Lighting *lighting = &rc->lighting;
+
+  EndFrameRecording(rc);
+  FlushBatch(rc);
+  ResetCamera(rc);
+  // Pushes left unpopped do not leak into the next frame
+  rc->state.isClipped = 0;
+  rc->numState = 0;
+
+  EndFrameCommand *command =
+      BeginCommand(ExecuteEndFrame, sizeof(EndFrameCommand));
+  command->result = &rc->frameResults[rc->numFrame % NUM_FRAME_RESULT];
+  command->cpuFrameTime = cpuFrameTime;
+  command->lighting = lighting->params;
+  command->lights = CopyCommandData(
+      lighting->lights, sizeof(LightInstance) * (size_t)lighting->numLight);
+  command->numLight = lighting->numLight;
+  command->postProcess = rc->postProcess.params;
+#ifdef SD_DEBUG
+  RecordDebugDraw(rc, &command->debugDraw);
+#endif
+  CommitCommand();
+
+  lighting->numLight = 0;
+  rc->numFrame++;
+}
+
 // ----------------------------------------------------------------------------
 // Graphics Properties
 // ----------------------------------------------------------------------------
@@ -218,10 +726,548 @@ SDAPI float SDGetPointToPixel(void) { return CTX.pointToPixel; }
 
 SDAPI float SDGetPixelToPoint(void) { return CTX.pixelToPoint; }
 
+extern const FrameResult *GetLastFrameResult(const RenderContext *rc) {
+  static const FrameResult none = {.resolutionScale = 1.0f};
+  int frame = rc->numFrame - 1 - GetFrameLatency();
+  return frame >= 0 ? &rc->frameResults[frame % NUM_FRAME_RESULT] : &none;
+}
+
+SDAPI SDRenderStats SDGetRenderStats(void) {
+  return GetLastFrameResult(CTX.rc)->stats;
+}
+
+SDAPI const SDSubmittedDraw *SDGetSubmittedDraws(int *numDraw) {
+  const SubmittedDraws *draws = &GetLastFrameResult(CTX.rc)->submittedDraws;
+  *numDraw = draws->numDraw;
+  return draws->draws;
+}
+
+// ----------------------------------------------------------------------------
+// Camera
+// ----------------------------------------------------------------------------
+
+SDAPI SDCamera SDMakeCamera(void) {
+  SDVec2 canvasSize = SDV2(SDGetCanvasWidth(), SDGetCanvasHeight());
+  SDCamera camera = {
+      .position = SDV2(canvasSize.x * 0.5f, canvasSize.y * 0.5f),
+      .zoom = 1.0f,
+      .rotation = 0.0f,
+      .viewport = SDRectMinMax(SDZeroVec2(), canvasSize),
+      .view = SDIdentityM3(),
+      .viewProjection = SDIdentityM3(),
+      .visibleBounds = SDZeroRect(),
+  };
+  return camera;
+}
+
+typedef struct SetScissorCommand {
+  SDRect viewport;
+} SetScissorCommand;
+
+static void ExecuteSetScissor(void *data) {
+  const SetScissorCommand *command = data;
+  RenderContext *rc = CTX.rc;
+  DynamicResolution *dr = &rc->dynamicResolution;
+  SDRect viewport = command->viewport;
+
+  // Clip to the viewport in render target pixels, which start at the bottom
+  float scale = CTX.pointToPixel * dr->renderWidth / rc->viewportWidth;
+  int minX = (int)SDFloorF(viewport.min.x * scale + 0.5f);
+  int maxX = (int)SDFloorF(viewport.max.x * scale + 0.5f);
+  int minY = (int)SDFloorF(viewport.min.y * scale + 0.5f);
+  int maxY = (int)SDFloorF(viewport.max.y * scale + 0.5f);
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(minX, dr->renderHeight - maxY, maxX > minX ? maxX - minX : 0,
+            maxY > minY ? maxY - minY : 0);
+}
+
+SDAPI void SDBeginCamera(SDCamera *camera) {
+  RenderContext *rc = CTX.rc;
+  SDRect viewport = camera->viewport;
+
+  if (rc->recorder) {
+    RecordCall(rc->recorder, RECORD_BEGIN_CAMERA, camera, sizeof(*camera));
+  }
+
+  FlushBatch(rc);
+
+  SDVec2 center = SDV2((viewport.min.x + viewport.max.x) * 0.5f,
+                       (viewport.min.y + viewport.max.y) * 0.5f);
+  camera->view = SDDotM3(
+      SDMat3Translation(center.x, center.y),
+      SDDotM3(SDMat3Scale(camera->zoom, camera->zoom),
+              SDDotM3(SDMat3Rotation(-camera->rotation),
+                      SDMat3Translation(-camera->position.x,
+                                        -camera->position.y))));
+  camera->viewProjection = SDDotM3(rc->projection, camera->view);
+  camera->visibleBounds =
+      SDTransformRectM3(SDInverseM3(camera->view), viewport);
+
+  rc->camera = camera->view;
+  rc->viewProjection = camera->viewProjection;
+  rc->cameraViewport = viewport;
+  rc->visibleBounds = camera->visibleBounds;
+
+  SetScissorCommand *command =
+      BeginCommand(ExecuteSetScissor, sizeof(SetScissorCommand));
+  command->viewport = viewport;
+  CommitCommand();
+  rc->isClipScissorSet = 0;
+}
+
+SDAPI void SDEndCamera(void) {
+  RenderContext *rc = CTX.rc;
+
+  if (rc->recorder) {
+    RecordCall(rc->recorder, RECORD_END_CAMERA, NULL, 0);
+  }
+
+  FlushBatch(rc);
+  ResetCamera(rc);
+}
+
+// ----------------------------------------------------------------------------
+// Render State
+// ----------------------------------------------------------------------------
+
+static SDRect IntersectRect(SDRect a, SDRect b) {
+  return SDRectMinMax(
+      SDV2(SDMaxF(a.min.x, b.min.x), SDMaxF(a.min.y, b.min.y)),
+      SDV2(SDMinF(a.max.x, b.max.x), SDMinF(a.max.y, b.max.y)));
+}
+
+static int IsRectEmpty(SDRect rect) {
+  return rect.max.x <= rect.min.x || rect.max.y <= rect.min.y;
+}
+
+static int ContainsRect(SDRect outer, SDRect inner) {
+  return inner.min.x >= outer.min.x && inner.min.y >= outer.min.y &&
+         inner.max.x <= outer.max.x && inner.max.y <= outer.max.y;
+}
+
+extern void ApplyClipScissor(RenderContext *rc) {
+  if (!rc->state.isClipped || rc->isClipScissorSet) {
+    return;
+  }
+
+  FlushBatch(rc);
+
+  SetScissorCommand *command =
+      BeginCommand(ExecuteSetScissor, sizeof(SetScissorCommand));
+  command->viewport = IntersectRect(rc->state.clipRect, rc->cameraViewport);
+  CommitCommand();
+  rc->isClipScissorSet = 1;
+}
+
+// Back to the scissor of the camera, before the clip rect changes
+static void RestoreScissor(RenderContext *rc) {
+  if (!rc->isClipScissorSet) {
+    return;
+  }
+
+  FlushBatch(rc);
+
+  SetScissorCommand *command =
+      BeginCommand(ExecuteSetScissor, sizeof(SetScissorCommand));
+  command->viewport = rc->cameraViewport;
+  CommitCommand();
+  rc->isClipScissorSet = 0;
+}
+
+extern int ClipBounds(RenderContext *rc, SDRect bounds) {
+  if (!rc->state.isClipped) {
+    return 1;
+  }
+
+  SDRect canvasBounds = SDTransformRectM3(rc->camera, bounds);
+  SDRect clipRect = rc->state.clipRect;
+  if (IsRectEmpty(IntersectRect(canvasBounds, clipRect))) {
+    return 0;
+  }
+
+  if (!ContainsRect(clipRect, canvasBounds)) {
+    ApplyClipScissor(rc);
+  }
+  return 1;
+}
+
+// Trim a quad to the clip rect on the CPU, cutting the texture coordinates at
+// the same fractions, so clipped quads stay in the batch. Only quads which are
+// axis aligned on the canvas can be trimmed, the others fall back to scissor.
+// Returns 0 if nothing of the quad is left.
+static int ClipQuad(RenderContext *rc, const SDMat3 *transform,
+                    SDRect *dstRect, SDRect *texRect) {
+  if (!rc->state.isClipped) {
+    return 1;
+  }
+
+  SDMat3 m = SDDotM3(rc->camera, *transform);
+  if (m.m10 != 0.0f || m.m01 != 0.0f || m.m00 == 0.0f || m.m11 == 0.0f) {
+    return ClipBounds(rc, SDTransformRectM3(*transform, *dstRect));
+  }
+
+  // Clip rect brought back to the space of dstRect
+  SDRect clipRect = rc->state.clipRect;
+  SDFloat x0 = (clipRect.min.x - m.m02) / m.m00;
+  SDFloat x1 = (clipRect.max.x - m.m02) / m.m00;
+  SDFloat y0 = (clipRect.min.y - m.m12) / m.m11;
+  SDFloat y1 = (clipRect.max.y - m.m12) / m.m11;
+  SDRect local = SDRectMinMax(SDV2(SDMinF(x0, x1), SDMinF(y0, y1)),
+                              SDV2(SDMaxF(x0, x1), SDMaxF(y0, y1)));
+
+  SDRect dst = *dstRect;
+  SDRect clipped = IntersectRect(dst, local);
+  if (IsRectEmpty(clipped)) {
+    return 0;
+  }
+
+  // Each side is moved from its own end so untouched sides stay exact
+  SDRect tex = *texRect;
+  SDVec2 scale = SDV2((tex.max.x - tex.min.x) / (dst.max.x - dst.min.x),
+                      (tex.max.y - tex.min.y) / (dst.max.y - dst.min.y));
+  texRect->min.x = tex.min.x + (clipped.min.x - dst.min.x) * scale.x;
+  texRect->min.y = tex.min.y + (clipped.min.y - dst.min.y) * scale.y;
+  texRect->max.x = tex.max.x - (dst.max.x - clipped.max.x) * scale.x;
+  texRect->max.y = tex.max.y - (dst.max.y - clipped.max.y) * scale.y;
+  *dstRect = clipped;
+  return 1;
+}
+
+static void PushState(RenderContext *rc) {
+  if (rc->numState == MAX_RENDER_STATE) {
+    printf("Too many render states pushed\n");
+    exit(EXIT_FAILURE);
+  }
+
+  rc->stateStack[rc->numState++] = rc->state;
+}
+
+SDAPI void SDPushState(void) {
+  RenderContext *rc = CTX.rc;
+
+  if (rc->recorder) {
+    RecordCall(rc->recorder, RECORD_PUSH_STATE, NULL, 0);
+  }
+
+  PushState(rc);
+}
+
+SDAPI void SDPopState(void) {
+  RenderContext *rc = CTX.rc;
+
+  if (rc->recorder) {
+    RecordCall(rc->recorder, RECORD_POP_STATE, NULL, 0);
+  }
+
+  SDAssert(rc->numState > 0);
+  if (rc->numState == 0) {
+    return;
+  }
+
+  RestoreScissor(rc);
+  rc->state = rc->stateStack[--rc->numState];
+}
+
+SDAPI void SDPushClipRect(SDRect rect) {
+  RenderContext *rc = CTX.rc;
+
+  if (rc->recorder) {
+    RecordCall(rc->recorder, RECORD_PUSH_CLIP_RECT, &rect, sizeof(rect));
+  }
+
+  PushState(rc);
+  RestoreScissor(rc);
+
+  SDRect clipRect = SDTransformRectM3(rc->camera, rect);
+  if (rc->state.isClipped) {
+    clipRect = IntersectRect(rc->state.clipRect, clipRect);
+  }
+  rc->state.isClipped = 1;
+  rc->state.clipRect = clipRect;
+}
+
+SDAPI void SDPopClipRect(void) { SDPopState(); }
+
+// ----------------------------------------------------------------------------
+// Buffer Arena
+// ----------------------------------------------------------------------------
+
+extern void InitBufferArena(BufferArena *arena,
+                            InitVertexFormatFunc initVertexFormat) {
+  arena->initVertexFormat = initVertexFormat;
+  arena->numBlock = 0;
+}
+
+static void ExecuteCreateBufferBlock(void *data) {
+  BufferBlock *block = *(BufferBlock **)data;
+
+  glGenBuffers(1, &block->buffer);
+  glGenVertexArrays(1, &block->vao);
+
+  glBindVertexArray(block->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, block->buffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, block->buffer);
+  glBufferData(GL_ARRAY_BUFFER, block->size, NULL, GL_DYNAMIC_DRAW);
+  block->initVertexFormat();
+  glBindVertexArray(0);
+}
+
+static void InsertFreeRange(BufferBlock *block, int index, size_t offset,
+                            size_t size) {
+  if (block->numFreeRange == block->freeRangeCapacity) {
+    block->freeRangeCapacity *= 2;
+    block->freeRanges =
+        realloc(block->freeRanges,
+                (size_t)block->freeRangeCapacity * sizeof(FreeRange));
+  }
+
+  memmove(block->freeRanges + index + 1, block->freeRanges + index,
+          (size_t)(block->numFreeRange - index) * sizeof(FreeRange));
+  block->freeRanges[index] = (FreeRange){offset, size};
+  block->numFreeRange++;
+}
+
+static void RemoveFreeRange(BufferBlock *block, int index) {
+  memmove(block->freeRanges + index, block->freeRanges + index + 1,
+          (size_t)(block->numFreeRange - index - 1) * sizeof(FreeRange));
+  block->numFreeRange--;
+}
+
+static BufferBlock *CreateBufferBlock(BufferArena *arena, size_t size) {
+  if (arena->numBlock == MAX_BUFFER_BLOCK) {
+    printf("Too many buffer blocks\n");
+    exit(EXIT_FAILURE);
+  }
+
+  BufferBlock *block = malloc(sizeof(BufferBlock));
+  block->initVertexFormat = arena->initVertexFormat;
+  block->size = size;
+  block->freeRangeCapacity = 16;
+  block->freeRanges = malloc(block->freeRangeCapacity * sizeof(FreeRange));
+  block->freeRanges[0] = (FreeRange){0, size};
+  block->numFreeRange = 1;
+  block->buffer = 0;
+  block->vao = 0;
+  arena->blocks[arena->numBlock++] = block;
+
+  BufferBlock **command =
+      BeginCommand(ExecuteCreateBufferBlock, sizeof(BufferBlock *));
+  *command = block;
+  CommitCommand();
+
+  return block;
+}
+
+// First fit, the padding before the aligned start stays free
+static int AllocFromBlock(BufferBlock *block, size_t size, size_t alignment,
+                          size_t *offset) {
+  for (int i = 0; i < block->numFreeRange; ++i) {
+    FreeRange *range = &block->freeRanges[i];
+    size_t start = (range->offset + alignment - 1) / alignment * alignment;
+    size_t end = range->offset + range->size;
+    if (start + size > end) {
+      continue;
+    }
+
+    size_t padding = start - range->offset;
+    size_t rest = end - (start + size);
+    if (padding > 0) {
+      range->size = padding;
+      if (rest > 0) {
+        InsertFreeRange(block, i + 1, start + size, rest);
+      }
+    } else if (rest > 0) {
+      range->offset = start + size;
+      range->size = rest;
+    } else {
+      RemoveFreeRange(block, i);
+    }
+
+    *offset = start;
+    return 1;
+  }
+  return 0;
+}
+
+extern BufferRange AllocBufferRange(BufferArena *arena, size_t size,
+                                    size_t alignment) {
+  BufferRange range = {NULL, 0, size};
+
+  for (int i = 0; i < arena->numBlock; ++i) {
+    if (AllocFromBlock(arena->blocks[i], size, alignment, &range.offset)) {
+      range.block = arena->blocks[i];
+      return range;
+    }
+  }
+
+  size_t blockSize = size > BUFFER_BLOCK_SIZE ? size : BUFFER_BLOCK_SIZE;
+  range.block = CreateBufferBlock(arena, blockSize);
+  AllocFromBlock(range.block, size, alignment, &range.offset);
+  return range;
+}
+
+extern void FreeBufferRange(BufferRange range) {
+  BufferBlock *block = range.block;
+  if (!block) {
+    return;
+  }
+
+  int index = 0;
+  while (index < block->numFreeRange &&
+         block->freeRanges[index].offset < range.offset) {
+    index++;
+  }
+
+  // Merge with the free neighbours
+  FreeRange *prev = index > 0 ? &block->freeRanges[index - 1] : NULL;
+  FreeRange *next =
+      index < block->numFreeRange ? &block->freeRanges[index] : NULL;
+  int isPrevAdjacent = prev && prev->offset + prev->size == range.offset;
+  int isNextAdjacent = next && range.offset + range.size == next->offset;
+
+  if (isPrevAdjacent && isNextAdjacent) {
+    prev->size += range.size + next->size;
+    RemoveFreeRange(block, index);
+  } else if (isPrevAdjacent) {
+    prev->size += range.size;
+  } else if (isNextAdjacent) {
+    next->offset = range.offset;
+    next->size += range.size;
+  } else {
+    InsertFreeRange(block, index, range.offset, range.size);
+  }
+}
+
+typedef struct UploadBufferRangeCommand {
+  const BufferBlock *block;
+  size_t offset;  // in the block
+  size_t size;
+  const void *data;
+} UploadBufferRangeCommand;
+
+static void ExecuteUploadBufferRange(void *data) {
+  const UploadBufferRangeCommand *command = data;
+
+  // Not the element buffer target, which belongs to the bound VAO
+  glBindBuffer(GL_COPY_WRITE_BUFFER, command->block->buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, command->offset, command->size,
+                  command->data);
+}
+
+extern void UploadBufferRange(BufferRange range, size_t offset,
+                              const void *data, size_t size) {
+  SDAssert(offset + size <= range.size);
+
+  UploadBufferRangeCommand *command = BeginCommand(
+      ExecuteUploadBufferRange, sizeof(UploadBufferRangeCommand));
+  command->block = range.block;
+  command->offset = range.offset + offset;
+  command->size = size;
+  command->data = CopyCommandData(data, size);
+  CommitCommand();
+}
+
+// ----------------------------------------------------------------------------
+// Dynamic Resolution
+// ----------------------------------------------------------------------------
+
+SDAPI SDDynamicResolutionParams SDMakeDynamicResolutionParams(void) {
+  SDDynamicResolutionParams params = {
+      .enabled = 1,
+      .targetFrameTime = 1.0f / 60.0f,
+      .minScale = 0.5f,
+      .maxScale = 1.0f,
+  };
+  return params;
+}
+
+// The scale is adjusted on the render thread, so settings are applied there
+static void ExecuteSetDynamicResolution(void *data) {
+  DynamicResolution *dr = &CTX.rc->dynamicResolution;
+
+  dr->pendingParams = *(const SDDynamicResolutionParams *)data;
+  dr->hasPendingParams = 1;
+}
+
+SDAPI void SDSetDynamicResolution(const SDDynamicResolutionParams *params) {
+  SDDynamicResolutionParams *command = BeginCommand(
+      ExecuteSetDynamicResolution, sizeof(SDDynamicResolutionParams));
+  *command = *params;
+  CommitCommand();
+}
+
+SDAPI SDFloat SDGetResolutionScale(void) {
+  return GetLastFrameResult(CTX.rc)->resolutionScale;
+}
+
 // ----------------------------------------------------------------------------
 // Image
 // ----------------------------------------------------------------------------
 
+// Pre-multiplied value of each sRGB encoded channel for each alpha, computed in
+// linear space so the result matches blending in an sRGB framebuffer
+static unsigned char PREMULTIPLY_TABLE[256][256];
+
+static void InitPremultiplyTable(void) {
+  for (int c = 0; c < 256; ++c) {
+    float srgb = c / 255.0f;
+    float linear = srgb <= 0.04045f ? srgb / 12.92f
+                                    : powf((srgb + 0.055f) / 1.055f, 2.4f);
+
+    for (int a = 0; a < 256; ++a) {
+      float v = linear * (a / 255.0f);
+      v = v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+      PREMULTIPLY_TABLE[a][c] = (unsigned char)(v * 255.0f + 0.5f);
+    }
+  }
+}
+
+static void PremultiplyPixel(unsigned char *dst, const unsigned char *src) {
+  const unsigned char *table = PREMULTIPLY_TABLE[src[3]];
+  dst[0] = table[src[0]];
+  dst[1] = table[src[1]];
+  dst[2] = table[src[2]];
+  dst[3] = src[3];
+}
+
+// Pre-multiply numPixel RGBA8 pixels, dst may be src. Most pixels of sprites
+// are either opaque or fully transparent, groups of 4 of those are copied or
+// cleared without going through the table.
+static void PremultiplyRow(unsigned char *dst, const unsigned char *src,
+                           int numPixel) {
+  static int isTableReady = 0;
+  if (!isTableReady) {
+    InitPremultiplyTable();
+    isTableReady = 1;
+  }
+
+  int i = 0;
+
+#ifdef SD_SSE2
+  __m128i alphaMask = _mm_set1_epi32((int)0xFF000000);
+  __m128i zero = _mm_setzero_si128();
+
+  for (; i + 4 <= numPixel; i += 4) {
+    __m128i pixels = _mm_loadu_si128((const __m128i *)(src + i * 4));
+    __m128i alpha = _mm_and_si128(pixels, alphaMask);
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) == 0xFFFF) {
+      _mm_storeu_si128((__m128i *)(dst + i * 4), pixels);
+    } else if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xFFFF) {
+      _mm_storeu_si128((__m128i *)(dst + i * 4), zero);
+    } else {
+      for (int j = i; j < i + 4; ++j) {
+        PremultiplyPixel(dst + j * 4, src + j * 4);
+      }
+    }
+  }
+#endif
+
+  for (; i < numPixel; ++i) {
+    PremultiplyPixel(dst + i * 4, src + i * 4);
+  }
+}
+
 SDAPI SDImage *SDLoadImage(const char *path) {
   SDImage *image = malloc(sizeof(SDImage));
 
@@ -234,12 +1280,20 @@ SDAPI SDImage *SDLoadImage(const char *path) {
   image->stride = 4 * image->width;
   image->format = SD_IMAGE_FORMAT_RGBA8;
 
+  unsigned char *row = image->data;
+  for (int y = 0; y < image->height; ++y) {
+    PremultiplyRow(row, row, image->width);
+    row += image->stride;
+  }
+  image->isPremultiplied = 1;
+
   return image;
 }
 
 SDAPI void SDDestroyImage(SDImage **ptr) {
   SDImage *image = *ptr;
   stbi_image_free(image->data);
+  free(image);
 
   *ptr = NULL;
 }
@@ -248,22 +1302,55 @@ SDAPI void SDDestroyImage(SDImage **ptr) {
 // Texture
 // ----------------------------------------------------------------------------
 
-struct SDTexture {
-  GLuint id;
-  int actualWidth;
-  int actualHeight;
-  int width;
-  int height;
-};
+typedef struct CreateTextureCommand {
+  SDTexture *texture;
+  GLint internalFormat;
+  GLenum format;
+  GLint rowLength;  // in pixel
+  const unsigned char *pixels;
+} CreateTextureCommand;
+
+static void ExecuteCreateTexture(void *data) {
+  const CreateTextureCommand *command = data;
+  SDTexture *texture = command->texture;
+
+  glGenTextures(1, &texture->id);
+  glBindTexture(GL_TEXTURE_2D, texture->id);
+
+  if (command->format == GL_RED) {
+    // Pre-multiplied white
+    GLint swizzleMask[] = {GL_RED, GL_RED, GL_RED, GL_RED};
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzleMask);
+  }
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, command->rowLength);
+  glTexImage2D(GL_TEXTURE_2D, 0, command->internalFormat,
+               texture->actualWidth, texture->actualHeight, 0,
+               command->format, GL_UNSIGNED_BYTE, command->pixels);
+
+  if (CTX.renderBackend == SD_RENDER_BACKEND_SOFTWARE) {
+    CreateSoftwareTexture(texture, command->pixels,
+                          command->rowLength *
+                              (command->format == GL_RED ? 1 : 4));
+  }
+}
 
 static SDTexture *LoadTextureFromMemory(const void *data, int width, int height,
-                                        int stride, int format) {
+                                        int stride, int format,
+                                        int isPremultiplied) {
   SDTexture *texture = malloc(sizeof(SDTexture));
+  texture->id = 0;
+  texture->format = format;
   texture->width = width;
   texture->height = height;
-
-  glGenTextures(1, &texture->id);
-  glBindTexture(GL_TEXTURE_2D, texture->id);
+  texture->nineSlice.isValid = 0;
+  texture->texels = NULL;
+  texture->texelStride = 0;
 
   texture->actualWidth = (int)SDNextPow2F((float)width);
   texture->actualHeight = height;
@@ -288,9 +1375,6 @@ static SDTexture *LoadTextureFromMemory(const void *data, int width, int height,
 
       internalFormat = GL_R8;
       glFormat = GL_RED;
-
-      GLint swizzleMask[] = {GL_ONE, GL_ONE, GL_ONE, GL_RED};
-      glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzleMask);
     } break;
   }
 
@@ -306,25 +1390,35 @@ static SDTexture *LoadTextureFromMemory(const void *data, int width, int height,
   const unsigned char *srcRow = data;
 
   for (int y = 0; y < height; ++y) {
-    memcpy(dstRow, srcRow, (size_t)stride);
+    if (format == SD_IMAGE_FORMAT_RGBA8 && !isPremultiplied) {
+      PremultiplyRow(dstRow, srcRow, width);
+    } else {
+      memcpy(dstRow, srcRow, (size_t)stride);
+    }
     dstRow += texStride;
     srcRow += stride;
   }
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-  glPixelStorei(GL_UNPACK_ROW_LENGTH, numberOfPixels);
-  glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, texture->actualWidth,
-               texture->actualHeight, 0, glFormat, GL_UNSIGNED_BYTE, texBuf);
+  CreateTextureCommand *command =
+      BeginCommand(ExecuteCreateTexture, sizeof(CreateTextureCommand));
+  command->texture = texture;
+  command->internalFormat = internalFormat;
+  command->format = glFormat;
+  command->rowLength = numberOfPixels;
+  command->pixels = CopyCommandData(texBuf, texBufLen);
+  CommitCommand();
 
   free(texBuf);
 
   return texture;
 }
 
+SDAPI SDTexture *SDLoadTextureFromImage(const SDImage *image) {
+  return LoadTextureFromMemory(image->data, image->width, image->height,
+                               image->stride, image->format,
+                               image->isPremultiplied);
+}
+
 SDAPI SDTexture *SDLoadTexture(const char *path) {
   SDImage *image = SDLoadImage(path);
 
@@ -332,20 +1426,29 @@ SDAPI SDTexture *SDLoadTexture(const char *path) {
     return NULL;
   }
 
-  SDTexture *texture = LoadTextureFromMemory(
-      image->data, image->width, image->height, image->stride, image->format);
+  SDTexture *texture =
+      LoadTextureFromMemory(image->data, image->width, image->height,
+                            image->stride, image->format, 1);
 
   SDDestroyImage(&image);
 
   return texture;
 }
 
-SDAPI void SDDestroyTexture(SDTexture **ptr) {
-  SDTexture *texture = *ptr;
+static void ExecuteDestroyTexture(void *data) {
+  SDTexture *texture = *(SDTexture **)data;
 
   glDeleteTextures(1, &texture->id);
 
+  free(texture->texels);
   free(texture);
+}
+
+SDAPI void SDDestroyTexture(SDTexture **ptr) {
+  SDTexture **command =
+      BeginCommand(ExecuteDestroyTexture, sizeof(SDTexture *));
+  *command = *ptr;
+  CommitCommand();
 
   *ptr = NULL;
 }
@@ -361,10 +1464,81 @@ SDAPI SDDrawTextureParams SDMakeDrawTextureParams(SDTexture *texture) {
       .srcRect = SDRectMinMax(SDV2(0.0f, 0.0f), SDV2((SDFloat)texture->width,
                                                      (SDFloat)texture->height)),
       .tintColor = SDRGBA(1.0f, 1.0f, 1.0f, 1.0f),
+      .blendMode = SD_BLEND_MODE_ALPHA,
   };
   return params;
 }
 
+// Write a quad with one transform for all four vertices, returns the vertices
+// after it
+static DrawTextureVertexAttrib *WriteQuad(DrawTextureVertexAttrib *v,
+                                          const SDMat3 *transform,
+                                          SDRect dstRect, SDRect texRect,
+                                          SDColor color) {
+  // top right, bottom right, bottom left, top left
+  SDVec2 pos[4] = {dstRect.max, SDV2(dstRect.max.x, dstRect.min.y),
+                   dstRect.min, SDV2(dstRect.min.x, dstRect.max.y)};
+  SDVec2 texCoord[4] = {texRect.max, SDV2(texRect.max.x, texRect.min.y),
+                        texRect.min, SDV2(texRect.min.x, texRect.max.y)};
+
+  const float *m = (const float *)transform;
+
+  for (int i = 0; i < 4; ++i) {
+    memcpy(v->transform0, m, sizeof(v->transform0));
+    memcpy(v->transform1, m + 3, sizeof(v->transform1));
+    memcpy(v->transform2, m + 6, sizeof(v->transform2));
+    v->pos[0] = pos[i].x;
+    v->pos[1] = pos[i].y;
+    v->texCoord[0] = texCoord[i].x;
+    v->texCoord[1] = texCoord[i].y;
+    v->color[0] = color.r;
+    v->color[1] = color.g;
+    v->color[2] = color.b;
+    v->color[3] = color.a;
+    v->paramOffset = 0;
+    ++v;
+  }
+
+  return v;
+}
+
+static void WriteQuadIndices(unsigned int *indices, unsigned int base,
+                             int numQuad) {
+  for (int i = 0; i < numQuad; ++i) {
+    unsigned int *quad = indices + i * 6;
+    // first triangle
+    quad[0] = base;
+    quad[1] = base + 1;
+    quad[2] = base + 3;
+    // second triangle
+    quad[3] = base + 1;
+    quad[4] = base + 2;
+    quad[5] = base + 3;
+    base += 4;
+  }
+}
+
+// Append the material parameters of a draw to the batch unless the last draw
+// had the same, returns the offset of the first in vec4
+static int AddBatchParams(SpriteBatch *batch, const SDFloat *params,
+                          int numParam) {
+  size_t size = (size_t)numParam * 4 * sizeof(SDFloat);
+  int last = batch->numParam - numParam;
+
+  if (numParam == 0) {
+    return 0;
+  }
+
+  if (last >= 0 && memcmp(batch->params + last * 4, params, size) == 0) {
+    return last;
+  }
+
+  int offset = batch->numParam;
+  memcpy(batch->params + offset * 4, params, size);
+  batch->numParam += numParam;
+  return offset;
+}
+
 SDAPI void SDDrawTexture(const SDDrawTextureParams *params) {
   RenderContext *rc = CTX.rc;
   SDTexture *texture = params->texture;
@@ -373,110 +1547,157 @@ SDAPI void SDDrawTexture(const SDDrawTextureParams *params) {
     return;
   }
 
+  if (rc->recorder) {
+    RecordTextureDraw(rc->recorder, params);
+  }
+
   SDVec2 texSize =
       SDV2((SDFloat)texture->actualWidth, (SDFloat)texture->actualHeight);
   SDRect texRect = SDRectMinMax(SDHadamardDivV2(params->srcRect.min, texSize),
                                 SDHadamardDivV2(params->srcRect.max, texSize));
-  const float *m = (const float *)&params->transform;
-  DrawTextureVertexAttrib vertices[] = {
-      // top right
-      m[0],
-      m[1],
-      m[2],
-      m[3],
-      m[4],
-      m[5],
-      m[6],
-      m[7],
-      m[8],
-      params->dstRect.max.x,
-      params->dstRect.max.y,
-      texRect.max.x,
-      texRect.max.y,
-      params->tintColor.r,
-      params->tintColor.g,
-      params->tintColor.b,
-      params->tintColor.a,
-      // bottom right
-      m[0],
-      m[1],
-      m[2],
-      m[3],
-      m[4],
-      m[5],
-      m[6],
-      m[7],
-      m[8],
-      params->dstRect.max.x,
-      params->dstRect.min.y,
-      texRect.max.x,
-      texRect.min.y,
-      params->tintColor.r,
-      params->tintColor.g,
-      params->tintColor.b,
-      params->tintColor.a,
-      // bottom left
-      m[0],
-      m[1],
-      m[2],
-      m[3],
-      m[4],
-      m[5],
-      m[6],
-      m[7],
-      m[8],
-      params->dstRect.min.x,
-      params->dstRect.min.y,
-      texRect.min.x,
-      texRect.min.y,
-      params->tintColor.r,
-      params->tintColor.g,
-      params->tintColor.b,
-      params->tintColor.a,
-      // top left
-      m[0],
-      m[1],
-      m[2],
-      m[3],
-      m[4],
-      m[5],
-      m[6],
-      m[7],
-      m[8],
-      params->dstRect.min.x,
-      params->dstRect.max.y,
-      texRect.min.x,
-      texRect.max.y,
-      params->tintColor.r,
-      params->tintColor.g,
-      params->tintColor.b,
-      params->tintColor.a,
-  };
+  SDRect dstRect = params->dstRect;
 
-  unsigned int indices[] = {
-      // note that we start from 0!
-      0, 1, 3,  // first triangle
-      1, 2, 3,  // second triangle
-  };
+  if (!ClipQuad(rc, &params->transform, &dstRect, &texRect)) {
+    return;
+  }
 
-  glBindBuffer(GL_ARRAY_BUFFER, rc->drawTextureProgram.vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STREAM_DRAW);
+  // Pre-multiplied colors with zero alpha leave the destination as is and
+  // add to it
+  SDColor color = params->tintColor;
+  if (params->blendMode == SD_BLEND_MODE_ADDITIVE) {
+    color = SDRGBA(color.r * color.a, color.g * color.a, color.b * color.a,
+                   0.0f);
+  }
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rc->drawTextureProgram.ebo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
-               GL_STREAM_DRAW);
+  DrawTextureVertexAttrib *vertices;
+  unsigned int *indices;
+  const SDMaterial *material = params->material;
+  unsigned int base = ReserveBatch(rc, texture, params->blendMode, material, 4,
+                                   6, &vertices, &indices);
+
+  WriteQuad(vertices, &params->transform, dstRect, texRect, color);
+  if (material) {
+    int paramOffset = AddBatchParams(&rc->batch, params->materialParams,
+                                     material->numParam);
+    for (int i = 0; i < 4; ++i) {
+      vertices[i].paramOffset = paramOffset;
+    }
+  }
+  WriteQuadIndices(indices, base, 1);
+}
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texture->id);
+// Compute the normalized slice lines of texture for insets unless cached
+static void UpdateNineSliceCache(SDTexture *texture, SDInsets insets) {
+  NineSliceCache *cache = &texture->nineSlice;
 
-  glUseProgram(rc->drawTextureProgram.program);
-  SDMat3 MVP = SDDotM3(rc->projection, rc->camera);
-  glUniformMatrix3fv(rc->drawTextureProgram.MVPLocation, 1, GL_FALSE,
-                     (const GLfloat *)&MVP);
+  if (cache->isValid && cache->insets.left == insets.left &&
+      cache->insets.top == insets.top && cache->insets.right == insets.right &&
+      cache->insets.bottom == insets.bottom) {
+    return;
+  }
 
-  glBindVertexArray(rc->drawTextureProgram.vao);
+  SDFloat invWidth = 1.0f / texture->actualWidth;
+  SDFloat invHeight = 1.0f / texture->actualHeight;
+
+  cache->insets = insets;
+  cache->u[0] = 0.0f;
+  cache->u[1] = insets.left * invWidth;
+  cache->u[2] = (texture->width - insets.right) * invWidth;
+  cache->u[3] = texture->width * invWidth;
+  cache->v[0] = 0.0f;
+  cache->v[1] = insets.top * invHeight;
+  cache->v[2] = (texture->height - insets.bottom) * invHeight;
+  cache->v[3] = texture->height * invHeight;
+  cache->isValid = 1;
+}
 
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+SDAPI void SDDrawNineSlice(SDTexture *texture, SDInsets insets, SDRect dstRect,
+                           SDMat3 transform, SDColor tintColor) {
+  RenderContext *rc = CTX.rc;
 
-  rc->numDrawCall++;
+  if (!texture) {
+    return;
+  }
+
+  if (rc->recorder) {
+    RecordNineSliceDraw(rc->recorder, texture, insets, dstRect, transform,
+                        tintColor);
+  }
+
+  UpdateNineSliceCache(texture, insets);
+  const NineSliceCache *cache = &texture->nineSlice;
+
+  // Insets are in pixel, the destination is in point. Shrink them
+  // proportionally if the destination is too small to hold both sides.
+  SDFloat pixelToPoint = SDGetPixelToPoint();
+  SDFloat dstWidth = dstRect.max.x - dstRect.min.x;
+  SDFloat dstHeight = dstRect.max.y - dstRect.min.y;
+  SDFloat left = insets.left * pixelToPoint;
+  SDFloat right = insets.right * pixelToPoint;
+  SDFloat top = insets.top * pixelToPoint;
+  SDFloat bottom = insets.bottom * pixelToPoint;
+  if (left + right > dstWidth) {
+    SDFloat scale = dstWidth / (left + right);
+    left *= scale;
+    right *= scale;
+  }
+  if (top + bottom > dstHeight) {
+    SDFloat scale = dstHeight / (top + bottom);
+    top *= scale;
+    bottom *= scale;
+  }
+
+  SDFloat x[4] = {dstRect.min.x, dstRect.min.x + left, dstRect.max.x - right,
+                  dstRect.max.x};
+  SDFloat y[4] = {dstRect.min.y, dstRect.min.y + top, dstRect.max.y - bottom,
+                  dstRect.max.y};
+
+  // Skip rows and columns with no area, e.g. when an inset is zero
+  int columns[3];
+  int rows[3];
+  int numColumn = 0;
+  int numRow = 0;
+  for (int i = 0; i < 3; ++i) {
+    if (x[i + 1] > x[i]) {
+      columns[numColumn++] = i;
+    }
+    if (y[i + 1] > y[i]) {
+      rows[numRow++] = i;
+    }
+  }
+
+  // Slices left after clipping
+  SDRect dstRects[9];
+  SDRect texRects[9];
+  int numQuad = 0;
+  for (int r = 0; r < numRow; ++r) {
+    int row = rows[r];
+    for (int c = 0; c < numColumn; ++c) {
+      int column = columns[c];
+      dstRects[numQuad] = SDRectMinMax(SDV2(x[column], y[row]),
+                                       SDV2(x[column + 1], y[row + 1]));
+      texRects[numQuad] =
+          SDRectMinMax(SDV2(cache->u[column], cache->v[row]),
+                       SDV2(cache->u[column + 1], cache->v[row + 1]));
+      if (ClipQuad(rc, &transform, &dstRects[numQuad], &texRects[numQuad])) {
+        numQuad++;
+      }
+    }
+  }
+
+  if (numQuad == 0) {
+    return;
+  }
+
+  DrawTextureVertexAttrib *vertices;
+  unsigned int *indices;
+  unsigned int base =
+      ReserveBatch(rc, texture, SD_BLEND_MODE_ALPHA, NULL, numQuad * 4,
+                   numQuad * 6, &vertices, &indices);
+
+  for (int i = 0; i < numQuad; ++i) {
+    vertices =
+        WriteQuad(vertices, &transform, dstRects[i], texRects[i], tintColor);
+  }
+  WriteQuadIndices(indices, base, numQuad);
 }
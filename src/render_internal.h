@@ -0,0 +1,657 @@
+#ifndef SD_RENDER_INTERNAL_H
+#define SD_RENDER_INTERNAL_H
+
+#include <glad/glad.h>
+
+#include "context.h"
+#include "sword/debug.h"
+#include "sword/light.h"
+#include "sword/mesh.h"
+#include "sword/render.h"
+
+typedef struct DrawTextureProgram {
+  GLuint vao;
+  GLuint vbo;
+  GLuint ebo;
+  GLuint program;
+  GLint MVPLocation;
+} DrawTextureProgram;
+
+typedef struct DrawTextureVertexAttrib {
+  float transform0[3];
+  float transform1[3];
+  float transform2[3];
+  float pos[2];
+  float texCoord[2];
+  float color[4];
+  int paramOffset;  // First vec4 of the material parameters of the draw
+} DrawTextureVertexAttrib;
+
+#define MAX_BATCH_VERTEX 16384
+#define MAX_BATCH_INDEX (MAX_BATCH_VERTEX / 4 * 6)
+// Material parameters of a batch in vec4, a block of 16KB which is the least
+// GL_MAX_UNIFORM_BLOCK_SIZE allows. Material shaders declare the same size.
+#define MAX_BATCH_PARAM 1024
+
+// Draws with the same texture and blend state accumulate here and are submitted
+// with a single draw call when either changes, the batch is full or someone
+// else needs the GL state.
+typedef struct SpriteBatch {
+  const SDTexture *texture;
+  SDBlendMode blendMode;  // Never additive, which is drawn as alpha
+  const SDMaterial *material;
+  SDFloat *params;  // Material parameters of the draws, in vec4
+  int numParam;
+  int numVertex;
+  int numIndex;
+  DrawTextureVertexAttrib *vertices;
+  unsigned int *indices;
+} SpriteBatch;
+
+typedef struct TilemapProgram {
+  GLuint ebo;  // Shared quad indices for a full chunk
+  GLuint program;
+  GLint MVPLocation;
+  GLint tintColorLocation;
+} TilemapProgram;
+
+// Vertex of static geometry drawn with the mesh program, colors are
+// pre-multiplied
+typedef struct MeshVertex {
+  float pos[2];
+  float texCoord[2];
+  float color[4];
+} MeshVertex;
+
+// Vertex and index data of meshes, sprite buffers and tilemap chunks live in
+// ranges of a few large GL buffers, so draws of different objects share a VAO
+// and can be merged into one multi-draw. A block is bound as both vertex and
+// element buffer of its VAO, draws index it with a byte offset and a base
+// vertex.
+#define BUFFER_BLOCK_SIZE (4 * 1024 * 1024)
+#define MAX_BUFFER_BLOCK 64
+
+// Set the vertex attributes of a block's VAO, with the VAO and block bound. May
+// bind another element buffer.
+typedef void (*InitVertexFormatFunc)(void);
+
+typedef struct FreeRange {
+  size_t offset;
+  size_t size;
+} FreeRange;
+
+typedef struct BufferBlock {
+  InitVertexFormatFunc initVertexFormat;
+  size_t size;
+  // Sorted by offset, neighbours are always merged. Only touched by the main
+  // thread.
+  FreeRange *freeRanges;
+  int numFreeRange;
+  int freeRangeCapacity;
+  GLuint buffer;  // Created on render side
+  GLuint vao;
+} BufferBlock;
+
+// Blocks of one vertex format
+typedef struct BufferArena {
+  InitVertexFormatFunc initVertexFormat;
+  BufferBlock *blocks[MAX_BUFFER_BLOCK];
+  int numBlock;
+} BufferArena;
+
+typedef struct BufferRange {
+  BufferBlock *block;  // NULL for no range
+  size_t offset;       // in bytes
+  size_t size;
+} BufferRange;
+
+typedef struct MeshProgram {
+  GLuint program;
+  GLint MVPLocation;
+  GLint tintColorLocation;
+} MeshProgram;
+
+typedef struct ParticleProgram {
+  GLuint program;
+  GLint MVPLocation;
+  GLint frameSizeLocation;
+  GLint numColumnLocation;
+} ParticleProgram;
+
+typedef struct RenderTarget {
+  GLuint fbo;
+  GLuint texture;
+  int width;
+  int height;
+  GLenum internalFormat;
+  int isInUse;
+} RenderTarget;
+
+#define MAX_POOLED_RENDER_TARGET 16
+
+#define MAX_RENDER_PASS 64
+#define MAX_GRAPH_TARGET 64
+#define MAX_PASS_TARGET 4
+#define RENDER_PASS_DATA_SIZE 64
+
+typedef struct RenderGraph RenderGraph;
+
+// Runs a pass with the data it was added with. The targets it declared are
+// ready through GetGraphTarget.
+typedef void (*RenderPassFunc)(RenderContext *rc, const RenderGraph *graph,
+                               const void *data);
+
+typedef struct RenderPass {
+  RenderPassFunc func;
+  double data[RENDER_PASS_DATA_SIZE / sizeof(double)];  // double for alignment
+  int reads[MAX_PASS_TARGET];
+  int numRead;
+  int writes[MAX_PASS_TARGET];
+  int numWrite;
+  int refCount;  // Targets it writes that are still used, culled at zero
+} RenderPass;
+
+typedef struct GraphTarget {
+  RenderTarget *target;  // Imported, or taken from the pool while alive
+  int isImported;
+  int width;
+  int height;
+  GLenum internalFormat;
+  int refCount;   // Passes reading it
+  int firstPass;  // Position in execution order where it comes alive
+  int lastPass;   // and where it goes back to the pool
+} GraphTarget;
+
+// Passes of one frame and the targets they read and write. Transient targets
+// only exist from the first pass using them to the last one, so targets whose
+// lifetimes do not overlap share memory through the render target pool.
+struct RenderGraph {
+  RenderPass passes[MAX_RENDER_PASS];
+  int numPass;
+  GraphTarget targets[MAX_GRAPH_TARGET];
+  int numTarget;
+  int order[MAX_RENDER_PASS];  // Passes that are not culled, as they run
+  int numOrdered;
+};
+
+typedef struct FullscreenProgram {
+  GLuint program;
+  GLint sourceLocation;
+  GLint uvScaleLocation;
+  GLint uvMaxLocation;
+  GLint texelSizeLocation;
+  GLint paramsLocation;
+} FullscreenProgram;
+
+enum {
+  POST_PROCESS_BLOOM = 1,
+  POST_PROCESS_COLOR_GRADING = 2,
+  POST_PROCESS_VIGNETTE = 4,
+  POST_PROCESS_VARIANT_COUNT = 8,
+};
+
+typedef struct CompositeProgram {
+  GLuint program;
+  GLint sceneUVScaleLocation;
+  GLint bloomUVScaleLocation;
+  GLint bloomUVMaxLocation;
+  GLint bloomIntensityLocation;
+  GLint gradingLocation;
+  GLint colorFilterLocation;
+  GLint vignetteLocation;
+} CompositeProgram;
+
+// Screen tiles of the light buffer for tiled light culling, in pixels
+#define LIGHT_TILE_SIZE 16
+
+// A queued light in canvas space. Used both as instance data and as four
+// RGBA32F texels in the tiled pass.
+typedef struct LightInstance {
+  float center[2];
+  float radius;
+  float cosCone;
+  float color[4];
+  float direction[2];
+  float padding[2];
+  float clip[4];  // Viewport of the camera it was drawn with
+} LightInstance;
+
+typedef struct Lighting {
+  // Settings and lights of the frame being recorded
+  SDLightingParams params;
+  LightInstance *lights;
+  int numLight;
+  int lightCapacity;
+
+  // The rest is used where the frame runs, on the render thread if any
+
+  // Lights drawn as instanced quads with additive blending
+  GLuint program;
+  GLint projectionLocation;
+  GLuint vao;
+  GLuint cornerVBO;
+  GLuint instanceVBO;
+
+  // Lights shaded per tile in one fullscreen pass
+  GLuint tiledProgram;
+  GLint fragToCanvasLocation;
+  GLint numTileXLocation;
+  GLint ambientLocation;
+  GLuint lightTBO;
+  GLuint lightTexture;
+  GLuint tileTBO;
+  GLuint tileTexture;
+  GLuint indexTBO;
+  GLuint indexTexture;
+  int *tiles;  // Offset and count for each tile
+  int tileCapacity;
+  int *indices;
+  int indexCapacity;
+
+  FullscreenProgram compositeProgram;
+} Lighting;
+
+typedef struct PostProcess {
+  SDPostProcessParams params;  // For the frame being recorded
+  FullscreenProgram brightPassProgram;
+  FullscreenProgram blurProgram;
+  // Compiled on demand for each combination of enabled effects
+  CompositeProgram compositePrograms[POST_PROCESS_VARIANT_COUNT];
+} PostProcess;
+
+#define TIMER_QUERY_COUNT 4
+
+// Renders the scene into a sub-rect of the scene target whose size is a
+// fraction of the viewport, then upscales it to the window. The target is
+// allocated at full viewport size once, so changing the scale only changes the
+// GL viewport.
+typedef struct DynamicResolution {
+  // Settings from SDSetDynamicResolution, which may come in the middle of a
+  // frame, so they are applied when the next one begins
+  SDDynamicResolutionParams pendingParams;
+  int hasPendingParams;
+
+  int enabled;
+  SDFloat targetFrameTime;  // in seconds
+  SDFloat minScale;
+  SDFloat maxScale;
+  SDFloat scale;
+  int cooldown;  // frames to wait before scaling up again
+
+  // Smoothed frame times in seconds
+  SDFloat gpuFrameTime;
+  SDFloat cpuFrameTime;
+
+  int renderWidth;
+  int renderHeight;
+
+  // Ring of GL_TIME_ELAPSED queries so reading results never stalls
+  GLuint timerQueries[TIMER_QUERY_COUNT];
+  int numFrame;
+} DynamicResolution;
+
+struct SDMaterial {
+  GLuint program;  // 0 when compiling failed, drawn like no material
+  GLint MVPLocation;
+  int numParam;
+  char *source;  // As given, for frame recordings
+};
+
+// Material parameters of every batch are copied to the next range of one
+// uniform buffer, which is orphaned when it wraps around
+#define MATERIAL_RING_SIZE (MAX_BATCH_PARAM * 16 * 16)
+#define MATERIAL_PARAM_BINDING 0
+
+typedef struct MaterialRing {
+  GLuint ubo;  // Created with the first material
+  GLint alignment;
+  int offset;
+} MaterialRing;
+
+#ifdef SD_DEBUG
+// Debug shapes of a frame, in canvas space
+typedef struct DebugDrawList {
+  const MeshVertex *triangles;
+  int numTriangleVertex;
+  const MeshVertex *lines;
+  int numLineVertex;
+} DebugDrawList;
+
+typedef struct DebugDraw {
+  // Accumulated since the last frame ended
+  MeshVertex *triangles;
+  int numTriangleVertex;
+  int triangleCapacity;
+  MeshVertex *lines;
+  int numLineVertex;
+  int lineCapacity;
+
+  GLuint vao;
+  GLuint vbo;
+} DebugDraw;
+
+// Functions kept of the GL calls of a frame, the ones taking the most time
+#define MAX_GL_CALL_STATS 128
+
+typedef struct GLCallFrame {
+  SDGLCallStats stats[MAX_GL_CALL_STATS];
+  int numStats;
+} GLCallFrame;
+#endif  // SD_DEBUG
+
+// Frames recorded but not yet read back from, see SDGetRenderStats
+#define NUM_FRAME_RESULT 2
+
+// Draw calls of a frame made with the recording backend
+typedef struct SubmittedDraws {
+  SDSubmittedDraw *draws;
+  int numDraw;
+  int capacity;
+} SubmittedDraws;
+
+typedef struct FrameResult {
+  SDRenderStats stats;
+  SDFloat resolutionScale;
+  SubmittedDraws submittedDraws;
+#ifdef SD_DEBUG
+  GLCallFrame glCalls;
+#endif
+} FrameResult;
+
+// Calls of a frame being recorded, see SDRecordFrame
+typedef enum RecordOp {
+  RECORD_PUSH_STATE,
+  RECORD_POP_STATE,
+  RECORD_PUSH_CLIP_RECT,
+  RECORD_BEGIN_CAMERA,
+  RECORD_END_CAMERA,
+  RECORD_DRAW_TEXTURE,
+  RECORD_DRAW_NINE_SLICE,
+  RECORD_DRAW_RECT,
+  RECORD_DRAW_CIRCLE,
+  RECORD_DRAW_LINE,
+  RECORD_DRAW_POLYLINE,
+  RECORD_DRAW_POLYGON,
+  RECORD_DRAW_LIGHT,
+  RECORD_DRAW_MESH,
+} RecordOp;
+
+typedef struct FrameRecorder FrameRecorder;
+
+#define MAX_RENDER_STATE 32
+
+// What SDPushState saves
+typedef struct RenderState {
+  int isClipped;
+  SDRect clipRect;  // in point on the canvas
+} RenderState;
+
+// Camera and batch state belong to the main thread, which records commands.
+// GL objects and the state next to them are only touched by command executors,
+// so with a render thread they belong to it.
+struct RenderContext {
+  int numDrawCall;
+  int numFrame;  // Recorded so far
+  // Written by the executor ending each frame, in a slot of its own so older
+  // ones can be read while the render thread runs
+  FrameResult frameResults[NUM_FRAME_RESULT];
+  int viewportWidth;
+  int viewportHeight;
+  SDMat3 projection;  // Canvas to clip space
+
+  // Current camera, or the identity one with the whole canvas as viewport
+  SDMat3 camera;  // World to canvas
+  SDMat3 viewProjection;
+  SDRect cameraViewport;  // in point
+  SDRect visibleBounds;   // in world space
+
+  char *recordPath;         // Where to record the next frame to
+  FrameRecorder *recorder;  // Set while a frame is recorded
+
+  RenderState state;
+  RenderState stateStack[MAX_RENDER_STATE];
+  int numState;
+  // Scissor is set to the clip rect, only for what could not be clipped on
+  // the CPU
+  int isClipScissorSet;
+
+  DrawTextureProgram drawTextureProgram;
+  SpriteBatch batch;
+  BufferArena meshArena;     // MeshVertex of meshes and sprite buffers
+  BufferArena tilemapArena;  // Created with the first tilemap
+  SDTexture *whiteTexture;  // For untextured geometry in the batch
+  GLuint fullscreenVAO;  // Empty, fullscreen triangles come from gl_VertexID
+  DynamicResolution dynamicResolution;
+  RenderTarget sceneTarget;
+  int isSceneTargetBound;
+  RenderTarget renderTargetPool[MAX_POOLED_RENDER_TARGET];
+  RenderTarget windowTarget;  // The default framebuffer, for the render graph
+  RenderGraph renderGraph;    // Rebuilt at the end of each frame
+  PostProcess postProcess;
+  Lighting lighting;
+  TilemapProgram tilemapProgram;
+  MeshProgram meshProgram;
+  MaterialRing materialRing;
+#ifdef SD_DEBUG
+  DebugDraw debugDraw;
+#endif
+  ParticleProgram particleProgram;
+};
+
+// Normalized slice lines of the last insets a texture was nine-sliced with
+typedef struct NineSliceCache {
+  int isValid;
+  SDInsets insets;
+  SDFloat u[4];
+  SDFloat v[4];
+} NineSliceCache;
+
+struct SDTexture {
+  GLuint id;
+  int format;  // SD_IMAGE_FORMAT_*
+  int actualWidth;
+  int actualHeight;
+  int width;
+  int height;
+  NineSliceCache nineSlice;
+  // Copy of the pixels for the software backend, NULL otherwise
+  unsigned char *texels;
+  int texelStride;
+};
+
+extern GLuint CompileGLProgram(const char *vss, const char *fss);
+
+// Result of the last frame the render side is done with, a blank one before
+extern const FrameResult *GetLastFrameResult(const RenderContext *rc);
+
+// Swap the draws the null GL made since the last call into draws, whose
+// array is reused for the next frame
+extern void EndNullGLFrame(SubmittedDraws *draws);
+// Scissor box as GL takes it, returns whether the scissor test is enabled
+extern int GetNullGLScissor(int box[4]);
+// Contents of a buffer on the software backend, NULL on the others
+extern const void *GetNullGLBufferData(GLuint buffer);
+
+// Rasterizer of the software backend. Sprite batches and the triangles of
+// retained objects are binned into tiles as they are drawn and the tiles are
+// drawn in parallel when the frame ends, which pixel reads of the null GL then
+// return.
+extern void InitSoftwareRasterizer(void);
+extern void CreateSoftwareTexture(SDTexture *texture,
+                                  const unsigned char *pixels, int stride);
+extern void BeginSoftwareFrame(int width, int height);
+extern void DrawSoftwareBatch(const SDTexture *texture, SDBlendMode blendMode,
+                              SDMat3 viewProjection,
+                              const DrawTextureVertexAttrib *vertices,
+                              const unsigned int *indices, int numIndex);
+// Triangles of MeshVertex with GL_UNSIGNED_SHORT or GL_UNSIGNED_INT indices,
+// drawn like the mesh program with pre-multiplied alpha blending
+extern void DrawSoftwareMesh(const SDTexture *texture, SDMat3 MVP,
+                             SDColor tintColor, const MeshVertex *vertices,
+                             const void *indices, GLenum indexType,
+                             int numIndex);
+extern void EndSoftwareFrame(void);
+// Rows from the bottom like glReadPixels, zero where nothing was drawn
+extern void ReadSoftwarePixels(int x, int y, int width, int height,
+                               unsigned char *pixels);
+
+// Get a color target of exactly this size from the pool, it is reused by
+// whoever acquires the same size after it is released
+extern RenderTarget *AcquireRenderTarget(RenderContext *rc, int width,
+                                         int height, GLenum internalFormat);
+extern void ReleaseRenderTarget(RenderTarget *rt);
+
+extern void ResetRenderGraph(RenderGraph *graph);
+// Use a target that outlives the graph, passes writing to it are never culled
+extern int ImportGraphTarget(RenderGraph *graph, RenderTarget *target);
+// Declare a target that only lives while the graph runs
+extern int CreateGraphTarget(RenderGraph *graph, int width, int height,
+                             GLenum internalFormat);
+// Add a pass running func with a copy of size bytes of data. Reading a target
+// depends on the passes added before that write it, or on all passes writing
+// it when there are none.
+extern RenderPass *AddRenderPass(RenderGraph *graph, RenderPassFunc func,
+                                 const void *data, size_t size);
+extern void ReadGraphTarget(RenderPass *pass, int target);
+extern void WriteGraphTarget(RenderPass *pass, int target);
+extern RenderTarget *GetGraphTarget(const RenderGraph *graph, int target);
+// Cull passes whose outputs are never read, order the rest by their
+// dependencies and run them
+extern void ExecuteRenderGraph(RenderContext *rc, RenderGraph *graph);
+
+extern const char FULLSCREEN_VERTEX_SHADER[];
+
+// Fullscreen fragment shaders get source, uvScale, uvMax, texelSize and params
+// uniforms
+extern void InitFullscreenProgram(FullscreenProgram *fullscreenProgram,
+                                  const char *fss);
+// Draw source, a sourceWidth x sourceHeight sub-rect of its texture, into the
+// targetWidth x targetHeight sub-rect of target. Expects fullscreenVAO bound.
+extern void RunFullscreenPass(const FullscreenProgram *fullscreenProgram,
+                              const RenderTarget *source, int sourceWidth,
+                              int sourceHeight, const RenderTarget *target,
+                              int targetWidth, int targetHeight,
+                              SDVec2 texelScale, const float *params);
+// Add a pass running RunFullscreenPass without blending
+extern RenderPass *AddFullscreenPass(RenderGraph *graph,
+                                     const FullscreenProgram *program,
+                                     int source, int sourceWidth,
+                                     int sourceHeight, int target,
+                                     int targetWidth, int targetHeight,
+                                     const float *params);
+
+// Vertex shader of the sprite batch, shared by the materials
+extern const char DRAW_TEXTURE_VERTEX_SHADER[];
+// Copy the material parameters of a batch to the ring and bind them
+extern void BindMaterialParams(RenderContext *rc, const SDFloat *params,
+                               int numParam);
+
+#ifdef SD_DEBUG
+// Hand the debug shapes of the frame over to a command
+extern void RecordDebugDraw(RenderContext *rc, DebugDrawList *list);
+// Draw them over the window
+extern void ExecuteDebugDraw(RenderContext *rc, const DebugDrawList *list);
+
+// Count and time every GL call made from now on
+extern void InstallGLCallHooks(void);
+// Move the counters of the GL calls made since the last frame ended to frame
+extern void EndGLCallFrame(GLCallFrame *frame);
+#endif
+
+// Meshes and sprite buffers draw MeshVertex with an MVP and tintColor
+extern void InitMeshProgram(MeshProgram *meshProgram);
+extern void InitMeshVertexFormat(void);
+// Create a mesh of vertices which are already pre-multiplied and in the space
+// of texture's padded size
+extern SDMesh *CreateMeshFromVertices(const MeshVertex *vertices,
+                                      int numVertex,
+                                      const unsigned int *indices,
+                                      int numIndex, SDTexture *texture);
+
+extern void InitBufferArena(BufferArena *arena,
+                            InitVertexFormatFunc initVertexFormat);
+// Find size bytes at an offset which is a multiple of alignment, in a new block
+// if no block has room. Ranges larger than a block get a block of their own.
+extern BufferRange AllocBufferRange(BufferArena *arena, size_t size,
+                                    size_t alignment);
+// Give the range back for reuse. Draws recorded before still see the old data,
+// uploads to the range by its next owner are recorded after them.
+extern void FreeBufferRange(BufferRange range);
+// Record copying size bytes of data to offset within range
+extern void UploadBufferRange(BufferRange range, size_t offset,
+                              const void *data, size_t size);
+
+extern void InitPostProcess(PostProcess *postProcess);
+extern int IsPostProcessEnabled(const SDPostProcessParams *params);
+// Add passes running enabled effects on the width x height sub-rect of scene
+// and writing the result to window
+extern void AddPostProcessPasses(RenderContext *rc, RenderGraph *graph,
+                                 const SDPostProcessParams *params, int scene,
+                                 int window, int width, int height);
+
+// Issue pending frame captures on the window's framebuffer and hand finished
+// read backs to the background thread
+extern void ProcessFrameCaptures(RenderContext *rc);
+
+extern void InitLighting(Lighting *lighting);
+extern int IsLightingEnabled(const RenderContext *rc);
+// Add passes multiplying the width x height sub-rect of scene by lights.
+// params and lights must stay valid until the graph has run.
+extern void AddLightingPasses(RenderContext *rc, RenderGraph *graph,
+                              const SDLightingParams *params,
+                              const LightInstance *lights, int numLight,
+                              int scene, int width, int height);
+
+// Start recording the frame to rc->recordPath if one was asked for
+extern void BeginFrameRecording(RenderContext *rc);
+// Record writing the file once the frame has run
+extern void EndFrameRecording(RenderContext *rc);
+// Append a call whose arguments are size bytes of data without pointers
+extern void RecordCall(FrameRecorder *recorder, RecordOp op, const void *data,
+                       size_t size);
+extern void RecordTextureDraw(FrameRecorder *recorder,
+                              const SDDrawTextureParams *params);
+extern void RecordNineSliceDraw(FrameRecorder *recorder,
+                                const SDTexture *texture, SDInsets insets,
+                                SDRect dstRect, SDMat3 transform,
+                                SDColor tintColor);
+extern void RecordLineDraw(FrameRecorder *recorder, SDVec2 from, SDVec2 to,
+                           SDFloat width, SDColor color);
+extern void RecordPolylineDraw(FrameRecorder *recorder, const SDVec2 *points,
+                               int numPoint, SDFloat width, SDLineJoin join,
+                               SDColor color);
+extern void RecordPolygonDraw(FrameRecorder *recorder,
+                              const SDDrawPolygonParams *params);
+// Retained geometry is recorded as meshes. Returns the index of the mesh
+// recorded for object this frame, -1 if there is none yet.
+extern int FindRecordedMesh(FrameRecorder *recorder, const void *object);
+// Add a mesh for object, NULL if its geometry may change within the frame, and
+// return its index. The caller fills vertices and indices before the frame
+// ends, on render side if need be.
+extern int AddRecordedMesh(FrameRecorder *recorder, const void *object,
+                           const SDTexture *texture, int numVertex,
+                           int numIndex, MeshVertex **vertices,
+                           unsigned int **indices);
+extern void RecordMeshDraw(FrameRecorder *recorder, int mesh, SDMat3 transform,
+                           SDColor tintColor);
+// Stop sharing the mesh of object, which is destroyed
+extern void ForgetRecordedMesh(FrameRecorder *recorder, const void *object);
+
+// Submit the pending sprite batch. Must be called before touching GL state
+// the batch depends on.
+extern void FlushBatch(RenderContext *rc);
+// Reserve room in the sprite batch for geometry using texture, returns the
+// index of the first reserved vertex
+extern unsigned int ReserveBatch(RenderContext *rc, const SDTexture *texture,
+                                 SDBlendMode blendMode,
+                                 const SDMaterial *material, int numVertex,
+                                 int numIndex,
+                                 DrawTextureVertexAttrib **vertices,
+                                 unsigned int **indices);
+// Whether geometry within bounds in world space survives the clip rect. What
+// is partly clipped is drawn with the scissor set to it.
+extern int ClipBounds(RenderContext *rc, SDRect bounds);
+// Set the scissor to the clip rect for geometry that is not clipped on the CPU
+extern void ApplyClipScissor(RenderContext *rc);
+
+#endif  // SD_RENDER_INTERNAL_H
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "render_internal.h"
+
+extern void ResetRenderGraph(RenderGraph *graph) {
+  graph->numPass = 0;
+  graph->numTarget = 0;
+  graph->numOrdered = 0;
+}
+
+static int AddGraphTarget(RenderGraph *graph, RenderTarget *target,
+                          int width, int height, GLenum internalFormat) {
+  if (graph->numTarget == MAX_GRAPH_TARGET) {
+    printf("Too many render graph targets\n");
+    exit(EXIT_FAILURE);
+  }
+
+  int index = graph->numTarget++;
+  GraphTarget *graphTarget = &graph->targets[index];
+  graphTarget->target = target;
+  graphTarget->isImported = target != NULL;
+  graphTarget->width = width;
+  graphTarget->height = height;
+  graphTarget->internalFormat = internalFormat;
+  graphTarget->refCount = 0;
+  graphTarget->firstPass = -1;
+  graphTarget->lastPass = -1;
+  return index;
+}
+
+extern int ImportGraphTarget(RenderGraph *graph, RenderTarget *target) {
+  return AddGraphTarget(graph, target, target->width, target->height,
+                        target->internalFormat);
+}
+
+extern int CreateGraphTarget(RenderGraph *graph, int width, int height,
+                             GLenum internalFormat) {
+  return AddGraphTarget(graph, NULL, width, height, internalFormat);
+}
+
+extern RenderPass *AddRenderPass(RenderGraph *graph, RenderPassFunc func,
+                                 const void *data, size_t size) {
+  SDAssert(size <= RENDER_PASS_DATA_SIZE);
+
+  if (graph->numPass == MAX_RENDER_PASS) {
+    printf("Too many render passes\n");
+    exit(EXIT_FAILURE);
+  }
+
+  RenderPass *pass = &graph->passes[graph->numPass++];
+  pass->func = func;
+  memcpy(pass->data, data, size);
+  pass->numRead = 0;
+  pass->numWrite = 0;
+  pass->refCount = 0;
+  return pass;
+}
+
+extern void ReadGraphTarget(RenderPass *pass, int target) {
+  SDAssert(pass->numRead < MAX_PASS_TARGET);
+  pass->reads[pass->numRead++] = target;
+}
+
+extern void WriteGraphTarget(RenderPass *pass, int target) {
+  SDAssert(pass->numWrite < MAX_PASS_TARGET);
+  pass->writes[pass->numWrite++] = target;
+}
+
+extern RenderTarget *GetGraphTarget(const RenderGraph *graph, int target) {
+  return graph->targets[target].target;
+}
+
+static int IsTargetIn(const int *targets, int count, int target) {
+  for (int i = 0; i < count; ++i) {
+    if (targets[i] == target) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Cull passes whose transient outputs nobody reads, then the passes that only
+// fed them
+static void CullPasses(RenderGraph *graph) {
+  int unused[MAX_GRAPH_TARGET];
+  int numUnused = 0;
+
+  for (int i = 0; i < graph->numPass; ++i) {
+    RenderPass *pass = &graph->passes[i];
+    pass->refCount = pass->numWrite;
+    for (int j = 0; j < pass->numRead; ++j) {
+      graph->targets[pass->reads[j]].refCount++;
+    }
+  }
+
+  for (int i = 0; i < graph->numTarget; ++i) {
+    const GraphTarget *target = &graph->targets[i];
+    if (!target->isImported && target->refCount == 0) {
+      unused[numUnused++] = i;
+    }
+  }
+
+  while (numUnused > 0) {
+    int target = unused[--numUnused];
+
+    for (int i = 0; i < graph->numPass; ++i) {
+      RenderPass *pass = &graph->passes[i];
+      if (pass->refCount == 0 ||
+          !IsTargetIn(pass->writes, pass->numWrite, target)) {
+        continue;
+      }
+
+      if (--pass->refCount > 0) {
+        continue;
+      }
+
+      for (int j = 0; j < pass->numRead; ++j) {
+        GraphTarget *read = &graph->targets[pass->reads[j]];
+        if (--read->refCount == 0 && !read->isImported) {
+          unused[numUnused++] = pass->reads[j];
+        }
+      }
+    }
+  }
+}
+
+// Whether pass reads the target as written by the passes added before it. A
+// transient target nobody wrote yet is read as written by later passes.
+static int ReadsEarlierVersion(const RenderGraph *graph, int pass, int target) {
+  if (graph->targets[target].isImported) {
+    return 1;
+  }
+
+  for (int i = 0; i < pass; ++i) {
+    const RenderPass *writer = &graph->passes[i];
+    if (writer->refCount > 0 &&
+        IsTargetIn(writer->writes, writer->numWrite, target)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Whether pass a has to run before pass b
+static int DependsOn(const RenderGraph *graph, int b, int a) {
+  const RenderPass *passA = &graph->passes[a];
+  const RenderPass *passB = &graph->passes[b];
+
+  // b reads what a writes
+  for (int i = 0; i < passB->numRead; ++i) {
+    int target = passB->reads[i];
+    if (IsTargetIn(passA->writes, passA->numWrite, target) &&
+        (a < b) == ReadsEarlierVersion(graph, b, target)) {
+      return 1;
+    }
+  }
+
+  if (a > b) {
+    return 0;
+  }
+
+  // b overwrites what a, added before, writes or reads
+  for (int i = 0; i < passB->numWrite; ++i) {
+    int target = passB->writes[i];
+    if (IsTargetIn(passA->writes, passA->numWrite, target) ||
+        (IsTargetIn(passA->reads, passA->numRead, target) &&
+         ReadsEarlierVersion(graph, a, target))) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+// Topological order of the passes left, the earliest added first among the
+// ready ones
+static void OrderPasses(RenderGraph *graph) {
+  int isOrdered[MAX_RENDER_PASS] = {0};
+  int numLive = 0;
+
+  for (int i = 0; i < graph->numPass; ++i) {
+    if (graph->passes[i].refCount > 0) {
+      numLive++;
+    } else {
+      isOrdered[i] = 1;
+    }
+  }
+
+  graph->numOrdered = 0;
+  while (graph->numOrdered < numLive) {
+    int next = -1;
+    for (int i = 0; i < graph->numPass && next < 0; ++i) {
+      if (isOrdered[i]) {
+        continue;
+      }
+
+      next = i;
+      for (int j = 0; j < graph->numPass; ++j) {
+        if (j != i && !isOrdered[j] && graph->passes[j].refCount > 0 &&
+            DependsOn(graph, i, j)) {
+          next = -1;
+          break;
+        }
+      }
+    }
+
+    if (next < 0) {
+      printf("Render graph has a cycle\n");
+      exit(EXIT_FAILURE);
+    }
+
+    isOrdered[next] = 1;
+    graph->order[graph->numOrdered++] = next;
+  }
+}
+
+static void ComputeLifetimes(RenderGraph *graph) {
+  for (int i = 0; i < graph->numOrdered; ++i) {
+    const RenderPass *pass = &graph->passes[graph->order[i]];
+    for (int j = 0; j < pass->numRead + pass->numWrite; ++j) {
+      int index = j < pass->numRead ? pass->reads[j]
+                                    : pass->writes[j - pass->numRead];
+      GraphTarget *target = &graph->targets[index];
+      if (target->firstPass < 0) {
+        target->firstPass = i;
+      }
+      target->lastPass = i;
+    }
+  }
+}
+
+extern void ExecuteRenderGraph(RenderContext *rc, RenderGraph *graph) {
+  CullPasses(graph);
+  OrderPasses(graph);
+  ComputeLifetimes(graph);
+
+  for (int i = 0; i < graph->numOrdered; ++i) {
+    const RenderPass *pass = &graph->passes[graph->order[i]];
+
+    for (int j = 0; j < graph->numTarget; ++j) {
+      GraphTarget *target = &graph->targets[j];
+      if (!target->isImported && target->firstPass == i) {
+        target->target = AcquireRenderTarget(rc, target->width, target->height,
+                                             target->internalFormat);
+      }
+    }
+
+    pass->func(rc, graph, pass->data);
+
+    // Released targets are handed to the next pass asking for the same size
+    for (int j = 0; j < graph->numTarget; ++j) {
+      GraphTarget *target = &graph->targets[j];
+      if (!target->isImported && target->lastPass == i) {
+        ReleaseRenderTarget(target->target);
+        target->target = NULL;
+      }
+    }
+  }
+}
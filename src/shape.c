@@ -0,0 +1,893 @@
+#include "sword/render.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "render_internal.h"
+
+#define PI 3.14159265358979f
+
+// Max distance in pixel between a curve and its tessellation
+#define CURVE_TOLERANCE 0.25f
+#define MIN_CIRCLE_SEGMENT 8
+#define MAX_CIRCLE_SEGMENT 256
+#define MITER_LIMIT 4.0f
+
+#define TESS_CACHE_SIZE 1024  // Power of 2
+// Indices of a chunk of a mesh too big for one batch, whose triangles are
+// emitted without shared vertices
+#define TESS_CHUNK_INDEX (MAX_BATCH_VERTEX / 3 * 3)
+
+enum {
+  PART_FILL,
+  PART_STROKE,
+};
+
+enum {
+  SHAPE_RECT,
+  SHAPE_POLYLINE,
+  SHAPE_POLYGON,
+};
+
+// Triangles of a shape. Each vertex belongs to the fill or the stroke, so
+// colors can be applied when the mesh is emitted. Positions are relative to
+// the shape's origin, so a shape that only moves keeps hitting the cache.
+typedef struct TessMesh {
+  SDVec2 *positions;
+  unsigned char *parts;
+  int numVertex;
+  int vertexCapacity;
+  unsigned int *indices;
+  int numIndex;
+  int indexCapacity;
+} TessMesh;
+
+typedef struct TessEntry {
+  uint64_t key;  // 0 means the slot is free
+  TessMesh mesh;
+} TessEntry;
+
+// Unit circle directions for a segment count, shared by all circles
+typedef struct CircleTable {
+  int numSegment;
+  SDVec2 *dirs;
+} CircleTable;
+
+typedef struct TessCache {
+  TessEntry entries[TESS_CACHE_SIZE];
+  int numEntry;
+  CircleTable circles[MAX_CIRCLE_SEGMENT / 4 + 1];
+  TessMesh scratch;
+} TessCache;
+
+static TessCache TESS = {0};
+
+// ----------------------------------------------------------------------------
+// Tessellation Cache
+// ----------------------------------------------------------------------------
+
+static uint64_t HashBytes(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *bytes = data;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static void FreeTessMesh(TessMesh *mesh) {
+  free(mesh->positions);
+  free(mesh->parts);
+  free(mesh->indices);
+  memset(mesh, 0, sizeof(TessMesh));
+}
+
+static const TessMesh *FindTessMesh(uint64_t key) {
+  unsigned int slot = (unsigned int)key & (TESS_CACHE_SIZE - 1);
+
+  for (;;) {
+    TessEntry *entry = &TESS.entries[slot];
+    if (entry->key == key) {
+      return &entry->mesh;
+    }
+    if (entry->key == 0) {
+      return NULL;
+    }
+    slot = (slot + 1) & (TESS_CACHE_SIZE - 1);
+  }
+}
+
+// Copy the scratch mesh into the cache under key
+static const TessMesh *InsertTessMesh(uint64_t key) {
+  // Start over when the table gets crowded, shapes still in use come back
+  // after one frame
+  if (TESS.numEntry >= TESS_CACHE_SIZE * 3 / 4) {
+    for (int i = 0; i < TESS_CACHE_SIZE; ++i) {
+      if (TESS.entries[i].key) {
+        FreeTessMesh(&TESS.entries[i].mesh);
+        TESS.entries[i].key = 0;
+      }
+    }
+    TESS.numEntry = 0;
+  }
+
+  unsigned int slot = (unsigned int)key & (TESS_CACHE_SIZE - 1);
+  while (TESS.entries[slot].key) {
+    slot = (slot + 1) & (TESS_CACHE_SIZE - 1);
+  }
+
+  const TessMesh *scratch = &TESS.scratch;
+  TessEntry *entry = &TESS.entries[slot];
+  TessMesh *mesh = &entry->mesh;
+  size_t numVertex = (size_t)scratch->numVertex;
+  size_t numIndex = (size_t)scratch->numIndex;
+
+  entry->key = key;
+  mesh->positions = malloc(numVertex * sizeof(SDVec2));
+  mesh->parts = malloc(numVertex);
+  mesh->indices = malloc(numIndex * sizeof(unsigned int));
+  memcpy(mesh->positions, scratch->positions, numVertex * sizeof(SDVec2));
+  memcpy(mesh->parts, scratch->parts, numVertex);
+  memcpy(mesh->indices, scratch->indices, numIndex * sizeof(unsigned int));
+  mesh->numVertex = scratch->numVertex;
+  mesh->vertexCapacity = scratch->numVertex;
+  mesh->numIndex = scratch->numIndex;
+  mesh->indexCapacity = scratch->numIndex;
+  TESS.numEntry++;
+
+  return mesh;
+}
+
+// ----------------------------------------------------------------------------
+// Tessellation
+// ----------------------------------------------------------------------------
+
+static unsigned int AddVertex(TessMesh *mesh, SDVec2 pos, int part) {
+  if (mesh->numVertex == mesh->vertexCapacity) {
+    mesh->vertexCapacity =
+        mesh->vertexCapacity ? mesh->vertexCapacity * 2 : 256;
+    mesh->positions = realloc(mesh->positions,
+                              (size_t)mesh->vertexCapacity * sizeof(SDVec2));
+    mesh->parts = realloc(mesh->parts, (size_t)mesh->vertexCapacity);
+  }
+
+  mesh->positions[mesh->numVertex] = pos;
+  mesh->parts[mesh->numVertex] = (unsigned char)part;
+  return (unsigned int)mesh->numVertex++;
+}
+
+static void AddTriangle(TessMesh *mesh, unsigned int a, unsigned int b,
+                        unsigned int c) {
+  if (mesh->numIndex + 3 > mesh->indexCapacity) {
+    mesh->indexCapacity = mesh->indexCapacity ? mesh->indexCapacity * 2 : 768;
+    mesh->indices = realloc(
+        mesh->indices, (size_t)mesh->indexCapacity * sizeof(unsigned int));
+  }
+
+  mesh->indices[mesh->numIndex++] = a;
+  mesh->indices[mesh->numIndex++] = b;
+  mesh->indices[mesh->numIndex++] = c;
+}
+
+// Pixels per point for geometry drawn through the current camera
+static SDFloat GetPixelScale(const RenderContext *rc) {
+  SDFloat det =
+      rc->camera.m00 * rc->camera.m11 - rc->camera.m01 * rc->camera.m10;
+  return SDGetPointToPixel() * sqrtf(SDAbsF(det));
+}
+
+// Number of segments for a full circle of radius in pixel, a multiple of 4
+static int GetCircleSegmentCount(SDFloat radius) {
+  int result = MAX_CIRCLE_SEGMENT;
+
+  if (radius <= CURVE_TOLERANCE) {
+    result = MIN_CIRCLE_SEGMENT;
+  } else {
+    SDFloat step = acosf(1.0f - CURVE_TOLERANCE / radius);
+    if (step > 0.0f) {
+      result = (int)SDCeilF(2.0f * PI / step);
+    }
+  }
+
+  result = (result + 3) / 4 * 4;
+  if (result < MIN_CIRCLE_SEGMENT) {
+    result = MIN_CIRCLE_SEGMENT;
+  } else if (result > MAX_CIRCLE_SEGMENT) {
+    result = MAX_CIRCLE_SEGMENT;
+  }
+  return result;
+}
+
+static const CircleTable *GetCircleTable(int numSegment) {
+  CircleTable *table = &TESS.circles[numSegment / 4];
+
+  if (!table->dirs) {
+    table->numSegment = numSegment;
+    table->dirs = malloc((size_t)numSegment * sizeof(SDVec2));
+    for (int i = 0; i < numSegment; ++i) {
+      SDFloat angle = 2.0f * PI * i / numSegment;
+      table->dirs[i] = SDV2(cosf(angle), sinf(angle));
+    }
+  }
+
+  return table;
+}
+
+static SDVec2 AddV2(SDVec2 a, SDVec2 b) { return SDV2(a.x + b.x, a.y + b.y); }
+
+static SDVec2 SubV2(SDVec2 a, SDVec2 b) { return SDV2(a.x - b.x, a.y - b.y); }
+
+static SDVec2 ScaleV2(SDVec2 a, SDFloat s) { return SDV2(a.x * s, a.y * s); }
+
+static SDFloat CrossV2(SDVec2 a, SDVec2 b) { return a.x * b.y - a.y * b.x; }
+
+// Unit left normal of segment from a to b, zero if degenerate
+static SDVec2 SegmentNormal(SDVec2 a, SDVec2 b) {
+  SDVec2 d = SubV2(b, a);
+  SDFloat len = sqrtf(d.x * d.x + d.y * d.y);
+  if (len == 0.0f) {
+    return SDZeroVec2();
+  }
+  return SDV2(-d.y / len, d.x / len);
+}
+
+static void TessellateJoin(TessMesh *mesh, SDVec2 p, SDVec2 n0, SDVec2 n1,
+                           SDFloat cross, SDFloat halfWidth, SDLineJoin join,
+                           SDFloat pixelScale) {
+  // Geometry goes on the outer side of the turn
+  SDFloat side = cross > 0.0f ? -1.0f : 1.0f;
+  SDVec2 a = ScaleV2(n0, side * halfWidth);
+  SDVec2 c = ScaleV2(n1, side * halfWidth);
+
+  unsigned int center = AddVertex(mesh, p, PART_STROKE);
+
+  switch (join) {
+    case SD_LINE_JOIN_MITER: {
+      SDVec2 m = AddV2(n0, n1);
+      SDFloat len = sqrtf(m.x * m.x + m.y * m.y);
+      SDFloat cosHalf = len * 0.5f;
+      if (len > 0.0f && 1.0f / cosHalf <= MITER_LIMIT) {
+        SDVec2 tip = ScaleV2(m, side * halfWidth / (len * cosHalf));
+        unsigned int ia = AddVertex(mesh, AddV2(p, a), PART_STROKE);
+        unsigned int it = AddVertex(mesh, AddV2(p, tip), PART_STROKE);
+        unsigned int ic = AddVertex(mesh, AddV2(p, c), PART_STROKE);
+        AddTriangle(mesh, center, ia, it);
+        AddTriangle(mesh, center, it, ic);
+        break;
+      }
+    }
+    // Too sharp for a miter
+    // fall through
+
+    case SD_LINE_JOIN_BEVEL: {
+      unsigned int ia = AddVertex(mesh, AddV2(p, a), PART_STROKE);
+      unsigned int ic = AddVertex(mesh, AddV2(p, c), PART_STROKE);
+      AddTriangle(mesh, center, ia, ic);
+    } break;
+
+    case SD_LINE_JOIN_ROUND: {
+      SDFloat angle0 = atan2f(a.y, a.x);
+      SDFloat delta = atan2f(c.y, c.x) - angle0;
+      if (delta > PI) {
+        delta -= 2.0f * PI;
+      } else if (delta < -PI) {
+        delta += 2.0f * PI;
+      }
+
+      int numSegment = GetCircleSegmentCount(halfWidth * pixelScale);
+      int numStep = (int)SDCeilF(SDAbsF(delta) / (2.0f * PI) * numSegment);
+      if (numStep < 1) {
+        numStep = 1;
+      }
+
+      unsigned int prev = AddVertex(mesh, AddV2(p, a), PART_STROKE);
+      for (int i = 1; i <= numStep; ++i) {
+        SDFloat angle = angle0 + delta * i / numStep;
+        SDVec2 dir = SDV2(cosf(angle), sinf(angle));
+        unsigned int next =
+            AddVertex(mesh, AddV2(p, ScaleV2(dir, halfWidth)), PART_STROKE);
+        AddTriangle(mesh, center, prev, next);
+        prev = next;
+      }
+    } break;
+  }
+}
+
+static void TessellateStroke(TessMesh *mesh, const SDVec2 *points,
+                             int numPoint, int closed, SDFloat width,
+                             SDLineJoin join, SDFloat pixelScale) {
+  SDFloat halfWidth = width * 0.5f;
+  int numSegment = closed ? numPoint : numPoint - 1;
+
+  for (int i = 0; i < numSegment; ++i) {
+    SDVec2 p0 = points[i];
+    SDVec2 p1 = points[(i + 1) % numPoint];
+    SDVec2 n = ScaleV2(SegmentNormal(p0, p1), halfWidth);
+    if (n.x == 0.0f && n.y == 0.0f) {
+      continue;
+    }
+
+    unsigned int a = AddVertex(mesh, AddV2(p0, n), PART_STROKE);
+    unsigned int b = AddVertex(mesh, AddV2(p1, n), PART_STROKE);
+    unsigned int c = AddVertex(mesh, SubV2(p1, n), PART_STROKE);
+    unsigned int d = AddVertex(mesh, SubV2(p0, n), PART_STROKE);
+    AddTriangle(mesh, a, b, c);
+    AddTriangle(mesh, a, c, d);
+  }
+
+  int first = closed ? 0 : 1;
+  int last = closed ? numPoint - 1 : numPoint - 2;
+  for (int i = first; i <= last; ++i) {
+    SDVec2 prev = points[(i + numPoint - 1) % numPoint];
+    SDVec2 p = points[i];
+    SDVec2 next = points[(i + 1) % numPoint];
+
+    SDFloat cross = CrossV2(SubV2(p, prev), SubV2(next, p));
+    SDVec2 n0 = SegmentNormal(prev, p);
+    SDVec2 n1 = SegmentNormal(p, next);
+    if (SDAbsF(cross) < 1e-6f || (n0.x == 0.0f && n0.y == 0.0f) ||
+        (n1.x == 0.0f && n1.y == 0.0f)) {
+      continue;
+    }
+
+    TessellateJoin(mesh, p, n0, n1, cross, halfWidth, join, pixelScale);
+  }
+}
+
+// Band between two closed paths whose points correspond one to one
+static void TessellateRing(TessMesh *mesh, const SDVec2 *outer,
+                           const SDVec2 *inner, int numPoint) {
+  unsigned int base = (unsigned int)mesh->numVertex;
+  for (int i = 0; i < numPoint; ++i) {
+    AddVertex(mesh, outer[i], PART_STROKE);
+    AddVertex(mesh, inner[i], PART_STROKE);
+  }
+
+  for (int i = 0; i < numPoint; ++i) {
+    unsigned int out0 = base + i * 2;
+    unsigned int in0 = out0 + 1;
+    unsigned int out1 = base + (i + 1) % numPoint * 2;
+    unsigned int in1 = out1 + 1;
+    AddTriangle(mesh, out0, out1, in1);
+    AddTriangle(mesh, out0, in1, in0);
+  }
+}
+
+static SDFloat SignedArea(const SDVec2 *points, int numPoint) {
+  SDFloat area = 0.0f;
+  for (int i = 0; i < numPoint; ++i) {
+    area += CrossV2(points[i], points[(i + 1) % numPoint]);
+  }
+  return area * 0.5f;
+}
+
+static int IsPointInTriangle(SDVec2 p, SDVec2 a, SDVec2 b, SDVec2 c) {
+  SDFloat d0 = CrossV2(SubV2(b, a), SubV2(p, a));
+  SDFloat d1 = CrossV2(SubV2(c, b), SubV2(p, b));
+  SDFloat d2 = CrossV2(SubV2(a, c), SubV2(p, c));
+  int hasNeg = d0 < 0.0f || d1 < 0.0f || d2 < 0.0f;
+  int hasPos = d0 > 0.0f || d1 > 0.0f || d2 > 0.0f;
+  return !(hasNeg && hasPos);
+}
+
+// Triangulate a simple polygon by ear clipping, convex ones become a fan
+static void TessellateFill(TessMesh *mesh, const SDVec2 *points,
+                           int numPoint) {
+  if (numPoint < 3) {
+    return;
+  }
+
+  unsigned int base = (unsigned int)mesh->numVertex;
+  for (int i = 0; i < numPoint; ++i) {
+    AddVertex(mesh, points[i], PART_FILL);
+  }
+
+  SDFloat orientation = SignedArea(points, numPoint) >= 0.0f ? 1.0f : -1.0f;
+
+  int isConvex = 1;
+  for (int i = 0; i < numPoint && isConvex; ++i) {
+    SDVec2 a = points[i];
+    SDVec2 b = points[(i + 1) % numPoint];
+    SDVec2 c = points[(i + 2) % numPoint];
+    isConvex = CrossV2(SubV2(b, a), SubV2(c, b)) * orientation >= 0.0f;
+  }
+
+  if (isConvex) {
+    for (int i = 1; i + 1 < numPoint; ++i) {
+      AddTriangle(mesh, base, base + i, base + i + 1);
+    }
+    return;
+  }
+
+  int *remain = malloc((size_t)numPoint * sizeof(int));
+  for (int i = 0; i < numPoint; ++i) {
+    remain[i] = i;
+  }
+
+  int numRemain = numPoint;
+  while (numRemain > 3) {
+    int found = 0;
+
+    for (int i = 0; i < numRemain; ++i) {
+      int ia = remain[(i + numRemain - 1) % numRemain];
+      int ib = remain[i];
+      int ic = remain[(i + 1) % numRemain];
+      SDVec2 a = points[ia];
+      SDVec2 b = points[ib];
+      SDVec2 c = points[ic];
+
+      if (CrossV2(SubV2(b, a), SubV2(c, b)) * orientation <= 0.0f) {
+        continue;
+      }
+
+      int isEar = 1;
+      for (int j = 0; j < numRemain && isEar; ++j) {
+        int ip = remain[j];
+        if (ip != ia && ip != ib && ip != ic) {
+          isEar = !IsPointInTriangle(points[ip], a, b, c);
+        }
+      }
+
+      if (isEar) {
+        AddTriangle(mesh, base + ia, base + ib, base + ic);
+        memmove(remain + i, remain + i + 1,
+                (size_t)(numRemain - i - 1) * sizeof(int));
+        numRemain--;
+        found = 1;
+        break;
+      }
+    }
+
+    // Self-intersecting input has no ear left, give up on the rest
+    if (!found) {
+      break;
+    }
+  }
+
+  if (numRemain == 3) {
+    AddTriangle(mesh, base + remain[0], base + remain[1], base + remain[2]);
+  }
+
+  free(remain);
+}
+
+// ----------------------------------------------------------------------------
+// Emission
+// ----------------------------------------------------------------------------
+
+static SDColor Premultiply(SDColor color) {
+  return SDRGBA(color.r * color.a, color.g * color.a, color.b * color.a,
+                color.a);
+}
+
+static void WriteShapeVertex(DrawTextureVertexAttrib *v, SDVec2 pos,
+                             const SDColor *color) {
+  static const float IDENTITY[9] = {1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+                                    0.0f, 0.0f, 0.0f, 1.0f};
+
+  memcpy(v->transform0, IDENTITY, sizeof(v->transform0));
+  memcpy(v->transform1, IDENTITY + 3, sizeof(v->transform1));
+  memcpy(v->transform2, IDENTITY + 6, sizeof(v->transform2));
+  v->pos[0] = pos.x;
+  v->pos[1] = pos.y;
+  // Center of the white texel
+  v->texCoord[0] = 0.5f;
+  v->texCoord[1] = 0.5f;
+  v->color[0] = color->r;
+  v->color[1] = color->g;
+  v->color[2] = color->b;
+  v->color[3] = color->a;
+  v->paramOffset = 0;
+}
+
+// Emit mesh translated by offset
+static void EmitTessMesh(RenderContext *rc, const TessMesh *mesh,
+                         SDVec2 offset, SDColor fillColor,
+                         SDColor strokeColor) {
+  if (mesh->numIndex == 0) {
+    return;
+  }
+
+  if (rc->state.isClipped) {
+    SDRect bounds = SDRectMinMax(mesh->positions[0], mesh->positions[0]);
+    for (int i = 1; i < mesh->numVertex; ++i) {
+      SDVec2 p = mesh->positions[i];
+      bounds.min = SDV2(SDMinF(bounds.min.x, p.x), SDMinF(bounds.min.y, p.y));
+      bounds.max = SDV2(SDMaxF(bounds.max.x, p.x), SDMaxF(bounds.max.y, p.y));
+    }
+    bounds.min = AddV2(bounds.min, offset);
+    bounds.max = AddV2(bounds.max, offset);
+    if (!ClipBounds(rc, bounds)) {
+      return;
+    }
+  }
+
+  SDColor colors[2] = {Premultiply(fillColor), Premultiply(strokeColor)};
+
+  DrawTextureVertexAttrib *vertices;
+  unsigned int *indices;
+
+  if (mesh->numVertex > MAX_BATCH_VERTEX ||
+      mesh->numIndex > MAX_BATCH_INDEX) {
+    // Each chunk fills a batch of its own, the one before is flushed
+    for (int first = 0; first < mesh->numIndex; first += TESS_CHUNK_INDEX) {
+      int numIndex = mesh->numIndex - first < TESS_CHUNK_INDEX
+                         ? mesh->numIndex - first
+                         : TESS_CHUNK_INDEX;
+      unsigned int base =
+          ReserveBatch(rc, rc->whiteTexture, SD_BLEND_MODE_ALPHA, NULL,
+                       numIndex, numIndex, &vertices, &indices);
+
+      for (int i = 0; i < numIndex; ++i) {
+        unsigned int index = mesh->indices[first + i];
+        WriteShapeVertex(vertices + i, AddV2(mesh->positions[index], offset),
+                         &colors[mesh->parts[index]]);
+        indices[i] = base + (unsigned int)i;
+      }
+    }
+    return;
+  }
+
+  unsigned int base =
+      ReserveBatch(rc, rc->whiteTexture, SD_BLEND_MODE_ALPHA, NULL,
+                   mesh->numVertex, mesh->numIndex, &vertices, &indices);
+
+  for (int i = 0; i < mesh->numVertex; ++i) {
+    WriteShapeVertex(vertices + i, AddV2(mesh->positions[i], offset),
+                     &colors[mesh->parts[i]]);
+  }
+  for (int i = 0; i < mesh->numIndex; ++i) {
+    indices[i] = base + mesh->indices[i];
+  }
+}
+
+// Start a fresh scratch mesh for a cache miss
+static TessMesh *BeginTessellation(void) {
+  TESS.scratch.numVertex = 0;
+  TESS.scratch.numIndex = 0;
+  return &TESS.scratch;
+}
+
+// ----------------------------------------------------------------------------
+// Shapes
+// ----------------------------------------------------------------------------
+
+SDAPI SDDrawRectParams SDMakeDrawRectParams(SDRect rect) {
+  SDDrawRectParams params = {
+      .rect = rect,
+      .borderWidth = 0.0f,
+      .cornerRadius = 0.0f,
+      .strokeColor = SDRGBA(0.0f, 0.0f, 0.0f, 1.0f),
+      .fillColor = SDRGBA(1.0f, 1.0f, 1.0f, 1.0f),
+  };
+  return params;
+}
+
+// Outline of a rounded rect, clockwise on screen. Without corner steps it is
+// the 4 corners, otherwise each corner has numCornerStep + 1 points, which
+// all sit on the corner when radius is 0.
+static int BuildRoundedRectPath(SDVec2 *points, SDRect rect, SDFloat radius,
+                                int numCornerStep) {
+  if (numCornerStep <= 0) {
+    points[0] = rect.min;
+    points[1] = SDV2(rect.max.x, rect.min.y);
+    points[2] = rect.max;
+    points[3] = SDV2(rect.min.x, rect.max.y);
+    return 4;
+  }
+
+  SDVec2 centers[4] = {
+      SDV2(rect.max.x - radius, rect.min.y + radius),
+      SDV2(rect.max.x - radius, rect.max.y - radius),
+      SDV2(rect.min.x + radius, rect.max.y - radius),
+      SDV2(rect.min.x + radius, rect.min.y + radius),
+  };
+
+  int numPoint = 0;
+  for (int corner = 0; corner < 4; ++corner) {
+    SDFloat angle0 = (corner - 1) * 0.5f * PI;
+    for (int i = 0; i <= numCornerStep; ++i) {
+      SDFloat angle = angle0 + 0.5f * PI * i / numCornerStep;
+      points[numPoint++] = AddV2(
+          centers[corner], SDV2(cosf(angle) * radius, sinf(angle) * radius));
+    }
+  }
+  return numPoint;
+}
+
+SDAPI void SDDrawRect(const SDDrawRectParams *params) {
+  RenderContext *rc = CTX.rc;
+  SDRect rect = params->rect;
+  SDFloat width = rect.max.x - rect.min.x;
+  SDFloat height = rect.max.y - rect.min.y;
+
+  if (width <= 0.0f || height <= 0.0f) {
+    return;
+  }
+
+  if (rc->recorder) {
+    RecordCall(rc->recorder, RECORD_DRAW_RECT, params, sizeof(*params));
+  }
+
+  SDFloat radius = SDClampF(params->cornerRadius, 0.0f,
+                            SDMinF(width, height) * 0.5f);
+  SDFloat borderWidth =
+      SDClampF(params->borderWidth, 0.0f, SDMinF(width, height) * 0.5f);
+  int numCornerStep =
+      GetCircleSegmentCount(radius * GetPixelScale(rc)) / 4;
+
+  // Tessellated with its top left corner at the origin
+  SDVec2 size = SDV2(width, height);
+  uint64_t key = HashBytes(0xcbf29ce484222325ull, &(int){SHAPE_RECT},
+                           sizeof(int));
+  key = HashBytes(key, &size, sizeof(size));
+  key = HashBytes(key, &radius, sizeof(radius));
+  key = HashBytes(key, &borderWidth, sizeof(borderWidth));
+  key = HashBytes(key, &numCornerStep, sizeof(numCornerStep));
+  key = key ? key : 1;
+
+  const TessMesh *mesh = FindTessMesh(key);
+  if (!mesh) {
+    TessMesh *scratch = BeginTessellation();
+    size_t pathSize = (size_t)(numCornerStep + 1) * 4 * sizeof(SDVec2);
+    SDVec2 *points = malloc(pathSize);
+    SDVec2 *innerPoints = malloc(pathSize);
+
+    // The fill stops where the border starts and the border is a ring
+    // between the outline and the inset outline, so they never overlap
+    SDRect inner =
+        SDRectMinMax(SDV2(borderWidth, borderWidth),
+                     SDV2(width - borderWidth, height - borderWidth));
+    SDFloat innerRadius = SDMaxF(radius - borderWidth, 0.0f);
+    if (inner.max.x > inner.min.x && inner.max.y > inner.min.y) {
+      int numPoint = BuildRoundedRectPath(
+          points, inner, innerRadius, innerRadius > 0.0f ? numCornerStep : 0);
+      TessellateFill(scratch, points, numPoint);
+    }
+
+    if (borderWidth > 0.0f) {
+      int numStep = radius > 0.0f ? numCornerStep : 0;
+      int numPoint = BuildRoundedRectPath(
+          points, SDRectMinMax(SDV2(0.0f, 0.0f), size), radius, numStep);
+      BuildRoundedRectPath(innerPoints, inner, innerRadius, numStep);
+      TessellateRing(scratch, points, innerPoints, numPoint);
+    }
+
+    free(points);
+    free(innerPoints);
+    mesh = InsertTessMesh(key);
+  }
+
+  EmitTessMesh(rc, mesh, rect.min, params->fillColor, params->strokeColor);
+}
+
+SDAPI SDDrawCircleParams SDMakeDrawCircleParams(SDVec2 center,
+                                                SDFloat radius) {
+  SDDrawCircleParams params = {
+      .center = center,
+      .radius = radius,
+      .borderWidth = 0.0f,
+      .strokeColor = SDRGBA(0.0f, 0.0f, 0.0f, 1.0f),
+      .fillColor = SDRGBA(1.0f, 1.0f, 1.0f, 1.0f),
+  };
+  return params;
+}
+
+// Circles of any size share the unit directions, so only placing the
+// vertices is left per draw
+SDAPI void SDDrawCircle(const SDDrawCircleParams *params) {
+  RenderContext *rc = CTX.rc;
+  SDFloat radius = params->radius;
+
+  if (radius <= 0.0f) {
+    return;
+  }
+
+  if (rc->recorder) {
+    RecordCall(rc->recorder, RECORD_DRAW_CIRCLE, params, sizeof(*params));
+  }
+
+  int numSegment = GetCircleSegmentCount(radius * GetPixelScale(rc));
+  const CircleTable *table = GetCircleTable(numSegment);
+  SDVec2 center = params->center;
+  SDFloat borderWidth = SDClampF(params->borderWidth, 0.0f, radius);
+  SDFloat innerRadius = radius - borderWidth;
+  int hasFill = innerRadius > 0.0f && params->fillColor.a > 0.0f;
+  int hasStroke = borderWidth > 0.0f && params->strokeColor.a > 0.0f;
+
+  int numVertex = (hasFill ? numSegment + 1 : 0) +
+                  (hasStroke ? numSegment * 2 : 0);
+  int numIndex = (hasFill ? numSegment * 3 : 0) +
+                 (hasStroke ? numSegment * 6 : 0);
+  SDRect bounds = SDRectMinMax(SDV2(center.x - radius, center.y - radius),
+                               SDV2(center.x + radius, center.y + radius));
+  if (numVertex == 0 || !ClipBounds(rc, bounds)) {
+    return;
+  }
+
+  DrawTextureVertexAttrib *v;
+  unsigned int *indices;
+  unsigned int base =
+      ReserveBatch(rc, rc->whiteTexture, SD_BLEND_MODE_ALPHA, NULL,
+                   numVertex, numIndex, &v, &indices);
+
+  if (hasFill) {
+    SDColor color = Premultiply(params->fillColor);
+    WriteShapeVertex(v++, center, &color);
+    for (int i = 0; i < numSegment; ++i) {
+      WriteShapeVertex(v++, AddV2(center, ScaleV2(table->dirs[i], innerRadius)),
+                       &color);
+      *indices++ = base;
+      *indices++ = base + 1 + i;
+      *indices++ = base + 1 + (i + 1) % numSegment;
+    }
+    base += numSegment + 1;
+  }
+
+  if (hasStroke) {
+    SDColor color = Premultiply(params->strokeColor);
+    for (int i = 0; i < numSegment; ++i) {
+      WriteShapeVertex(v++, AddV2(center, ScaleV2(table->dirs[i], innerRadius)),
+                       &color);
+      WriteShapeVertex(v++, AddV2(center, ScaleV2(table->dirs[i], radius)),
+                       &color);
+
+      unsigned int in0 = base + i * 2;
+      unsigned int out0 = in0 + 1;
+      unsigned int in1 = base + (i + 1) % numSegment * 2;
+      unsigned int out1 = in1 + 1;
+      *indices++ = in0;
+      *indices++ = out0;
+      *indices++ = out1;
+      *indices++ = in0;
+      *indices++ = out1;
+      *indices++ = in1;
+    }
+  }
+}
+
+SDAPI void SDDrawLine(SDVec2 from, SDVec2 to, SDFloat width, SDColor color) {
+  RenderContext *rc = CTX.rc;
+  SDVec2 n = ScaleV2(SegmentNormal(from, to), width * 0.5f);
+
+  if (n.x == 0.0f && n.y == 0.0f) {
+    return;
+  }
+
+  if (rc->recorder) {
+    RecordLineDraw(rc->recorder, from, to, width, color);
+  }
+
+  SDVec2 extent = SDV2(SDAbsF(n.x), SDAbsF(n.y));
+  SDRect bounds = SDRectMinMax(
+      SDV2(SDMinF(from.x, to.x) - extent.x, SDMinF(from.y, to.y) - extent.y),
+      SDV2(SDMaxF(from.x, to.x) + extent.x, SDMaxF(from.y, to.y) + extent.y));
+  if (!ClipBounds(rc, bounds)) {
+    return;
+  }
+
+  color = Premultiply(color);
+
+  DrawTextureVertexAttrib *v;
+  unsigned int *indices;
+  unsigned int base =
+      ReserveBatch(rc, rc->whiteTexture, SD_BLEND_MODE_ALPHA, NULL, 4, 6,
+                   &v, &indices);
+
+  WriteShapeVertex(v + 0, AddV2(from, n), &color);
+  WriteShapeVertex(v + 1, AddV2(to, n), &color);
+  WriteShapeVertex(v + 2, SubV2(to, n), &color);
+  WriteShapeVertex(v + 3, SubV2(from, n), &color);
+  indices[0] = base;
+  indices[1] = base + 1;
+  indices[2] = base + 2;
+  indices[3] = base;
+  indices[4] = base + 2;
+  indices[5] = base + 3;
+}
+
+// Points are hashed relative to the first one, which paths are tessellated
+// around
+static uint64_t HashPath(int shape, const SDVec2 *points, int numPoint,
+                         SDFloat width, SDLineJoin join, int numJoinSegment) {
+  uint64_t key = HashBytes(0xcbf29ce484222325ull, &shape, sizeof(shape));
+  key = HashBytes(key, &numPoint, sizeof(numPoint));
+  for (int i = 0; i < numPoint; ++i) {
+    SDVec2 p = SubV2(points[i], points[0]);
+    key = HashBytes(key, &p, sizeof(p));
+  }
+  key = HashBytes(key, &width, sizeof(width));
+  key = HashBytes(key, &join, sizeof(join));
+  key = HashBytes(key, &numJoinSegment, sizeof(numJoinSegment));
+  return key ? key : 1;
+}
+
+// Copy of points relative to the first one, to be freed
+static SDVec2 *ToLocalPath(const SDVec2 *points, int numPoint) {
+  SDVec2 *local = malloc((size_t)numPoint * sizeof(SDVec2));
+  for (int i = 0; i < numPoint; ++i) {
+    local[i] = SubV2(points[i], points[0]);
+  }
+  return local;
+}
+
+SDAPI void SDDrawPolyline(const SDVec2 *points, int numPoint, SDFloat width,
+                          SDLineJoin join, SDColor color) {
+  RenderContext *rc = CTX.rc;
+
+  if (numPoint < 2 || width <= 0.0f) {
+    return;
+  }
+
+  if (rc->recorder) {
+    RecordPolylineDraw(rc->recorder, points, numPoint, width, join, color);
+  }
+
+  SDFloat pixelScale = GetPixelScale(rc);
+  int numJoinSegment = join == SD_LINE_JOIN_ROUND
+                           ? GetCircleSegmentCount(width * 0.5f * pixelScale)
+                           : 0;
+  uint64_t key =
+      HashPath(SHAPE_POLYLINE, points, numPoint, width, join, numJoinSegment);
+
+  const TessMesh *mesh = FindTessMesh(key);
+  if (!mesh) {
+    TessMesh *scratch = BeginTessellation();
+    SDVec2 *local = ToLocalPath(points, numPoint);
+    TessellateStroke(scratch, local, numPoint, 0, width, join, pixelScale);
+    free(local);
+    mesh = InsertTessMesh(key);
+  }
+
+  EmitTessMesh(rc, mesh, points[0], color, color);
+}
+
+SDAPI SDDrawPolygonParams SDMakeDrawPolygonParams(const SDVec2 *points,
+                                                  int numPoint) {
+  SDDrawPolygonParams params = {
+      .points = points,
+      .numPoint = numPoint,
+      .borderWidth = 0.0f,
+      .join = SD_LINE_JOIN_MITER,
+      .strokeColor = SDRGBA(0.0f, 0.0f, 0.0f, 1.0f),
+      .fillColor = SDRGBA(1.0f, 1.0f, 1.0f, 1.0f),
+  };
+  return params;
+}
+
+SDAPI void SDDrawPolygon(const SDDrawPolygonParams *params) {
+  RenderContext *rc = CTX.rc;
+
+  if (params->numPoint < 3) {
+    return;
+  }
+
+  if (rc->recorder) {
+    RecordPolygonDraw(rc->recorder, params);
+  }
+
+  SDFloat pixelScale = GetPixelScale(rc);
+  SDFloat borderWidth = SDMaxF(params->borderWidth, 0.0f);
+  int numJoinSegment =
+      params->join == SD_LINE_JOIN_ROUND
+          ? GetCircleSegmentCount(borderWidth * 0.5f * pixelScale)
+          : 0;
+  uint64_t key = HashPath(SHAPE_POLYGON, params->points, params->numPoint,
+                          borderWidth, params->join, numJoinSegment);
+
+  const TessMesh *mesh = FindTessMesh(key);
+  if (!mesh) {
+    TessMesh *scratch = BeginTessellation();
+    SDVec2 *local = ToLocalPath(params->points, params->numPoint);
+    TessellateFill(scratch, local, params->numPoint);
+    if (borderWidth > 0.0f) {
+      TessellateStroke(scratch, local, params->numPoint, 1, borderWidth,
+                       params->join, pixelScale);
+    }
+    free(local);
+    mesh = InsertTessMesh(key);
+  }
+
+  EmitTessMesh(rc, mesh, params->points[0], params->fillColor,
+               params->strokeColor);
+}
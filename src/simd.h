@@ -0,0 +1,11 @@
+#ifndef SD_SIMD_H
+#define SD_SIMD_H
+
+// SSE2 is always available on x86-64, other targets use scalar fallbacks
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SD_SSE2
+#include <emmintrin.h>
+#endif
+
+#endif  // SD_SIMD_H
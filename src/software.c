@@ -0,0 +1,529 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "job.h"
+#include "render_internal.h"
+#include "simd.h"
+
+// Rasterizer of the software backend. Triangles of sprite batches and retained
+// objects are set up and binned into screen tiles as they are drawn. When the
+// frame ends the tiles are rasterized in parallel, each one blending its
+// triangles in order into linear colors which are then encoded to sRGB like the
+// window's framebuffer.
+
+#define SOFTWARE_TILE_SIZE 64
+#define SUBPIXEL_BITS 8
+#define SUBPIXEL_ONE (1 << SUBPIXEL_BITS)
+// Linear values are encoded through a table of this many steps
+#define SRGB_ENCODE_STEPS 4096
+
+typedef struct SoftwareTriangle {
+  // In fixed point pixels with rows from the top, wound so that the edge
+  // functions are positive inside
+  int32_t x[3];
+  int32_t y[3];
+  // Makes edges that do not own the pixels exactly on them exclude them
+  int64_t bias[3];
+  int minX;  // Pixels covered, clipped to the scissor box
+  int minY;
+  int maxX;
+  int maxY;
+  // Attributes at the center of pixel (0, 0), then their steps along x and y
+  float color[3][4];
+  float texCoord[3][2];
+  const SDTexture *texture;
+  SDBlendMode blendMode;
+} SoftwareTriangle;
+
+typedef struct SoftwareVertex {
+  SDVec2 pos;  // in window pixels with rows from the top
+  float texCoord[2];
+  float color[4];  // Pre-multiplied
+} SoftwareVertex;
+
+typedef struct SoftwareBin {
+  int *triangles;
+  int numTriangle;
+  int capacity;
+} SoftwareBin;
+
+static struct {
+  int width;
+  int height;
+  int numTileX;
+  int numTileY;
+  SoftwareBin *bins;
+
+  SoftwareTriangle *triangles;
+  int numTriangle;
+  int triangleCapacity;
+
+  float *colors;          // Linear pre-multiplied RGBA of the frame
+  unsigned char *pixels;  // sRGB encoded RGBA8 of the last frame, from the top
+
+  float srgbToLinear[256];
+  unsigned char linearToSRGB[SRGB_ENCODE_STEPS + 1];
+} SOFTWARE;
+
+extern void InitSoftwareRasterizer(void) {
+  for (int i = 0; i < 256; ++i) {
+    float srgb = i / 255.0f;
+    SOFTWARE.srgbToLinear[i] = srgb <= 0.04045f
+                                   ? srgb / 12.92f
+                                   : powf((srgb + 0.055f) / 1.055f, 2.4f);
+  }
+  for (int i = 0; i <= SRGB_ENCODE_STEPS; ++i) {
+    float linear = (float)i / SRGB_ENCODE_STEPS;
+    float srgb = linear <= 0.0031308f
+                     ? linear * 12.92f
+                     : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+    SOFTWARE.linearToSRGB[i] = (unsigned char)(srgb * 255.0f + 0.5f);
+  }
+
+  // Workers are started here on the main thread, not by the first frame on a
+  // render thread racing the main thread's own first parallel loop
+  GetNumWorker();
+}
+
+extern void CreateSoftwareTexture(SDTexture *texture,
+                                  const unsigned char *pixels, int stride) {
+  size_t size = (size_t)stride * texture->actualHeight;
+  texture->texels = malloc(size);
+  memcpy(texture->texels, pixels, size);
+  texture->texelStride = stride;
+}
+
+extern void BeginSoftwareFrame(int width, int height) {
+  if (width != SOFTWARE.width || height != SOFTWARE.height) {
+    for (int i = 0; i < SOFTWARE.numTileX * SOFTWARE.numTileY; ++i) {
+      free(SOFTWARE.bins[i].triangles);
+    }
+    free(SOFTWARE.bins);
+    free(SOFTWARE.colors);
+    free(SOFTWARE.pixels);
+
+    SOFTWARE.width = width;
+    SOFTWARE.height = height;
+    SOFTWARE.numTileX = (width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+    SOFTWARE.numTileY = (height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+    SOFTWARE.bins = calloc((size_t)SOFTWARE.numTileX * SOFTWARE.numTileY,
+                           sizeof(SoftwareBin));
+    SOFTWARE.colors = malloc((size_t)width * height * 4 * sizeof(float));
+    SOFTWARE.pixels = calloc((size_t)width * height, 4);
+  }
+
+  SOFTWARE.numTriangle = 0;
+  for (int i = 0; i < SOFTWARE.numTileX * SOFTWARE.numTileY; ++i) {
+    SOFTWARE.bins[i].numTriangle = 0;
+  }
+}
+
+static int MinI(int a, int b) { return a < b ? a : b; }
+
+static int MaxI(int a, int b) { return a > b ? a : b; }
+
+static int ClampI(int x, int min, int max) { return MinI(MaxI(x, min), max); }
+
+static void AddToBin(SoftwareBin *bin, int triangle) {
+  if (bin->numTriangle == bin->capacity) {
+    bin->capacity = bin->capacity > 0 ? bin->capacity * 2 : 256;
+    bin->triangles =
+        realloc(bin->triangles, sizeof(int) * (size_t)bin->capacity);
+  }
+  bin->triangles[bin->numTriangle++] = triangle;
+}
+
+// Plane of an attribute with values a at the vertices, as its value at the
+// center of pixel (0, 0) and its steps along x and y
+static void SetupPlane(const float *x, const float *y, const float *a,
+                       float invArea, float *origin, float *dx, float *dy) {
+  float a10 = a[1] - a[0];
+  float a20 = a[2] - a[0];
+  *dx = (a10 * (y[2] - y[0]) - a20 * (y[1] - y[0])) * invArea;
+  *dy = (a20 * (x[1] - x[0]) - a10 * (x[2] - x[0])) * invArea;
+  *origin = a[0] + *dx * (0.5f - x[0]) + *dy * (0.5f - y[0]);
+}
+
+// Clipped to box
+static void AddSoftwareTriangle(const SoftwareVertex *vertices, const int *box,
+                                const SDTexture *texture,
+                                SDBlendMode blendMode) {
+  SDVec2 pos[3] = {vertices[0].pos, vertices[1].pos, vertices[2].pos};
+  int32_t fx[3];
+  int32_t fy[3];
+  for (int i = 0; i < 3; ++i) {
+    fx[i] = (int32_t)lrintf(pos[i].x * SUBPIXEL_ONE);
+    fy[i] = (int32_t)lrintf(pos[i].y * SUBPIXEL_ONE);
+  }
+
+  int64_t area = (int64_t)(fx[1] - fx[0]) * (fy[2] - fy[0]) -
+                 (int64_t)(fy[1] - fy[0]) * (fx[2] - fx[0]);
+  if (area == 0) {
+    return;
+  }
+  // Nothing is culled, wind the other way round instead
+  int order[3] = {0, 1, 2};
+  if (area < 0) {
+    order[1] = 2;
+    order[2] = 1;
+  }
+
+  float minX = SDMinF(pos[0].x, SDMinF(pos[1].x, pos[2].x));
+  float minY = SDMinF(pos[0].y, SDMinF(pos[1].y, pos[2].y));
+  float maxX = SDMaxF(pos[0].x, SDMaxF(pos[1].x, pos[2].x));
+  float maxY = SDMaxF(pos[0].y, SDMaxF(pos[1].y, pos[2].y));
+  int x0 = (int)SDMaxF(SDFloorF(minX), (float)box[0]);
+  int y0 = (int)SDMaxF(SDFloorF(minY), (float)box[1]);
+  int x1 = (int)SDMinF(SDCeilF(maxX), (float)box[2] - 1);
+  int y1 = (int)SDMinF(SDCeilF(maxY), (float)box[3] - 1);
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+
+  if (SOFTWARE.numTriangle == SOFTWARE.triangleCapacity) {
+    SOFTWARE.triangleCapacity = SOFTWARE.triangleCapacity > 0
+                                    ? SOFTWARE.triangleCapacity * 2
+                                    : 1024;
+    SOFTWARE.triangles =
+        realloc(SOFTWARE.triangles,
+                sizeof(SoftwareTriangle) * (size_t)SOFTWARE.triangleCapacity);
+  }
+  int index = SOFTWARE.numTriangle++;
+  SoftwareTriangle *triangle = &SOFTWARE.triangles[index];
+
+  float x[3];
+  float y[3];
+  for (int i = 0; i < 3; ++i) {
+    triangle->x[i] = fx[order[i]];
+    triangle->y[i] = fy[order[i]];
+    x[i] = pos[order[i]].x;
+    y[i] = pos[order[i]].y;
+  }
+
+  // Edge i is the one facing vertex i. Top and left edges own the pixels
+  // exactly on them, so pixels shared by two triangles are drawn once.
+  for (int i = 0; i < 3; ++i) {
+    int a = (i + 1) % 3;
+    int b = (i + 2) % 3;
+    int32_t dx = triangle->x[b] - triangle->x[a];
+    int32_t dy = triangle->y[b] - triangle->y[a];
+    int isTopLeft = dy < 0 || (dy == 0 && dx > 0);
+    triangle->bias[i] = isTopLeft ? 0 : -1;
+  }
+
+  triangle->minX = x0;
+  triangle->minY = y0;
+  triangle->maxX = x1;
+  triangle->maxY = y1;
+
+  float invArea = 1.0f / ((x[1] - x[0]) * (y[2] - y[0]) -
+                          (y[1] - y[0]) * (x[2] - x[0]));
+  for (int c = 0; c < 4; ++c) {
+    float a[3];
+    for (int i = 0; i < 3; ++i) {
+      a[i] = vertices[order[i]].color[c];
+    }
+    SetupPlane(x, y, a, invArea, &triangle->color[0][c],
+               &triangle->color[1][c], &triangle->color[2][c]);
+  }
+  for (int c = 0; c < 2; ++c) {
+    float a[3];
+    for (int i = 0; i < 3; ++i) {
+      a[i] = vertices[order[i]].texCoord[c];
+    }
+    SetupPlane(x, y, a, invArea, &triangle->texCoord[0][c],
+               &triangle->texCoord[1][c], &triangle->texCoord[2][c]);
+  }
+
+  triangle->texture = texture;
+  triangle->blendMode = blendMode;
+
+  for (int ty = y0 / SOFTWARE_TILE_SIZE; ty <= y1 / SOFTWARE_TILE_SIZE;
+       ++ty) {
+    for (int tx = x0 / SOFTWARE_TILE_SIZE; tx <= x1 / SOFTWARE_TILE_SIZE;
+         ++tx) {
+      AddToBin(&SOFTWARE.bins[ty * SOFTWARE.numTileX + tx], index);
+    }
+  }
+}
+
+// Scissor box in pixels from the top, as {minX, minY, maxX, maxY}
+static void GetSoftwareScissorBox(int box[4]) {
+  int scissor[4];
+  box[0] = 0;
+  box[1] = 0;
+  box[2] = SOFTWARE.width;
+  box[3] = SOFTWARE.height;
+  if (GetNullGLScissor(scissor)) {
+    box[0] = MaxI(scissor[0], 0);
+    box[1] = MaxI(SOFTWARE.height - scissor[1] - scissor[3], 0);
+    box[2] = MinI(scissor[0] + scissor[2], SOFTWARE.width);
+    box[3] = MinI(SOFTWARE.height - scissor[1], SOFTWARE.height);
+  }
+}
+
+static SDVec2 ClipToSoftwareWindow(SDVec2 clip) {
+  return SDV2((clip.x + 1.0f) * SOFTWARE.width * 0.5f,
+              (1.0f - clip.y) * SOFTWARE.height * 0.5f);
+}
+
+extern void DrawSoftwareBatch(const SDTexture *texture, SDBlendMode blendMode,
+                              SDMat3 viewProjection,
+                              const DrawTextureVertexAttrib *vertices,
+                              const unsigned int *indices, int numIndex) {
+  int box[4];
+  GetSoftwareScissorBox(box);
+
+  for (int i = 0; i + 2 < numIndex; i += 3) {
+    SoftwareVertex triangle[3];
+    for (int j = 0; j < 3; ++j) {
+      const DrawTextureVertexAttrib *v = &vertices[indices[i + j]];
+      SDMat3 transform;
+      float *m = (float *)&transform;
+      memcpy(m, v->transform0, sizeof(v->transform0));
+      memcpy(m + 3, v->transform1, sizeof(v->transform1));
+      memcpy(m + 6, v->transform2, sizeof(v->transform2));
+      SDVec2 clip =
+          SDDotM3V2(viewProjection, SDDotM3V2(transform, SDV2(v->pos[0],
+                                                               v->pos[1])));
+      triangle[j].pos = ClipToSoftwareWindow(clip);
+      memcpy(triangle[j].texCoord, v->texCoord, sizeof(v->texCoord));
+      memcpy(triangle[j].color, v->color, sizeof(v->color));
+    }
+    AddSoftwareTriangle(triangle, box, texture, blendMode);
+  }
+}
+
+extern void DrawSoftwareMesh(const SDTexture *texture, SDMat3 MVP,
+                             SDColor tintColor, const MeshVertex *vertices,
+                             const void *indices, GLenum indexType,
+                             int numIndex) {
+  int box[4];
+  GetSoftwareScissorBox(box);
+  const float tint[4] = {tintColor.r, tintColor.g, tintColor.b, tintColor.a};
+
+  for (int i = 0; i + 2 < numIndex; i += 3) {
+    SoftwareVertex triangle[3];
+    for (int j = 0; j < 3; ++j) {
+      unsigned int index =
+          indexType == GL_UNSIGNED_SHORT
+              ? ((const unsigned short *)indices)[i + j]
+              : ((const unsigned int *)indices)[i + j];
+      const MeshVertex *v = &vertices[index];
+      triangle[j].pos =
+          ClipToSoftwareWindow(SDDotM3V2(MVP, SDV2(v->pos[0], v->pos[1])));
+      memcpy(triangle[j].texCoord, v->texCoord, sizeof(v->texCoord));
+      // The mesh program multiplies the vertex color by the tint
+      for (int c = 0; c < 4; ++c) {
+        triangle[j].color[c] = v->color[c] * tint[c];
+      }
+    }
+    AddSoftwareTriangle(triangle, box, texture, SD_BLEND_MODE_ALPHA);
+  }
+}
+
+// Nearest texel, clamped to the edges, in linear pre-multiplied RGBA
+static void SampleSoftwareTexture(const SDTexture *texture, float u, float v,
+                                  float *texel) {
+  int x = ClampI((int)SDFloorF(u * texture->actualWidth), 0,
+                   texture->actualWidth - 1);
+  int y = ClampI((int)SDFloorF(v * texture->actualHeight), 0,
+                   texture->actualHeight - 1);
+
+  if (texture->format == SD_IMAGE_FORMAT_A8) {
+    // Pre-multiplied white, like the GL swizzle
+    float a = texture->texels[y * texture->texelStride + x] / 255.0f;
+    texel[0] = texel[1] = texel[2] = texel[3] = a;
+  } else {
+    const unsigned char *p = texture->texels + y * texture->texelStride + x * 4;
+    texel[0] = SOFTWARE.srgbToLinear[p[0]];
+    texel[1] = SOFTWARE.srgbToLinear[p[1]];
+    texel[2] = SOFTWARE.srgbToLinear[p[2]];
+    texel[3] = p[3] / 255.0f;
+  }
+}
+
+// Blend src over dst the way ExecuteFlushBatch sets up GL blending, with
+// alpha always the pre-multiplied over operator. The result is clamped like
+// GL stores it in a normalized target, which additive colors overflow.
+static void BlendSoftwarePixel(float *dst, const float *texel,
+                               const float *color, SDBlendMode blendMode) {
+#ifdef SD_SSE2
+  __m128 one = _mm_set1_ps(1.0f);
+  __m128 alphaMask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+  __m128 src = _mm_mul_ps(_mm_loadu_ps(texel), _mm_loadu_ps(color));
+  __m128 d = _mm_loadu_ps(dst);
+  __m128 srcAlpha = _mm_shuffle_ps(src, src, _MM_SHUFFLE(3, 3, 3, 3));
+
+  switch (blendMode) {
+    case SD_BLEND_MODE_MULTIPLY: {
+      // src * (dst.rgb, 1) + dst * (1 - src.a)
+      __m128 factor = _mm_or_ps(_mm_andnot_ps(alphaMask, d),
+                                _mm_and_ps(alphaMask, one));
+      d = _mm_add_ps(_mm_mul_ps(src, factor),
+                     _mm_mul_ps(d, _mm_sub_ps(one, srcAlpha)));
+    } break;
+    case SD_BLEND_MODE_SCREEN: {
+      // src + dst * (1 - (src.rgb, src.a))
+      d = _mm_add_ps(src, _mm_mul_ps(d, _mm_sub_ps(one, src)));
+    } break;
+    default: {
+      d = _mm_add_ps(src, _mm_mul_ps(d, _mm_sub_ps(one, srcAlpha)));
+    } break;
+  }
+
+  _mm_storeu_ps(dst, _mm_min_ps(_mm_max_ps(d, _mm_setzero_ps()), one));
+#else
+  float src[4];
+  for (int c = 0; c < 4; ++c) {
+    src[c] = texel[c] * color[c];
+  }
+
+  for (int c = 0; c < 4; ++c) {
+    float keep = 1.0f - src[3];
+    if (blendMode == SD_BLEND_MODE_MULTIPLY && c < 3) {
+      dst[c] = src[c] * dst[c] + dst[c] * keep;
+    } else if (blendMode == SD_BLEND_MODE_SCREEN) {
+      dst[c] = src[c] + dst[c] * (1.0f - src[c]);
+    } else {
+      dst[c] = src[c] + dst[c] * keep;
+    }
+    dst[c] = SDClampF(dst[c], 0.0f, 1.0f);
+  }
+#endif
+}
+
+static void RasterizeSoftwareTriangle(const SoftwareTriangle *triangle,
+                                      int tileMinX, int tileMinY,
+                                      int tileMaxX, int tileMaxY) {
+  int x0 = MaxI(triangle->minX, tileMinX);
+  int y0 = MaxI(triangle->minY, tileMinY);
+  int x1 = MinI(triangle->maxX, tileMaxX);
+  int y1 = MinI(triangle->maxY, tileMaxY);
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+
+  // Edge functions at the center of pixel (x0, y0) and their steps
+  int64_t px = ((int64_t)x0 << SUBPIXEL_BITS) + SUBPIXEL_ONE / 2;
+  int64_t py = ((int64_t)y0 << SUBPIXEL_BITS) + SUBPIXEL_ONE / 2;
+  int64_t rowEdge[3];
+  int64_t stepX[3];
+  int64_t stepY[3];
+  for (int i = 0; i < 3; ++i) {
+    int a = (i + 1) % 3;
+    int b = (i + 2) % 3;
+    int64_t dx = triangle->x[b] - triangle->x[a];
+    int64_t dy = triangle->y[b] - triangle->y[a];
+    rowEdge[i] = dx * (py - triangle->y[a]) - dy * (px - triangle->x[a]) +
+                 triangle->bias[i];
+    stepX[i] = -dy * SUBPIXEL_ONE;
+    stepY[i] = dx * SUBPIXEL_ONE;
+  }
+
+  const float *colorDx = triangle->color[1];
+  const SDTexture *texture = triangle->texture;
+
+  for (int y = y0; y <= y1; ++y) {
+    int64_t e0 = rowEdge[0];
+    int64_t e1 = rowEdge[1];
+    int64_t e2 = rowEdge[2];
+
+    float color[4];
+    for (int c = 0; c < 4; ++c) {
+      color[c] = triangle->color[0][c] + colorDx[c] * x0 +
+                 triangle->color[2][c] * y;
+    }
+    float u = triangle->texCoord[0][0] + triangle->texCoord[1][0] * x0 +
+              triangle->texCoord[2][0] * y;
+    float v = triangle->texCoord[0][1] + triangle->texCoord[1][1] * x0 +
+              triangle->texCoord[2][1] * y;
+
+    float *dst = SOFTWARE.colors + ((size_t)y * SOFTWARE.width + x0) * 4;
+    for (int x = x0; x <= x1; ++x) {
+      if ((e0 | e1 | e2) >= 0) {
+        float texel[4];
+        SampleSoftwareTexture(texture, u, v, texel);
+        BlendSoftwarePixel(dst, texel, color, triangle->blendMode);
+      }
+
+      e0 += stepX[0];
+      e1 += stepX[1];
+      e2 += stepX[2];
+      for (int c = 0; c < 4; ++c) {
+        color[c] += colorDx[c];
+      }
+      u += triangle->texCoord[1][0];
+      v += triangle->texCoord[1][1];
+      dst += 4;
+    }
+
+    rowEdge[0] += stepY[0];
+    rowEdge[1] += stepY[1];
+    rowEdge[2] += stepY[2];
+  }
+}
+
+static unsigned char EncodeSRGB(float linear) {
+  int index = (int)(SDClampF(linear, 0.0f, 1.0f) * SRGB_ENCODE_STEPS + 0.5f);
+  return SOFTWARE.linearToSRGB[index];
+}
+
+static void RasterizeSoftwareTiles(void *data, int begin, int end,
+                                   int index) {
+  for (int tile = begin; tile < end; ++tile) {
+    int minX = tile % SOFTWARE.numTileX * SOFTWARE_TILE_SIZE;
+    int minY = tile / SOFTWARE.numTileX * SOFTWARE_TILE_SIZE;
+    int maxX = MinI(minX + SOFTWARE_TILE_SIZE, SOFTWARE.width) - 1;
+    int maxY = MinI(minY + SOFTWARE_TILE_SIZE, SOFTWARE.height) - 1;
+
+    // Cleared to transparent black like the GL path
+    for (int y = minY; y <= maxY; ++y) {
+      memset(SOFTWARE.colors + ((size_t)y * SOFTWARE.width + minX) * 4, 0,
+             (size_t)(maxX - minX + 1) * 4 * sizeof(float));
+    }
+
+    const SoftwareBin *bin = &SOFTWARE.bins[tile];
+    for (int i = 0; i < bin->numTriangle; ++i) {
+      RasterizeSoftwareTriangle(&SOFTWARE.triangles[bin->triangles[i]], minX,
+                                minY, maxX, maxY);
+    }
+
+    for (int y = minY; y <= maxY; ++y) {
+      size_t offset = ((size_t)y * SOFTWARE.width + minX) * 4;
+      const float *src = SOFTWARE.colors + offset;
+      unsigned char *dst = SOFTWARE.pixels + offset;
+      for (int x = minX; x <= maxX; ++x) {
+        dst[0] = EncodeSRGB(src[0]);
+        dst[1] = EncodeSRGB(src[1]);
+        dst[2] = EncodeSRGB(src[2]);
+        dst[3] = (unsigned char)(SDClampF(src[3], 0.0f, 1.0f) * 255.0f + 0.5f);
+        src += 4;
+        dst += 4;
+      }
+    }
+  }
+}
+
+extern void EndSoftwareFrame(void) {
+  ParallelFor(RasterizeSoftwareTiles, NULL,
+              SOFTWARE.numTileX * SOFTWARE.numTileY, 1);
+}
+
+extern void ReadSoftwarePixels(int x, int y, int width, int height,
+                               unsigned char *pixels) {
+  for (int row = 0; row < height; ++row) {
+    unsigned char *dst = pixels + (size_t)row * width * 4;
+    // Rows of GL reads start at the bottom
+    int srcY = SOFTWARE.height - 1 - (y + row);
+    if (!SOFTWARE.pixels || srcY < 0 || srcY >= SOFTWARE.height ||
+        x + width > SOFTWARE.width) {
+      memset(dst, 0, (size_t)width * 4);
+      continue;
+    }
+    memcpy(dst, SOFTWARE.pixels + ((size_t)srcY * SOFTWARE.width + x) * 4,
+           (size_t)width * 4);
+  }
+}
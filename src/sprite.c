@@ -0,0 +1,567 @@
+#include "sword/sprite.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "command.h"
+#include "render_internal.h"
+
+// Repairing the last order of a sprite layer gives up after shifting sprites
+// this many times per sprite, sorting from scratch is cheaper from there
+#define MAX_SORT_SHIFT_PER_SPRITE 4
+
+// Dirty ranges closer than this many slots are merged into one upload, a
+// slightly larger upload is cheaper than another glBufferSubData call
+#define MAX_DIRTY_GAP 8
+
+struct SDSpriteBuffer {
+  SDTexture *texture;
+  int capacity;
+  int numSlot;  // Slots ever used, the draw covers all of them
+
+  int *freeSlots;  // Removed slots waiting for reuse
+  int numFreeSlot;
+  unsigned char *isFree;  // By slot, whether it is in freeSlots
+
+  // CPU copy of the vertex buffer and one dirty bit per slot
+  MeshVertex *vertices;
+  unsigned long long *dirtyBits;
+  int numDirtyWord;
+
+  BufferRange range;  // Vertices of all slots, then their quad indices
+};
+
+SDAPI SDSprite SDMakeSprite(const SDTexture *texture) {
+  SDFloat pixelToPoint = SDGetPixelToPoint();
+  SDSprite sprite = {
+      .transform = SDIdentityM3(),
+      .dstRect = SDRectMinMax(
+          SDV2(0.0f, 0.0f),
+          SDV2(texture->width * pixelToPoint, texture->height * pixelToPoint)),
+      .srcRect = SDRectMinMax(SDV2(0.0f, 0.0f), SDV2((SDFloat)texture->width,
+                                                     (SDFloat)texture->height)),
+      .tintColor = SDRGBA(1.0f, 1.0f, 1.0f, 1.0f),
+  };
+  return sprite;
+}
+
+static void WriteQuadIndices(unsigned int *indices, int numQuad) {
+  for (int i = 0; i < numQuad; ++i) {
+    unsigned int base = (unsigned int)i * 4;
+    unsigned int *quad = indices + i * 6;
+    quad[0] = base;
+    quad[1] = base + 1;
+    quad[2] = base + 3;
+    quad[3] = base + 1;
+    quad[4] = base + 2;
+    quad[5] = base + 3;
+  }
+}
+
+static void UploadQuadIndices(BufferRange range, size_t offset,
+                              int capacity) {
+  unsigned int *indices = malloc((size_t)capacity * 6 * sizeof(*indices));
+  WriteQuadIndices(indices, capacity);
+  UploadBufferRange(range, offset, indices,
+                    (size_t)capacity * 6 * sizeof(*indices));
+  free(indices);
+}
+
+SDAPI SDSpriteBuffer *SDCreateSpriteBuffer(SDTexture *texture, int capacity) {
+  SDSpriteBuffer *spriteBuffer = malloc(sizeof(SDSpriteBuffer));
+  spriteBuffer->texture = texture;
+  spriteBuffer->capacity = capacity;
+  spriteBuffer->numSlot = 0;
+  spriteBuffer->freeSlots = malloc((size_t)capacity * sizeof(int));
+  spriteBuffer->numFreeSlot = 0;
+  spriteBuffer->isFree = calloc((size_t)capacity, 1);
+  spriteBuffer->vertices = malloc((size_t)capacity * 4 * sizeof(MeshVertex));
+  spriteBuffer->numDirtyWord = (capacity + 63) / 64;
+  spriteBuffer->dirtyBits =
+      calloc((size_t)spriteBuffer->numDirtyWord, sizeof(unsigned long long));
+
+  size_t vertexSize = (size_t)capacity * 4 * sizeof(MeshVertex);
+  size_t indexSize = (size_t)capacity * 6 * sizeof(unsigned int);
+  spriteBuffer->range = AllocBufferRange(&CTX.rc->meshArena,
+                                         vertexSize + indexSize,
+                                         sizeof(MeshVertex));
+  UploadQuadIndices(spriteBuffer->range, vertexSize, capacity);
+
+  return spriteBuffer;
+}
+
+static void ExecuteDestroySpriteBuffer(void *data) {
+  SDSpriteBuffer *spriteBuffer = *(SDSpriteBuffer **)data;
+
+  free(spriteBuffer->freeSlots);
+  free(spriteBuffer->isFree);
+  free(spriteBuffer->vertices);
+  free(spriteBuffer->dirtyBits);
+  free(spriteBuffer);
+}
+
+SDAPI void SDDestroySpriteBuffer(SDSpriteBuffer **ptr) {
+  FreeBufferRange((*ptr)->range);
+
+  SDSpriteBuffer **command =
+      BeginCommand(ExecuteDestroySpriteBuffer, sizeof(SDSpriteBuffer *));
+  *command = *ptr;
+  CommitCommand();
+
+  *ptr = NULL;
+}
+
+static void MarkDirty(SDSpriteBuffer *spriteBuffer, int slot) {
+  spriteBuffer->dirtyBits[slot / 64] |= 1ull << (slot % 64);
+}
+
+// Transform the sprite into its slot's four vertices, in the same order as the
+// sprite batch: top right, bottom right, bottom left, top left
+static void WriteSprite(SDSpriteBuffer *spriteBuffer, int slot,
+                        const SDSprite *sprite) {
+  SDTexture *texture = spriteBuffer->texture;
+  SDVec2 texSize =
+      SDV2((SDFloat)texture->actualWidth, (SDFloat)texture->actualHeight);
+  SDRect dst = sprite->dstRect;
+  SDRect tex = SDRectMinMax(SDHadamardDivV2(sprite->srcRect.min, texSize),
+                            SDHadamardDivV2(sprite->srcRect.max, texSize));
+
+  SDVec2 pos[4] = {dst.max, SDV2(dst.max.x, dst.min.y), dst.min,
+                   SDV2(dst.min.x, dst.max.y)};
+  SDVec2 texCoord[4] = {tex.max, SDV2(tex.max.x, tex.min.y), tex.min,
+                        SDV2(tex.min.x, tex.max.y)};
+  SDColor color = sprite->tintColor;
+
+  MeshVertex *v = spriteBuffer->vertices + slot * 4;
+  for (int i = 0; i < 4; ++i) {
+    SDVec2 p = SDDotM3V2(sprite->transform, pos[i]);
+    v[i] = (MeshVertex){{p.x, p.y},
+                        {texCoord[i].x, texCoord[i].y},
+                        {color.r, color.g, color.b, color.a}};
+  }
+
+  MarkDirty(spriteBuffer, slot);
+}
+
+SDAPI int SDAddSprite(SDSpriteBuffer *spriteBuffer, const SDSprite *sprite) {
+  int slot;
+  if (spriteBuffer->numFreeSlot > 0) {
+    slot = spriteBuffer->freeSlots[--spriteBuffer->numFreeSlot];
+  } else if (spriteBuffer->numSlot < spriteBuffer->capacity) {
+    slot = spriteBuffer->numSlot++;
+  } else {
+    return -1;
+  }
+
+  spriteBuffer->isFree[slot] = 0;
+  WriteSprite(spriteBuffer, slot, sprite);
+
+  return slot;
+}
+
+SDAPI void SDSetSprite(SDSpriteBuffer *spriteBuffer, int slot,
+                       const SDSprite *sprite) {
+  SDAssert(slot >= 0 && slot < spriteBuffer->numSlot);
+
+  WriteSprite(spriteBuffer, slot, sprite);
+}
+
+SDAPI void SDRemoveSprite(SDSpriteBuffer *spriteBuffer, int slot) {
+  // A slot removed twice would be handed out twice
+  if (slot < 0 || slot >= spriteBuffer->numSlot ||
+      spriteBuffer->isFree[slot]) {
+    return;
+  }
+
+  // Collapse the quad so it produces no fragments until the slot is reused
+  MeshVertex *v = spriteBuffer->vertices + slot * 4;
+  memset(v, 0, 4 * sizeof(MeshVertex));
+  MarkDirty(spriteBuffer, slot);
+
+  spriteBuffer->freeSlots[spriteBuffer->numFreeSlot++] = slot;
+  spriteBuffer->isFree[slot] = 1;
+}
+
+static void UploadSlots(SDSpriteBuffer *spriteBuffer, int first, int end) {
+  UploadBufferRange(spriteBuffer->range, (size_t)first * 4 * sizeof(MeshVertex),
+                    spriteBuffer->vertices + first * 4,
+                    (size_t)(end - first) * 4 * sizeof(MeshVertex));
+}
+
+// Upload runs of dirty slots, merging runs separated by small gaps. Clean
+// words of 64 slots are skipped without looking at their slots.
+static void UploadDirtySlots(SDSpriteBuffer *spriteBuffer) {
+  int rangeFirst = -1;
+  int rangeEnd = -1;
+
+  for (int word = 0; word < spriteBuffer->numDirtyWord; ++word) {
+    unsigned long long bits = spriteBuffer->dirtyBits[word];
+    if (!bits) {
+      continue;
+    }
+    spriteBuffer->dirtyBits[word] = 0;
+
+    for (int bit = 0; bits; ++bit, bits >>= 1) {
+      if (!(bits & 1)) {
+        continue;
+      }
+
+      int slot = word * 64 + bit;
+      if (rangeFirst >= 0 && slot - rangeEnd <= MAX_DIRTY_GAP) {
+        rangeEnd = slot + 1;
+        continue;
+      }
+
+      if (rangeFirst >= 0) {
+        UploadSlots(spriteBuffer, rangeFirst, rangeEnd);
+      }
+      rangeFirst = slot;
+      rangeEnd = slot + 1;
+    }
+  }
+
+  if (rangeFirst >= 0) {
+    UploadSlots(spriteBuffer, rangeFirst, rangeEnd);
+  }
+}
+
+typedef struct DrawSpriteBufferCommand {
+  const SDSpriteBuffer *spriteBuffer;
+  SDMat3 MVP;
+  SDColor tintColor;
+  int numSlot;
+} DrawSpriteBufferCommand;
+
+static void ExecuteDrawSpriteBuffer(void *data) {
+  const DrawSpriteBufferCommand *command = data;
+  RenderContext *rc = CTX.rc;
+  MeshProgram *meshProgram = &rc->meshProgram;
+  const SDSpriteBuffer *spriteBuffer = command->spriteBuffer;
+  SDColor tintColor = command->tintColor;
+
+  if (!meshProgram->program) {
+    InitMeshProgram(meshProgram);
+  }
+
+  glUseProgram(meshProgram->program);
+  glUniformMatrix3fv(meshProgram->MVPLocation, 1, GL_FALSE,
+                     (const GLfloat *)&command->MVP);
+  glUniform4f(meshProgram->tintColorLocation, tintColor.r, tintColor.g,
+              tintColor.b, tintColor.a);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, spriteBuffer->texture->id);
+
+  const BufferRange *range = &spriteBuffer->range;
+  size_t indexOffset =
+      range->offset + (size_t)spriteBuffer->capacity * 4 * sizeof(MeshVertex);
+  glBindVertexArray(range->block->vao);
+  glDrawElementsBaseVertex(GL_TRIANGLES, command->numSlot * 6,
+                           GL_UNSIGNED_INT, (void *)indexOffset,
+                           (GLint)(range->offset / sizeof(MeshVertex)));
+  glBindVertexArray(0);
+
+  if (CTX.renderBackend == SD_RENDER_BACKEND_SOFTWARE) {
+    const unsigned char *buffer = GetNullGLBufferData(range->block->buffer);
+    DrawSoftwareMesh(spriteBuffer->texture, command->MVP, tintColor,
+                     (const MeshVertex *)(buffer + range->offset),
+                     buffer + indexOffset, GL_UNSIGNED_INT,
+                     command->numSlot * 6);
+  }
+
+  rc->numDrawCall++;
+}
+
+// The CPU copy is what the draw uploads, removed slots are degenerate quads
+static void RecordSpriteBuffer(FrameRecorder *recorder,
+                               const SDSpriteBuffer *spriteBuffer,
+                               SDMat3 transform, SDColor tintColor) {
+  int numSlot = spriteBuffer->numSlot;
+  MeshVertex *vertices;
+  unsigned int *indices;
+  int mesh = AddRecordedMesh(recorder, NULL, spriteBuffer->texture,
+                             numSlot * 4, numSlot * 6, &vertices, &indices);
+  memcpy(vertices, spriteBuffer->vertices,
+         (size_t)numSlot * 4 * sizeof(MeshVertex));
+  WriteQuadIndices(indices, numSlot);
+  RecordMeshDraw(recorder, mesh, transform, tintColor);
+}
+
+SDAPI void SDDrawSpriteBuffer(SDSpriteBuffer *spriteBuffer, SDMat3 transform,
+                              SDColor tintColor) {
+  RenderContext *rc = CTX.rc;
+
+  if (spriteBuffer->numSlot == spriteBuffer->numFreeSlot) {
+    return;
+  }
+
+  if (rc->recorder) {
+    RecordSpriteBuffer(rc->recorder, spriteBuffer, transform, tintColor);
+  }
+
+  FlushBatch(rc);
+  ApplyClipScissor(rc);
+
+  UploadDirtySlots(spriteBuffer);
+
+  DrawSpriteBufferCommand *command =
+      BeginCommand(ExecuteDrawSpriteBuffer, sizeof(DrawSpriteBufferCommand));
+  command->spriteBuffer = spriteBuffer;
+  command->MVP = SDDotM3(rc->viewProjection, transform);
+  command->tintColor = tintColor;
+  command->numSlot = spriteBuffer->numSlot;
+  CommitCommand();
+}
+
+// ----------------------------------------------------------------------------
+// Sprite Layer
+// ----------------------------------------------------------------------------
+
+struct SDSpriteLayer {
+  SDSpriteBuffer *spriteBuffer;  // Slots hold the sprites in draw order
+  int capacity;
+
+  // By handle
+  SDSprite *sprites;
+  SDFloat *sortKeys;
+  unsigned char *isChanged;  // Since the last draw
+  unsigned char *isRemoved;  // Still in order until the next draw
+  int numHandle;             // Handles ever used
+  int *freeHandles;
+  int numFreeHandle;
+
+  // Handles in the draw order of the last frame, new ones appended
+  int *order;
+  int numOrder;
+  int numRemoved;
+  int *drawnHandles;  // Handle whose sprite each slot holds, -1 for none
+
+  // Sort scratch, keys run parallel to order
+  uint32_t *keys;
+  uint32_t *tempKeys;
+  int *tempOrder;
+};
+
+SDAPI SDSpriteLayer *SDCreateSpriteLayer(SDTexture *texture, int capacity) {
+  SDSpriteLayer *spriteLayer = malloc(sizeof(SDSpriteLayer));
+  size_t count = (size_t)capacity;
+
+  spriteLayer->spriteBuffer = SDCreateSpriteBuffer(texture, capacity);
+  spriteLayer->capacity = capacity;
+  spriteLayer->sprites = malloc(count * sizeof(SDSprite));
+  spriteLayer->sortKeys = malloc(count * sizeof(SDFloat));
+  spriteLayer->isChanged = calloc(count, 1);
+  spriteLayer->isRemoved = calloc(count, 1);
+  spriteLayer->numHandle = 0;
+  spriteLayer->freeHandles = malloc(count * sizeof(int));
+  spriteLayer->numFreeHandle = 0;
+  spriteLayer->order = malloc(count * sizeof(int));
+  spriteLayer->numOrder = 0;
+  spriteLayer->numRemoved = 0;
+  spriteLayer->drawnHandles = malloc(count * sizeof(int));
+  for (int i = 0; i < capacity; ++i) {
+    spriteLayer->drawnHandles[i] = -1;
+  }
+  spriteLayer->keys = malloc(count * sizeof(uint32_t));
+  spriteLayer->tempKeys = malloc(count * sizeof(uint32_t));
+  spriteLayer->tempOrder = malloc(count * sizeof(int));
+
+  return spriteLayer;
+}
+
+SDAPI void SDDestroySpriteLayer(SDSpriteLayer **ptr) {
+  SDSpriteLayer *spriteLayer = *ptr;
+
+  SDDestroySpriteBuffer(&spriteLayer->spriteBuffer);
+  free(spriteLayer->sprites);
+  free(spriteLayer->sortKeys);
+  free(spriteLayer->isChanged);
+  free(spriteLayer->isRemoved);
+  free(spriteLayer->freeHandles);
+  free(spriteLayer->order);
+  free(spriteLayer->drawnHandles);
+  free(spriteLayer->keys);
+  free(spriteLayer->tempKeys);
+  free(spriteLayer->tempOrder);
+  free(spriteLayer);
+
+  *ptr = NULL;
+}
+
+SDAPI int SDAddLayerSprite(SDSpriteLayer *spriteLayer, const SDSprite *sprite,
+                           SDFloat sortKey) {
+  int handle;
+  if (spriteLayer->numFreeHandle > 0) {
+    handle = spriteLayer->freeHandles[--spriteLayer->numFreeHandle];
+  } else if (spriteLayer->numHandle < spriteLayer->capacity) {
+    handle = spriteLayer->numHandle++;
+  } else {
+    return -1;
+  }
+
+  spriteLayer->sprites[handle] = *sprite;
+  spriteLayer->sortKeys[handle] = sortKey;
+  spriteLayer->isChanged[handle] = 1;
+  spriteLayer->isRemoved[handle] = 0;
+  spriteLayer->order[spriteLayer->numOrder++] = handle;
+
+  return handle;
+}
+
+SDAPI void SDSetLayerSprite(SDSpriteLayer *spriteLayer, int handle,
+                            const SDSprite *sprite, SDFloat sortKey) {
+  SDAssert(handle >= 0 && handle < spriteLayer->numHandle &&
+           !spriteLayer->isRemoved[handle]);
+
+  spriteLayer->sprites[handle] = *sprite;
+  spriteLayer->sortKeys[handle] = sortKey;
+  spriteLayer->isChanged[handle] = 1;
+}
+
+SDAPI void SDRemoveLayerSprite(SDSpriteLayer *spriteLayer, int handle) {
+  if (handle < 0 || handle >= spriteLayer->numHandle ||
+      spriteLayer->isRemoved[handle]) {
+    return;
+  }
+
+  spriteLayer->isRemoved[handle] = 1;
+  spriteLayer->numRemoved++;
+}
+
+// Drop removed handles from the order, they can be reused from now on
+static void CompactOrder(SDSpriteLayer *spriteLayer) {
+  int numOrder = 0;
+
+  for (int i = 0; i < spriteLayer->numOrder; ++i) {
+    int handle = spriteLayer->order[i];
+    if (spriteLayer->isRemoved[handle]) {
+      spriteLayer->isRemoved[handle] = 0;
+      spriteLayer->freeHandles[spriteLayer->numFreeHandle++] = handle;
+    } else {
+      spriteLayer->order[numOrder++] = handle;
+    }
+  }
+
+  spriteLayer->numOrder = numOrder;
+  spriteLayer->numRemoved = 0;
+}
+
+// Float bits mapped so that comparing them unsigned orders the floats
+static uint32_t ToSortableKey(SDFloat key) {
+  uint32_t bits;
+  memcpy(&bits, &key, sizeof(bits));
+  return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+}
+
+// Insertion sort, linear in the number of sprites plus how far the out of
+// place ones move. Returns 0, with the order only partly sorted, once it has
+// shifted more than maxShift times.
+static int RepairOrder(uint32_t *keys, int *order, int count,
+                       long long maxShift) {
+  long long numShift = 0;
+
+  for (int i = 1; i < count; ++i) {
+    uint32_t key = keys[i];
+    if (keys[i - 1] <= key) {
+      continue;
+    }
+
+    int handle = order[i];
+    int j = i;
+    do {
+      keys[j] = keys[j - 1];
+      order[j] = order[j - 1];
+      --j;
+    } while (j > 0 && keys[j - 1] > key);
+    keys[j] = key;
+    order[j] = handle;
+
+    numShift += i - j;
+    if (numShift > maxShift) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+// LSD radix sort a byte at a time, stable so equal keys keep their last
+// order. Bytes every key shares, usually the high ones, cost a counting pass
+// only.
+static void RadixSortOrder(SDSpriteLayer *spriteLayer, int count) {
+  uint32_t *keys = spriteLayer->keys;
+  uint32_t *tempKeys = spriteLayer->tempKeys;
+  int *order = spriteLayer->order;
+  int *tempOrder = spriteLayer->tempOrder;
+
+  for (int shift = 0; shift < 32; shift += 8) {
+    int offsets[256] = {0};
+    for (int i = 0; i < count; ++i) {
+      offsets[(keys[i] >> shift) & 0xff]++;
+    }
+    if (offsets[(keys[0] >> shift) & 0xff] == count) {
+      continue;
+    }
+
+    int offset = 0;
+    for (int i = 0; i < 256; ++i) {
+      int bucketSize = offsets[i];
+      offsets[i] = offset;
+      offset += bucketSize;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      int dst = offsets[(keys[i] >> shift) & 0xff]++;
+      tempKeys[dst] = keys[i];
+      tempOrder[dst] = order[i];
+    }
+
+    uint32_t *swapKeys = keys;
+    keys = tempKeys;
+    tempKeys = swapKeys;
+    int *swapOrder = order;
+    order = tempOrder;
+    tempOrder = swapOrder;
+  }
+
+  if (order != spriteLayer->order) {
+    memcpy(spriteLayer->order, order, (size_t)count * sizeof(int));
+  }
+}
+
+SDAPI void SDDrawSpriteLayer(SDSpriteLayer *spriteLayer, SDMat3 transform,
+                             SDColor tintColor) {
+  SDSpriteBuffer *spriteBuffer = spriteLayer->spriteBuffer;
+  int *order = spriteLayer->order;
+
+  if (spriteLayer->numRemoved > 0) {
+    CompactOrder(spriteLayer);
+  }
+
+  int count = spriteLayer->numOrder;
+  if (count == 0) {
+    return;
+  }
+
+  for (int i = 0; i < count; ++i) {
+    spriteLayer->keys[i] = ToSortableKey(spriteLayer->sortKeys[order[i]]);
+  }
+  if (!RepairOrder(spriteLayer->keys, order, count,
+                   (long long)count * MAX_SORT_SHIFT_PER_SPRITE)) {
+    RadixSortOrder(spriteLayer, count);
+  }
+
+  // Slots keep their sprite unless it changed or another one moved in
+  for (int slot = 0; slot < count; ++slot) {
+    int handle = order[slot];
+    if (spriteLayer->drawnHandles[slot] != handle ||
+        spriteLayer->isChanged[handle]) {
+      WriteSprite(spriteBuffer, slot, &spriteLayer->sprites[handle]);
+      spriteLayer->drawnHandles[slot] = handle;
+    }
+    spriteLayer->isChanged[handle] = 0;
+  }
+  spriteBuffer->numSlot = count;
+
+  SDDrawSpriteBuffer(spriteBuffer, transform, tintColor);
+}
@@ -0,0 +1,547 @@
+#include "sword/tilemap.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "command.h"
+#include "render_internal.h"
+
+#define CHUNK_SIZE 32  // in tiles
+#define CHUNK_NUM_TILE (CHUNK_SIZE * CHUNK_SIZE)
+#define NO_TILE 0xFFFF
+
+const char TILEMAP_VERTEX_SHADER[] =
+    "#version 330 core                                                      \n"
+    "                                                                       \n"
+    "uniform mat3 MVP;                                                      \n"
+    "                                                                       \n"
+    "layout (location = 0) in vec2 aPos;                                    \n"
+    "layout (location = 1) in vec2 aTexCoord;                               \n"
+    "out vec2 vTexCoord;                                                    \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   gl_Position = vec4(MVP * vec3(aPos, 1), 1);                         \n"
+    "   vTexCoord = aTexCoord;                                              \n"
+    "}                                                                      \n";
+
+const char TILEMAP_FRAGMENT_SHADER[] =
+    "#version 330 core                                                      \n"
+    "                                                                       \n"
+    "uniform sampler2D texture0;                                            \n"
+    "uniform vec4 tintColor;                                                \n"
+    "                                                                       \n"
+    "in vec2 vTexCoord;                                                     \n"
+    "                                                                       \n"
+    "out vec4 fragColor;                                                    \n"
+    "                                                                       \n"
+    "void main() {                                                          \n"
+    "   // Textures are pre-multiplied at load                              \n"
+    "   vec4 texColor = texture(texture0, vTexCoord);                       \n"
+    "   fragColor = texColor * tintColor;                                   \n"
+    "}                                                                      \n";
+
+typedef struct TilemapVertex {
+  float pos[2];
+  float texCoord[2];
+} TilemapVertex;
+
+typedef struct TilemapChunk {
+  unsigned short tiles[CHUNK_NUM_TILE];
+  BufferRange range;  // Allocated when the chunk first has any tile
+  int numQuad;
+  int isDirty;
+} TilemapChunk;
+
+struct SDTilemap {
+  SDTexture *tileset;
+  int tileWidth;   // in pixel
+  int tileHeight;  // in pixel
+  int numColumn;   // Tiles per row in tileset
+  int numTile;     // In tileset, never more than NO_TILE
+  SDVec2 tileSize;   // in point
+  SDVec2 chunkSize;  // in point
+
+  int width;  // in tiles
+  int height;
+  int numChunkX;
+  int numChunkY;
+  TilemapChunk *chunks;
+
+  // Scratch memory for rebuilding one chunk
+  TilemapVertex *vertices;
+  // Scratch memory for the multi-draws of the visible chunks
+  const BufferBlock **drawBlocks;
+  GLsizei *drawCounts;
+  GLint *drawBaseVertices;
+  const void **drawOffsets;  // All 0, the chunks share the quad indices
+};
+
+static void InitTilemapProgram(TilemapProgram *tilemapProgram) {
+  // Every chunk draws a prefix of the same quad indices
+  unsigned short *indices = malloc(CHUNK_NUM_TILE * 6 * sizeof(*indices));
+  for (int i = 0; i < CHUNK_NUM_TILE; ++i) {
+    unsigned short base = (unsigned short)(i * 4);
+    unsigned short *quad = indices + i * 6;
+    quad[0] = base;
+    quad[1] = base + 1;
+    quad[2] = base + 2;
+    quad[3] = base;
+    quad[4] = base + 2;
+    quad[5] = base + 3;
+  }
+
+  glGenBuffers(1, &tilemapProgram->ebo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tilemapProgram->ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, CHUNK_NUM_TILE * 6 * sizeof(*indices),
+               indices, GL_STATIC_DRAW);
+  free(indices);
+
+  tilemapProgram->program =
+      CompileGLProgram(TILEMAP_VERTEX_SHADER, TILEMAP_FRAGMENT_SHADER);
+  if (!tilemapProgram->program) {
+    exit(EXIT_FAILURE);
+  }
+  glUseProgram(tilemapProgram->program);
+  glUniform1i(glGetUniformLocation(tilemapProgram->program, "texture0"), 0);
+  tilemapProgram->MVPLocation =
+      glGetUniformLocation(tilemapProgram->program, "MVP");
+  tilemapProgram->tintColorLocation =
+      glGetUniformLocation(tilemapProgram->program, "tintColor");
+}
+
+static void InitTilemapVertexFormat(void) {
+  // Every block draws the shared quad indices instead of its own
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, CTX.rc->tilemapProgram.ebo);
+
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TilemapVertex),
+                        (void *)offsetof(TilemapVertex, pos));
+  glEnableVertexAttribArray(0);
+
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TilemapVertex),
+                        (void *)offsetof(TilemapVertex, texCoord));
+  glEnableVertexAttribArray(1);
+}
+
+static void ExecuteInitTilemapProgram(void *data) {
+  RenderContext *rc = CTX.rc;
+
+  if (!rc->tilemapProgram.program) {
+    InitTilemapProgram(&rc->tilemapProgram);
+  }
+}
+
+SDAPI SDTilemap *SDCreateTilemap(SDTexture *tileset, int tileWidth,
+                                 int tileHeight, int width, int height) {
+  RenderContext *rc = CTX.rc;
+
+  if (tileWidth <= 0 || tileHeight <= 0 || tileset->width < tileWidth ||
+      tileset->height < tileHeight) {
+    printf("Tileset %dx%d has no tile of %dx%d\n", tileset->width,
+           tileset->height, tileWidth, tileHeight);
+    return NULL;
+  }
+  if (width <= 0 || height <= 0) {
+    printf("Tilemap of %dx%d tiles is empty\n", width, height);
+    return NULL;
+  }
+
+  BeginCommand(ExecuteInitTilemapProgram, 0);
+  CommitCommand();
+
+  if (!rc->tilemapArena.initVertexFormat) {
+    InitBufferArena(&rc->tilemapArena, InitTilemapVertexFormat);
+  }
+
+  SDTilemap *tilemap = malloc(sizeof(SDTilemap));
+  SDFloat pixelToPoint = SDGetPixelToPoint();
+
+  tilemap->tileset = tileset;
+  tilemap->tileWidth = tileWidth;
+  tilemap->tileHeight = tileHeight;
+  tilemap->numColumn = tileset->width / tileWidth;
+  int numTile = tilemap->numColumn * (tileset->height / tileHeight);
+  tilemap->numTile = numTile < NO_TILE ? numTile : NO_TILE;
+  tilemap->tileSize = SDV2(tileWidth * pixelToPoint, tileHeight * pixelToPoint);
+  tilemap->chunkSize = SDV2(tilemap->tileSize.x * CHUNK_SIZE,
+                            tilemap->tileSize.y * CHUNK_SIZE);
+
+  tilemap->width = width;
+  tilemap->height = height;
+  tilemap->numChunkX = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  tilemap->numChunkY = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+  int numChunk = tilemap->numChunkX * tilemap->numChunkY;
+  tilemap->chunks = malloc((size_t)numChunk * sizeof(TilemapChunk));
+  for (int i = 0; i < numChunk; ++i) {
+    TilemapChunk *chunk = &tilemap->chunks[i];
+    memset(chunk->tiles, 0xFF, sizeof(chunk->tiles));
+    chunk->range = (BufferRange){NULL, 0, 0};
+    chunk->numQuad = 0;
+    chunk->isDirty = 0;
+  }
+
+  tilemap->vertices = malloc(CHUNK_NUM_TILE * 4 * sizeof(TilemapVertex));
+  tilemap->drawBlocks = malloc((size_t)numChunk * sizeof(BufferBlock *));
+  tilemap->drawCounts = malloc((size_t)numChunk * sizeof(GLsizei));
+  tilemap->drawBaseVertices = malloc((size_t)numChunk * sizeof(GLint));
+  tilemap->drawOffsets = calloc((size_t)numChunk, sizeof(void *));
+
+  return tilemap;
+}
+
+static void ExecuteDestroyTilemap(void *data) {
+  SDTilemap *tilemap = *(SDTilemap **)data;
+
+  free(tilemap->chunks);
+  free(tilemap->vertices);
+  free(tilemap->drawBlocks);
+  free(tilemap->drawCounts);
+  free(tilemap->drawBaseVertices);
+  free(tilemap->drawOffsets);
+  free(tilemap);
+}
+
+SDAPI void SDDestroyTilemap(SDTilemap **ptr) {
+  SDTilemap *tilemap = *ptr;
+  int numChunk = tilemap->numChunkX * tilemap->numChunkY;
+  for (int i = 0; i < numChunk; ++i) {
+    FreeBufferRange(tilemap->chunks[i].range);
+  }
+
+  // Draws recorded before still use the chunks
+  SDTilemap **command =
+      BeginCommand(ExecuteDestroyTilemap, sizeof(SDTilemap *));
+  *command = *ptr;
+  CommitCommand();
+
+  *ptr = NULL;
+}
+
+static TilemapChunk *GetChunk(const SDTilemap *tilemap, int x, int y) {
+  int index = (y / CHUNK_SIZE) * tilemap->numChunkX + x / CHUNK_SIZE;
+  return &tilemap->chunks[index];
+}
+
+SDAPI void SDSetTile(SDTilemap *tilemap, int x, int y, int tile) {
+  if (x < 0 || x >= tilemap->width || y < 0 || y >= tilemap->height ||
+      tile >= tilemap->numTile) {
+    return;
+  }
+
+  TilemapChunk *chunk = GetChunk(tilemap, x, y);
+  unsigned short value = tile < 0 ? NO_TILE : (unsigned short)tile;
+  unsigned short *slot =
+      &chunk->tiles[(y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE];
+
+  if (*slot != value) {
+    *slot = value;
+    chunk->isDirty = 1;
+  }
+}
+
+SDAPI int SDGetTile(const SDTilemap *tilemap, int x, int y) {
+  if (x < 0 || x >= tilemap->width || y < 0 || y >= tilemap->height) {
+    return SD_TILE_EMPTY;
+  }
+
+  const TilemapChunk *chunk = GetChunk(tilemap, x, y);
+  unsigned short value =
+      chunk->tiles[(y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE];
+  return value == NO_TILE ? SD_TILE_EMPTY : value;
+}
+
+// Write a quad for each tile of the chunk to tilemap->vertices and return the
+// number of quads
+static int WriteChunkQuads(SDTilemap *tilemap, const TilemapChunk *chunk,
+                           int chunkX, int chunkY) {
+  SDTexture *tileset = tilemap->tileset;
+  SDFloat du = (SDFloat)tilemap->tileWidth / tileset->actualWidth;
+  SDFloat dv = (SDFloat)tilemap->tileHeight / tileset->actualHeight;
+  SDVec2 origin = SDV2(chunkX * tilemap->chunkSize.x,
+                       chunkY * tilemap->chunkSize.y);
+
+  TilemapVertex *v = tilemap->vertices;
+  int numQuad = 0;
+
+  for (int y = 0; y < CHUNK_SIZE; ++y) {
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+      unsigned short tile = chunk->tiles[y * CHUNK_SIZE + x];
+      if (tile == NO_TILE) {
+        continue;
+      }
+
+      SDFloat x0 = origin.x + x * tilemap->tileSize.x;
+      SDFloat y0 = origin.y + y * tilemap->tileSize.y;
+      SDFloat x1 = x0 + tilemap->tileSize.x;
+      SDFloat y1 = y0 + tilemap->tileSize.y;
+      SDFloat u0 = (tile % tilemap->numColumn) * du;
+      SDFloat v0 = (tile / tilemap->numColumn) * dv;
+      SDFloat u1 = u0 + du;
+      SDFloat v1 = v0 + dv;
+
+      // top left, top right, bottom right, bottom left
+      *v++ = (TilemapVertex){{x0, y0}, {u0, v0}};
+      *v++ = (TilemapVertex){{x1, y0}, {u1, v0}};
+      *v++ = (TilemapVertex){{x1, y1}, {u1, v1}};
+      *v++ = (TilemapVertex){{x0, y1}, {u0, v1}};
+      numQuad++;
+    }
+  }
+
+  return numQuad;
+}
+
+static void RebuildChunk(SDTilemap *tilemap, TilemapChunk *chunk, int chunkX,
+                         int chunkY) {
+  int numQuad = WriteChunkQuads(tilemap, chunk, chunkX, chunkY);
+
+  // Keep the range while the chunk fits, a chunk emptied gives it back
+  size_t size = (size_t)numQuad * 4 * sizeof(TilemapVertex);
+  if (size > chunk->range.size || numQuad == 0) {
+    FreeBufferRange(chunk->range);
+    chunk->range = (BufferRange){NULL, 0, 0};
+  }
+  if (numQuad) {
+    if (!chunk->range.block) {
+      chunk->range = AllocBufferRange(&CTX.rc->tilemapArena, size,
+                                      sizeof(TilemapVertex));
+    }
+    UploadBufferRange(chunk->range, 0, tilemap->vertices, size);
+  }
+
+  chunk->numQuad = numQuad;
+  chunk->isDirty = 0;
+}
+
+typedef struct BeginTilemapCommand {
+  SDMat3 MVP;
+  SDColor tintColor;
+  const SDTexture *tileset;
+} BeginTilemapCommand;
+
+static void ExecuteBeginTilemap(void *data) {
+  const BeginTilemapCommand *command = data;
+  TilemapProgram *tilemapProgram = &CTX.rc->tilemapProgram;
+  SDColor tintColor = command->tintColor;
+
+  glUseProgram(tilemapProgram->program);
+  glUniformMatrix3fv(tilemapProgram->MVPLocation, 1, GL_FALSE,
+                     (const GLfloat *)&command->MVP);
+  glUniform4f(tilemapProgram->tintColorLocation, tintColor.r, tintColor.g,
+              tintColor.b, tintColor.a);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, command->tileset->id);
+}
+
+// White quads drawn like the tilemap program does
+static void ToMeshVertices(const TilemapVertex *src, int numVertex,
+                           MeshVertex *dst) {
+  for (int i = 0; i < numVertex; ++i) {
+    dst[i] = (MeshVertex){{src[i].pos[0], src[i].pos[1]},
+                          {src[i].texCoord[0], src[i].texCoord[1]},
+                          {1.0f, 1.0f, 1.0f, 1.0f}};
+  }
+}
+
+typedef struct DrawChunksCommand {
+  const BufferBlock *block;
+  int numDraw;
+  const GLsizei *counts;
+  const GLint *baseVertices;
+  const void *const *offsets;
+
+  // Set by the program for GL, the software backend needs them here
+  SDMat3 MVP;
+  SDColor tintColor;
+  const SDTexture *tileset;
+} DrawChunksCommand;
+
+static void DrawSoftwareChunks(const DrawChunksCommand *command) {
+  const TilemapVertex *blockVertices =
+      GetNullGLBufferData(command->block->buffer);
+  const void *indices = GetNullGLBufferData(CTX.rc->tilemapProgram.ebo);
+
+  for (int i = 0; i < command->numDraw; ++i) {
+    int numVertex = command->counts[i] / 6 * 4;
+    MeshVertex *vertices = malloc((size_t)numVertex * sizeof(MeshVertex));
+    ToMeshVertices(blockVertices + command->baseVertices[i], numVertex,
+                   vertices);
+    DrawSoftwareMesh(command->tileset, command->MVP, command->tintColor,
+                     vertices, indices, GL_UNSIGNED_SHORT, command->counts[i]);
+    free(vertices);
+  }
+}
+
+static void ExecuteDrawChunks(void *data) {
+  const DrawChunksCommand *command = data;
+  RenderContext *rc = CTX.rc;
+
+  glBindVertexArray(command->block->vao);
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, command->counts,
+                                GL_UNSIGNED_SHORT, command->offsets,
+                                command->numDraw, command->baseVertices);
+  glBindVertexArray(0);
+
+  if (CTX.renderBackend == SD_RENDER_BACKEND_SOFTWARE) {
+    DrawSoftwareChunks(command);
+  }
+
+  rc->numDrawCall++;
+}
+
+// One multi-draw for the visible chunks in each block, in the order the
+// first chunk of each block was found
+static void DrawChunks(SDTilemap *tilemap, int numDraw, SDMat3 MVP,
+                       SDColor tintColor) {
+  const BufferBlock **blocks = tilemap->drawBlocks;
+  GLsizei *counts = tilemap->drawCounts;
+  GLint *baseVertices = tilemap->drawBaseVertices;
+
+  int first = 0;
+  while (first < numDraw) {
+    // Move the draws of the first block to the front
+    const BufferBlock *block = blocks[first];
+    int end = first;
+    for (int i = first; i < numDraw; ++i) {
+      if (blocks[i] != block) {
+        continue;
+      }
+
+      GLsizei count = counts[i];
+      GLint baseVertex = baseVertices[i];
+      blocks[i] = blocks[end];
+      counts[i] = counts[end];
+      baseVertices[i] = baseVertices[end];
+      blocks[end] = block;
+      counts[end] = count;
+      baseVertices[end] = baseVertex;
+      end++;
+    }
+
+    int numBlockDraw = end - first;
+    DrawChunksCommand *command =
+        BeginCommand(ExecuteDrawChunks, sizeof(DrawChunksCommand));
+    command->block = block;
+    command->numDraw = numBlockDraw;
+    command->counts =
+        CopyCommandData(counts + first, numBlockDraw * sizeof(GLsizei));
+    command->baseVertices =
+        CopyCommandData(baseVertices + first, numBlockDraw * sizeof(GLint));
+    command->offsets =
+        CopyCommandData(tilemap->drawOffsets, numBlockDraw * sizeof(void *));
+    command->MVP = MVP;
+    command->tintColor = tintColor;
+    command->tileset = tilemap->tileset;
+    CommitCommand();
+
+    first = end;
+  }
+}
+
+// All tiles as one mesh of white quads, culled again when replayed
+static void RecordTilemap(FrameRecorder *recorder, SDTilemap *tilemap,
+                          SDMat3 transform, SDColor tintColor) {
+  int numChunk = tilemap->numChunkX * tilemap->numChunkY;
+  int numQuad = 0;
+  for (int i = 0; i < numChunk; ++i) {
+    const TilemapChunk *chunk = &tilemap->chunks[i];
+    for (int tile = 0; tile < CHUNK_NUM_TILE; ++tile) {
+      numQuad += chunk->tiles[tile] != NO_TILE;
+    }
+  }
+
+  if (numQuad == 0) {
+    return;
+  }
+
+  MeshVertex *vertices;
+  unsigned int *indices;
+  int mesh = AddRecordedMesh(recorder, NULL, tilemap->tileset, numQuad * 4,
+                             numQuad * 6, &vertices, &indices);
+
+  MeshVertex *dst = vertices;
+  for (int i = 0; i < numChunk; ++i) {
+    int numChunkQuad =
+        WriteChunkQuads(tilemap, &tilemap->chunks[i], i % tilemap->numChunkX,
+                        i / tilemap->numChunkX);
+    ToMeshVertices(tilemap->vertices, numChunkQuad * 4, dst);
+    dst += numChunkQuad * 4;
+  }
+
+  // Same order as the shared quad indices
+  for (int i = 0; i < numQuad; ++i) {
+    unsigned int base = (unsigned int)i * 4;
+    unsigned int *quad = indices + i * 6;
+    quad[0] = base;
+    quad[1] = base + 1;
+    quad[2] = base + 2;
+    quad[3] = base;
+    quad[4] = base + 2;
+    quad[5] = base + 3;
+  }
+
+  RecordMeshDraw(recorder, mesh, transform, tintColor);
+}
+
+SDAPI void SDDrawTilemap(SDTilemap *tilemap, SDMat3 transform,
+                         SDColor tintColor) {
+  RenderContext *rc = CTX.rc;
+
+  if (rc->recorder) {
+    RecordTilemap(rc->recorder, tilemap, transform, tintColor);
+  }
+
+  SDMat3 MVP = SDDotM3(rc->viewProjection, transform);
+
+  // Bring the camera's visible bounds to tilemap space to find visible chunks
+  SDRect visible =
+      SDTransformRectM3(SDInverseM3(transform), rc->visibleBounds);
+  int minX = (int)SDFloorF(visible.min.x / tilemap->chunkSize.x);
+  int minY = (int)SDFloorF(visible.min.y / tilemap->chunkSize.y);
+  int maxX = (int)SDFloorF(visible.max.x / tilemap->chunkSize.x);
+  int maxY = (int)SDFloorF(visible.max.y / tilemap->chunkSize.y);
+  minX = minX < 0 ? 0 : minX;
+  minY = minY < 0 ? 0 : minY;
+  maxX = maxX >= tilemap->numChunkX ? tilemap->numChunkX - 1 : maxX;
+  maxY = maxY >= tilemap->numChunkY ? tilemap->numChunkY - 1 : maxY;
+
+  if (minX > maxX || minY > maxY) {
+    return;
+  }
+
+  FlushBatch(rc);
+  ApplyClipScissor(rc);
+
+  BeginTilemapCommand *command =
+      BeginCommand(ExecuteBeginTilemap, sizeof(BeginTilemapCommand));
+  command->MVP = MVP;
+  command->tintColor = tintColor;
+  command->tileset = tilemap->tileset;
+  CommitCommand();
+
+  int numDraw = 0;
+  for (int chunkY = minY; chunkY <= maxY; ++chunkY) {
+    for (int chunkX = minX; chunkX <= maxX; ++chunkX) {
+      TilemapChunk *chunk =
+          &tilemap->chunks[chunkY * tilemap->numChunkX + chunkX];
+
+      if (chunk->isDirty) {
+        RebuildChunk(tilemap, chunk, chunkX, chunkY);
+      }
+
+      if (chunk->numQuad == 0) {
+        continue;
+      }
+
+      const BufferRange *range = &chunk->range;
+      tilemap->drawBlocks[numDraw] = range->block;
+      tilemap->drawCounts[numDraw] = chunk->numQuad * 6;
+      tilemap->drawBaseVertices[numDraw] =
+          (GLint)(range->offset / sizeof(TilemapVertex));
+      numDraw++;
+    }
+  }
+
+  DrawChunks(tilemap, numDraw, MVP, tintColor);
+}
@@ -0,0 +1,1151 @@
+/**
+ * Golden image and performance regression test for the renderer.
+ *
+ * Each scene is rendered for a fixed number of frames, then its last frame is
+ * captured and compared with golden/<scene>.qoi. A missing golden image is a
+ * failure, run with --update to write all of them from the current output
+ * after an intended change. Frame times and draw calls of every scene are
+ * written to a JSON report, along with GL calls in debug builds, and a scene
+ * fails when it needs more draw calls than it declares.
+ *
+ * With --recording the scenes run on the recording backend, which needs no
+ * GPU. Images are not compared, and a scene also fails when it submits a draw
+ * call of nothing.
+ *
+ * With --software the scenes run on the software backend and are compared
+ * with the same golden images as the GPU. Scenes using what it does not draw,
+ * such as lighting and materials, are reported as skipped.
+ *
+ * Usage: sword_render_test <golden dir> <report.json> [--update]
+ *        [--render-thread] [--recording] [--software]
+ */
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sword/sword.h"
+
+// A pixel mismatches when any channel differs by more than this
+#define CHANNEL_TOLERANCE 3
+// A scene fails when more than this fraction of pixels mismatch
+#define MAX_MISMATCH_RATIO 0.001
+
+typedef struct Scene {
+  const char *name;
+  int numFrame;
+  int maxDrawCall;
+  void (*load)(void);
+  void (*render)(int frame);
+  void (*unload)(void);
+  int isSoftware;  // Drawn alike by the software backend
+} Scene;
+
+typedef struct SceneResult {
+  int numTimedFrame;
+  double totalCpuFrameTime;
+  double maxCpuFrameTime;
+  int numDrawCall;
+  int numGLCall;  // Counted by the debug GL loader, 0 in release builds
+  int numSubmittedDraw;  // With the recording backend
+  int numEmptyDraw;
+  int numMismatch;
+  const char *status;
+} SceneResult;
+
+// ----------------------------------------------------------------------------
+// QOI
+// ----------------------------------------------------------------------------
+
+static unsigned int ReadBigEndian32(const unsigned char *in) {
+  return (unsigned int)in[0] << 24 | (unsigned int)in[1] << 16 |
+         (unsigned int)in[2] << 8 | in[3];
+}
+
+// Decode a QOI image to RGBA8, see https://qoiformat.org
+static unsigned char *DecodeQOI(const unsigned char *data, size_t size,
+                                int *width, int *height) {
+  if (size < 22 || memcmp(data, "qoif", 4) != 0) {
+    return NULL;
+  }
+
+  *width = (int)ReadBigEndian32(data + 4);
+  *height = (int)ReadBigEndian32(data + 8);
+
+  size_t numPixel = (size_t)*width * *height;
+  unsigned char *pixels = malloc(numPixel * 4);
+  unsigned char index[64][4] = {{0}};
+  unsigned char px[4] = {0, 0, 0, 255};
+  const unsigned char *in = data + 14;
+  const unsigned char *end = data + size - 8;
+  int run = 0;
+
+  for (size_t i = 0; i < numPixel; ++i) {
+    if (run > 0) {
+      run--;
+    } else if (in < end) {
+      int op = *in++;
+      if (op == 0xfe) {
+        memcpy(px, in, 3);
+        in += 3;
+      } else if (op == 0xff) {
+        memcpy(px, in, 4);
+        in += 4;
+      } else if ((op & 0xc0) == 0x00) {
+        memcpy(px, index[op], 4);
+      } else if ((op & 0xc0) == 0x40) {
+        px[0] += ((op >> 4) & 3) - 2;
+        px[1] += ((op >> 2) & 3) - 2;
+        px[2] += (op & 3) - 2;
+      } else if ((op & 0xc0) == 0x80) {
+        int vg = (op & 0x3f) - 32;
+        int b = *in++;
+        px[0] += vg - 8 + (b >> 4);
+        px[1] += vg;
+        px[2] += vg - 8 + (b & 0x0f);
+      } else {
+        run = op & 0x3f;
+      }
+
+      memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px,
+             4);
+    }
+
+    memcpy(pixels + i * 4, px, 4);
+  }
+
+  return pixels;
+}
+
+static unsigned char *ReadFile(const char *path, size_t *size) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+
+  fseek(file, 0, SEEK_END);
+  *size = (size_t)ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  unsigned char *data = malloc(*size);
+  if (fread(data, 1, *size, file) != *size) {
+    free(data);
+    data = NULL;
+  }
+  fclose(file);
+
+  return data;
+}
+
+static int WriteFile(const char *path, const void *data, size_t size) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return 0;
+  }
+
+  int ok = fwrite(data, 1, size, file) == size;
+  fclose(file);
+  return ok;
+}
+
+// ----------------------------------------------------------------------------
+// Scenes
+// ----------------------------------------------------------------------------
+
+static SDTexture *CHECKER;
+static SDTilemap *TILEMAP;
+static SDParticleSystem *PARTICLES;
+static SDMesh *TERRAIN;
+static SDMesh *FAN;
+static SDSpriteBuffer *SPRITES;
+static SDSpriteLayer *LAYER;
+static SDMaterial *DESATURATE;
+static SDFrameRecording *RECORDING;
+static char RECORDING_PATH[1024];
+
+// 4 tiles of 16x16 pixels side by side, each a checker of two colors
+static SDTexture *CreateCheckerTexture(void) {
+  static const unsigned char colors[4][4] = {
+      {255, 64, 64, 255}, {64, 255, 64, 255}, {64, 64, 255, 255},
+      {255, 255, 255, 128}};
+  unsigned char pixels[16 * 64 * 4];
+
+  for (int y = 0; y < 16; ++y) {
+    for (int x = 0; x < 64; ++x) {
+      unsigned char *px = pixels + (y * 64 + x) * 4;
+      memcpy(px, colors[x / 16], 4);
+      if (((x / 4) + (y / 4)) % 2) {
+        px[0] /= 2;
+        px[1] /= 2;
+        px[2] /= 2;
+      }
+    }
+  }
+
+  SDImage image = {
+      .width = 64,
+      .height = 16,
+      .stride = 64 * 4,
+      .format = SD_IMAGE_FORMAT_RGBA8,
+      .data = pixels,
+  };
+  return SDLoadTextureFromImage(&image);
+}
+
+static void RenderShapes(int frame) {
+  SDDrawRectParams rect =
+      SDMakeDrawRectParams(SDRectMinMax(SDV2(40, 40), SDV2(360, 240)));
+  rect.borderWidth = 8;
+  rect.cornerRadius = 24;
+  rect.fillColor = SDRGBA(0.2f, 0.4f, 0.8f, 1);
+  rect.strokeColor = SDRGBA(1, 1, 1, 1);
+  SDDrawRect(&rect);
+
+  // A translucent border shows the background, not the fill, through it
+  SDDrawRectParams translucent =
+      SDMakeDrawRectParams(SDRectMinMax(SDV2(720, 40), SDV2(1000, 200)));
+  translucent.borderWidth = 20;
+  translucent.cornerRadius = 12;
+  translucent.fillColor = SDRGBA(0.2f, 0.8f, 0.4f, 1);
+  translucent.strokeColor = SDRGBA(1, 1, 1, 0.5f);
+  SDDrawRect(&translucent);
+
+  SDDrawCircleParams circle = SDMakeDrawCircleParams(SDV2(560, 140), 100);
+  circle.borderWidth = 6;
+  circle.fillColor = SDRGBA(0.9f, 0.6f, 0.1f, 0.5f);
+  circle.strokeColor = SDRGBA(0, 0, 0, 1);
+  SDDrawCircle(&circle);
+
+  SDVec2 zigzag[] = {SDV2(40, 400), SDV2(160, 300), SDV2(280, 400),
+                     SDV2(400, 300), SDV2(520, 400)};
+  SDDrawPolyline(zigzag, 5, 12, SD_LINE_JOIN_MITER, SDRGBA(1, 0, 0, 1));
+  SDDrawLine(SDV2(40, 460), SDV2(520, 500), 4, SDRGBA(0, 1, 0, 1));
+
+  SDVec2 star[10];
+  for (int i = 0; i < 10; ++i) {
+    float angle = i * 3.14159265f / 5;
+    float radius = i % 2 ? 50.0f : 120.0f;
+    star[i] = SDV2(900 + radius * sinf(angle), 400 - radius * cosf(angle));
+  }
+  SDDrawPolygonParams polygon = SDMakeDrawPolygonParams(star, 10);
+  polygon.borderWidth = 4;
+  polygon.join = SD_LINE_JOIN_ROUND;
+  polygon.fillColor = SDRGBA(0.5f, 0.1f, 0.6f, 1);
+  polygon.strokeColor = SDRGBA(1, 1, 0, 1);
+  SDDrawPolygon(&polygon);
+}
+
+static void LoadSprites(void) { CHECKER = CreateCheckerTexture(); }
+
+static void RenderSprites(int frame) {
+  for (int i = 0; i < 64; ++i) {
+    SDDrawTextureParams sprite = SDMakeDrawTextureParams(CHECKER);
+    float x = 40.0f + (i % 16) * 72.0f;
+    float y = 40.0f + (i / 16) * 48.0f;
+    sprite.srcRect = SDRectMinMax(SDV2((i % 4) * 16.0f, 0),
+                                  SDV2((i % 4) * 16.0f + 16, 16));
+    sprite.dstRect = SDRectMinMax(SDV2(x, y), SDV2(x + 32, y + 32));
+    sprite.tintColor = SDRGBA(1, 1, 1, (i % 3 + 1) / 3.0f);
+    SDDrawTexture(&sprite);
+  }
+
+  SDMat3 rotation = SDDotM3(SDMat3Translation(400, 500),
+                            SDMat3Rotation(0.3f + frame * 0.01f));
+  SDDrawTextureParams rotated = SDMakeDrawTextureParams(CHECKER);
+  rotated.transform = rotation;
+  rotated.dstRect = SDRectMinMax(SDV2(-128, -32), SDV2(128, 32));
+  SDDrawTexture(&rotated);
+
+  SDDrawNineSlice(CHECKER, SDMakeInsets(4, 4, 4, 4),
+                  SDRectMinMax(SDV2(700, 320), SDV2(1200, 680)),
+                  SDIdentityM3(), SDRGBA(1, 1, 1, 1));
+}
+
+static void UnloadSprites(void) { SDDestroyTexture(&CHECKER); }
+
+static void LoadTilemap(void) {
+  CHECKER = CreateCheckerTexture();
+  TILEMAP = SDCreateTilemap(CHECKER, 16, 16, 100, 60);
+  for (int y = 0; y < 60; ++y) {
+    for (int x = 0; x < 100; ++x) {
+      SDSetTile(TILEMAP, x, y, (x * 7 + y * 3) % 5 - 1);
+    }
+  }
+}
+
+static void RenderTilemap(int frame) {
+  SDMat3 transform = SDDotM3(SDMat3Translation(-frame * 4.0f, -frame * 2.0f),
+                             SDMat3Scale(1.5f, 1.5f));
+  SDDrawTilemap(TILEMAP, transform, SDRGBA(1, 1, 1, 1));
+}
+
+static void UnloadTilemap(void) {
+  SDDestroyTilemap(&TILEMAP);
+  SDDestroyTexture(&CHECKER);
+}
+
+static void LoadParticles(void) {
+  CHECKER = CreateCheckerTexture();
+  SDParticleSystemParams params = SDMakeParticleSystemParams(CHECKER);
+  params.frameWidth = 16;
+  params.frameHeight = 16;
+  params.capacity = 4096;
+  params.gravity = SDV2(0, 200);
+  PARTICLES = SDCreateParticleSystem(&params);
+}
+
+static void RenderParticles(int frame) {
+  for (int i = 0; i < 64; ++i) {
+    float angle = (frame * 64 + i) * 0.618f * 6.2831853f;
+    SDEmitParticleParams emit = SDMakeEmitParticleParams(SDV2(640, 300));
+    emit.velocity = SDV2(cosf(angle) * 300, sinf(angle) * 300 - 200);
+    emit.lifetime = 1.0f + (i % 8) * 0.1f;
+    emit.size = 8.0f + i % 4 * 4;
+    emit.frame = i % 4;
+    SDEmitParticle(PARTICLES, &emit);
+  }
+
+  SDUpdateParticleSystem(PARTICLES, 1.0f / 60.0f);
+  SDDrawParticleSystem(PARTICLES, SDIdentityM3());
+}
+
+static void UnloadParticles(void) {
+  SDDestroyParticleSystem(&PARTICLES);
+  SDDestroyTexture(&CHECKER);
+}
+
+static void LoadLighting(void) {
+  SDLightingParams params = SDMakeLightingParams();
+  params.enabled = 1;
+  params.tiledCulling = 1;
+  SDSetLighting(&params);
+}
+
+static void RenderLighting(int frame) {
+  RenderShapes(frame);
+
+  SDLight point =
+      SDMakePointLight(SDV2(300, 200), 300, SDRGBA(1, 0.8f, 0.6f, 1.5f));
+  SDDrawLight(&point);
+
+  SDLight spot = SDMakeSpotLight(SDV2(900, 100), 500, SDV2(0, 1), 0.4f,
+                                 SDRGBA(0.4f, 0.6f, 1, 2));
+  SDDrawLight(&spot);
+
+  for (int i = 0; i < 256; ++i) {
+    SDLight small = SDMakePointLight(
+        SDV2(20 + (i % 32) * 40.0f, 560 + (i / 32) * 20.0f), 24,
+        SDRGBA((i % 3) == 0, (i % 3) == 1, (i % 3) == 2, 1));
+    SDDrawLight(&small);
+  }
+}
+
+static void UnloadLighting(void) {
+  SDLightingParams params = SDMakeLightingParams();
+  SDSetLighting(&params);
+}
+
+static void LoadPostProcess(void) {
+  SDPostProcessParams params = SDMakePostProcessParams();
+  params.bloomEnabled = 1;
+  params.colorGradingEnabled = 1;
+  params.saturation = 0.6f;
+  params.vignetteEnabled = 1;
+  SDSetPostProcess(&params);
+}
+
+static void UnloadPostProcess(void) {
+  SDPostProcessParams params = SDMakePostProcessParams();
+  SDSetPostProcess(&params);
+}
+
+// Dynamic resolution toggled from the render callback every frame, at a fixed
+// half scale so the upscaled frame does not depend on GPU timing. Settings
+// take effect from the next frame, so the last frame is rendered at half scale.
+static void SetHalfResolution(int enabled) {
+  SDDynamicResolutionParams params = SDMakeDynamicResolutionParams();
+  params.enabled = enabled;
+  params.minScale = 0.5f;
+  params.maxScale = 0.5f;
+  SDSetDynamicResolution(&params);
+}
+
+static void RenderDynamicResolution(int frame) {
+  SetHalfResolution(frame % 2 == 0);
+  RenderSprites(frame);
+}
+
+static void UnloadDynamicResolution(void) {
+  SetHalfResolution(0);
+  UnloadSprites();
+}
+
+// A textured terrain strip and a vertex colored fan, drawn once for each half
+// of a split screen
+static void LoadMeshes(void) {
+  CHECKER = CreateCheckerTexture();
+
+  SDMeshVertex strip[64];
+  unsigned int stripIndices[31 * 6];
+  for (int i = 0; i < 32; ++i) {
+    float x = i * 40.0f;
+    float height = 80.0f + 40.0f * sinf(i * 0.5f);
+    strip[i * 2] = (SDMeshVertex){SDV2(x, 600 - height), SDV2(i * 2.0f, 0),
+                                  SDRGBA(1, 1, 1, 1)};
+    strip[i * 2 + 1] = (SDMeshVertex){SDV2(x, 600), SDV2(i * 2.0f, 16),
+                                      SDRGBA(0.5f, 0.5f, 0.5f, 1)};
+  }
+  for (int i = 0; i < 31; ++i) {
+    unsigned int *quad = stripIndices + i * 6;
+    unsigned int base = (unsigned int)i * 2;
+    quad[0] = base;
+    quad[1] = base + 1;
+    quad[2] = base + 2;
+    quad[3] = base + 1;
+    quad[4] = base + 3;
+    quad[5] = base + 2;
+  }
+  TERRAIN = SDCreateMesh(strip, 64, stripIndices, 31 * 6, CHECKER);
+
+  SDMeshVertex fan[13];
+  unsigned int fanIndices[12 * 3];
+  fan[0] = (SDMeshVertex){SDZeroVec2(), SDZeroVec2(), SDRGBA(1, 1, 1, 1)};
+  for (int i = 0; i < 12; ++i) {
+    float angle = i * 6.2831853f / 12;
+    fan[i + 1] = (SDMeshVertex){SDV2(cosf(angle) * 120, sinf(angle) * 120),
+                                SDZeroVec2(),
+                                SDRGBA(i % 3 == 0, i % 3 == 1, i % 3 == 2,
+                                       0.5f + (i % 2) * 0.5f)};
+    fanIndices[i * 3] = 0;
+    fanIndices[i * 3 + 1] = (unsigned int)i + 1;
+    fanIndices[i * 3 + 2] = (unsigned int)(i + 1) % 12 + 1;
+  }
+  FAN = SDCreateMesh(fan, 13, fanIndices, 12 * 3, NULL);
+}
+
+static void RenderMeshes(int frame) {
+  for (int i = 0; i < 2; ++i) {
+    SDCamera camera = SDMakeCamera();
+    camera.viewport =
+        SDRectMinMax(SDV2(i * 640.0f, 0), SDV2(i * 640.0f + 640, 720));
+    camera.position = SDV2(320 + i * 200.0f + frame * 4.0f, 400);
+    camera.zoom = 1.0f + i * 0.5f;
+    camera.rotation = i * 0.2f;
+    SDBeginCamera(&camera);
+
+    SDDrawMesh(TERRAIN, SDIdentityM3(), SDRGBA(1, 1, 1, 1));
+    SDMat3 transform = SDDotM3(SDMat3Translation(400, 300),
+                               SDMat3Rotation(frame * 0.05f));
+    SDDrawMesh(FAN, transform, SDRGBA(1, 1, 1, 1));
+
+    SDEndCamera();
+  }
+}
+
+static void UnloadMeshes(void) {
+  SDDestroyMesh(&FAN);
+  SDDestroyMesh(&TERRAIN);
+  SDDestroyTexture(&CHECKER);
+}
+
+static SDSprite MakeGridSprite(int i, int frame) {
+  SDSprite sprite = SDMakeSprite(CHECKER);
+  float x = 40.0f + (i % 32) * 38.0f;
+  float y = 40.0f + (i / 32) * 38.0f + (i % 5 == 0 ? frame * 2.0f : 0.0f);
+  sprite.srcRect = SDRectMinMax(SDV2((i % 4) * 16.0f, 0),
+                                SDV2((i % 4) * 16.0f + 16, 16));
+  sprite.dstRect = SDRectMinMax(SDV2(x, y), SDV2(x + 32, y + 32));
+  return sprite;
+}
+
+// Every fifth sprite moves each frame and a few are removed and added back,
+// the rest are only uploaded once
+static void LoadSpriteBuffer(void) {
+  CHECKER = CreateCheckerTexture();
+  SPRITES = SDCreateSpriteBuffer(CHECKER, 512);
+  for (int i = 0; i < 512; ++i) {
+    SDSprite sprite = MakeGridSprite(i, 0);
+    SDAddSprite(SPRITES, &sprite);
+  }
+}
+
+static void RenderSpriteBuffer(int frame) {
+  for (int i = 0; i < 512; i += 5) {
+    if (frame >= 3 && i % 7 == 1) {
+      continue;  // Removed below
+    }
+    SDSprite sprite = MakeGridSprite(i, frame);
+    SDSetSprite(SPRITES, i, &sprite);
+  }
+
+  if (frame == 3) {
+    for (int i = 1; i < 512; i += 7) {
+      SDRemoveSprite(SPRITES, i);
+    }
+  } else if (frame == 6) {
+    SDSprite sprite = MakeGridSprite(1, frame);
+    sprite.tintColor = SDRGBA(0.5f, 0.5f, 0.5f, 0.5f);
+    SDAddSprite(SPRITES, &sprite);
+  }
+
+  SDDrawSpriteBuffer(SPRITES, SDIdentityM3(), SDRGBA(1, 1, 1, 1));
+}
+
+static void UnloadSpriteBuffer(void) {
+  SDDestroySpriteBuffer(&SPRITES);
+  SDDestroyTexture(&CHECKER);
+}
+
+// A scrolling list trimmed on the CPU, then a panel where rotated content and
+// shapes crossing the edge need the scissor
+static void RenderClipRect(int frame) {
+  SDRect list = SDRectMinMax(SDV2(80, 80), SDV2(560, 560));
+  SDDrawNineSlice(CHECKER, SDMakeInsets(4, 4, 4, 4),
+                  SDRectMinMax(SDV2(72, 72), SDV2(568, 568)), SDIdentityM3(),
+                  SDRGBA(0.3f, 0.3f, 0.3f, 1));
+
+  SDPushClipRect(list);
+  for (int i = 0; i < 12; ++i) {
+    float y = 60.0f + i * 64.0f - frame * 7.0f;
+    SDDrawNineSlice(CHECKER, SDMakeInsets(4, 4, 4, 4),
+                    SDRectMinMax(SDV2(60, y), SDV2(520, y + 56)),
+                    SDIdentityM3(), SDRGBA(1, 1, 1, 0.5f));
+
+    SDDrawTextureParams icon = SDMakeDrawTextureParams(CHECKER);
+    icon.srcRect = SDRectMinMax(SDV2((i % 4) * 16.0f, 0),
+                                SDV2((i % 4) * 16.0f + 16, 16));
+    icon.dstRect = SDRectMinMax(SDV2(500, y + 4), SDV2(548, y + 52));
+    SDDrawTexture(&icon);
+  }
+
+  // Nested, only the part inside both is drawn
+  SDPushClipRect(SDRectMinMax(SDV2(200, 0), SDV2(300, 1000)));
+  SDDrawTextureParams bar = SDMakeDrawTextureParams(CHECKER);
+  bar.dstRect = SDRectMinMax(SDV2(0, 300), SDV2(1280, 340));
+  SDDrawTexture(&bar);
+  SDPopClipRect();
+  SDPopClipRect();
+
+  SDPushClipRect(SDRectMinMax(SDV2(700, 80), SDV2(1200, 560)));
+  SDDrawTextureParams rotated = SDMakeDrawTextureParams(CHECKER);
+  rotated.transform = SDDotM3(SDMat3Translation(720, 300),
+                              SDMat3Rotation(0.3f + frame * 0.01f));
+  rotated.dstRect = SDRectMinMax(SDV2(-128, -32), SDV2(128, 32));
+  SDDrawTexture(&rotated);
+
+  SDDrawCircleParams circle = SDMakeDrawCircleParams(SDV2(1180, 520), 100);
+  circle.fillColor = SDRGBA(0.9f, 0.6f, 0.1f, 1);
+  SDDrawCircle(&circle);
+  SDPopClipRect();
+
+  SDDrawLine(SDV2(40, 640), SDV2(1240, 640), 4, SDRGBA(0, 1, 0, 1));
+}
+
+#define NUM_LAYER_SPRITE 600
+
+static SDSprite MakeLayerSprite(int i, float y) {
+  SDSprite sprite = SDMakeSprite(CHECKER);
+  float x = 20.0f + (i * 37 % 1200);
+  sprite.srcRect = SDRectMinMax(SDV2((i % 4) * 16.0f, 0),
+                                SDV2((i % 4) * 16.0f + 16, 16));
+  sprite.dstRect = SDRectMinMax(SDV2(x, y - 48), SDV2(x + 48, y));
+  return sprite;
+}
+
+static float LayerSpriteY(int i, int frame) {
+  float y = 60.0f + (i * 53 % 640);
+  // Every tenth walks down, passing the others on the way
+  return i % 10 ? y : y + frame * 9.0f;
+}
+
+// Sprites drawn by their feet, the first frame sorts from scratch and the
+// later ones repair the order left by the last
+static void LoadSpriteLayer(void) {
+  CHECKER = CreateCheckerTexture();
+  LAYER = SDCreateSpriteLayer(CHECKER, NUM_LAYER_SPRITE);
+  for (int i = 0; i < NUM_LAYER_SPRITE; ++i) {
+    float y = LayerSpriteY(i, 0);
+    SDSprite sprite = MakeLayerSprite(i, y);
+    SDAddLayerSprite(LAYER, &sprite, y);
+  }
+}
+
+static void RenderSpriteLayer(int frame) {
+  for (int i = 0; i < NUM_LAYER_SPRITE; i += 10) {
+    float y = LayerSpriteY(i, frame);
+    SDSprite sprite = MakeLayerSprite(i, y);
+    SDSetLayerSprite(LAYER, i, &sprite, y);
+  }
+
+  // Swap a few out for new ones taking the freed handles
+  if (frame % 3 == 1) {
+    for (int i = 5; i < NUM_LAYER_SPRITE; i += 100) {
+      SDRemoveLayerSprite(LAYER, i);
+    }
+  } else if (frame % 3 == 2) {
+    for (int i = 5; i < NUM_LAYER_SPRITE; i += 100) {
+      float y = LayerSpriteY(i, frame) + 20;
+      SDSprite sprite = MakeLayerSprite(i, y);
+      SDAddLayerSprite(LAYER, &sprite, y);
+    }
+  }
+
+  SDDrawSpriteLayer(LAYER, SDIdentityM3(), SDRGBA(1, 1, 1, 1));
+}
+
+static void UnloadSpriteLayer(void) {
+  SDDestroySpriteLayer(&LAYER);
+  SDDestroyTexture(&CHECKER);
+}
+
+// Alpha and additive sprites interleaved in one batch, then multiply and
+// screen over a gradient of backdrops
+static void RenderBlendModes(int frame) {
+  for (int i = 0; i < 8; ++i) {
+    SDDrawRectParams backdrop = SDMakeDrawRectParams(
+        SDRectMinMax(SDV2(i * 160.0f, 0), SDV2(i * 160.0f + 160, 720)));
+    backdrop.fillColor = SDRGBA(i / 7.0f, 0.5f, 1 - i / 7.0f, 1);
+    SDDrawRect(&backdrop);
+  }
+
+  SDBlendMode modes[] = {SD_BLEND_MODE_ALPHA, SD_BLEND_MODE_ADDITIVE,
+                         SD_BLEND_MODE_MULTIPLY, SD_BLEND_MODE_SCREEN};
+  for (int row = 0; row < 4; ++row) {
+    for (int i = 0; i < 12; ++i) {
+      SDDrawTextureParams sprite = SDMakeDrawTextureParams(CHECKER);
+      float x = 40.0f + i * 100.0f + frame * 2.0f;
+      float y = 40.0f + row * 170.0f;
+      sprite.srcRect = SDRectMinMax(SDV2((i % 4) * 16.0f, 0),
+                                    SDV2((i % 4) * 16.0f + 16, 16));
+      sprite.dstRect = SDRectMinMax(SDV2(x, y), SDV2(x + 120, y + 120));
+      sprite.tintColor = SDRGBA(1, 1, 1, 0.75f);
+      // The first two rows alternate, which must not break the batch
+      sprite.blendMode = row < 2 ? modes[(row + i) % 2] : modes[row];
+      SDDrawTexture(&sprite);
+    }
+  }
+}
+
+// Mixes the texel towards its luminance, tinted by the first parameter, by the
+// alpha of that parameter
+static const char DESATURATE_SOURCE[] =
+    "vec4 Shade(vec2 texCoord, vec4 color) {\n"
+    "  vec4 texel = texture(texture0, texCoord) * color;\n"
+    "  float luma = dot(texel.rgb, vec3(0.2126, 0.7152, 0.0722));\n"
+    "  vec4 param = SDParam(0);\n"
+    "  return vec4(mix(texel.rgb, luma * param.rgb, param.a), texel.a);\n"
+    "}\n";
+
+static void LoadMaterials(void) {
+  CHECKER = CreateCheckerTexture();
+  DESATURATE = SDCreateMaterial(DESATURATE_SOURCE, 1);
+}
+
+// Sprites of one material with a different parameter each stay in one batch,
+// plain sprites after them start another
+static void RenderMaterials(int frame) {
+  for (int i = 0; i < 64; ++i) {
+    SDDrawTextureParams sprite = SDMakeDrawTextureParams(CHECKER);
+    float x = 40.0f + (i % 16) * 72.0f;
+    float y = 40.0f + (i / 16) * 72.0f;
+    sprite.srcRect = SDRectMinMax(SDV2((i % 4) * 16.0f, 0),
+                                  SDV2((i % 4) * 16.0f + 16, 16));
+    sprite.dstRect = SDRectMinMax(SDV2(x, y), SDV2(x + 64, y + 64));
+    sprite.material = DESATURATE;
+    sprite.materialParams[0] = (i % 3) / 2.0f;
+    sprite.materialParams[1] = 0.8f;
+    sprite.materialParams[2] = ((i + frame) % 5) / 4.0f;
+    sprite.materialParams[3] = (i / 16 + 1) / 4.0f;
+    SDDrawTexture(&sprite);
+  }
+
+  for (int i = 0; i < 4; ++i) {
+    SDDrawTextureParams sprite = SDMakeDrawTextureParams(CHECKER);
+    sprite.dstRect = SDRectMinMax(SDV2(40.0f + i * 300, 400),
+                                  SDV2(296.0f + i * 300, 656));
+    SDDrawTexture(&sprite);
+  }
+}
+
+static void UnloadMaterials(void) {
+  SDDestroyMaterial(&DESATURATE);
+  SDDestroyTexture(&CHECKER);
+}
+
+// Shapes, then material sprites and a clipped nine-slice through a camera
+static void RenderRecordedFrame(void) {
+  RenderShapes(0);
+
+  SDCamera camera = SDMakeCamera();
+  camera.position = SDV2(480, 360);
+  camera.zoom = 1.25f;
+  camera.rotation = 0.1f;
+  SDBeginCamera(&camera);
+
+  SDPushClipRect(SDRectMinMax(SDV2(100, 420), SDV2(700, 640)));
+  SDDrawNineSlice(CHECKER, SDMakeInsets(4, 4, 4, 4),
+                  SDRectMinMax(SDV2(60, 400), SDV2(760, 700)), SDIdentityM3(),
+                  SDRGBA(1, 1, 1, 0.75f));
+  SDPopClipRect();
+
+  for (int i = 0; i < 16; ++i) {
+    SDDrawTextureParams sprite = SDMakeDrawTextureParams(CHECKER);
+    float x = 100.0f + (i % 8) * 72.0f;
+    float y = 520.0f + (i / 8) * 72.0f;
+    sprite.srcRect = SDRectMinMax(SDV2((i % 4) * 16.0f, 0),
+                                  SDV2((i % 4) * 16.0f + 16, 16));
+    sprite.dstRect = SDRectMinMax(SDV2(x, y), SDV2(x + 64, y + 64));
+    sprite.material = i < 8 ? DESATURATE : NULL;
+    sprite.materialParams[0] = 1;
+    sprite.materialParams[3] = 0.8f;
+    SDDrawTexture(&sprite);
+  }
+
+  SDEndCamera();
+}
+
+// The frame after the first is recorded, loaded once the render thread has
+// written it and replayed from then on
+static void RenderReplay(int frame) {
+  if (frame == 0) {
+    SDRecordFrame(RECORDING_PATH);
+  }
+  if (frame < 2) {
+    RenderRecordedFrame();
+    return;
+  }
+
+  if (frame == 4) {
+    RECORDING = SDLoadFrameRecording(RECORDING_PATH);
+  }
+  if (RECORDING) {
+    SDReplayFrameRecording(RECORDING);
+  }
+}
+
+static void UnloadReplay(void) {
+  if (RECORDING) {
+    SDDestroyFrameRecording(&RECORDING);
+  }
+  remove(RECORDING_PATH);
+  UnloadMaterials();
+}
+
+// Meshes, a tilemap, a sprite buffer and particles, which are recorded as
+// meshes of what they drew
+static void LoadRetainedFrame(void) {
+  LoadMeshes();
+  TILEMAP = SDCreateTilemap(CHECKER, 16, 16, 40, 12);
+  for (int y = 0; y < 12; ++y) {
+    for (int x = 0; x < 40; ++x) {
+      SDSetTile(TILEMAP, x, y, (x * 7 + y * 3) % 5 - 1);
+    }
+  }
+  SPRITES = SDCreateSpriteBuffer(CHECKER, 64);
+  for (int i = 0; i < 64; ++i) {
+    SDSprite sprite = MakeGridSprite(i * 5, 0);
+    SDAddSprite(SPRITES, &sprite);
+  }
+  SDRemoveSprite(SPRITES, 3);
+
+  SDParticleSystemParams params = SDMakeParticleSystemParams(CHECKER);
+  params.frameWidth = 16;
+  params.frameHeight = 16;
+  params.capacity = 256;
+  PARTICLES = SDCreateParticleSystem(&params);
+}
+
+static void RenderRetainedFrame(int frame) {
+  SDDrawTilemap(TILEMAP, SDMat3Translation(0, 360), SDRGBA(1, 1, 1, 0.75f));
+  RenderMeshes(frame);
+  SDDrawSpriteBuffer(SPRITES, SDIdentityM3(), SDRGBA(1, 1, 1, 1));
+  RenderParticles(frame);
+}
+
+// Recorded and replayed like the replay scene
+static void RenderReplayRetained(int frame) {
+  if (frame == 0) {
+    SDRecordFrame(RECORDING_PATH);
+  }
+  if (frame < 2) {
+    RenderRetainedFrame(frame);
+    return;
+  }
+
+  if (frame == 4) {
+    RECORDING = SDLoadFrameRecording(RECORDING_PATH);
+  }
+  if (RECORDING) {
+    SDReplayFrameRecording(RECORDING);
+  }
+}
+
+static void UnloadRetainedFrame(void) {
+  if (RECORDING) {
+    SDDestroyFrameRecording(&RECORDING);
+  }
+  remove(RECORDING_PATH);
+  SDDestroyParticleSystem(&PARTICLES);
+  SDDestroySpriteBuffer(&SPRITES);
+  SDDestroyTilemap(&TILEMAP);
+  UnloadMeshes();
+}
+
+#ifdef SD_DEBUG
+// Sprites under a zoomed, rotated camera outlined by debug shapes, which all
+// end up in two draw calls over the frame
+static void RenderDebugDraw(int frame) {
+  SDCamera camera = SDMakeCamera();
+  camera.position = SDV2(320, 180);
+  camera.zoom = 1.5f;
+  camera.rotation = 0.1f + frame * 0.01f;
+  SDBeginCamera(&camera);
+
+  for (int x = 0; x <= 640; x += 40) {
+    SDDebugDrawLine(SDV2((float)x, 0), SDV2((float)x, 360),
+                    SDRGBA(0.3f, 0.3f, 0.3f, 1));
+  }
+  for (int y = 0; y <= 360; y += 40) {
+    SDDebugDrawLine(SDV2(0, (float)y), SDV2(640, (float)y),
+                    SDRGBA(0.3f, 0.3f, 0.3f, 1));
+  }
+
+  for (int i = 0; i < 24; ++i) {
+    SDDrawTextureParams sprite = SDMakeDrawTextureParams(CHECKER);
+    SDVec2 center = SDV2(60.0f + (i % 6) * 100, 60.0f + (i / 6) * 80);
+    sprite.srcRect = SDRectMinMax(SDV2((i % 4) * 16.0f, 0),
+                                  SDV2((i % 4) * 16.0f + 16, 16));
+    sprite.transform = SDDotM3(SDMat3Translation(center.x, center.y),
+                               SDMat3Rotation(i * 0.2f));
+    sprite.dstRect = SDRectMinMax(SDV2(-20, -20), SDV2(20, 20));
+    SDDrawTexture(&sprite);
+
+    SDDebugDrawRect(sprite.dstRect, sprite.transform, SDRGBA(1, 1, 0, 1));
+    SDDebugDrawCircle(center, 28, SDRGBA(0, 1, 1, 1));
+    SDDebugDrawPoint(center, 6, SDRGBA(1, 0, 1, 1));
+  }
+
+  SDDebugFillRect(SDRectMinMax(SDV2(20, 330), SDV2(620, 350)), SDIdentityM3(),
+                  SDRGBA(1, 0, 0, 0.5f));
+  SDEndCamera();
+}
+#endif
+
+static const Scene SCENES[] = {
+    {"shapes", 10, 1, NULL, RenderShapes, NULL, 1},
+    {"sprites", 10, 1, LoadSprites, RenderSprites, UnloadSprites, 1},
+    {"tilemap", 10, 8, LoadTilemap, RenderTilemap, UnloadTilemap, 1},
+    {"particles", 30, 1, LoadParticles, RenderParticles, UnloadParticles, 1},
+    {"lighting", 10, 2, LoadLighting, RenderLighting, UnloadLighting, 0},
+    {"postprocess", 10, 1, LoadPostProcess, RenderShapes, UnloadPostProcess,
+     0},
+    {"meshes", 10, 4, LoadMeshes, RenderMeshes, UnloadMeshes, 1},
+    {"spritebuffer", 10, 1, LoadSpriteBuffer, RenderSpriteBuffer,
+     UnloadSpriteBuffer, 1},
+    {"cliprect", 10, 8, LoadSprites, RenderClipRect, UnloadSprites, 1},
+    {"blendmodes", 10, 4, LoadSprites, RenderBlendModes, UnloadSprites, 1},
+    {"spritelayer", 10, 1, LoadSpriteLayer, RenderSpriteLayer,
+     UnloadSpriteLayer, 1},
+    {"materials", 10, 2, LoadMaterials, RenderMaterials, UnloadMaterials, 0},
+    {"replay", 10, 6, LoadMaterials, RenderReplay, UnloadReplay, 0},
+    {"replayretained", 10, 7, LoadRetainedFrame, RenderReplayRetained,
+     UnloadRetainedFrame, 1},
+    {"dynamicresolution", 10, 1, LoadSprites, RenderDynamicResolution,
+     UnloadDynamicResolution, 0},
+#ifdef SD_DEBUG
+    {"debugdraw", 10, 3, LoadSprites, RenderDebugDraw, UnloadSprites, 0},
+#endif
+};
+
+#define NUM_SCENE ((int)(sizeof(SCENES) / sizeof(SCENES[0])))
+
+// ----------------------------------------------------------------------------
+// Runner
+// ----------------------------------------------------------------------------
+
+typedef struct TestState {
+  const char *goldenDir;
+  const char *reportPath;
+  int update;
+  int headless;  // On the recording backend
+  int software;
+
+  int sceneIndex;
+  int frame;
+  int isWaitingCapture;
+  SceneResult results[NUM_SCENE];
+  int numFailure;
+
+  // Written by the capture callback on the background thread
+  SDL_atomic_t isCaptured;
+  unsigned char *qoi;
+  size_t qoiSize;
+  unsigned char *pixels;
+  int width;
+  int height;
+} TestState;
+
+static void OnCapture(const SDFrameCapture *capture, void *userData) {
+  TestState *state = userData;
+
+  state->width = capture->width;
+  state->height = capture->height;
+  state->pixels = malloc((size_t)capture->width * capture->height * 4);
+  memcpy(state->pixels, capture->pixels,
+         (size_t)capture->width * capture->height * 4);
+  state->qoi = malloc(capture->qoiSize);
+  memcpy(state->qoi, capture->qoi, capture->qoiSize);
+  state->qoiSize = capture->qoiSize;
+
+  SDL_AtomicSet(&state->isCaptured, 1);
+}
+
+static int CountMismatch(const unsigned char *a, const unsigned char *b,
+                         size_t numPixel) {
+  int numMismatch = 0;
+  for (size_t i = 0; i < numPixel * 4; i += 4) {
+    for (int c = 0; c < 4; ++c) {
+      if (abs(a[i + c] - b[i + c]) > CHANNEL_TOLERANCE) {
+        numMismatch++;
+        break;
+      }
+    }
+  }
+  return numMismatch;
+}
+
+static void CompareWithGolden(TestState *state, const Scene *scene,
+                              SceneResult *result) {
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/%s.qoi", state->goldenDir, scene->name);
+
+  size_t size = 0;
+  // Golden images are only written on request and only ever come from the
+  // GPU, so a run never changes the checkout behind the test's back
+  if (state->update && !state->software) {
+    result->status = WriteFile(path, state->qoi, state->qoiSize)
+                         ? "updated"
+                         : "failed to write golden";
+    return;
+  }
+
+  unsigned char *golden = ReadFile(path, &size);
+  if (!golden) {
+    result->status = "missing golden";
+    snprintf(path, sizeof(path), "%s.%s.qoi", state->reportPath, scene->name);
+    WriteFile(path, state->qoi, state->qoiSize);
+    return;
+  }
+
+  int width = 0;
+  int height = 0;
+  unsigned char *expected = DecodeQOI(golden, size, &width, &height);
+  free(golden);
+
+  if (!expected || width != state->width || height != state->height) {
+    result->status = "size mismatch";
+  } else {
+    size_t numPixel = (size_t)width * height;
+    result->numMismatch = CountMismatch(expected, state->pixels, numPixel);
+    result->status = result->numMismatch > numPixel * MAX_MISMATCH_RATIO
+                         ? "image mismatch"
+                         : "pass";
+  }
+  free(expected);
+
+  // Keep the output next to the report for inspection
+  if (strcmp(result->status, "pass") != 0) {
+    snprintf(path, sizeof(path), "%s.%s.qoi", state->reportPath, scene->name);
+    WriteFile(path, state->qoi, state->qoiSize);
+  }
+}
+
+static void WriteReport(const TestState *state) {
+  FILE *file = fopen(state->reportPath, "w");
+  if (!file) {
+    printf("Failed to write report %s\n", state->reportPath);
+    return;
+  }
+
+  fprintf(file, "{\n  \"scenes\": [\n");
+  for (int i = 0; i < NUM_SCENE; ++i) {
+    const SceneResult *result = &state->results[i];
+    double average = result->numTimedFrame
+                         ? result->totalCpuFrameTime / result->numTimedFrame
+                         : 0.0;
+    fprintf(file,
+            "    {\"name\": \"%s\", \"status\": \"%s\", \"frames\": %d, "
+            "\"avgCpuFrameTimeMs\": %.4f, \"maxCpuFrameTimeMs\": %.4f, "
+            "\"drawCalls\": %d, \"maxDrawCalls\": %d, \"glCalls\": %d, "
+            "\"submittedDraws\": %d, \"mismatchedPixels\": %d}%s\n",
+            SCENES[i].name, result->status, SCENES[i].numFrame,
+            average * 1000.0, result->maxCpuFrameTime * 1000.0,
+            result->numDrawCall, SCENES[i].maxDrawCall, result->numGLCall,
+            result->numSubmittedDraw, result->numMismatch,
+            i + 1 < NUM_SCENE ? "," : "");
+  }
+  fprintf(file, "  ],\n  \"failures\": %d\n}\n", state->numFailure);
+
+  fclose(file);
+}
+
+static void FinishScene(TestState *state) {
+  const Scene *scene = &SCENES[state->sceneIndex];
+  SceneResult *result = &state->results[state->sceneIndex];
+
+  // Captures of the recording backend are blank, and the software backend
+  // leaves out lighting, post processing, dynamic resolution, materials and
+  // debug draws
+  if (state->headless) {
+    result->status = "pass";
+  } else if (state->software && !scene->isSoftware) {
+    result->status = "skipped";
+  } else {
+    CompareWithGolden(state, scene, result);
+  }
+  if (strcmp(result->status, "pass") == 0 &&
+      result->numDrawCall > scene->maxDrawCall) {
+    result->status = "too many draw calls";
+  }
+  if (strcmp(result->status, "pass") == 0 && result->numEmptyDraw > 0) {
+    result->status = "empty draw calls";
+  }
+
+  int isFailure = strcmp(result->status, "pass") != 0 &&
+                  strcmp(result->status, "updated") != 0 &&
+                  strcmp(result->status, "skipped") != 0;
+  state->numFailure += isFailure;
+  printf("%-12s %s (%d draw calls)\n", scene->name, result->status,
+         result->numDrawCall);
+
+  free(state->pixels);
+  free(state->qoi);
+  state->pixels = NULL;
+  state->qoi = NULL;
+  SDL_AtomicSet(&state->isCaptured, 0);
+
+  if (scene->unload) {
+    scene->unload();
+  }
+}
+
+static void Update(TestState *state) {
+  if (state->sceneIndex == NUM_SCENE) {
+    return;
+  }
+
+  SceneResult *result = &state->results[state->sceneIndex];
+
+  // Stats are of the previous frame, the first one of a scene compiles
+  // shaders and creates buffers so it is not timed
+  if (state->frame > 1 && !state->isWaitingCapture) {
+    SDRenderStats stats = SDGetRenderStats();
+    result->numTimedFrame++;
+    result->totalCpuFrameTime += stats.cpuFrameTime;
+    if (stats.cpuFrameTime > result->maxCpuFrameTime) {
+      result->maxCpuFrameTime = stats.cpuFrameTime;
+    }
+    if (stats.numDrawCall > result->numDrawCall) {
+      result->numDrawCall = stats.numDrawCall;
+    }
+
+#ifdef SD_DEBUG
+    SDGLCallStats glCalls[64];
+    int numGLCall = 0;
+    int numStats = SDGetGLCallStats(glCalls, 64);
+    for (int i = 0; i < numStats; ++i) {
+      numGLCall += glCalls[i].numCall;
+    }
+    if (numGLCall > result->numGLCall) {
+      result->numGLCall = numGLCall;
+    }
+#endif
+
+    int numDraw = 0;
+    const SDSubmittedDraw *draws = SDGetSubmittedDraws(&numDraw);
+    for (int i = 0; i < numDraw; ++i) {
+      result->numEmptyDraw +=
+          draws[i].numElement == 0 || draws[i].numInstance == 0;
+    }
+    if (numDraw > result->numSubmittedDraw) {
+      result->numSubmittedDraw = numDraw;
+    }
+  }
+
+  if (!state->isWaitingCapture || !SDL_AtomicGet(&state->isCaptured)) {
+    return;
+  }
+
+  FinishScene(state);
+
+  state->sceneIndex++;
+  state->frame = 0;
+  state->isWaitingCapture = 0;
+
+  if (state->sceneIndex == NUM_SCENE) {
+    WriteReport(state);
+    SDQuit();
+  } else if (SCENES[state->sceneIndex].load) {
+    SCENES[state->sceneIndex].load();
+  }
+}
+
+static void Render(TestState *state) {
+  if (state->sceneIndex == NUM_SCENE || state->isWaitingCapture) {
+    return;
+  }
+
+  const Scene *scene = &SCENES[state->sceneIndex];
+  scene->render(state->frame++);
+
+  if (state->frame == scene->numFrame) {
+    SDCaptureFrame(OnCapture, state);
+    state->isWaitingCapture = 1;
+  }
+}
+
+static void Load(TestState *state) {
+  if (SCENES[0].load) {
+    SCENES[0].load();
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    printf("Usage: %s <golden dir> <report.json> [--update] "
+           "[--render-thread] [--recording] [--software]\n",
+           argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  static TestState state = {0};
+  state.goldenDir = argv[1];
+  state.reportPath = argv[2];
+  snprintf(RECORDING_PATH, sizeof(RECORDING_PATH), "%s.recording",
+           state.reportPath);
+
+  for (int i = 3; i < argc; ++i) {
+    if (strcmp(argv[i], "--update") == 0) {
+      state.update = 1;
+    } else if (strcmp(argv[i], "--render-thread") == 0) {
+      SDSetRenderThread(1);
+    } else if (strcmp(argv[i], "--recording") == 0) {
+      SDSetRenderBackend(SD_RENDER_BACKEND_RECORDING);
+      state.headless = 1;
+    } else if (strcmp(argv[i], "--software") == 0) {
+      SDSetRenderBackend(SD_RENDER_BACKEND_SOFTWARE);
+      state.software = 1;
+    }
+  }
+
+  SDSetWindowHidden(1);
+  SDSetGameState(&state);
+  SDSetLoadCallback((SDLoadCallback)Load);
+  SDSetUpdateCallback((SDUpdateCallback)Update);
+  SDSetRenderCallback((SDRenderCallback)Render);
+
+  SDRun();
+
+  return state.numFailure ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+/**
+ * Replay a frame written by SDRecordFrame over and over and report how long
+ * recording its commands takes on the CPU, to profile the renderer without
+ * the game. The first frames compile shaders and create buffers and are not
+ * timed. Debug builds also print the GL calls of the last frame. With --null
+ * it runs on the null backend, timing the renderer's CPU work alone, and with
+ * --software on the software backend, adding the rasterizer's.
+ *
+ * Usage: sword_replay <recording> [frames] [--render-thread] [--hidden]
+ *        [--null] [--software]
+ */
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sword/sword.h"
+
+#define NUM_WARM_UP_FRAME 10
+
+typedef struct ReplayState {
+  const char *path;
+  int numFrame;  // Timed frames to replay
+
+  SDFrameRecording *recording;
+  int frame;
+
+  // Of the replay call alone and of the whole frame, in seconds
+  double totalReplayTime;
+  double minReplayTime;
+  double maxReplayTime;
+  double totalCpuFrameTime;
+  int numStats;
+  int numDrawCall;
+} ReplayState;
+
+static void Load(ReplayState *state) {
+  state->recording = SDLoadFrameRecording(state->path);
+  if (!state->recording) {
+    printf("Failed to load %s\n", state->path);
+    exit(EXIT_FAILURE);
+  }
+
+  SDFrameRecordingInfo info = SDGetFrameRecordingInfo(state->recording);
+  printf("%s: %d calls, %d textures, %d materials, %d meshes\n", state->path,
+         info.numCall, info.numTexture, info.numMaterial, info.numMesh);
+  if (info.canvasWidth != SDGetCanvasWidth() ||
+      info.canvasHeight != SDGetCanvasHeight()) {
+    printf("Recorded on a %.0fx%.0f canvas, replaying on %.0fx%.0f\n",
+           info.canvasWidth, info.canvasHeight, SDGetCanvasWidth(),
+           SDGetCanvasHeight());
+  }
+
+  state->minReplayTime = 1e9;
+}
+
+static void Update(ReplayState *state) {
+  // Stats are of an earlier frame
+  if (state->frame > NUM_WARM_UP_FRAME) {
+    SDRenderStats stats = SDGetRenderStats();
+    state->totalCpuFrameTime += stats.cpuFrameTime;
+    state->numStats++;
+    state->numDrawCall = stats.numDrawCall;
+  }
+
+  if (state->frame == NUM_WARM_UP_FRAME + state->numFrame) {
+    SDDumpGLCallStats();
+    SDQuit();
+  }
+}
+
+static void Render(ReplayState *state) {
+  if (state->frame == NUM_WARM_UP_FRAME + state->numFrame) {
+    return;
+  }
+
+  Uint64 start = SDL_GetPerformanceCounter();
+  SDReplayFrameRecording(state->recording);
+  double time = (double)(SDL_GetPerformanceCounter() - start) /
+                SDL_GetPerformanceFrequency();
+
+  if (state->frame++ < NUM_WARM_UP_FRAME) {
+    return;
+  }
+
+  state->totalReplayTime += time;
+  if (time < state->minReplayTime) {
+    state->minReplayTime = time;
+  }
+  if (time > state->maxReplayTime) {
+    state->maxReplayTime = time;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    printf("Usage: %s <recording> [frames] [--render-thread] [--hidden] "
+           "[--null] [--software]\n",
+           argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  static ReplayState state = {0};
+  state.path = argv[1];
+  state.numFrame = 300;
+
+  for (int i = 2; i < argc; ++i) {
+    if (strcmp(argv[i], "--render-thread") == 0) {
+      SDSetRenderThread(1);
+    } else if (strcmp(argv[i], "--hidden") == 0) {
+      SDSetWindowHidden(1);
+    } else if (strcmp(argv[i], "--null") == 0) {
+      SDSetRenderBackend(SD_RENDER_BACKEND_NULL);
+    } else if (strcmp(argv[i], "--software") == 0) {
+      SDSetRenderBackend(SD_RENDER_BACKEND_SOFTWARE);
+    } else if (atoi(argv[i]) > 0) {
+      state.numFrame = atoi(argv[i]);
+    }
+  }
+
+  SDSetGameState(&state);
+  SDSetLoadCallback((SDLoadCallback)Load);
+  SDSetUpdateCallback((SDUpdateCallback)Update);
+  SDSetRenderCallback((SDRenderCallback)Render);
+
+  SDRun();
+
+  printf("Replayed %d frames, %d draw calls per frame\n", state.numFrame,
+         state.numDrawCall);
+  printf("Replay:    avg %.3f ms, min %.3f ms, max %.3f ms\n",
+         state.totalReplayTime / state.numFrame * 1000.0,
+         state.minReplayTime * 1000.0, state.maxReplayTime * 1000.0);
+  printf("CPU frame: avg %.3f ms\n",
+         state.numStats > 0 ? state.totalCpuFrameTime / state.numStats * 1000.0
+                            : 0.0);
+
+  return EXIT_SUCCESS;
+}